@@ -0,0 +1,50 @@
+#pragma once
+#ifndef PLAYGROUND_BENCHMARK_HPP
+#define PLAYGROUND_BENCHMARK_HPP
+
+// Minimal timing helpers for the *_bench.cpp programs in the playground.
+// Benchmarks are ordinary single file applications: build and run them with
+// ./run.sh path/to/something_bench.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Keeps the optimizer from discarding a value that is only computed to be
+// timed.
+template <class T> inline void keep(T const &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r"(&value) : "memory");
+#else
+  static const void *volatile sink;
+  sink = &value;
+#endif
+}
+
+// Runs fn repeatedly for at least minSeconds (and at least minRuns times) and
+// returns the median time of a single call, in seconds.
+template <class Function>
+double measure(Function &&fn, double minSeconds = 0.2, int minRuns = 5) {
+  fn(); // warm up caches and lazily allocated buffers
+  std::vector<double> runs;
+  auto start = Clock::now();
+  while (secondsSince(start) < minSeconds || (int)runs.size() < minRuns) {
+    auto t = Clock::now();
+    fn();
+    runs.push_back(secondsSince(t));
+  }
+  std::sort(runs.begin(), runs.end());
+  return runs[runs.size() / 2];
+}
+
+} // namespace bench
+
+#endif // PLAYGROUND_BENCHMARK_HPP
@@ -0,0 +1,97 @@
+#pragma once
+#ifndef PLAYGROUND_MAPPED_FILE_HPP
+#define PLAYGROUND_MAPPED_FILE_HPP
+
+// Read-only memory mapping of a whole file.
+//
+// The operating system pages the file in on demand, straight from its cache,
+// so "loading" a large binary file costs a page fault per page touched
+// instead of a read() into a buffer plus a copy.
+
+#include <cstddef>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &path) { open(path); }
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Maps the file at path, replacing any file mapped before. Returns false if
+  // it cannot be opened or is empty.
+  bool open(const std::string &path) {
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+      HANDLE mapping =
+          CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping) {
+        mData = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // the view keeps the mapping alive
+      }
+      mSize = mData ? size_t(size.QuadPart) : 0;
+    }
+    CloseHandle(file);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void *data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE,
+                        fd, 0);
+      if (data != MAP_FAILED) {
+        mData = data;
+        mSize = size_t(info.st_size);
+      }
+    }
+    ::close(fd); // the mapping stays valid
+#endif
+    return mData != nullptr;
+  }
+
+  void close() {
+    if (mData) {
+#if defined(_WIN32)
+      UnmapViewOfFile(mData);
+#else
+      munmap(mData, mSize);
+#endif
+    }
+    mData = nullptr;
+    mSize = 0;
+  }
+
+  bool isOpen() const { return mData != nullptr; }
+  const void *data() const { return mData; }
+  size_t size() const { return mSize; }
+
+private:
+  void *mData{nullptr};
+  size_t mSize{0};
+};
+
+#endif // PLAYGROUND_MAPPED_FILE_HPP
@@ -0,0 +1,212 @@
+#pragma once
+#ifndef PLAYGROUND_MESH_NORMALS_HPP
+#define PLAYGROUND_MESH_NORMALS_HPP
+
+// Vertex normals of a triangle mesh whose vertices move but whose triangles
+// stay the same, as a replacement for calling Mesh::generateNormals() every
+// frame.
+//
+// The faces around every vertex are found once, when the triangles are set,
+// and stored in compressed sparse row form. update() then compares the
+// positions with those of the previous update and only recomputes the faces
+// around the vertices that moved, and the normals of the vertices of those
+// faces. When most of the mesh moved it recomputes everything instead, which
+// skips the bookkeeping. Both passes (faces, then vertices) run in chunks
+// across a ThreadPool, and every vertex sums its faces in the order of the
+// triangles, so the normals are the same bit for bit as a full sweep that
+// accumulates the area weighted face normals like generateNormals() does.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/ThreadPool.hpp"
+
+class MeshNormals {
+public:
+  // Triangles as triples of indices into numVertices vertices
+  void setTriangles(int numVertices, const unsigned *indices,
+                    size_t numIndices) {
+    mNumVertices = numVertices;
+    mTriangles.assign(indices, indices + numIndices - numIndices % 3);
+    const size_t numFaces = mTriangles.size() / 3;
+    mOffsets.assign(size_t(numVertices) + 1, 0);
+    for (unsigned v : mTriangles) {
+      mOffsets[v + 1]++;
+    }
+    for (int v = 0; v < numVertices; v++) {
+      mOffsets[v + 1] += mOffsets[v];
+    }
+    mFacesOfVertex.resize(mTriangles.size());
+    std::vector<int> fill(mOffsets.begin(), mOffsets.end() - 1);
+    for (size_t f = 0; f < numFaces; f++) {
+      for (int k = 0; k < 3; k++) {
+        mFacesOfVertex[fill[mTriangles[f * 3 + k]]++] = int(f);
+      }
+    }
+    mFaceNormals.assign(numFaces * 3, 0.0f);
+    mFaceStamp.assign(numFaces, 0);
+    mVertexStamp.assign(size_t(numVertices), 0);
+    mLast.clear();
+  }
+
+  // Recomputes the normals (x, y, z per vertex) around the vertices that
+  // moved since the last update. The first update computes all of them.
+  void update(const float *positions, float *normals, ThreadPool &pool) {
+    const size_t n = size_t(mNumVertices);
+    if (mLast.size() != n * 3) {
+      updateAll(positions, normals, pool);
+      return;
+    }
+    // Find the moved vertices, one list per worker
+    mMoved.resize(pool.size());
+    for (auto &list : mMoved) {
+      list.clear();
+    }
+    const size_t chunks = (n + kChunk - 1) / kChunk;
+    pool.parallelFor(chunks, [&](size_t c, unsigned worker) {
+      const size_t end = std::min(n, (c + 1) * kChunk);
+      float *last = mLast.data();
+      for (size_t v = c * kChunk; v < end; v++) {
+        const float *p = positions + v * 3;
+        if (p[0] != last[v * 3] || p[1] != last[v * 3 + 1] ||
+            p[2] != last[v * 3 + 2]) {
+          last[v * 3] = p[0];
+          last[v * 3 + 1] = p[1];
+          last[v * 3 + 2] = p[2];
+          mMoved[worker].push_back(int(v));
+        }
+      }
+    });
+    size_t moved = 0;
+    for (auto &list : mMoved) {
+      moved += list.size();
+    }
+    mLastMoved = moved;
+    if (moved * 4 > n) {
+      computeAll(positions, normals, pool);
+      return;
+    }
+
+    // Faces around the moved vertices, and the vertices of those faces
+    if (++mEpoch == 0) {
+      std::fill(mFaceStamp.begin(), mFaceStamp.end(), 0);
+      std::fill(mVertexStamp.begin(), mVertexStamp.end(), 0);
+      mEpoch = 1;
+    }
+    mFaces.clear();
+    for (auto &list : mMoved) {
+      for (int v : list) {
+        for (int k = mOffsets[v]; k < mOffsets[v + 1]; k++) {
+          const int f = mFacesOfVertex[k];
+          if (mFaceStamp[f] != mEpoch) {
+            mFaceStamp[f] = mEpoch;
+            mFaces.push_back(f);
+          }
+        }
+      }
+    }
+    mVertices.clear();
+    for (int f : mFaces) {
+      for (int k = 0; k < 3; k++) {
+        const int v = int(mTriangles[f * 3 + k]);
+        if (mVertexStamp[v] != mEpoch) {
+          mVertexStamp[v] = mEpoch;
+          mVertices.push_back(v);
+        }
+      }
+    }
+    forEachChunk(pool, mFaces.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        faceNormal(positions, mFaces[i]);
+      }
+    });
+    forEachChunk(pool, mVertices.size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        vertexNormal(normals, mVertices[i]);
+      }
+    });
+  }
+
+  // Recomputes every normal
+  void updateAll(const float *positions, float *normals, ThreadPool &pool) {
+    mLast.assign(positions, positions + size_t(mNumVertices) * 3);
+    mLastMoved = size_t(mNumVertices);
+    computeAll(positions, normals, pool);
+  }
+
+  int size() const { return mNumVertices; }
+
+  // Number of vertices that moved in the last update
+  size_t lastMoved() const { return mLastMoved; }
+
+private:
+  static const size_t kChunk = 4096;
+
+  template <class Function>
+  static void forEachChunk(ThreadPool &pool, size_t count, Function &&fn) {
+    const size_t chunks = (count + kChunk - 1) / kChunk;
+    pool.parallelFor(chunks, [&](size_t c, unsigned) {
+      fn(c * kChunk, std::min(count, (c + 1) * kChunk));
+    });
+  }
+
+  void computeAll(const float *positions, float *normals, ThreadPool &pool) {
+    forEachChunk(pool, mTriangles.size() / 3, [&](size_t begin, size_t end) {
+      for (size_t f = begin; f < end; f++) {
+        faceNormal(positions, int(f));
+      }
+    });
+    forEachChunk(pool, size_t(mNumVertices), [&](size_t begin, size_t end) {
+      for (size_t v = begin; v < end; v++) {
+        vertexNormal(normals, int(v));
+      }
+    });
+  }
+
+  // Area weighted normal of face f
+  void faceNormal(const float *positions, int f) {
+    const float *a = positions + mTriangles[f * 3] * 3;
+    const float *b = positions + mTriangles[f * 3 + 1] * 3;
+    const float *c = positions + mTriangles[f * 3 + 2] * 3;
+    const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float *n = &mFaceNormals[size_t(f) * 3];
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+  }
+
+  // Normalized sum of the normals of the faces around vertex v
+  void vertexNormal(float *normals, int v) {
+    float x = 0, y = 0, z = 0;
+    for (int k = mOffsets[v]; k < mOffsets[v + 1]; k++) {
+      const float *n = &mFaceNormals[size_t(mFacesOfVertex[k]) * 3];
+      x += n[0];
+      y += n[1];
+      z += n[2];
+    }
+    const float length = std::sqrt(x * x + y * y + z * z);
+    const float s = length > 0 ? 1 / length : 0;
+    normals[v * 3] = x * s;
+    normals[v * 3 + 1] = y * s;
+    normals[v * 3 + 2] = z * s;
+  }
+
+  int mNumVertices{0};
+  std::vector<unsigned> mTriangles;
+  std::vector<int> mOffsets, mFacesOfVertex; // faces around each vertex
+  std::vector<float> mFaceNormals;
+  std::vector<float> mLast; // positions of the last update
+  size_t mLastMoved{0};
+
+  // Scratch of update()
+  std::vector<std::vector<int>> mMoved;
+  std::vector<int> mFaces, mVertices;
+  std::vector<uint32_t> mFaceStamp, mVertexStamp;
+  uint32_t mEpoch{0};
+};
+
+#endif // PLAYGROUND_MESH_NORMALS_HPP
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef PLAYGROUND_POINT_BUFFER_HPP
+#define PLAYGROUND_POINT_BUFFER_HPP
+
+// Persistent per-vertex attribute arrays for meshes whose vertices are
+// rewritten every frame (particles, boids).
+//
+// Rebuilding an al::Mesh with reset() pushes every vertex and color again,
+// and drawing it uploads all attributes. Here the arrays keep their size
+// between frames: positions are mapped and written in place every frame,
+// while colors, packed as RGBA8, are only mapped (and uploaded) when they
+// change.
+//
+// PointMesh (cookbook/simulation/PointMesh.hpp) maps the arrays straight from
+// OpenGL vertex buffers. PointBuffer has the same interface in plain memory,
+// so code writing the arrays can be used and timed without a GL context.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace point_color {
+
+// Packs a color in [0, 1] into RGBA8, in memory order r, g, b, a
+inline uint32_t rgba(float r, float g, float b, float a = 1.0f) {
+  auto byte = [](float x) {
+    return uint32_t(std::min(std::max(x, 0.0f), 1.0f) * 255.0f + 0.5f);
+  };
+  const uint32_t bytes[4] = {byte(r), byte(g), byte(b), byte(a)};
+  uint32_t packed;
+  unsigned char *out = reinterpret_cast<unsigned char *>(&packed);
+  for (int i = 0; i < 4; i++) {
+    out[i] = (unsigned char)bytes[i];
+  }
+  return packed;
+}
+
+// Same conversion as al::HSV to al::RGB: hue wraps, saturation and value in
+// [0, 1]
+inline uint32_t hsv(float h, float s, float v, float a = 1.0f) {
+  h = (h - std::floor(h)) * 6.0f;
+  const int sector = std::min(int(h), 5);
+  const float f = h - sector;
+  const float p = v * (1.0f - s);
+  const float q = v * (1.0f - s * f);
+  const float t = v * (1.0f - s * (1.0f - f));
+  switch (sector) {
+  case 0:
+    return rgba(v, t, p, a);
+  case 1:
+    return rgba(q, v, p, a);
+  case 2:
+    return rgba(p, v, t, a);
+  case 3:
+    return rgba(p, q, v, a);
+  case 4:
+    return rgba(t, p, v, a);
+  default:
+    return rgba(v, p, q, a);
+  }
+}
+
+} // namespace point_color
+
+class PointBuffer {
+public:
+  // Number of vertices. Storage only grows. Changing the count invalidates
+  // the colors, see colorsValid().
+  void resize(size_t count) {
+    if (count > mCapacity) {
+      mCapacity = std::max(count, mCapacity + mCapacity / 2);
+      mPositions.resize(mCapacity * 3);
+      mColors.resize(mCapacity);
+    }
+    if (count != mCount) {
+      mCount = count;
+      mColorsValid = false;
+    }
+  }
+
+  size_t size() const { return mCount; }
+
+  // x, y, z per vertex. Every position must be written before unmapping.
+  float *mapPositions() { return mPositions.data(); }
+  void unmapPositions() {}
+
+  // Packed RGBA8 per vertex (see point_color). Every color must be written
+  // before unmapping.
+  uint32_t *mapColors() { return mColors.data(); }
+  void unmapColors() { mColorsValid = true; }
+
+  // False after resize() until the colors have been written again
+  bool colorsValid() const { return mColorsValid; }
+
+  const float *positions() const { return mPositions.data(); }
+  const uint32_t *colors() const { return mColors.data(); }
+
+private:
+  std::vector<float> mPositions;
+  std::vector<uint32_t> mColors;
+  size_t mCount{0};
+  size_t mCapacity{0};
+  bool mColorsValid{false};
+};
+
+#endif // PLAYGROUND_POINT_BUFFER_HPP
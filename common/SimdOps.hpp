@@ -0,0 +1,409 @@
+#pragma once
+#ifndef PLAYGROUND_SIMD_OPS_HPP
+#define PLAYGROUND_SIMD_OPS_HPP
+
+// Small block kernels shared by the playground applications.
+//
+// Every function works on plain float arrays so it can be called on
+// AudioIOData buffers, mesh attribute arrays or scratch memory alike. SSE is
+// used on x86 and NEON on ARM; other targets get a scalar loop that the
+// compiler is free to vectorize. Arrays need no particular alignment.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLAYGROUND_SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PLAYGROUND_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace simd {
+
+// out[i] += in[i] * gain
+inline void addScaled(float *out, const float *in, float gain, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 4 <= n; i += 4) {
+    __m128 o = _mm_loadu_ps(out + i);
+    o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+    _mm_storeu_ps(out + i, o);
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const float32x4_t g = vdupq_n_f32(gain);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), vld1q_f32(in + i), g));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] += in[i] * gain;
+  }
+}
+
+// out[i] += in[i] * (gain0 + i * step)
+// Applies a linear gain ramp; with step = (gain1 - gain0) / n the ramp ends
+// one step short of gain1, so the next block can start exactly at gain1.
+inline void addRamp(float *out, const float *in, float gain0, float step,
+                    size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  __m128 g = _mm_add_ps(_mm_set1_ps(gain0),
+                        _mm_mul_ps(_mm_set1_ps(step),
+                                   _mm_set_ps(3.f, 2.f, 1.f, 0.f)));
+  const __m128 dg = _mm_set1_ps(4.f * step);
+  for (; i + 4 <= n; i += 4) {
+    __m128 o = _mm_loadu_ps(out + i);
+    o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+    _mm_storeu_ps(out + i, o);
+    g = _mm_add_ps(g, dg);
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const float offsets[4] = {0.f, 1.f, 2.f, 3.f};
+  float32x4_t g =
+      vmlaq_n_f32(vdupq_n_f32(gain0), vld1q_f32(offsets), step);
+  const float32x4_t dg = vdupq_n_f32(4.f * step);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), vld1q_f32(in + i), g));
+    g = vaddq_f32(g, dg);
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] += in[i] * (gain0 + step * i);
+  }
+}
+
+// out[i] += in[i]
+inline void add(float *out, const float *in, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(out + i,
+                  _mm_add_ps(_mm_loadu_ps(out + i), _mm_loadu_ps(in + i)));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vld1q_f32(in + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] += in[i];
+  }
+}
+
+// buf[i] *= gain
+inline void scale(float *buf, float gain, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(buf + i, vmulq_n_f32(vld1q_f32(buf + i), gain));
+  }
+#endif
+  for (; i < n; ++i) {
+    buf[i] *= gain;
+  }
+}
+
+// buf[i] *= gain0 + i * step (see addRamp())
+inline void scaleRamp(float *buf, float gain0, float step, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  __m128 g = _mm_add_ps(_mm_set1_ps(gain0),
+                        _mm_mul_ps(_mm_set1_ps(step),
+                                   _mm_set_ps(3.f, 2.f, 1.f, 0.f)));
+  const __m128 dg = _mm_set1_ps(4.f * step);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+    g = _mm_add_ps(g, dg);
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const float offsets[4] = {0.f, 1.f, 2.f, 3.f};
+  float32x4_t g =
+      vmlaq_n_f32(vdupq_n_f32(gain0), vld1q_f32(offsets), step);
+  const float32x4_t dg = vdupq_n_f32(4.f * step);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), g));
+    g = vaddq_f32(g, dg);
+  }
+#endif
+  for (; i < n; ++i) {
+    buf[i] *= gain0 + step * i;
+  }
+}
+
+// (a[i], b[i]) = (a[i] + b[i], a[i] - b[i]), one butterfly of a Hadamard
+// transform
+inline void sumDiff(float *a, float *b, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  for (; i + 4 <= n; i += 4) {
+    __m128 x = _mm_loadu_ps(a + i);
+    __m128 y = _mm_loadu_ps(b + i);
+    _mm_storeu_ps(a + i, _mm_add_ps(x, y));
+    _mm_storeu_ps(b + i, _mm_sub_ps(x, y));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t x = vld1q_f32(a + i);
+    float32x4_t y = vld1q_f32(b + i);
+    vst1q_f32(a + i, vaddq_f32(x, y));
+    vst1q_f32(b + i, vsubq_f32(x, y));
+  }
+#endif
+  for (; i < n; ++i) {
+    float x = a[i];
+    a[i] = x + b[i];
+    b[i] = x - b[i];
+  }
+}
+
+// Returns max(|in[i]|)
+inline float absMax(const float *in, size_t n) {
+  size_t i = 0;
+  float peak = 0.0f;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 p = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    p = _mm_max_ps(p, _mm_and_ps(_mm_loadu_ps(in + i), absMask));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, p);
+  peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  peak = peak > lanes[2] ? peak : lanes[2];
+  peak = peak > lanes[3] ? peak : lanes[3];
+#elif defined(PLAYGROUND_SIMD_NEON)
+  float32x4_t p = vdupq_n_f32(0.f);
+  for (; i + 4 <= n; i += 4) {
+    p = vmaxq_f32(p, vabsq_f32(vld1q_f32(in + i)));
+  }
+  float lanes[4];
+  vst1q_f32(lanes, p);
+  peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  peak = peak > lanes[2] ? peak : lanes[2];
+  peak = peak > lanes[3] ? peak : lanes[3];
+#endif
+  for (; i < n; ++i) {
+    float a = in[i] < 0.0f ? -in[i] : in[i];
+    peak = a > peak ? a : peak;
+  }
+  return peak;
+}
+
+// buf[i] = min(max(buf[i], -limit), limit)
+inline void clamp(float *buf, float limit, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 hi = _mm_set1_ps(limit);
+  const __m128 lo = _mm_set1_ps(-limit);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(buf + i,
+                  _mm_min_ps(_mm_max_ps(_mm_loadu_ps(buf + i), lo), hi));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const float32x4_t hi = vdupq_n_f32(limit);
+  const float32x4_t lo = vdupq_n_f32(-limit);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(buf + i, vminq_f32(vmaxq_f32(vld1q_f32(buf + i), lo), hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    buf[i] = buf[i] < -limit ? -limit : (buf[i] > limit ? limit : buf[i]);
+  }
+}
+
+// Returns max(|in[i]|) and adds sum(in[i] * in[i]) to sumSquares, in a single
+// pass over the buffer.
+inline float peakAndSumSquares(const float *in, size_t n, float &sumSquares) {
+  size_t i = 0;
+  float peak = 0.0f;
+  float sum = 0.0f;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 p0 = _mm_setzero_ps(), p1 = _mm_setzero_ps();
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    __m128 a = _mm_loadu_ps(in + i);
+    __m128 b = _mm_loadu_ps(in + i + 4);
+    p0 = _mm_max_ps(p0, _mm_and_ps(a, absMask));
+    p1 = _mm_max_ps(p1, _mm_and_ps(b, absMask));
+    s0 = _mm_add_ps(s0, _mm_mul_ps(a, a));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(b, b));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_max_ps(p0, p1));
+  peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  peak = peak > lanes[2] ? peak : lanes[2];
+  peak = peak > lanes[3] ? peak : lanes[3];
+  _mm_storeu_ps(lanes, _mm_add_ps(s0, s1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(PLAYGROUND_SIMD_NEON)
+  float32x4_t p0 = vdupq_n_f32(0.f), p1 = vdupq_n_f32(0.f);
+  float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t a = vld1q_f32(in + i);
+    float32x4_t b = vld1q_f32(in + i + 4);
+    p0 = vmaxq_f32(p0, vabsq_f32(a));
+    p1 = vmaxq_f32(p1, vabsq_f32(b));
+    s0 = vmlaq_f32(s0, a, a);
+    s1 = vmlaq_f32(s1, b, b);
+  }
+  float lanes[4];
+  vst1q_f32(lanes, vmaxq_f32(p0, p1));
+  peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+  peak = peak > lanes[2] ? peak : lanes[2];
+  peak = peak > lanes[3] ? peak : lanes[3];
+  vst1q_f32(lanes, vaddq_f32(s0, s1));
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; i < n; ++i) {
+    float a = in[i] < 0.0f ? -in[i] : in[i];
+    peak = a > peak ? a : peak;
+    sum += in[i] * in[i];
+  }
+  sumSquares += sum;
+  return peak;
+}
+
+// vel[i] += acc[i], then pos[i] += vel[i]: one explicit Euler step with unit
+// time step, as particle systems integrate
+inline void integrate(float *pos, float *vel, const float *acc, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  for (; i + 8 <= n; i += 8) {
+    __m128 v0 = _mm_add_ps(_mm_loadu_ps(vel + i), _mm_loadu_ps(acc + i));
+    __m128 v1 =
+        _mm_add_ps(_mm_loadu_ps(vel + i + 4), _mm_loadu_ps(acc + i + 4));
+    _mm_storeu_ps(vel + i, v0);
+    _mm_storeu_ps(vel + i + 4, v1);
+    _mm_storeu_ps(pos + i, _mm_add_ps(_mm_loadu_ps(pos + i), v0));
+    _mm_storeu_ps(pos + i + 4, _mm_add_ps(_mm_loadu_ps(pos + i + 4), v1));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t v0 = vaddq_f32(vld1q_f32(vel + i), vld1q_f32(acc + i));
+    float32x4_t v1 = vaddq_f32(vld1q_f32(vel + i + 4), vld1q_f32(acc + i + 4));
+    vst1q_f32(vel + i, v0);
+    vst1q_f32(vel + i + 4, v1);
+    vst1q_f32(pos + i, vaddq_f32(vld1q_f32(pos + i), v0));
+    vst1q_f32(pos + i + 4, vaddq_f32(vld1q_f32(pos + i + 4), v1));
+  }
+#endif
+  for (; i < n; ++i) {
+    vel[i] += acc[i];
+    pos[i] += vel[i];
+  }
+}
+
+// out[i] = a[i] * b[i], as when applying a window
+inline void multiply(float *out, const float *a, const float *b, size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(out + i,
+                  _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(out + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = a[i] * b[i];
+  }
+}
+
+// out[i] = sqrt(re[i] * re[i] + im[i] * im[i]), the magnitudes of complex
+// numbers stored as separate real and imaginary arrays
+inline void magnitude(float *out, const float *re, const float *im,
+                      size_t n) {
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  for (; i + 4 <= n; i += 4) {
+    const __m128 x = _mm_loadu_ps(re + i);
+    const __m128 y = _mm_loadu_ps(im + i);
+    _mm_storeu_ps(out + i,
+                  _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON) && defined(__aarch64__)
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t x = vld1q_f32(re + i);
+    const float32x4_t y = vld1q_f32(im + i);
+    vst1q_f32(out + i, vsqrtq_f32(vmlaq_f32(vmulq_f32(x, x), y, y)));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = std::sqrt(re[i] * re[i] + im[i] * im[i]);
+  }
+}
+
+// buf[i] = log2(buf[i]) for buf[i] > 0, to within 2e-5 (about 1e-4 dB).
+// The exponent is read off the bits and the log of the mantissa, in [1, 2),
+// comes from a polynomial. Zero gives -127, the exponent of the smallest
+// normal float.
+inline void log2(float *buf, size_t n) {
+  const float c1 = 1.44196574f, c2 = -0.709664322f, c3 = 0.417601311f,
+              c4 = -0.196277364f, c5 = 0.0463889911f;
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+  const __m128i one = _mm_set1_epi32(0x3f800000);
+  const __m128i bias = _mm_set1_epi32(127);
+  for (; i + 4 <= n; i += 4) {
+    const __m128i bits = _mm_castps_si128(_mm_loadu_ps(buf + i));
+    const __m128 e = _mm_cvtepi32_ps(
+        _mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+    const __m128 t = _mm_sub_ps(
+        _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), one)),
+        _mm_set1_ps(1.0f));
+    __m128 p = _mm_set1_ps(c5);
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c4));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c3));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c2));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(c1));
+    _mm_storeu_ps(buf + i, _mm_add_ps(e, _mm_mul_ps(p, t)));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const uint32x4_t mantissaMask = vdupq_n_u32(0x007fffff);
+  const uint32x4_t one = vdupq_n_u32(0x3f800000);
+  for (; i + 4 <= n; i += 4) {
+    const uint32x4_t bits = vreinterpretq_u32_f32(vld1q_f32(buf + i));
+    const float32x4_t e = vcvtq_f32_s32(vsubq_s32(
+        vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+    const float32x4_t t = vsubq_f32(
+        vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissaMask), one)),
+        vdupq_n_f32(1.0f));
+    float32x4_t p = vdupq_n_f32(c5);
+    p = vaddq_f32(vmulq_f32(p, t), vdupq_n_f32(c4));
+    p = vaddq_f32(vmulq_f32(p, t), vdupq_n_f32(c3));
+    p = vaddq_f32(vmulq_f32(p, t), vdupq_n_f32(c2));
+    p = vaddq_f32(vmulq_f32(p, t), vdupq_n_f32(c1));
+    vst1q_f32(buf + i, vaddq_f32(e, vmulq_f32(p, t)));
+  }
+#endif
+  for (; i < n; ++i) {
+    uint32_t bits;
+    std::memcpy(&bits, buf + i, sizeof(bits));
+    const float e = float(int32_t(bits >> 23) - 127);
+    const uint32_t mantissa = (bits & 0x007fffffu) | 0x3f800000u;
+    float t;
+    std::memcpy(&t, &mantissa, sizeof(t));
+    t -= 1.0f;
+    const float p = (((c5 * t + c4) * t + c3) * t + c2) * t + c1;
+    buf[i] = e + p * t;
+  }
+}
+
+} // namespace simd
+
+#endif // PLAYGROUND_SIMD_OPS_HPP
@@ -0,0 +1,95 @@
+#pragma once
+#ifndef PLAYGROUND_SPSC_QUEUE_HPP
+#define PLAYGROUND_SPSC_QUEUE_HPP
+
+// Lock-free single producer / single consumer queue of fixed capacity.
+//
+// push() and pop() never wait or allocate, so either end can be the audio
+// callback: a UI thread sending commands to it, or the callback handing
+// results back. The producer publishes an element with a release store of
+// the tail index and the consumer frees its slot with a release store of the
+// head, so whatever the element points to is visible on the other side.
+// Blocks of elements, such as audio samples, can go through in one call.
+// Capacity is a power of two; the indices run freely and wrap around.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+template <class T, size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of two");
+
+public:
+  SpscQueue() = default;
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  // Producer side. Returns false if the queue is full.
+  bool push(const T &value) {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    mItems[tail & (Capacity - 1)] = value;
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the queue is empty.
+  bool pop(T &value) {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = mItems[head & (Capacity - 1)];
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer side: pushes as many of the n values as there is room for, in
+  // order, with a single release of the tail. Returns how many it pushed.
+  size_t push(const T *values, size_t n) {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    const size_t head = mHead.load(std::memory_order_acquire);
+    const size_t room = Capacity - (tail - head);
+    n = n < room ? n : room;
+    const size_t at = tail & (Capacity - 1);
+    const size_t first = n < Capacity - at ? n : Capacity - at;
+    std::copy(values, values + first, mItems + at);
+    std::copy(values + first, values + n, mItems);
+    mTail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer side: pops up to n values into values, oldest first. Returns
+  // how many it popped.
+  size_t pop(T *values, size_t n) {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    const size_t waiting = mTail.load(std::memory_order_acquire) - head;
+    n = n < waiting ? n : waiting;
+    const size_t at = head & (Capacity - 1);
+    const size_t first = n < Capacity - at ? n : Capacity - at;
+    std::copy(mItems + at, mItems + at + first, values);
+    std::copy(mItems, mItems + (n - first), values + first);
+    mHead.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // Elements waiting; exact only when called from one of the two ends
+  // while the other is idle
+  size_t size() const {
+    return mTail.load(std::memory_order_acquire) -
+           mHead.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  // On separate cache lines so the two ends don't slow each other down
+  alignas(64) std::atomic<size_t> mHead{0}; // written by the consumer
+  alignas(64) std::atomic<size_t> mTail{0}; // written by the producer
+  T mItems[Capacity] = {}; // touched here, not first on the audio thread
+};
+
+#endif // PLAYGROUND_SPSC_QUEUE_HPP
@@ -0,0 +1,235 @@
+#pragma once
+#ifndef PLAYGROUND_THREAD_POOL_HPP
+#define PLAYGROUND_THREAD_POOL_HPP
+
+// Fork-join thread pool for splitting per-frame or per-block work across
+// cores.
+//
+// parallelFor() splits the indices into chunks and gives every worker an equal,
+// contiguous share of them. Workers take chunks from the front of their own
+// share and, once it is empty, steal chunks from the back of the others', so
+// faster threads simply do more. The calling thread works too (as worker 0)
+// and the call returns once every index has been processed. Dispatching does
+// not allocate, and waiting workers spin briefly before going to sleep, so the
+// pool can be driven from the audio callback.
+//
+// Only one thread at a time may call parallelFor() on a given pool.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+class ThreadPool {
+public:
+  // numThreads counts the calling thread; 0 uses every hardware thread.
+  // With realtime set, helper threads ask for real-time scheduling (this
+  // silently does nothing without the required privileges).
+  explicit ThreadPool(unsigned numThreads = 0, bool realtime = false) {
+    if (numThreads == 0) {
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mNumWorkers = numThreads;
+    mShares.reset(new Share[numThreads]);
+    for (unsigned i = 1; i < numThreads; i++) {
+      mThreads.emplace_back([this, i]() { workerLoop(i); });
+      if (realtime) {
+        raisePriority(mThreads.back());
+      }
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lk(mMutex);
+      mStop = true;
+      mGeneration.fetch_add(1);
+    }
+    mWake.notify_all();
+    for (auto &t : mThreads) {
+      t.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of threads that execute work, including the caller
+  unsigned size() const { return mNumWorkers; }
+
+  // How many times an idle worker polls for new work before sleeping
+  void spinIterations(unsigned count) { mSpinIterations = count; }
+
+  // Calls fn(index, worker) for every index in [0, count). Indices are
+  // handed out grain at a time; worker is in [0, size()). Which worker runs
+  // which index varies from call to call, so results that must not depend
+  // on the thread count should only depend on index.
+  template <class Function>
+  void parallelFor(size_t count, Function &&fn, size_t grain = 1) {
+    if (count == 0) {
+      return;
+    }
+    if (mNumWorkers == 1 || count <= grain) {
+      for (size_t i = 0; i < count; i++) {
+        fn(i, 0u);
+      }
+      return;
+    }
+    using F = typename std::remove_reference<Function>::type;
+    mInvoke = [](void *context, size_t begin, size_t end, unsigned worker) {
+      F &f = *static_cast<F *>(context);
+      for (size_t i = begin; i < end; i++) {
+        f(i, worker);
+      }
+    };
+    mContext = const_cast<void *>(static_cast<const void *>(&fn));
+    mCount = count;
+    mGrain = grain;
+    const uint64_t numChunks = (count + grain - 1) / grain;
+    for (unsigned w = 0; w < mNumWorkers; w++) {
+      uint64_t begin = numChunks * w / mNumWorkers;
+      uint64_t end = numChunks * (w + 1) / mNumWorkers;
+      mShares[w].span.store(pack(begin, end), std::memory_order_relaxed);
+    }
+    mPending.store(mNumWorkers - 1, std::memory_order_relaxed);
+
+    mGeneration.fetch_add(1); // publishes the job
+    if (mSleeping.load() > 0) {
+      { std::lock_guard<std::mutex> lk(mMutex); }
+      mWake.notify_all();
+    }
+
+    runChunks(0);
+    unsigned spins = 0;
+    while (mPending.load(std::memory_order_acquire) != 0) {
+      if (++spins > mSpinIterations) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  // Chunk range [begin, end) of a worker's share, packed in one word so it
+  // can be updated with a single compare and swap
+  static uint64_t pack(uint64_t begin, uint64_t end) {
+    return (end << 32) | begin;
+  }
+
+  bool takeFront(unsigned owner, uint64_t &chunk) {
+    auto &span = mShares[owner].span;
+    uint64_t s = span.load(std::memory_order_relaxed);
+    while (true) {
+      uint64_t begin = s & 0xffffffffu, end = s >> 32;
+      if (begin >= end) {
+        return false;
+      }
+      if (span.compare_exchange_weak(s, pack(begin + 1, end),
+                                     std::memory_order_acq_rel)) {
+        chunk = begin;
+        return true;
+      }
+    }
+  }
+
+  bool takeBack(unsigned victim, uint64_t &chunk) {
+    auto &span = mShares[victim].span;
+    uint64_t s = span.load(std::memory_order_relaxed);
+    while (true) {
+      uint64_t begin = s & 0xffffffffu, end = s >> 32;
+      if (begin >= end) {
+        return false;
+      }
+      if (span.compare_exchange_weak(s, pack(begin, end - 1),
+                                     std::memory_order_acq_rel)) {
+        chunk = end - 1;
+        return true;
+      }
+    }
+  }
+
+  void runChunk(uint64_t chunk, unsigned worker) {
+    size_t begin = size_t(chunk) * mGrain;
+    size_t end = std::min(begin + mGrain, mCount);
+    mInvoke(mContext, begin, end, worker);
+  }
+
+  void runChunks(unsigned worker) {
+    uint64_t chunk;
+    while (takeFront(worker, chunk)) {
+      runChunk(chunk, worker);
+    }
+    for (unsigned i = 1; i < mNumWorkers; i++) {
+      unsigned victim = (worker + i) % mNumWorkers;
+      while (takeBack(victim, chunk)) {
+        runChunk(chunk, worker);
+      }
+    }
+  }
+
+  void workerLoop(unsigned worker) {
+    uint64_t seen = 0;
+    while (true) {
+      unsigned spins = 0;
+      while (mGeneration.load() == seen && spins < mSpinIterations) {
+        spins++;
+      }
+      if (mGeneration.load() == seen) {
+        std::unique_lock<std::mutex> lk(mMutex);
+        mSleeping.fetch_add(1);
+        mWake.wait(lk, [&]() { return mGeneration.load() != seen; });
+        mSleeping.fetch_sub(1);
+      }
+      seen = mGeneration.load();
+      if (mStop) {
+        return;
+      }
+      runChunks(worker);
+      mPending.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  static void raisePriority(std::thread &t) {
+#if defined(__unix__) || defined(__APPLE__)
+    sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    pthread_setschedparam(t.native_handle(), SCHED_FIFO, &param);
+#else
+    (void)t;
+#endif
+  }
+
+  unsigned mNumWorkers{1};
+  std::atomic<unsigned> mSpinIterations{20000};
+  std::vector<std::thread> mThreads;
+
+  // Current job, written before mGeneration is incremented
+  void (*mInvoke)(void *, size_t, size_t, unsigned){nullptr};
+  void *mContext{nullptr};
+  size_t mCount{0};
+  size_t mGrain{1};
+  struct Share {
+    std::atomic<uint64_t> span{0};
+    char padding[56]; // one share per cache line
+  };
+  std::unique_ptr<Share[]> mShares;
+  std::atomic<unsigned> mPending{0};
+
+  std::atomic<uint64_t> mGeneration{0};
+  std::atomic<unsigned> mSleeping{0};
+  bool mStop{false};
+  std::mutex mMutex;
+  std::condition_variable mWake;
+};
+
+#endif // PLAYGROUND_THREAD_POOL_HPP
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef PLAYGROUND_TRIPLE_BUFFER_HPP
+#define PLAYGROUND_TRIPLE_BUFFER_HPP
+
+// Lock-free single producer / single consumer triple buffer.
+//
+// The producer fills writeBuffer() and calls publish(); the consumer calls
+// fetch() and then reads readBuffer(). Neither side ever waits or allocates:
+// the producer always has a free slot to write to and the consumer always
+// sees the most recently published value, skipping any it was too slow to
+// pick up. Meant for handing snapshots from the audio callback to the
+// graphics thread (or the other way around).
+
+#include <atomic>
+
+template <class T> class TripleBuffer {
+public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const T &initial) {
+    for (auto &b : mBuffers) {
+      b = initial;
+    }
+  }
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // Producer side
+  T &writeBuffer() { return mBuffers[mWriteIndex]; }
+
+  void publish() {
+    // Swap the written slot into the middle and mark it as fresh
+    unsigned previous =
+        mMiddle.exchange(mWriteIndex | kFresh, std::memory_order_acq_rel);
+    mWriteIndex = previous & kIndexMask;
+  }
+
+  // Consumer side. Returns true if a new value was published since the last
+  // call, in which case readBuffer() now holds it.
+  bool fetch() {
+    if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0) {
+      return false;
+    }
+    unsigned previous = mMiddle.exchange(mReadIndex, std::memory_order_acq_rel);
+    mReadIndex = previous & kIndexMask;
+    return true;
+  }
+
+  const T &readBuffer() const { return mBuffers[mReadIndex]; }
+
+private:
+  static constexpr unsigned kFresh = 4;
+  static constexpr unsigned kIndexMask = 3;
+
+  T mBuffers[3];
+  unsigned mWriteIndex{0};            // owned by the producer
+  std::atomic<unsigned> mMiddle{1};   // shared: index | kFresh
+  unsigned mReadIndex{2};             // owned by the consumer
+};
+
+#endif // PLAYGROUND_TRIPLE_BUFFER_HPP
@@ -0,0 +1,183 @@
+#pragma once
+#ifndef PLAYGROUND_UDP_SOCKET_HPP
+#define PLAYGROUND_UDP_SOCKET_HPP
+
+// Minimal non-blocking IPv4 UDP socket over BSD sockets / Winsock.
+//
+// receive() never blocks; wait() sleeps until a datagram arrives or a timeout
+// passes, for programs that have nothing else to do in between.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+struct UdpAddress {
+  sockaddr_in address;
+
+  UdpAddress() {
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+  }
+
+  // host is a dotted IPv4 address or a host name
+  static bool resolve(const std::string &host, uint16_t port,
+                      UdpAddress &out) {
+    UdpAddress::startup();
+    out = UdpAddress();
+    out.address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &out.address.sin_addr) == 1) {
+      return true;
+    }
+    addrinfo hints, *result = nullptr;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) {
+      return false;
+    }
+    out.address.sin_addr =
+        reinterpret_cast<sockaddr_in *>(result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+    return true;
+  }
+
+  // Address and port in one number, for use as a map key
+  uint64_t key() const {
+    return (uint64_t(ntohl(address.sin_addr.s_addr)) << 16) |
+           ntohs(address.sin_port);
+  }
+
+  // Winsock must be initialized once per process
+  static void startup() {
+#if defined(_WIN32)
+    static bool started = []() {
+      WSADATA data;
+      return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    (void)started;
+#endif
+  }
+};
+
+class UdpSocket {
+public:
+  UdpSocket() = default;
+  ~UdpSocket() { close(); }
+
+  UdpSocket(const UdpSocket &) = delete;
+  UdpSocket &operator=(const UdpSocket &) = delete;
+
+  // Binds to port on all interfaces (0 lets the system pick a port). With
+  // broadcast set, datagrams may be sent to broadcast addresses.
+  bool open(uint16_t port = 0, bool broadcast = false) {
+    close();
+    UdpAddress::startup();
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (mSocket == kInvalid) {
+      return false;
+    }
+    int yes = 1;
+    setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR,
+               reinterpret_cast<const char *>(&yes), sizeof(yes));
+    if (broadcast) {
+      setsockopt(mSocket, SOL_SOCKET, SO_BROADCAST,
+                 reinterpret_cast<const char *>(&yes), sizeof(yes));
+    }
+    UdpAddress local;
+    local.address.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.address.sin_port = htons(port);
+    if (bind(mSocket, reinterpret_cast<const sockaddr *>(&local.address),
+             sizeof(local.address)) != 0) {
+      close();
+      return false;
+    }
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ioctlsocket(mSocket, FIONBIO, &nonBlocking);
+#else
+    fcntl(mSocket, F_SETFL, fcntl(mSocket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    return true;
+  }
+
+  void close() {
+    if (mSocket != kInvalid) {
+#if defined(_WIN32)
+      closesocket(mSocket);
+#else
+      ::close(mSocket);
+#endif
+    }
+    mSocket = kInvalid;
+  }
+
+  bool isOpen() const { return mSocket != kInvalid; }
+
+  // Asks for a larger kernel receive buffer, so that bursts of datagrams
+  // are not dropped before they are read
+  void receiveBufferSize(int bytes) {
+    setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF,
+               reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+  }
+
+  bool sendTo(const UdpAddress &to, const void *data, size_t size) {
+    return sendto(mSocket, static_cast<const char *>(data), int(size), 0,
+                  reinterpret_cast<const sockaddr *>(&to.address),
+                  sizeof(to.address)) == long(size);
+  }
+
+  // Size of the datagram read into buffer, or -1 if none is waiting
+  long receive(void *buffer, size_t size, UdpAddress *from = nullptr) {
+    UdpAddress sender;
+    socklen_t length = sizeof(sender.address);
+    long n = long(recvfrom(mSocket, static_cast<char *>(buffer), int(size), 0,
+                           reinterpret_cast<sockaddr *>(&sender.address),
+                           &length));
+    if (n >= 0 && from) {
+      *from = sender;
+    }
+    return n < 0 ? -1 : n;
+  }
+
+  // Waits until a datagram can be read, for at most the given time. Returns
+  // false on timeout.
+  bool wait(double seconds) {
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(mSocket, &readable);
+    timeval timeout;
+    timeout.tv_sec = long(seconds);
+    timeout.tv_usec = long((seconds - double(timeout.tv_sec)) * 1e6);
+    return select(int(mSocket) + 1, &readable, nullptr, nullptr, &timeout) > 0;
+  }
+
+private:
+#if defined(_WIN32)
+  using Handle = SOCKET;
+  static constexpr Handle kInvalid = INVALID_SOCKET;
+#else
+  using Handle = int;
+  static constexpr Handle kInvalid = -1;
+#endif
+  Handle mSocket{kInvalid};
+};
+
+#endif // PLAYGROUND_UDP_SOCKET_HPP
@@ -0,0 +1,354 @@
+#pragma once
+#ifndef ICO_SPHERE_HPP
+#define ICO_SPHERE_HPP
+
+// Geometry of a subdivided icosahedron for the Blob: vertices, triangles and
+// the neighbors of every vertex.
+//
+// Neighbors are stored in compressed sparse row (CSR) form: the neighbors of
+// vertex i are neighbors[offsets[i]] ... neighbors[offsets[i + 1] - 1]. This
+// is one allocation instead of one per vertex, and the lists of consecutive
+// vertices are consecutive in memory.
+//
+// The .ico files number vertices in the order subdivision creates them, so
+// the neighbors of a vertex are scattered across the whole array. reorder()
+// renumbers the vertices breadth first (Cuthill-McKee), which keeps the
+// neighbors of each vertex within a ring or two of it in memory.
+//
+// Parsing the text files of the larger spheres takes seconds, so load() keeps
+// a binary copy of the renumbered sphere next to the text file: a header
+// followed by the vertex, index, offset and neighbor arrays as they are in
+// memory. Later runs map the cache file and copy the arrays out. The header
+// records the size and modification time of the text file, so an edited
+// .ico file is parsed again.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "common/MappedFile.hpp"
+
+struct IcoSphere {
+  std::vector<float> vertices;   // x, y, z per vertex
+  std::vector<unsigned> indices; // triangles
+  std::vector<int> offsets;      // size() + 1 entries
+  std::vector<int> neighbors;
+
+  int size() const { return int(vertices.size() / 3); }
+
+  // Loads fileName renumbered breadth first, from the binary cache
+  // fileName + ".bin" if it is up to date. Otherwise parses the text file and
+  // writes the cache (silently skipped if the directory is read-only).
+  bool load(const std::string &fileName) {
+    const std::string cacheName = fileName + ".bin";
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0) {
+      return false;
+    }
+    const uint64_t sourceSize = uint64_t(info.st_size);
+    const int64_t sourceTime = int64_t(info.st_mtime);
+    if (loadBinary(cacheName, sourceSize, sourceTime)) {
+      return true;
+    }
+    if (!loadText(fileName)) {
+      return false;
+    }
+    reorder(breadthFirstOrder());
+    saveBinary(cacheName, sourceSize, sourceTime);
+    return true;
+  }
+
+  // Reads the text format: one "x,y,z" vertex per line, "|", one index per
+  // line, "|", one comma separated list of 5 or 6 neighbors per line.
+  bool loadText(const std::string &fileName) {
+    *this = IcoSphere();
+    std::ifstream file(fileName);
+    if (!file.is_open())
+      return false;
+
+    offsets.push_back(0);
+    std::string line;
+    int state = 0;
+    while (getline(file, line)) {
+      if (line == "|") {
+        state++;
+        continue;
+      }
+      const char *c = line.c_str();
+      char *end;
+      switch (state) {
+      case 0: {
+        int count = 0;
+        for (float f = std::strtof(c, &end); end != c;
+             f = std::strtof(c, &end)) {
+          if (count++ < 3)
+            vertices.push_back(f);
+          c = *end == ',' ? end + 1 : end;
+        }
+        if (count < 3)
+          return false;
+      } break;
+
+      case 1: {
+        unsigned long i = std::strtoul(c, &end, 10);
+        if (end != c)
+          indices.push_back(unsigned(i));
+        else
+          return false;
+      } break;
+
+      case 2: {
+        int count = 0;
+        for (long i = std::strtol(c, &end, 10); end != c;
+             i = std::strtol(c, &end, 10)) {
+          neighbors.push_back(int(i));
+          count++;
+          c = *end == ',' ? end + 1 : end;
+        }
+        if ((count != 5) && (count != 6))
+          return false;
+        offsets.push_back(int(neighbors.size()));
+      } break;
+      }
+    }
+    return int(offsets.size()) == size() + 1;
+  }
+
+  bool saveText(const std::string &fileName) const {
+    FILE *file = std::fopen(fileName.c_str(), "w");
+    if (!file)
+      return false;
+    for (int i = 0; i < size(); i++) {
+      std::fprintf(file, "%.7g,%.7g,%.7g\n", vertices[i * 3],
+                   vertices[i * 3 + 1], vertices[i * 3 + 2]);
+    }
+    std::fprintf(file, "|\n");
+    for (unsigned i : indices) {
+      std::fprintf(file, "%u\n", i);
+    }
+    std::fprintf(file, "|\n");
+    for (int i = 0; i < size(); i++) {
+      for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+        std::fprintf(file, k == offsets[i] ? "%d" : ",%d", neighbors[k]);
+      }
+      std::fprintf(file, "\n");
+    }
+    std::fprintf(file, "|\n");
+    return std::fclose(file) == 0;
+  }
+
+  // Binary cache. sourceSize and sourceTime identify the text file it was
+  // made from; loadBinary() fails if they do not match.
+  bool saveBinary(const std::string &fileName, uint64_t sourceSize = 0,
+                  int64_t sourceTime = 0) const {
+    BinaryHeader header;
+    std::memcpy(header.magic, magic(), sizeof(header.magic));
+    header.vertexCount = uint32_t(size());
+    header.indexCount = uint32_t(indices.size());
+    header.neighborCount = uint32_t(neighbors.size());
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    // Written to a temporary file first, so that another process never maps
+    // a half written cache
+    const std::string temporary = fileName + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+      return false;
+    bool ok = write(file, &header, 1) &&
+              write(file, vertices.data(), vertices.size()) &&
+              write(file, indices.data(), indices.size()) &&
+              write(file, offsets.data(), offsets.size()) &&
+              write(file, neighbors.data(), neighbors.size());
+    ok = std::fclose(file) == 0 && ok;
+    std::remove(fileName.c_str()); // rename() does not replace on Windows
+    if (!ok || std::rename(temporary.c_str(), fileName.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool loadBinary(const std::string &fileName, uint64_t sourceSize = 0,
+                  int64_t sourceTime = 0) {
+    MappedFile file(fileName);
+    if (!file.isOpen() || file.size() < sizeof(BinaryHeader))
+      return false;
+    const char *data = static_cast<const char *>(file.data());
+    BinaryHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    const size_t v = header.vertexCount, i = header.indexCount,
+                 k = header.neighborCount;
+    const size_t expected = sizeof(header) + v * 3 * sizeof(float) +
+                            i * sizeof(unsigned) + (v + 1) * sizeof(int) +
+                            k * sizeof(int);
+    if (std::memcmp(header.magic, magic(), sizeof(header.magic)) != 0 ||
+        header.byteOrder != kByteOrder || file.size() != expected ||
+        header.sourceSize != sourceSize || header.sourceTime != sourceTime)
+      return false;
+    data += sizeof(header);
+    read(data, vertices, v * 3);
+    read(data, indices, i);
+    read(data, offsets, v + 1);
+    read(data, neighbors, k);
+    return true;
+  }
+
+  // Icosahedron subdivided `levels` times (10 * 4^levels + 2 vertices),
+  // projected onto the unit sphere. New vertices are numbered in the order
+  // they are created, like in the .ico files.
+  static IcoSphere subdivided(int levels) {
+    const float a = 0.5257311f, b = 0.8506508f;
+    IcoSphere s;
+    s.vertices = {-a, b,  0, a,  b,  0, -a, -b, 0, a, -b, 0, 0,  -a, b,  0,
+                  a,  b,  0, -a, -b, 0, a,  -b, b, 0, -a, b, 0,  a,  -b, 0,
+                  -a, -b, 0, a};
+    s.indices = {0, 11, 5,  0, 5,  1, 0, 1, 7, 0, 7,  10, 0, 10, 11,
+                 1, 5,  9,  5, 11, 4, 11, 10, 2, 10, 7, 6,  7, 1,  8,
+                 3, 9,  4,  3, 4,  2, 3, 2, 6, 3, 6,  8,  3, 8,  9,
+                 4, 9,  5,  2, 4,  11, 6, 2, 10, 8, 6, 7,  9, 8,  1};
+    for (int l = 0; l < levels; l++) {
+      std::map<std::pair<unsigned, unsigned>, unsigned> midpoints;
+      auto midpoint = [&](unsigned i, unsigned j) {
+        auto key = std::make_pair(std::min(i, j), std::max(i, j));
+        auto found = midpoints.find(key);
+        if (found != midpoints.end()) {
+          return found->second;
+        }
+        float m[3], len = 0;
+        for (int c = 0; c < 3; c++) {
+          m[c] = s.vertices[i * 3 + c] + s.vertices[j * 3 + c];
+          len += m[c] * m[c];
+        }
+        len = std::sqrt(len);
+        for (float c : m) {
+          s.vertices.push_back(c / len);
+        }
+        unsigned k = unsigned(s.size() - 1);
+        midpoints[key] = k;
+        return k;
+      };
+      std::vector<unsigned> indices;
+      for (size_t t = 0; t < s.indices.size(); t += 3) {
+        unsigned v0 = s.indices[t], v1 = s.indices[t + 1],
+                 v2 = s.indices[t + 2];
+        unsigned m01 = midpoint(v0, v1), m12 = midpoint(v1, v2),
+                 m20 = midpoint(v2, v0);
+        indices.insert(indices.end(), {v0, m01, m20, v1, m12, m01, v2, m20,
+                                       m12, m01, m12, m20});
+      }
+      s.indices.swap(indices);
+    }
+    std::vector<std::vector<int>> nn(s.size());
+    for (size_t t = 0; t < s.indices.size(); t += 3) {
+      for (int e = 0; e < 3; e++) {
+        int i = int(s.indices[t + e]), j = int(s.indices[t + (e + 1) % 3]);
+        if (std::find(nn[i].begin(), nn[i].end(), j) == nn[i].end()) {
+          nn[i].push_back(j);
+          nn[j].push_back(i);
+        }
+      }
+    }
+    s.offsets.assign(1, 0);
+    for (auto &list : nn) {
+      s.neighbors.insert(s.neighbors.end(), list.begin(), list.end());
+      s.offsets.push_back(int(s.neighbors.size()));
+    }
+    return s;
+  }
+
+  // Renumbers the vertices so that vertex order[k] becomes vertex k. The
+  // order of each neighbor list is kept.
+  void reorder(const std::vector<int> &order) {
+    const int n = size();
+    std::vector<int> rank(n);
+    for (int k = 0; k < n; k++) {
+      rank[order[k]] = k;
+    }
+    std::vector<float> v(vertices.size());
+    std::vector<int> o(n + 1), nn(neighbors.size());
+    o[0] = 0;
+    for (int k = 0; k < n; k++) {
+      const int i = order[k];
+      std::copy(&vertices[i * 3], &vertices[i * 3] + 3, &v[k * 3]);
+      int end = o[k];
+      for (int m = offsets[i]; m < offsets[i + 1]; m++) {
+        nn[end++] = rank[neighbors[m]];
+      }
+      o[k + 1] = end;
+    }
+    for (auto &i : indices) {
+      i = unsigned(rank[i]);
+    }
+    vertices.swap(v);
+    offsets.swap(o);
+    neighbors.swap(nn);
+  }
+
+  // Breadth first vertex order, starting from vertex 0 and visiting the
+  // neighbors of each vertex in order of increasing degree
+  std::vector<int> breadthFirstOrder() const {
+    const int n = size();
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<char> visited(n, 0);
+    std::vector<int> next;
+    for (int start = 0; start < n; start++) {
+      if (visited[start]) {
+        continue;
+      }
+      visited[start] = 1;
+      order.push_back(start);
+      for (size_t head = order.size() - 1; head < order.size(); head++) {
+        const int i = order[head];
+        next.assign(neighbors.data() + offsets[i],
+                    neighbors.data() + offsets[i + 1]);
+        std::stable_sort(next.begin(), next.end(), [&](int a, int b) {
+          return offsets[a + 1] - offsets[a] < offsets[b + 1] - offsets[b];
+        });
+        for (int j : next) {
+          if (!visited[j]) {
+            visited[j] = 1;
+            order.push_back(j);
+          }
+        }
+      }
+    }
+    return order;
+  }
+
+private:
+  static const char *magic() { return "ICO1"; }
+  static const uint32_t kByteOrder = 0x01020304;
+
+  struct BinaryHeader {
+    char magic[4];
+    uint32_t byteOrder = kByteOrder; // reads back swapped on other machines
+    uint32_t vertexCount, indexCount, neighborCount;
+    uint32_t reserved = 0;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+  };
+
+  template <class T> static bool write(FILE *file, const T *data, size_t n) {
+    return std::fwrite(data, sizeof(T), n, file) == n;
+  }
+
+  template <class T>
+  static void read(const char *&data, std::vector<T> &out, size_t n) {
+    out.resize(n);
+    std::memcpy(out.data(), data, n * sizeof(T));
+    data += n * sizeof(T);
+  }
+};
+
+#endif // ICO_SPHERE_HPP
@@ -0,0 +1,550 @@
+#pragma once
+#ifndef POSITION_CODEC_HPP
+#define POSITION_CODEC_HPP
+
+// Compact encoding of the Blob's vertex positions for sending them to the
+// renderers every frame, in datagrams that fit the network's MTU.
+//
+// Positions are quantized to 16 bits per component inside a bounding box. The
+// box is the bounds of the positions plus a margin, and is kept for as long
+// as the positions stay inside it, so that consecutive frames are quantized
+// identically. A frame is then sent either as a key frame (every value, two
+// bytes each) or as the difference to a reference frame the receivers still
+// hold. Vertices are grouped in blocks of 64: a bit mask says which blocks
+// changed, and only those are sent, as zigzag varints of the differences,
+// which take one byte for the small frame to frame motion of the springs.
+//
+// Receivers acknowledge the frames they hold (the last kHistory they
+// decoded). The encoder references the newest frame every known receiver
+// holds, and falls back to a key frame when there is none (or when the box
+// changed, or the differences would be larger than a key frame). A lost
+// datagram therefore only costs the frame it belonged to.
+//
+// Every encoder picks a random session number, sent with each datagram and
+// acknowledgement. Frame numbers restart with a new encoder (a restarted
+// simulator), so a receiver that sees a new session forgets its frames and
+// waits for a key frame, and an encoder ignores acknowledgements of other
+// sessions' frames.
+//
+// All multi-byte values are little-endian.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace position_codec {
+
+const uint32_t kPacketMagic = 0x32534f50; // "POS2"
+const uint32_t kAckMagic = 0x324b4341;    // "ACK2"
+const uint32_t kNoReference = 0xffffffff;
+const int kHistory = 4;        // frames kept for references on both sides
+const int kBlock = 64;         // vertices per block of the change mask
+const size_t kPacketHeader = 20;
+const size_t kFrameHeader = 36;
+const size_t kAckHeader = 12;
+
+inline void put32(uint8_t *p, uint32_t v) {
+  p[0] = uint8_t(v);
+  p[1] = uint8_t(v >> 8);
+  p[2] = uint8_t(v >> 16);
+  p[3] = uint8_t(v >> 24);
+}
+
+inline uint32_t get32(const uint8_t *p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+inline void putFloat(uint8_t *p, float v) {
+  uint32_t bits;
+  std::memcpy(&bits, &v, 4);
+  put32(p, bits);
+}
+
+inline float getFloat(const uint8_t *p) {
+  uint32_t bits = get32(p);
+  float v;
+  std::memcpy(&v, &bits, 4);
+  return v;
+}
+
+// True if frame a is newer than frame b (frame numbers wrap around)
+inline bool newer(uint32_t a, uint32_t b) { return int32_t(a - b) > 0; }
+
+// A quantized frame: position = min + q * step, per component
+struct Frame {
+  uint32_t id = kNoReference;
+  float min[3] = {0, 0, 0};
+  float step[3] = {1, 1, 1};
+  std::vector<uint16_t> q; // x, y, z per vertex
+
+  bool sameBox(const Frame &other) const {
+    return std::equal(min, min + 3, other.min) &&
+           std::equal(step, step + 3, other.step);
+  }
+
+  void dequantize(float *out) const {
+    for (size_t i = 0; i < q.size(); i += 3) {
+      for (int c = 0; c < 3; c++) {
+        out[i + c] = min[c] + float(q[i + c]) * step[c];
+      }
+    }
+  }
+};
+
+// Random session number for a new encoder
+inline uint32_t newSession() {
+  std::random_device device;
+  const uint64_t now =
+      std::chrono::steady_clock::now().time_since_epoch().count();
+  return device() ^ uint32_t(now) ^ uint32_t(now >> 32);
+}
+
+// Acknowledgement datagram: magic, session, count, then up to kHistory frame
+// numbers of that session
+inline size_t writeAck(uint8_t *out, uint32_t session, const uint32_t *frames,
+                       int count) {
+  put32(out, kAckMagic);
+  put32(out + 4, session);
+  put32(out + 8, uint32_t(count));
+  for (int i = 0; i < count; i++) {
+    put32(out + kAckHeader + 4 * i, frames[i]);
+  }
+  return kAckHeader + 4 * size_t(count);
+}
+
+inline int readAck(const uint8_t *data, size_t size, uint32_t *session,
+                   uint32_t *frames) {
+  if (size < kAckHeader || get32(data) != kAckMagic) {
+    return -1;
+  }
+  *session = get32(data + 4);
+  int count = int(std::min<uint32_t>(get32(data + 8), uint32_t(kHistory)));
+  if (size < kAckHeader + 4 * size_t(count)) {
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    frames[i] = get32(data + kAckHeader + 4 * i);
+  }
+  return count;
+}
+
+} // namespace position_codec
+
+class PositionEncoder {
+public:
+  // maxPacket is the size of the largest datagram to send. 1200 bytes stays
+  // below the usual 1500 byte Ethernet MTU with room for IP and UDP headers.
+  explicit PositionEncoder(size_t maxPacket = 1200,
+                           uint32_t session = position_codec::newSession())
+      : mMaxPacket(std::min(std::max(maxPacket, size_t(80)), size_t(65535))),
+        mSession(session) {}
+
+  uint32_t session() const { return mSession; }
+
+  // Records the frames a receiver holds, from its acknowledgement. Frames of
+  // another session are not ours, so the receiver holds none of them.
+  void acknowledge(uint64_t receiver, uint32_t session, const uint32_t *frames,
+                   int count) {
+    if (session == mSession) {
+      mReceivers[receiver].assign(frames, frames + count);
+    } else {
+      mReceivers[receiver].clear();
+    }
+  }
+
+  void removeReceiver(uint64_t receiver) { mReceivers.erase(receiver); }
+  size_t receivers() const { return mReceivers.size(); }
+
+  // Encodes the next frame from n interleaved x, y, z positions and calls
+  // send(const uint8_t *data, size_t size) once per datagram. Returns the
+  // number of bytes sent.
+  template <class Send> size_t encode(const float *positions, int n,
+                                      Send &&send) {
+    using namespace position_codec;
+    Frame &frame = mHistory[mNextSlot];
+    mNextSlot = (mNextSlot + 1) % kHistory;
+    frame.id = mNextId++;
+    updateBox(positions, n);
+    std::copy(mBox.min, mBox.min + 3, frame.min);
+    std::copy(mBox.step, mBox.step + 3, frame.step);
+    quantize(positions, n, frame);
+
+    const Frame *reference = chooseReference(frame);
+    mPayload.resize(kFrameHeader);
+    if (!reference || !encodeDelta(frame, *reference)) {
+      reference = nullptr;
+      encodeKey(frame);
+    }
+    uint8_t *h = mPayload.data();
+    put32(h, frame.id);
+    put32(h + 4, reference ? reference->id : kNoReference);
+    put32(h + 8, uint32_t(n));
+    for (int c = 0; c < 3; c++) {
+      putFloat(h + 12 + 4 * c, frame.min[c]);
+      putFloat(h + 24 + 4 * c, frame.step[c]);
+    }
+    mLastWasKey = reference == nullptr;
+    return packetize(frame.id, send);
+  }
+
+  // Whether the last frame was sent as a key frame
+  bool lastWasKey() const { return mLastWasKey; }
+
+private:
+  struct Box {
+    float min[3] = {0, 0, 0};
+    float max[3] = {0, 0, 0};
+    float step[3] = {0, 0, 0};
+  };
+
+  // Keeps the box while every position is inside it and it is not far too
+  // large; otherwise takes the bounds of the positions plus a 25% margin
+  void updateBox(const float *p, int n) {
+    float lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    if (n > 0) {
+      for (int c = 0; c < 3; c++) {
+        lo[c] = hi[c] = p[c];
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      for (int c = 0; c < 3; c++) {
+        lo[c] = std::min(lo[c], p[i * 3 + c]);
+        hi[c] = std::max(hi[c], p[i * 3 + c]);
+      }
+    }
+    bool keep = mBox.step[0] > 0;
+    for (int c = 0; c < 3 && keep; c++) {
+      const float extent = mBox.max[c] - mBox.min[c];
+      keep = lo[c] >= mBox.min[c] && hi[c] <= mBox.max[c] &&
+             hi[c] - lo[c] >= extent * 0.25f;
+    }
+    if (keep) {
+      return;
+    }
+    for (int c = 0; c < 3; c++) {
+      const float margin = std::max((hi[c] - lo[c]) * 0.25f, 1e-3f);
+      mBox.min[c] = lo[c] - margin;
+      mBox.max[c] = hi[c] + margin;
+      mBox.step[c] = (mBox.max[c] - mBox.min[c]) / 65535;
+    }
+  }
+
+  void quantize(const float *p, int n, position_codec::Frame &frame) {
+    frame.q.resize(size_t(n) * 3);
+    float scale[3];
+    for (int c = 0; c < 3; c++) {
+      scale[c] = 1 / frame.step[c];
+    }
+    for (int i = 0; i < n * 3; i += 3) {
+      for (int c = 0; c < 3; c++) {
+        float v = (p[i + c] - frame.min[c]) * scale[c] + 0.5f;
+        frame.q[i + c] = uint16_t(std::min(std::max(v, 0.0f), 65535.0f));
+      }
+    }
+  }
+
+  // Newest frame in the history, other than frame, that every receiver holds
+  // and that was quantized in the same box
+  const position_codec::Frame *
+  chooseReference(const position_codec::Frame &frame) const {
+    const position_codec::Frame *best = nullptr;
+    if (mReceivers.empty()) {
+      return nullptr;
+    }
+    for (const auto &candidate : mHistory) {
+      if (&candidate == &frame ||
+          candidate.id == position_codec::kNoReference ||
+          candidate.q.size() != frame.q.size() || !candidate.sameBox(frame) ||
+          (best && !position_codec::newer(candidate.id, best->id))) {
+        continue;
+      }
+      bool held = true;
+      for (const auto &receiver : mReceivers) {
+        const auto &frames = receiver.second;
+        held = held && std::find(frames.begin(), frames.end(), candidate.id) !=
+                           frames.end();
+      }
+      if (held) {
+        best = &candidate;
+      }
+    }
+    return best;
+  }
+
+  void encodeKey(const position_codec::Frame &frame) {
+    mPayload.resize(position_codec::kFrameHeader + frame.q.size() * 2);
+    uint8_t *out = mPayload.data() + position_codec::kFrameHeader;
+    for (uint16_t v : frame.q) {
+      *out++ = uint8_t(v);
+      *out++ = uint8_t(v >> 8);
+    }
+  }
+
+  // Change mask and varint differences of the changed blocks. Returns false
+  // (and leaves the payload to be overwritten) if that would not be smaller
+  // than a key frame.
+  bool encodeDelta(const position_codec::Frame &frame,
+                   const position_codec::Frame &reference) {
+    using namespace position_codec;
+    const size_t values = frame.q.size();
+    const size_t blocks = (values / 3 + kBlock - 1) / kBlock;
+    const size_t keySize = kFrameHeader + values * 2;
+    const size_t maskOffset = kFrameHeader;
+    mPayload.assign(maskOffset + (blocks + 7) / 8, 0);
+    const uint16_t *q = frame.q.data(), *r = reference.q.data();
+    for (size_t b = 0; b < blocks; b++) {
+      const size_t begin = b * kBlock * 3;
+      const size_t end = std::min(values, begin + kBlock * 3);
+      if (std::equal(q + begin, q + end, r + begin)) {
+        continue;
+      }
+      mPayload[maskOffset + b / 8] |= uint8_t(1 << (b % 8));
+      for (size_t i = begin; i < end; i++) {
+        const uint16_t d = uint16_t(q[i] - r[i]);
+        uint32_t z = uint16_t((d << 1) ^ (0u - (d >> 15))); // zigzag
+        while (z >= 0x80) {
+          mPayload.push_back(uint8_t(z | 0x80));
+          z >>= 7;
+        }
+        mPayload.push_back(uint8_t(z));
+      }
+      if (mPayload.size() >= keySize) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Splits the payload into datagrams: magic, session, frame, payload size,
+  // chunk index and the size of every chunk but the last, then the chunk
+  template <class Send> size_t packetize(uint32_t id, Send &send) {
+    using namespace position_codec;
+    const size_t chunk = mMaxPacket - kPacketHeader;
+    const size_t count = (mPayload.size() + chunk - 1) / chunk;
+    mPacket.resize(mMaxPacket);
+    size_t bytes = 0;
+    for (size_t k = 0; k < count; k++) {
+      const size_t begin = k * chunk;
+      const size_t size = std::min(chunk, mPayload.size() - begin);
+      uint8_t *p = mPacket.data();
+      put32(p, kPacketMagic);
+      put32(p + 4, mSession);
+      put32(p + 8, id);
+      put32(p + 12, uint32_t(mPayload.size()));
+      put32(p + 16, uint32_t(k) | uint32_t(chunk) << 16);
+      std::memcpy(p + kPacketHeader, mPayload.data() + begin, size);
+      send(static_cast<const uint8_t *>(p), kPacketHeader + size);
+      bytes += kPacketHeader + size;
+    }
+    return bytes;
+  }
+
+  size_t mMaxPacket;
+  uint32_t mSession;
+  Box mBox;
+  position_codec::Frame mHistory[position_codec::kHistory];
+  int mNextSlot{0};
+  uint32_t mNextId{0};
+  bool mLastWasKey{true};
+  std::map<uint64_t, std::vector<uint32_t>> mReceivers;
+  std::vector<uint8_t> mPayload, mPacket;
+};
+
+class PositionDecoder {
+public:
+  // Frames of more than maxVertices vertices are ignored, so that a bad
+  // datagram can't make the decoder allocate more than such a frame needs
+  explicit PositionDecoder(int maxVertices = 1 << 20)
+      : mMaxVertices(size_t(std::max(0, maxVertices))) {}
+
+  // Feeds one datagram. Returns true if it completed a frame, which
+  // positions() then holds. Datagrams of older frames than the one being
+  // assembled are ignored; a newer frame abandons an incomplete one. A
+  // datagram of a new session starts over from its key frame.
+  bool receive(const uint8_t *data, size_t size) {
+    using namespace position_codec;
+    if (size < kPacketHeader || get32(data) != kPacketMagic) {
+      return false;
+    }
+    const uint32_t session = get32(data + 4), id = get32(data + 8),
+                   payloadSize = get32(data + 12),
+                   chunkInfo = get32(data + 16);
+    const size_t index = chunkInfo & 0xffff, chunkSize = chunkInfo >> 16;
+    // A key frame is the largest a frame gets
+    if (chunkSize == 0 || payloadSize < kFrameHeader ||
+        payloadSize > kFrameHeader + mMaxVertices * 6) {
+      return false;
+    }
+    const size_t count = (payloadSize + chunkSize - 1) / chunkSize;
+    if (!mHasSession || session != mSession) {
+      restart(session);
+    }
+    if (mHasFrame && !newer(id, mFrameId)) {
+      return false; // already decoded, or too old
+    }
+    if (!mAssembling || id != mAssemblyId) {
+      if (mAssembling && newer(mAssemblyId, id)) {
+        return false;
+      }
+      mAssembling = true;
+      mAssemblyId = id;
+      mPayload.assign(payloadSize, 0);
+      mChunks.assign(count, 0);
+      mMissing = count;
+    }
+    const size_t chunk = size - kPacketHeader;
+    const size_t begin = index * chunkSize;
+    if (index >= mChunks.size() || mPayload.size() != payloadSize ||
+        begin + chunk > mPayload.size() || mChunks[index]) {
+      return false;
+    }
+    std::memcpy(mPayload.data() + begin, data + kPacketHeader, chunk);
+    mChunks[index] = 1;
+    if (--mMissing > 0) {
+      return false;
+    }
+    mAssembling = false;
+    return decode();
+  }
+
+  const std::vector<float> &positions() const { return mPositions; }
+  uint32_t frame() const { return mFrameId; }
+  // Session of the frames held, to acknowledge
+  uint32_t session() const { return mSession; }
+
+  // Frame numbers held for references, to acknowledge. Returns the count.
+  int heldFrames(uint32_t *out) const {
+    int count = 0;
+    for (const auto &frame : mHistory) {
+      if (frame.id != position_codec::kNoReference) {
+        out[count++] = frame.id;
+      }
+    }
+    return count;
+  }
+
+  // Key frames and frames decoded from a reference, and frames that had to
+  // be dropped because their reference was missing
+  size_t keyFrames() const { return mKeyFrames; }
+  size_t deltaFrames() const { return mDeltaFrames; }
+  size_t droppedFrames() const { return mDroppedFrames; }
+
+private:
+  // Forgets the frames of the previous session
+  void restart(uint32_t session) {
+    for (auto &frame : mHistory) {
+      frame.id = position_codec::kNoReference;
+      frame.q.clear();
+    }
+    mNextSlot = 0;
+    mHasFrame = false;
+    mAssembling = false;
+    mSession = session;
+    mHasSession = true;
+  }
+
+  bool decode() {
+    using namespace position_codec;
+    if (mPayload.size() < kFrameHeader) {
+      return false;
+    }
+    const uint8_t *h = mPayload.data();
+    Frame &frame = mHistory[mNextSlot];
+    const uint32_t id = get32(h), referenceId = get32(h + 4);
+    const size_t n = get32(h + 8);
+    if (n > mMaxVertices) {
+      return false;
+    }
+    const Frame *reference = nullptr;
+    if (referenceId != kNoReference) {
+      for (const auto &candidate : mHistory) {
+        if (candidate.id == referenceId && &candidate != &frame) {
+          reference = &candidate;
+        }
+      }
+      if (!reference || reference->q.size() != n * 3) {
+        mDroppedFrames++;
+        return false;
+      }
+    }
+    Frame decoded;
+    decoded.id = id;
+    for (int c = 0; c < 3; c++) {
+      decoded.min[c] = getFloat(h + 12 + 4 * c);
+      decoded.step[c] = getFloat(h + 24 + 4 * c);
+    }
+    const uint8_t *in = h + kFrameHeader, *end = h + mPayload.size();
+    if (!reference) {
+      if (size_t(end - in) != n * 6) {
+        return false;
+      }
+      decoded.q.resize(n * 3);
+      for (auto &v : decoded.q) {
+        v = uint16_t(in[0] | in[1] << 8);
+        in += 2;
+      }
+      mKeyFrames++;
+    } else {
+      decoded.q = reference->q;
+      const size_t blocks = (n + kBlock - 1) / kBlock;
+      const uint8_t *mask = in;
+      if (size_t(end - in) < (blocks + 7) / 8) {
+        return false;
+      }
+      in += (blocks + 7) / 8;
+      for (size_t b = 0; b < blocks; b++) {
+        if (!(mask[b / 8] & (1 << (b % 8)))) {
+          continue;
+        }
+        const size_t first = b * kBlock * 3;
+        const size_t last = std::min(n * 3, first + kBlock * 3);
+        for (size_t i = first; i < last; i++) {
+          uint32_t z = 0;
+          for (int shift = 0;; shift += 7) {
+            if (in == end || shift > 14) {
+              return false;
+            }
+            const uint8_t byte = *in++;
+            z |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+              break;
+            }
+          }
+          decoded.q[i] += uint16_t((z >> 1) ^ (0u - (z & 1)));
+        }
+      }
+      mDeltaFrames++;
+    }
+    frame = std::move(decoded);
+    mNextSlot = (mNextSlot + 1) % kHistory;
+    mPositions.resize(n * 3);
+    frame.dequantize(mPositions.data());
+    mFrameId = id;
+    mHasFrame = true;
+    return true;
+  }
+
+  size_t mMaxVertices;
+  position_codec::Frame mHistory[position_codec::kHistory];
+  int mNextSlot{0};
+  std::vector<float> mPositions;
+  uint32_t mSession{0};
+  bool mHasSession{false};
+  uint32_t mFrameId{0};
+  bool mHasFrame{false};
+  bool mAssembling{false};
+  uint32_t mAssemblyId{0};
+  std::vector<uint8_t> mPayload;
+  std::vector<char> mChunks;
+  size_t mMissing{0};
+  size_t mKeyFrames{0}, mDeltaFrames{0}, mDroppedFrames{0};
+};
+
+#endif // POSITION_CODEC_HPP
@@ -0,0 +1,154 @@
+#pragma once
+#ifndef POSITION_STREAM_HPP
+#define POSITION_STREAM_HPP
+
+// Sends the Blob's vertex positions from the simulator to the renderers over
+// UDP, encoded by PositionCodec.hpp, and reconstructs them on the other end.
+//
+// The sender sends to one address: a renderer, the broadcast address of the
+// render cluster's subnet, or 127.0.0.1 to test on one machine. Receivers
+// acknowledge every frame they decode to the address the datagrams came
+// from, and send an empty acknowledgement as soon as they hear from a sender
+// they have nothing from yet, which makes the sender start with a key frame.
+// Receivers that stop acknowledging are forgotten after two seconds, so
+// they no longer hold back the choice of reference frames.
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/UdpSocket.hpp"
+
+#include "PositionCodec.hpp"
+
+class PositionSender {
+public:
+  PositionSender(const std::string &address = "127.0.0.1",
+                 uint16_t port = 9110, size_t maxPacket = 1200)
+      : mEncoder(maxPacket) {
+    mOpen = UdpAddress::resolve(address, port, mDestination) &&
+            mSocket.open(0, true);
+  }
+
+  bool isOpen() const { return mOpen; }
+
+  // Reads the receivers' acknowledgements, then sends a frame of n
+  // interleaved x, y, z positions
+  void send(const float *positions, int n) {
+    if (!mOpen) {
+      return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    uint8_t buffer[256];
+    UdpAddress from;
+    long size;
+    while ((size = mSocket.receive(buffer, sizeof(buffer), &from)) >= 0) {
+      uint32_t session, frames[position_codec::kHistory];
+      int count =
+          position_codec::readAck(buffer, size_t(size), &session, frames);
+      if (count >= 0) {
+        mEncoder.acknowledge(from.key(), session, frames, count);
+        mLastHeard[from.key()] = now;
+      }
+    }
+    for (auto it = mLastHeard.begin(); it != mLastHeard.end();) {
+      if (now - it->second > std::chrono::seconds(2)) {
+        mEncoder.removeReceiver(it->first);
+        it = mLastHeard.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    mPackets = 0;
+    mBytes = mEncoder.encode(positions, n,
+                             [&](const uint8_t *data, size_t bytes) {
+                               mSocket.sendTo(mDestination, data, bytes);
+                               mPackets++;
+                             });
+  }
+
+  // Size of the last frame, including datagram headers
+  size_t lastBytes() const { return mBytes; }
+  size_t lastPackets() const { return mPackets; }
+  bool lastWasKey() const { return mEncoder.lastWasKey(); }
+  size_t receivers() const { return mEncoder.receivers(); }
+
+private:
+  PositionEncoder mEncoder;
+  UdpSocket mSocket;
+  UdpAddress mDestination;
+  bool mOpen{false};
+  std::map<uint64_t, std::chrono::steady_clock::time_point> mLastHeard;
+  size_t mBytes{0}, mPackets{0};
+};
+
+class PositionReceiver {
+public:
+  // maxVertices bounds the frames accepted, see PositionDecoder
+  explicit PositionReceiver(uint16_t port = 9110, int maxVertices = 1 << 20)
+      : mBuffer(65536), mDecoder(maxVertices) {
+    mOpen = mSocket.open(port);
+    if (mOpen) {
+      mSocket.receiveBufferSize(8 << 20); // a few large key frames
+    }
+  }
+
+  bool isOpen() const { return mOpen; }
+
+  // Reads every waiting datagram. Returns true if a new frame was completed,
+  // which positions() then holds.
+  bool poll() {
+    bool updated = false, heard = false;
+    long size;
+    UdpAddress from;
+    while (mOpen &&
+           (size = mSocket.receive(mBuffer.data(), mBuffer.size(), &from)) >=
+               0) {
+      heard = true;
+      mSender = from;
+      const size_t dropped = mDecoder.droppedFrames();
+      if (mDecoder.receive(mBuffer.data(), size_t(size))) {
+        updated = true;
+        acknowledge();
+      } else if (mDecoder.droppedFrames() != dropped) {
+        acknowledge(); // the sender has a wrong idea of what we hold
+      }
+    }
+    if (heard && !updated && !mAcknowledged) {
+      acknowledge(); // introduce ourselves
+    }
+    return updated;
+  }
+
+  // Waits up to the given time for datagrams to poll(). Returns false on
+  // timeout.
+  bool wait(double seconds) { return mOpen && mSocket.wait(seconds); }
+
+  const std::vector<float> &positions() const {
+    return mDecoder.positions();
+  }
+  uint32_t frame() const { return mDecoder.frame(); }
+  const PositionDecoder &decoder() const { return mDecoder; }
+
+private:
+  void acknowledge() {
+    uint32_t frames[position_codec::kHistory];
+    uint8_t ack[position_codec::kAckHeader + 4 * position_codec::kHistory];
+    int count = mDecoder.heldFrames(frames);
+    mSocket.sendTo(mSender, ack,
+                   position_codec::writeAck(ack, mDecoder.session(), frames,
+                                            count));
+    mAcknowledged = count > 0;
+  }
+
+  UdpSocket mSocket;
+  UdpAddress mSender;
+  bool mOpen{false};
+  bool mAcknowledged{false};
+  std::vector<uint8_t> mBuffer;
+  PositionDecoder mDecoder;
+};
+
+#endif // POSITION_STREAM_HPP
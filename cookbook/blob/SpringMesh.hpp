@@ -0,0 +1,179 @@
+#pragma once
+#ifndef SPRING_MESH_HPP
+#define SPRING_MESH_HPP
+
+// Spring-mass simulation of the Blob: every vertex is pulled back to its rest
+// position and toward its neighbors, with damping.
+//
+// Rest positions, positions and velocities are stored four floats per vertex
+// (x, y, z and padding), so one SSE or NEON register holds a vertex and a
+// neighbor spring is one load, subtract, multiply and add. Positions are
+// double buffered: step() reads the current positions and writes the next
+// ones, so every vertex only writes its own state and the vertices can be
+// split across a ThreadPool freely. The neighbor springs are summed in the
+// order of the neighbor lists with the same operations as the original loop
+// over vector<vector<int>>, so the results are the same bit for bit.
+// Renumber the vertices with IcoSphere::reorder() first to keep neighbors
+// close in memory.
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/ThreadPool.hpp"
+
+#include "IcoSphere.hpp"
+
+class SpringMesh {
+public:
+  float anchorStiffness = 0.06f;   // spring constant for anchor points
+  float neighborStiffness = 0.1f;  // spring constant between neighbors
+  float damping = 0.08f;
+
+  // Vertices at rest, with the neighbors of the sphere
+  void reset(const IcoSphere &sphere) {
+    const int n = sphere.size();
+    mOffsets = sphere.offsets;
+    mNeighbors = sphere.neighbors;
+    mRest.assign(size_t(n) * 4, 0.0f);
+    for (int i = 0; i < n; i++) {
+      for (int c = 0; c < 3; c++) {
+        mRest[i * 4 + c] = sphere.vertices[i * 3 + c];
+      }
+    }
+    mPosition[0] = mRest;
+    mPosition[1] = mRest;
+    mVelocity.assign(mRest.size(), 0.0f);
+    mFront = 0;
+  }
+
+  int size() const { return int(mRest.size() / 4); }
+
+  // Neighbors of vertex i, in CSR form (see IcoSphere)
+  const int *neighborsBegin(int i) const {
+    return mNeighbors.data() + mOffsets[i];
+  }
+  const int *neighborsEnd(int i) const {
+    return mNeighbors.data() + mOffsets[i + 1];
+  }
+
+  // Moves vertex i (a poke)
+  void displace(int i, float dx, float dy, float dz) {
+    float *p = &mPosition[mFront][size_t(i) * 4];
+    p[0] += dx;
+    p[1] += dy;
+    p[2] += dz;
+  }
+
+  // Advances one step. If given, also writes the new positions to out,
+  // interleaved x, y, z per vertex. Meshes that fit in one chunk, or a pool
+  // of one thread, are stepped on the calling thread.
+  void step(ThreadPool &pool, float *out = nullptr) {
+    const int n = size();
+    if (n <= kChunk || pool.size() == 1) {
+      stepRange(0, n, out);
+    } else {
+      const size_t chunks = (size_t(n) + kChunk - 1) / kChunk;
+      pool.parallelFor(chunks, [&](size_t c, unsigned) {
+        const int begin = int(c) * kChunk;
+        stepRange(begin, std::min(n, begin + kChunk), out);
+      });
+    }
+    mFront = 1 - mFront;
+  }
+
+  // Current position, velocity and rest position of vertex i (x, y, z)
+  const float *position(int i) const {
+    return &mPosition[mFront][size_t(i) * 4];
+  }
+  const float *velocity(int i) const { return &mVelocity[size_t(i) * 4]; }
+  const float *rest(int i) const { return &mRest[size_t(i) * 4]; }
+
+private:
+  static const int kChunk = 4096;
+
+  void stepRange(int begin, int end, float *out) {
+    const float *p = mPosition[mFront].data();
+    float *next = mPosition[1 - mFront].data();
+    float *v = mVelocity.data();
+    const float *r = mRest.data();
+    const int *offsets = mOffsets.data();
+    const int *neighbors = mNeighbors.data();
+#if defined(PLAYGROUND_SIMD_SSE)
+    const __m128 sk = _mm_set1_ps(-anchorStiffness);
+    const __m128 nk = _mm_set1_ps(-neighborStiffness);
+    const __m128 d = _mm_set1_ps(damping);
+    for (int i = begin; i < end; i++) {
+      const __m128 x = _mm_loadu_ps(p + i * 4);
+      __m128 f = _mm_mul_ps(_mm_sub_ps(x, _mm_loadu_ps(r + i * 4)), sk);
+      for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+        const __m128 m = _mm_loadu_ps(p + neighbors[k] * 4);
+        f = _mm_add_ps(f, _mm_mul_ps(_mm_sub_ps(x, m), nk));
+      }
+      __m128 u = _mm_loadu_ps(v + i * 4);
+      u = _mm_add_ps(u, _mm_sub_ps(f, _mm_mul_ps(u, d)));
+      const __m128 q = _mm_add_ps(x, u);
+      _mm_storeu_ps(v + i * 4, u);
+      _mm_storeu_ps(next + i * 4, q);
+      if (out) {
+        _mm_storel_pi(reinterpret_cast<__m64 *>(out + i * 3), q);
+        _mm_store_ss(out + i * 3 + 2, _mm_movehl_ps(q, q));
+      }
+    }
+#elif defined(PLAYGROUND_SIMD_NEON)
+    const float32x4_t sk = vdupq_n_f32(-anchorStiffness);
+    const float32x4_t nk = vdupq_n_f32(-neighborStiffness);
+    const float32x4_t d = vdupq_n_f32(damping);
+    for (int i = begin; i < end; i++) {
+      const float32x4_t x = vld1q_f32(p + i * 4);
+      float32x4_t f = vmulq_f32(vsubq_f32(x, vld1q_f32(r + i * 4)), sk);
+      for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+        const float32x4_t m = vld1q_f32(p + neighbors[k] * 4);
+        // No vmlaq_f32, which may be fused and round differently
+        f = vaddq_f32(f, vmulq_f32(vsubq_f32(x, m), nk));
+      }
+      float32x4_t u = vld1q_f32(v + i * 4);
+      u = vaddq_f32(u, vsubq_f32(f, vmulq_f32(u, d)));
+      const float32x4_t q = vaddq_f32(x, u);
+      vst1q_f32(v + i * 4, u);
+      vst1q_f32(next + i * 4, q);
+      if (out) {
+        vst1_f32(out + i * 3, vget_low_f32(q));
+        vst1q_lane_f32(out + i * 3 + 2, q, 2);
+      }
+    }
+#else
+    const float sk = -anchorStiffness, nk = -neighborStiffness, d = damping;
+    for (int i = begin; i < end; i++) {
+      const float *x = p + i * 4;
+      float f[3];
+      for (int c = 0; c < 3; c++) {
+        f[c] = (x[c] - r[i * 4 + c]) * sk;
+      }
+      for (int k = offsets[i]; k < offsets[i + 1]; k++) {
+        const float *m = p + neighbors[k] * 4;
+        for (int c = 0; c < 3; c++) {
+          f[c] += (x[c] - m[c]) * nk;
+        }
+      }
+      for (int c = 0; c < 3; c++) {
+        float &u = v[i * 4 + c];
+        u += f[c] - u * d;
+        next[i * 4 + c] = x[c] + u;
+        if (out) {
+          out[i * 3 + c] = x[c] + u;
+        }
+      }
+    }
+#endif
+  }
+
+  std::vector<int> mOffsets, mNeighbors;
+  std::vector<float> mRest;        // x, y, z, 0 per vertex
+  std::vector<float> mPosition[2]; // current and next, like mRest
+  std::vector<float> mVelocity;    // like mRest
+  int mFront{0};
+};
+
+#endif // SPRING_MESH_HPP
@@ -0,0 +1,170 @@
+// Benchmark for the Blob's spring-mass step, for every icosphere size the
+// app has a #define for (162 to 655362 vertices).
+//
+// The icospheres are generated by IcoSphere::subdivided(), which numbers new
+// vertices in the order they are created like the .ico files do.
+// "original" is the old loop over vector<vector<int>> neighbors and Vec3
+// arrays. SpringMesh is timed with the vertices in file order and renumbered
+// breadth first, on one thread and across a ThreadPool. Its positions are
+// also checked against the original loop after a poke and 100 steps.
+//
+// Build and run with ./run.sh cookbook/blob/blob_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "IcoSphere.hpp"
+#include "SpringMesh.hpp"
+
+struct Vec3 {
+  float x, y, z;
+};
+
+// The original simulation, minus the app
+struct OriginalBlob {
+  std::vector<std::vector<int>> nn;
+  std::vector<Vec3> p, velocity, original;
+  float SK = 0.06f, NK = 0.1f, D = 0.08f;
+
+  OriginalBlob(const IcoSphere &s) {
+    const int n = s.size();
+    for (int i = 0; i < n; i++) {
+      nn.emplace_back(&s.neighbors[s.offsets[i]],
+                      &s.neighbors[0] + s.offsets[i + 1]);
+      original.push_back(
+          {s.vertices[i * 3], s.vertices[i * 3 + 1], s.vertices[i * 3 + 2]});
+    }
+    p = original;
+    velocity.assign(n, {0, 0, 0});
+  }
+
+  void step() {
+    const int n = int(p.size());
+    for (int i = 0; i < n; i++) {
+      Vec3 &v = p[i];
+      Vec3 force{(v.x - original[i].x) * -SK, (v.y - original[i].y) * -SK,
+                 (v.z - original[i].z) * -SK};
+      for (size_t k = 0; k < nn[i].size(); k++) {
+        Vec3 &m = p[nn[i][k]];
+        force.x += (v.x - m.x) * -NK;
+        force.y += (v.y - m.y) * -NK;
+        force.z += (v.z - m.z) * -NK;
+      }
+      force.x -= velocity[i].x * D;
+      force.y -= velocity[i].y * D;
+      force.z -= velocity[i].z * D;
+      velocity[i].x += force.x;
+      velocity[i].y += force.y;
+      velocity[i].z += force.z;
+    }
+    for (int i = 0; i < n; i++) {
+      p[i].x += velocity[i].x;
+      p[i].y += velocity[i].y;
+      p[i].z += velocity[i].z;
+    }
+  }
+};
+
+// Poke as the app does: the vertex moves by v, its neighbors by half of it
+void poke(OriginalBlob &blob, int n) {
+  Vec3 v{0.3f, -0.2f, 0.1f};
+  for (int k : blob.nn[n]) {
+    blob.p[k].x += v.x * 0.5f;
+    blob.p[k].y += v.y * 0.5f;
+    blob.p[k].z += v.z * 0.5f;
+  }
+  blob.p[n].x += v.x;
+  blob.p[n].y += v.y;
+  blob.p[n].z += v.z;
+}
+
+void poke(SpringMesh &springs, int n) {
+  for (const int *k = springs.neighborsBegin(n); k != springs.neighborsEnd(n);
+       k++) {
+    springs.displace(*k, 0.3f * 0.5f, -0.2f * 0.5f, 0.1f * 0.5f);
+  }
+  springs.displace(n, 0.3f, -0.2f, 0.1f);
+}
+
+int main() {
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  // Same poke into both, renumbered solver mapped back to file order
+  {
+    IcoSphere sphere = IcoSphere::subdivided(4);
+    OriginalBlob original(sphere);
+    std::vector<int> order = sphere.breadthFirstOrder();
+    IcoSphere renumbered = sphere;
+    renumbered.reorder(order);
+    SpringMesh springs;
+    springs.reset(renumbered);
+    ThreadPool pool(std::min(cores, 4u));
+    const int pokedVertex = 1234;
+    const int rank = int(std::find(order.begin(), order.end(), pokedVertex) -
+                         order.begin());
+    poke(original, pokedVertex);
+    poke(springs, rank);
+    for (int s = 0; s < 100; s++) {
+      original.step();
+      springs.step(pool);
+    }
+    float difference = 0, moved = 0;
+    for (int k = 0; k < sphere.size(); k++) {
+      const Vec3 &p = original.p[order[k]];
+      const float *q = springs.position(k);
+      difference = std::max({difference, std::abs(p.x - q[0]),
+                             std::abs(p.y - q[1]), std::abs(p.z - q[2])});
+      moved = std::max(moved, std::abs(p.x - original.original[order[k]].x));
+    }
+    printf("after a poke and 100 steps at %d vertices: largest displacement "
+           "%g, max difference to the original loop %g\n\n",
+           sphere.size(), moved, difference);
+  }
+
+  printf("%d hardware threads. Steps per second:\n", int(cores));
+  printf("%8s %10s %10s %10s", "vertices", "original", "CSR", "reordered");
+  std::vector<unsigned> threadCounts;
+  for (unsigned t = 2; t <= cores && t <= 16; t *= 2) {
+    threadCounts.push_back(t);
+    printf(" %6u thr", t);
+  }
+  printf("\n");
+
+  for (int levels = 2; levels <= 8; levels++) {
+    IcoSphere sphere = IcoSphere::subdivided(levels);
+    const double seconds = levels >= 7 ? 0.5 : 0.2;
+    std::vector<float> out(sphere.vertices.size());
+
+    OriginalBlob original(sphere);
+    poke(original, 0);
+    double orig = bench::measure([&]() { original.step(); }, seconds);
+
+    ThreadPool single(1);
+    SpringMesh springs;
+    springs.reset(sphere);
+    poke(springs, 0);
+    double csr = bench::measure(
+        [&]() { springs.step(single, out.data()); }, seconds);
+
+    sphere.reorder(sphere.breadthFirstOrder());
+    springs.reset(sphere);
+    poke(springs, 0);
+    double reordered = bench::measure(
+        [&]() { springs.step(single, out.data()); }, seconds);
+    printf("%8d %10.0f %10.0f %10.0f", sphere.size(), 1 / orig, 1 / csr,
+           1 / reordered);
+    for (unsigned t : threadCounts) {
+      ThreadPool pool(t);
+      double time = bench::measure(
+          [&]() { springs.step(pool, out.data()); }, seconds);
+      printf(" %10.0f", 1 / time);
+    }
+    printf("\n");
+  }
+  return 0;
+}
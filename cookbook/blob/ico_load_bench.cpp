@@ -0,0 +1,135 @@
+// Benchmark for loading the Blob's .ico files, 10242 to 655362 vertices.
+//
+// The spheres are written as text files into the working directory first
+// (and removed at the end). "original" is the old load(): getline, a
+// stringstream and a vector per line. "text" is IcoSphere::loadText(),
+// "first load" is IcoSphere::load() without a cache (parse, renumber, write
+// the binary cache) and "cached" is IcoSphere::load() mapping that cache.
+// The cached sphere is checked against the parsed and renumbered one.
+//
+// Build and run with ./run.sh cookbook/blob/ico_load_bench.cpp
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "IcoSphere.hpp"
+
+struct Vec3 {
+  float x, y, z;
+};
+
+// The original loader, with the mesh replaced by vectors
+bool originalLoad(std::string fileName, std::vector<Vec3> &vertices,
+                  std::vector<unsigned> &indices,
+                  std::vector<std::vector<int>> &nn) {
+  std::ifstream file(fileName);
+  if (!file.is_open())
+    return false;
+
+  std::string line;
+  int state = 0;
+  while (getline(file, line)) {
+    if (line == "|") {
+      state++;
+      continue;
+    }
+    switch (state) {
+    case 0: {
+      std::vector<float> v;
+      std::stringstream ss(line);
+      float f;
+      while (ss >> f) {
+        v.push_back(f);
+        if (ss.peek() == ',')
+          ss.ignore();
+      }
+      vertices.push_back({v[0], v[1], v[2]});
+    } break;
+
+    case 1: {
+      std::stringstream ss(line);
+      int i;
+      if (ss >> i)
+        indices.push_back(i);
+      else
+        return false;
+    } break;
+
+    case 2: {
+      std::vector<int> v;
+      std::stringstream ss(line);
+      int i;
+      while (ss >> i) {
+        v.push_back(i);
+        if (ss.peek() == ',')
+          ss.ignore();
+      }
+      if ((v.size() != 5) && (v.size() != 6))
+        return false;
+      nn.push_back(v);
+    } break;
+    }
+  }
+  return true;
+}
+
+int main() {
+  printf("milliseconds per load:\n");
+  printf("%8s %10s %10s %12s %10s %10s\n", "vertices", "original", "text",
+         "first load", "cached", "cache MB");
+  for (int levels = 5; levels <= 8; levels++) {
+    const IcoSphere generated = IcoSphere::subdivided(levels);
+    const std::string name =
+        "bench_" + std::to_string(generated.size()) + ".ico";
+    const std::string cacheName = name + ".bin";
+    if (!generated.saveText(name)) {
+      printf("cannot write %s\n", name.c_str());
+      return 1;
+    }
+    const double seconds = 0.5;
+    const int runs = levels >= 7 ? 3 : 5;
+
+    double original = bench::measure(
+        [&]() {
+          std::vector<Vec3> vertices;
+          std::vector<unsigned> indices;
+          std::vector<std::vector<int>> nn;
+          originalLoad(name, vertices, indices, nn);
+          bench::keep(nn);
+        },
+        seconds, runs);
+
+    IcoSphere parsed;
+    double text = bench::measure([&]() { parsed.loadText(name); }, seconds,
+                                 runs);
+    parsed.reorder(parsed.breadthFirstOrder());
+
+    std::remove(cacheName.c_str());
+    IcoSphere sphere;
+    auto start = bench::Clock::now();
+    sphere.load(name);
+    double first = bench::secondsSince(start);
+
+    double cached = bench::measure([&]() { sphere.load(name); }, seconds,
+                                   runs);
+    const bool same = sphere.vertices == parsed.vertices &&
+                      sphere.indices == parsed.indices &&
+                      sphere.offsets == parsed.offsets &&
+                      sphere.neighbors == parsed.neighbors;
+
+    std::ifstream cache(cacheName, std::ios::binary | std::ios::ate);
+    const double megabytes = double(cache.tellg()) / (1 << 20);
+    printf("%8d %10.1f %10.1f %12.1f %10.2f %10.1f%s\n", generated.size(),
+           original * 1e3, text * 1e3, first * 1e3, cached * 1e3, megabytes,
+           same ? "" : "  MISMATCH");
+    cache.close();
+    std::remove(name.c_str());
+    std::remove(cacheName.c_str());
+  }
+  return 0;
+}
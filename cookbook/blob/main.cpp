@@ -12,11 +12,32 @@
 using namespace al;
 
 #include <iostream> // cout
+#include <memory>   // unique_ptr
 #include <vector> // vector
 
+#include "common/MeshNormals.hpp"
+
+#include "IcoSphere.hpp"
+#include "PositionStream.hpp"
+#include "SpringMesh.hpp"
+
 // This example demonstrates how to write a distributed application that
 // shares mesh vertices through cuttlebone.
 // Original by Karl Yerkes, adapted by Andres Cabrera
+//
+// The springs are simulated by SpringMesh across all cores of the simulator
+// machine. Vertices are renumbered breadth first on load (on every node, so
+// the streamed positions match every node's mesh), which keeps the neighbors
+// of a vertex close in memory for the larger icospheres. The renumbered
+// sphere is cached in a binary file next to the .ico file (e.g.
+// 655362.ico.bin), which later runs load in milliseconds.
+//
+// The vertex positions are not part of the cuttlebone state. They are sent
+// separately by PositionSender, quantized and as differences to frames the
+// renderers have acknowledged, in datagrams that fit the MTU. Point
+// POSITIONS_ADDRESS at the render cluster's broadcast address (or at a single
+// renderer). For shaded drawing every node computes the normals itself with
+// MeshNormals, which only recomputes them around the vertices that moved.
 
 // State --------------------------
 #define N 162
@@ -27,6 +48,9 @@ using namespace al;
 //#define N 163842
 //#define N 655362
 
+#define POSITIONS_ADDRESS "127.0.0.1"
+#define POSITIONS_PORT 9110
+
 struct State {
   Pose pose; // for navigation
 
@@ -42,73 +66,11 @@ struct State {
   // simultaneously because we're using UDP broadcast, which does not use a
   // foreach to send N identical messages to N renderering hosts.
   //
-  // below is another, different win. here we have an array of vertices that
-  // could get as big as the network will bear (~10MB). this data is calculated
-  // on the server/simulator, so it does not need to be calculated on the
-  // renderer, only interpreted.
-  //
-
-  Vec3f p[N];
+  // the vertices are another matter: as a plain array they would grow to
+  // ~8MB per frame for the largest icosphere, more than the network will
+  // bear. they are streamed by PositionSender instead (see above).
 };
 
-// Load file into mesh
-bool load(std::string fileName, Mesh &mesh, std::vector<std::vector<int>> &nn) {
-  std::ifstream file(fileName);
-  if (!file.is_open())
-    return false;
-
-  std::string line;
-  int state = 0;
-  while (getline(file, line)) {
-    if (line == "|") {
-      state++;
-      continue;
-    }
-    switch (state) {
-    case 0: {
-      std::vector<float> v;
-      std::stringstream ss(line);
-      float f;
-      while (ss >> f) {
-        v.push_back(f);
-        if (ss.peek() == ',')
-          ss.ignore();
-      }
-      mesh.vertex(v[0], v[1], v[2]);
-      // cout << v[0] << "|" << v[1] << "|" << v[2] << endl;
-    } break;
-
-    case 1: {
-      std::stringstream ss(line);
-      int i;
-      if (ss >> i)
-        mesh.index(i);
-      else
-        return false;
-      // cout << i << endl;
-    } break;
-
-    case 2: {
-      std::vector<int> v;
-      std::stringstream ss(line);
-      int i;
-      while (ss >> i) {
-        v.push_back(i);
-        if (ss.peek() == ',')
-          ss.ignore();
-      }
-      if ((v.size() != 5) && (v.size() != 6))
-        return false;
-      nn.push_back(v);
-      // cout << nn[nn.size() - 1].size() << endl;
-    } break;
-    }
-  }
-  file.close();
-
-  return true;
-}
-
 #ifdef AL_WINDOWS
 // Damn you Windows!
 #undef near
@@ -134,9 +96,14 @@ struct Blob : DistributedAppWithState<State> {
   // Internal computation data
   // This data will not be shared to remote nodes, so you should only use it on
   // the simulator machine
-  vector<vector<int>> nn;
-  vector<Vec3f> velocity;
-  vector<Vec3f> original;
+  SpringMesh springs;
+  std::unique_ptr<PositionSender> positionSender;
+
+  // Vertex positions: simulated on the primary, received on the renderers
+  std::vector<Vec3f> positions;
+  std::unique_ptr<PositionReceiver> positionReceiver;
+  MeshNormals normals;
+  std::unique_ptr<ThreadPool> pool; // simulation and normals
 
   // a boolean value that is read and reset (false) by the simulation step and
   // written (true) by audio, keyboard and mouse callbacks.
@@ -146,6 +113,7 @@ struct Blob : DistributedAppWithState<State> {
 
   // a mesh we use to do graphics rendering in this app
   Mesh mesh;
+  Light light;
 
   gam::NoisePink<> pinkNoise;
 
@@ -160,24 +128,32 @@ struct Blob : DistributedAppWithState<State> {
 
     std::string icoSphereFile = std::to_string(N) + ".ico";
 
-    if (!load(searchPaths.find(icoSphereFile).filepath(), mesh, nn)) {
+    IcoSphere sphere;
+    if (!sphere.load(searchPaths.find(icoSphereFile).filepath()) ||
+        sphere.size() != N) {
       std::cout << "cannot find " << icoSphereFile << std::endl;
       quit();
+      return;
     }
+    mesh.vertices().resize(N);
+    memcpy(mesh.vertices().data(), sphere.vertices.data(), sizeof(Vec3f) * N);
+    mesh.indices().assign(sphere.indices.begin(), sphere.indices.end());
+    positions = mesh.vertices();
+    normals.setTriangles(N, mesh.indices().data(), mesh.indices().size());
+    pool.reset(new ThreadPool);
+
     if (isPrimary()) {
       shouldPoke = true; // start with a poke
 
       // Initialize simulation data
-      velocity.resize(mesh.vertices().size(), Vec3f(0, 0, 0));
-      original.resize(mesh.vertices().size());
-      for (int i = 0; i < mesh.vertices().size(); i++)
-        original[i] = mesh.vertices()[i];
-
-      for (int i = 0; i < N; i++)
-        state().p[i] = original[i];
+      springs.reset(sphere);
+      positionSender.reset(
+          new PositionSender(POSITIONS_ADDRESS, POSITIONS_PORT));
       state().eyeSeparation = 0.03;
       state().backgroundColor = Color(0.1f, 0.1f);
       state().wireFrame = true;
+    } else {
+      positionReceiver.reset(new PositionReceiver(POSITIONS_PORT, N));
     }
 
     // Enable cuttlebone for state distribution
@@ -205,30 +181,23 @@ struct Blob : DistributedAppWithState<State> {
         shouldPoke = false;
         int n = al::rnd::uniform(N);
         pokedVertex = n;
-        pokedVertexRest = original[n];
+        const float *rest = springs.rest(n);
+        pokedVertexRest = Vec3f(rest[0], rest[1], rest[2]);
         Vec3f v = Vec3f(rnd::uniformS(), rnd::uniformS(), rnd::uniformS());
-        for (unsigned k = 0; k < nn[n].size(); k++)
-          state().p[nn[n][k]] += v * 0.5;
-        state().p[n] += v;
-      }
-
-      // Compute new postions
-      for (int i = 0; i < N; i++) {
-        Vec3f &v = state().p[i];
-        Vec3f force = (v - original[i]) * -SK;
-
-        for (int k = 0; k < nn[i].size(); k++) {
-          Vec3f &n = state().p[nn[i][k]];
-          force += (v - n) * -NK;
-        }
-
-        force -= velocity[i] * D;
-        velocity[i] += force;
+        Vec3f h = v * 0.5;
+        for (const int *k = springs.neighborsBegin(n);
+             k != springs.neighborsEnd(n); k++)
+          springs.displace(*k, h.x, h.y, h.z);
+        springs.displace(n, v.x, v.y, v.z);
       }
 
-      for (int i = 0; i < N; i++) {
-        state().p[i] += velocity[i];
-      }
+      // Simulate new positions into `positions` and stream them to the
+      // renderers with PositionSender
+      springs.anchorStiffness = SK;
+      springs.neighborStiffness = NK;
+      springs.damping = D;
+      springs.step(*pool, &positions[0][0]);
+      positionSender->send(&positions[0][0], N);
 
       // Update variables in state to send to nodes
       state().pose = nav();
@@ -240,9 +209,19 @@ struct Blob : DistributedAppWithState<State> {
       pose() = state().pose;
       bgColor = state().backgroundColor;
       wireFrame = state().wireFrame;
+
+      if (positionReceiver->poll() &&
+          positionReceiver->positions().size() == 3 * N) {
+        memcpy(&positions[0], positionReceiver->positions().data(),
+               sizeof(Vec3f) * N);
+      }
+    }
+    // Copy vertex positions to mesh
+    memcpy(&mesh.vertices()[0], &positions[0], sizeof(Vec3f) * N);
+    if (!state().wireFrame) {
+      mesh.normals().resize(N);
+      normals.update(&positions[0][0], &mesh.normals()[0][0], *pool);
     }
-    // Copy vertex positions from state to mesh
-    memcpy(&mesh.vertices()[0], &state().p[0], sizeof(Vec3f) * N);
   }
 
   void onDraw(Graphics &g) override {
@@ -255,8 +234,11 @@ struct Blob : DistributedAppWithState<State> {
     }
     if (state().wireFrame) {
       g.polygonLine();
+      g.lighting(false);
     } else {
       g.polygonFill();
+      g.lighting(true);
+      g.light(light);
     }
     g.draw(mesh);
     g.popMatrix();
@@ -275,7 +257,7 @@ struct Blob : DistributedAppWithState<State> {
           }
         }
 
-        float f = (state().p[pokedVertex] - pokedVertexRest).mag() - 0.45;
+        float f = (positions[pokedVertex] - pokedVertexRest).mag() - 0.45;
 
         if (f > 0.99) {
           f = 0.99;
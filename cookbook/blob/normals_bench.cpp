@@ -0,0 +1,179 @@
+// Benchmark for MeshNormals against regenerating every normal each frame, on
+// a 256x256 surface (the mesh of waveEquation.cpp) and the 40962 vertex
+// icosphere of the Blob.
+//
+// "full" is a stand-in for Mesh::generateNormals(): zero the normals,
+// accumulate the face normals of every triangle into its vertices, then
+// normalize. MeshNormals is timed recomputing everything, and updating after
+// all vertices moved and after a patch of about 1% of them moved, on one
+// thread and across a ThreadPool. Its normals are checked against the full
+// sweep.
+//
+// Build and run with ./run.sh cookbook/blob/normals_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+#include "common/MeshNormals.hpp"
+
+#include "IcoSphere.hpp"
+
+struct TestMesh {
+  std::string name;
+  std::vector<float> positions;
+  std::vector<unsigned> indices;
+  std::vector<int> patch; // about 1% of the vertices, close together
+};
+
+TestMesh makeSurface(int n) {
+  TestMesh m;
+  m.name = std::to_string(n) + "x" + std::to_string(n) + " surface";
+  for (int j = 0; j < n; j++) {
+    for (int i = 0; i < n; i++) {
+      m.positions.insert(m.positions.end(), {2.0f * i / (n - 1) - 1,
+                                             2.0f * j / (n - 1) - 1, 0.0f});
+    }
+  }
+  for (int j = 0; j < n - 1; j++) {
+    for (int i = 0; i < n - 1; i++) {
+      unsigned a = j * n + i, b = a + 1, c = a + n, d = c + 1;
+      m.indices.insert(m.indices.end(), {a, b, d, a, d, c});
+    }
+  }
+  const int side = n / 10;
+  for (int j = 0; j < side; j++) {
+    for (int i = 0; i < side; i++) {
+      m.patch.push_back((n / 2 + j) * n + n / 2 + i);
+    }
+  }
+  return m;
+}
+
+TestMesh makeSphere(int levels) {
+  IcoSphere s = IcoSphere::subdivided(levels);
+  s.reorder(s.breadthFirstOrder());
+  TestMesh m;
+  m.name = std::to_string(s.size()) + " icosphere";
+  m.positions = s.vertices;
+  m.indices = s.indices;
+  // Breadth first numbering: a run of indices is a patch of the surface
+  for (int v = s.size() / 2; v < s.size() / 2 + s.size() / 100; v++) {
+    m.patch.push_back(v);
+  }
+  return m;
+}
+
+void fullNormals(const TestMesh &m, const float *p,
+                 std::vector<float> &normals) {
+  std::fill(normals.begin(), normals.end(), 0.0f);
+  for (size_t t = 0; t < m.indices.size(); t += 3) {
+    const float *a = p + m.indices[t] * 3, *b = p + m.indices[t + 1] * 3,
+                *c = p + m.indices[t + 2] * 3;
+    float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                  e1[0] * e2[1] - e1[1] * e2[0]};
+    for (int k = 0; k < 3; k++) {
+      float *v = &normals[m.indices[t + k] * 3];
+      v[0] += n[0];
+      v[1] += n[1];
+      v[2] += n[2];
+    }
+  }
+  for (size_t v = 0; v < normals.size(); v += 3) {
+    float length = std::sqrt(normals[v] * normals[v] +
+                             normals[v + 1] * normals[v + 1] +
+                             normals[v + 2] * normals[v + 2]);
+    float s = length > 0 ? 1 / length : 0;
+    normals[v] *= s;
+    normals[v + 1] *= s;
+    normals[v + 2] *= s;
+  }
+}
+
+// The positions with the given vertices (every vertex if the list is empty)
+// moved a little
+std::vector<float> deformed(const TestMesh &m, const std::vector<int> &moving) {
+  std::vector<float> p = m.positions;
+  auto move = [&](int v) {
+    p[v * 3] += 1e-3f * std::sin(0.37f * v);
+    p[v * 3 + 1] += 1e-3f * std::cos(0.37f * v);
+    p[v * 3 + 2] += 1e-3f * std::sin(0.5f * v);
+  };
+  if (moving.empty()) {
+    for (int v = 0; v < int(p.size() / 3); v++) {
+      move(v);
+    }
+  } else {
+    for (int v : moving) {
+      move(v);
+    }
+  }
+  return p;
+}
+
+int main() {
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  printf("%d hardware threads. Milliseconds per frame:\n", int(cores));
+  printf("%-20s %8s %8s %9s %9s", "", "full", "all", "all moved",
+         "1% moved");
+  if (cores > 1) {
+    printf(" %9s %9s", "all, thr", "1%, thr");
+  }
+  printf(" %8s\n", "max diff");
+
+  for (const TestMesh &m : {makeSurface(256), makeSphere(6)}) {
+    const int n = int(m.positions.size() / 3);
+    std::vector<float> reference(m.positions.size()),
+        normals(m.positions.size());
+    // Frames alternate between the rest positions and one of these
+    const std::vector<float> allMoved = deformed(m, {});
+    const std::vector<float> patchMoved = deformed(m, m.patch);
+    int frame = 0;
+    auto alternate = [&](const std::vector<float> &moved) {
+      return frame++ % 2 ? moved.data() : m.positions.data();
+    };
+
+    double full = bench::measure(
+        [&]() { fullNormals(m, alternate(allMoved), reference); });
+
+    ThreadPool single(1), pool(cores);
+    MeshNormals engine;
+    engine.setTriangles(n, m.indices.data(), m.indices.size());
+    double all = bench::measure([&]() {
+      engine.updateAll(alternate(allMoved), normals.data(), single);
+    });
+    auto timeUpdate = [&](const std::vector<float> &moved, ThreadPool &p) {
+      return bench::measure(
+          [&]() { engine.update(alternate(moved), normals.data(), p); });
+    };
+    double allTime = timeUpdate(allMoved, single);
+    double patchTime = timeUpdate(patchMoved, single);
+    double allThreads = 0, patchThreads = 0;
+    if (cores > 1) {
+      allThreads = timeUpdate(allMoved, pool);
+      patchThreads = timeUpdate(patchMoved, pool);
+    }
+
+    // The incrementally updated normals match a full sweep
+    const float *last = frame % 2 ? m.positions.data() : patchMoved.data();
+    fullNormals(m, last, reference);
+    float difference = 0;
+    for (size_t i = 0; i < normals.size(); i++) {
+      difference = std::max(difference, std::abs(normals[i] - reference[i]));
+    }
+
+    printf("%-20s %8.3f %8.3f %9.3f %9.3f", m.name.c_str(), full * 1e3,
+           all * 1e3, allTime * 1e3, patchTime * 1e3);
+    if (cores > 1) {
+      printf(" %9.3f %9.3f", allThreads * 1e3, patchThreads * 1e3);
+    }
+    printf(" %8.1e\n", difference);
+  }
+  return 0;
+}
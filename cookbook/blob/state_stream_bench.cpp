@@ -0,0 +1,207 @@
+// Benchmark for sending the Blob's positions with PositionCodec.hpp instead of
+// the whole state: bytes per frame, datagrams per frame, quantization error
+// and encode/decode time at 2562, 40962 and 655362 vertices.
+//
+// Every size runs 240 frames of the spring simulation with a poke every 120
+// frames. The decoder acknowledges every frame right away, like a receiver
+// on a fast network would. "state" is what the State struct with Vec3f p[N]
+// costs per frame.
+//
+// Then the 40962 vertex blob is streamed between two processes over
+// loopback UDP: the receiver process runs the same simulation and checks
+// every frame it reconstructs. To try two machines (or two terminals), run
+// the program with "receive" on the renderer and "send <address>" on the
+// simulator.
+//
+// Build and run with ./run.sh cookbook/blob/state_stream_bench.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "common/Benchmark.hpp"
+
+#include "IcoSphere.hpp"
+#include "PositionStream.hpp"
+#include "SpringMesh.hpp"
+
+const uint16_t kPort = 9117;
+const int kFrames = 240;
+
+// The Blob's simulation, deterministic: frame k is the state after k + 1
+// steps
+struct Simulation {
+  SpringMesh springs;
+  ThreadPool pool{1};
+  std::vector<float> positions;
+  int steps = 0;
+
+  explicit Simulation(int levels) {
+    IcoSphere sphere = IcoSphere::subdivided(levels);
+    sphere.reorder(sphere.breadthFirstOrder());
+    springs.reset(sphere);
+    positions.resize(sphere.vertices.size());
+  }
+
+  int size() const { return springs.size(); }
+
+  void step() {
+    if (steps % 120 == 0) {
+      const int n = int((steps / 120 * 7919L + 17) % size());
+      for (const int *k = springs.neighborsBegin(n);
+           k != springs.neighborsEnd(n); k++) {
+        springs.displace(*k, 0.3f, -0.2f, 0.25f);
+      }
+      springs.displace(n, 0.6f, -0.4f, 0.5f);
+    }
+    springs.step(pool, positions.data());
+    steps++;
+  }
+};
+
+float maxError(const std::vector<float> &a, const std::vector<float> &b) {
+  float e = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    e = std::max(e, std::abs(a[i] - b[i]));
+  }
+  return e;
+}
+
+void codecTable() {
+  printf("%8s %10s %10s %10s %8s %6s %10s %8s %8s\n", "vertices", "state B",
+         "key B", "mean B", "packets", "keys", "max error", "enc ms",
+         "dec ms");
+  for (int levels : {4, 6, 8}) {
+    Simulation sim(levels);
+    PositionEncoder encoder;
+    PositionDecoder decoder;
+    size_t bytes = 0, packets = 0, keys = 0, keyBytes = 0;
+    double encodeTime = 0, decodeTime = 0;
+    float error = 0;
+    std::vector<std::vector<uint8_t>> datagrams;
+    for (int f = 0; f < kFrames; f++) {
+      sim.step();
+      datagrams.clear();
+      auto start = bench::Clock::now();
+      size_t frameBytes = encoder.encode(
+          sim.positions.data(), sim.size(),
+          [&](const uint8_t *data, size_t size) {
+            datagrams.emplace_back(data, data + size);
+          });
+      encodeTime += bench::secondsSince(start);
+      start = bench::Clock::now();
+      for (auto &d : datagrams) {
+        decoder.receive(d.data(), d.size());
+      }
+      decodeTime += bench::secondsSince(start);
+      uint32_t held[position_codec::kHistory];
+      encoder.acknowledge(1, decoder.session(), held,
+                          decoder.heldFrames(held));
+
+      bytes += frameBytes;
+      packets += datagrams.size();
+      if (encoder.lastWasKey()) {
+        keys++;
+        keyBytes = frameBytes;
+      }
+      error = std::max(error, maxError(decoder.positions(), sim.positions));
+    }
+    printf("%8d %10zu %10zu %10zu %8.1f %6zu %10.2e %8.2f %8.2f\n",
+           sim.size(), size_t(sim.size()) * 12, keyBytes, bytes / kFrames,
+           double(packets) / kFrames, keys, error, encodeTime / kFrames * 1e3,
+           decodeTime / kFrames * 1e3);
+  }
+}
+
+void send(const std::string &address, int levels) {
+  Simulation sim(levels);
+  PositionSender sender(address, kPort);
+  if (!sender.isOpen()) {
+    printf("cannot send to %s\n", address.c_str());
+    return;
+  }
+  size_t bytes = 0, packets = 0, keys = 0;
+  auto next = std::chrono::steady_clock::now();
+  for (int f = 0; f < kFrames; f++) {
+    sim.step();
+    sender.send(sim.positions.data(), sim.size());
+    bytes += sender.lastBytes();
+    packets += sender.lastPackets();
+    keys += sender.lastWasKey() ? 1 : 0;
+    next += std::chrono::microseconds(16667); // 60 frames per second
+    std::this_thread::sleep_until(next);
+  }
+  printf("sender: %d frames, %zu bytes/frame, %.1f datagrams/frame, %zu key "
+         "frames, %zu receivers\n",
+         kFrames, bytes / kFrames, double(packets) / kFrames, keys,
+         sender.receivers());
+}
+
+void receive(int levels) {
+  Simulation sim(levels);
+  PositionReceiver receiver(kPort);
+  if (!receiver.isOpen()) {
+    printf("cannot listen on port %d\n", int(kPort));
+    return;
+  }
+  int frames = 0;
+  float error = 0;
+  // Until the sender has been silent for a second (or never starts)
+  while (receiver.wait(frames > 0 ? 1.0 : 10.0)) {
+    if (!receiver.poll()) {
+      continue;
+    }
+    while (uint32_t(sim.steps) < receiver.frame() + 1) {
+      sim.step();
+    }
+    error = std::max(error, maxError(receiver.positions(), sim.positions));
+    frames++;
+  }
+  const PositionDecoder &d = receiver.decoder();
+  printf("receiver: %d of %d frames reconstructed (%zu key, %zu delta, %zu "
+         "dropped), max error %.2e\n",
+         frames, kFrames, d.keyFrames(), d.deltaFrames(), d.droppedFrames(),
+         error);
+}
+
+int main(int argc, char *argv[]) {
+  const int streamLevels = 6;
+  if (argc > 1 && std::strcmp(argv[1], "receive") == 0) {
+    receive(streamLevels);
+    return 0;
+  }
+  if (argc > 1 && std::strcmp(argv[1], "send") == 0) {
+    send(argc > 2 ? argv[2] : "127.0.0.1", streamLevels);
+    return 0;
+  }
+
+  codecTable();
+
+#if defined(__unix__) || defined(__APPLE__)
+  printf("\n%d vertices over loopback UDP, 60 frames per second:\n",
+         Simulation(streamLevels).size());
+  fflush(stdout);
+  pid_t child = fork();
+  if (child == 0) {
+    receive(streamLevels);
+    fflush(stdout);
+    _exit(0);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  send("127.0.0.1", streamLevels);
+  fflush(stdout);
+  int status;
+  waitpid(child, &status, 0);
+#endif
+  return 0;
+}
@@ -0,0 +1,222 @@
+#pragma once
+#ifndef FUNCTION_SAMPLER_HPP
+#define FUNCTION_SAMPLER_HPP
+
+// Samples y = f(x) over [xMin, xMax] into a polyline for the grapher.
+//
+// f comes as a batch function, `void f(const double *x, double *y, int n)`
+// (GraphFunction.hpp compiles one), and is only ever called on arrays. The
+// domain is first cut into `samples` equal intervals whose ends are
+// evaluated in batches spread over a ThreadPool. Then every interval is
+// refined on its own, one level at a time: the midpoints of the intervals
+// still refining are evaluated in one batch, and an interval whose
+// midpoint misses the chord between its ends by more than `tolerance` is
+// halved, both halves going on to the next level. Straight stretches cost
+// nothing beyond the uniform samples and curvy ones get points where they
+// need them, down to intervals 2^maxDepth times shorter. Where f is not
+// finite at an interval's ends or midpoint the interval is not refined.
+//
+// The intervals are refined in groups of kGroup, each group on one thread,
+// with a share of maxPoints proportional to its size, so the result does
+// not depend on the number of threads. update() samples only when the
+// function (told apart by its generation) or the settings changed; the
+// polyline stays as it is otherwise.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "common/ThreadPool.hpp"
+
+class FunctionSampler {
+public:
+  using BatchFunction = void (*)(const double *x, double *y, int n);
+
+  struct Point {
+    float x, y;
+  };
+
+  struct Settings {
+    double xMin{-1}, xMax{1};
+    int samples{1999};       // uniform intervals
+    int maxDepth{10};        // halvings of a uniform interval
+    double tolerance{5e-4};  // off the chord, in units of y
+    size_t maxPoints{1u << 22};
+
+    bool operator==(const Settings &o) const {
+      return xMin == o.xMin && xMax == o.xMax && samples == o.samples &&
+             maxDepth == o.maxDepth && tolerance == o.tolerance &&
+             maxPoints == o.maxPoints;
+    }
+  };
+
+  Settings settings;
+
+  explicit FunctionSampler(unsigned numThreads = 0) : mPool(numThreads) {}
+
+  ThreadPool &pool() { return mPool; }
+
+  // Samples fn unless it is the generation sampled last with the same
+  // settings. Returns whether it sampled; a null fn keeps the polyline.
+  bool update(BatchFunction fn, unsigned generation) {
+    if (fn == nullptr ||
+        (mSampled && generation == mGeneration && settings == mSettings)) {
+      return false;
+    }
+    sample(fn);
+    mGeneration = generation;
+    return true;
+  }
+
+  void sample(BatchFunction fn) {
+    mSettings = settings;
+    mSampled = true;
+    const Settings &s = mSettings;
+    const size_t intervals = size_t(std::max(1, s.samples));
+    const size_t budget = std::max(s.maxPoints, intervals + 1);
+
+    // The uniform samples
+    mX.resize(intervals + 1);
+    mY.resize(intervals + 1);
+    const size_t batches = (intervals + kBatch) / kBatch;
+    const double dx = (s.xMax - s.xMin) / double(intervals);
+    mPool.parallelFor(batches, [&](size_t b, unsigned) {
+      const size_t begin = b * kBatch;
+      const size_t n = std::min(size_t(kBatch), intervals + 1 - begin);
+      for (size_t i = begin; i < begin + n; i++) {
+        mX[i] = s.xMin + dx * double(i);
+      }
+      fn(&mX[begin], &mY[begin], int(n));
+    });
+
+    mEvaluations = intervals + 1;
+    if (s.maxDepth <= 0) {
+      mPoints.resize(intervals + 1);
+      mPool.parallelFor(batches, [&](size_t b, unsigned) {
+        const size_t begin = b * kBatch;
+        const size_t end = std::min(begin + kBatch, intervals + 1);
+        for (size_t i = begin; i < end; i++) {
+          mPoints[i] = Point{float(mX[i]), float(mY[i])};
+        }
+      });
+      return;
+    }
+
+    // Refinement
+    const size_t groups = (intervals + kGroup - 1) / kGroup;
+    if (mGroups.size() < groups) {
+      mGroups.resize(groups);
+    }
+    mPool.parallelFor(groups, [&](size_t g, unsigned) {
+      const size_t begin = g * kGroup;
+      const size_t end = std::min(begin + kGroup, intervals);
+      refine(fn, mGroups[g], begin, end, budget * (end - begin) / intervals);
+    });
+
+    // The groups' points one after the other, then the last uniform sample
+    size_t total = 1;
+    mOffsets.resize(groups);
+    for (size_t g = 0; g < groups; g++) {
+      mOffsets[g] = total - 1;
+      total += mGroups[g].points.size();
+    }
+    mPoints.resize(total);
+    mPool.parallelFor(groups, [&](size_t g, unsigned) {
+      Point *out = &mPoints[mOffsets[g]];
+      for (const Sample &p : mGroups[g].points) {
+        *out++ = Point{float(p.x), float(p.y)};
+      }
+    });
+    mPoints.back() = Point{float(mX.back()), float(mY.back())};
+    for (size_t g = 0; g < groups; g++) {
+      mEvaluations += mGroups[g].evaluations;
+    }
+  }
+
+  // The polyline, in order of x
+  const std::vector<Point> &points() const { return mPoints; }
+
+  // Calls to the function the last sample() made
+  size_t evaluations() const { return mEvaluations; }
+
+private:
+  static const size_t kBatch = 1024; // uniform samples per batch
+  static const size_t kGroup = 64;   // uniform intervals per thread
+
+  struct Sample {
+    double x, y;
+  };
+
+  struct Interval {
+    Sample a, b;
+  };
+
+  // A group's scratch memory, kept from one sample() to the next
+  struct Group {
+    std::vector<Sample> points;
+    std::vector<Interval> active, next;
+    std::vector<double> x, y;
+    size_t evaluations{0};
+  };
+
+  // Refines the uniform intervals [begin, end) into group.points, which
+  // gets their starts and every midpoint, sorted by x
+  void refine(BatchFunction fn, Group &group, size_t begin, size_t end,
+              size_t budget) {
+    const Settings &s = mSettings;
+    group.points.clear();
+    group.active.clear();
+    group.evaluations = 0;
+    for (size_t i = begin; i < end; i++) {
+      const Sample a{mX[i], mY[i]}, b{mX[i + 1], mY[i + 1]};
+      group.points.push_back(a);
+      if (std::isfinite(a.y) && std::isfinite(b.y)) {
+        group.active.push_back(Interval{a, b});
+      }
+    }
+    for (int depth = 0; depth < s.maxDepth && !group.active.empty();
+         depth++) {
+      const size_t n = group.active.size();
+      if (group.points.size() + n > budget) {
+        break;
+      }
+      group.x.resize(n);
+      group.y.resize(n);
+      for (size_t k = 0; k < n; k++) {
+        group.x[k] = 0.5 * (group.active[k].a.x + group.active[k].b.x);
+      }
+      fn(group.x.data(), group.y.data(), int(n));
+      group.evaluations += n;
+
+      group.next.clear();
+      for (size_t k = 0; k < n; k++) {
+        const Interval &in = group.active[k];
+        const Sample m{group.x[k], group.y[k]};
+        group.points.push_back(m);
+        const double off = std::abs(m.y - 0.5 * (in.a.y + in.b.y));
+        if (std::isfinite(m.y) && off > s.tolerance) {
+          group.next.push_back(Interval{in.a, m});
+          group.next.push_back(Interval{m, in.b});
+        }
+      }
+      group.active.swap(group.next);
+    }
+    if (group.points.size() > end - begin) {
+      std::sort(group.points.begin(), group.points.end(),
+                [](const Sample &p, const Sample &q) { return p.x < q.x; });
+    }
+  }
+
+  ThreadPool mPool;
+  Settings mSettings;
+  bool mSampled{false};
+  unsigned mGeneration{0};
+  std::vector<double> mX, mY; // the uniform samples
+  std::vector<Group> mGroups;
+  std::vector<size_t> mOffsets;
+  std::vector<Point> mPoints;
+  size_t mEvaluations{0};
+};
+
+#endif // FUNCTION_SAMPLER_HPP
@@ -0,0 +1,154 @@
+#pragma once
+#ifndef GRAPH_FUNCTION_HPP
+#define GRAPH_FUNCTION_HPP
+
+// The function the grapher plots: C source compiled in memory by TCC.
+//
+// The user writes `double function(double x)`. Every compile adds a loop
+// around it,
+//
+//   void function_batch(const double *x, double *y, int n)
+//
+// which evaluates n points at once, so FunctionSampler.hpp makes one
+// indirect call per batch instead of one per point. The loop is a unit of
+// its own, compiled after the user's straight from the editor's text, so
+// the text is never copied to make one source of both. It calls function,
+// since TCC does not inline; the call stays inside the compiled code. The
+// batch reads nothing but its arguments, so several threads may run it at
+// once as long as function keeps no state of its own.
+
+#include <cassert>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "libtcc.h"
+
+const char *const starterCode = R"(
+double tanh(double);
+double sin(double);
+double exp(double);
+double modf(double, double*);
+double fmod(double, double);
+
+double function(double x) {
+  return 0.3;
+  //return x;
+  //return tanh(6 * x);
+  //return x += .4, x *= 5, exp(-x * x);
+  //return x *= 100, sin(x) / x;
+  //return x += 1, sin(220 * x) * exp(-x * 5);
+  //return x *= 2, x * x * x - x * x - x / 10;
+  //return x + sin(x * 10) / 10;
+  //return modf(3 * x, &x);
+  //return fmod(x, .3333);
+}
+)";
+
+// Compiled along with the user's code
+const char *const kBatchWrapper = R"(
+double function(double x);
+
+void function_batch(const double *x, double *y, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    y[i] = function(x[i]);
+  }
+}
+)";
+
+inline void tccErrorHandler(void *tcc, const char *msg);
+
+struct TCC {
+  using FunctionPointer = double (*)(double);
+  using BatchFunction = void (*)(const double *, double *, int);
+  FunctionPointer function = nullptr;
+  BatchFunction batch = nullptr;
+  TCCState *instance = nullptr;
+  std::string error;
+  // Counts the successful compiles, so a sampler can tell new code from old
+  // even when it was relocated to the same address
+  unsigned generation = 0;
+
+  TCC() = default;
+  TCC(const TCC &) = delete;
+  TCC &operator=(const TCC &) = delete;
+  ~TCC() { destroy(); }
+
+  void destroy() {
+    if (instance) {
+      tcc_delete(instance);
+      instance = nullptr;
+    }
+    function = nullptr;
+    batch = nullptr;
+  }
+
+  bool compile(const std::string &source) {
+    destroy();
+    instance = tcc_new();
+    assert(instance != nullptr);
+
+    tcc_set_options(instance, "-nostdinc -Wall -Werror");
+    tcc_set_error_func(instance, this, tccErrorHandler);
+    tcc_set_output_type(instance, TCC_OUTPUT_MEMORY);
+
+    if (tcc_compile_string(instance, source.c_str()) == -1 ||
+        tcc_compile_string(instance, kBatchWrapper) == -1) {
+      // error string is set by the TCC handler
+      destroy();
+      return false;
+    }
+
+    if (tcc_relocate(instance, TCC_RELOCATE_AUTO) < 0) {
+      error = "failed to relocate code";
+      destroy();
+      return false;
+    }
+
+    FunctionPointer foo =
+        (FunctionPointer)(tcc_get_symbol(instance, "function"));
+    BatchFunction many =
+        (BatchFunction)(tcc_get_symbol(instance, "function_batch"));
+    if (foo == nullptr || many == nullptr) {
+      error = "could not find the symbol 'function'";
+      destroy();
+      return false;
+    }
+
+    error = "";
+    function = foo;
+    batch = many;
+    generation++;
+    return true;
+  }
+
+  // One point, through a call per point
+  double operator()(double x) {
+    if (function == nullptr) return 0;
+    return function(x);
+  }
+};
+
+inline void tccErrorHandler(void *tcc, const char *msg) {
+  ((TCC *)tcc)->error = msg;
+}
+
+// The declarations of starterCode followed by, one by one, every function
+// it has commented out, as sources. The benchmark runs them all.
+inline std::vector<std::string> starterFunctions() {
+  const std::string code = starterCode;
+  const std::string declarations = code.substr(0, code.find("double function"));
+  std::vector<std::string> sources;
+  std::istringstream lines(code);
+  std::string line;
+  while (std::getline(lines, line)) {
+    const size_t at = line.find("return");
+    if (at == std::string::npos) continue;
+    sources.push_back(declarations + "double function(double x) {\n  " +
+                      line.substr(at) + "\n}\n");
+  }
+  return sources;
+}
+
+#endif // GRAPH_FUNCTION_HPP
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <limits>
 #include <regex>
 #include <string>
 
@@ -35,14 +36,18 @@ TextEditor::TextEditor()
       mTextChanged(false),
       mTextStart(20.0f),
       mLeftMargin(10),
-      mColorRangeMin(0),
+      mColorRangeMin(std::numeric_limits<int>::max()),
       mColorRangeMax(0),
       mSelectionMode(SelectionMode::Normal),
-      mCheckComments(true),
+      mTextValid(false),
+      mTextFirst(std::numeric_limits<int>::max()),
+      mTextTail(std::numeric_limits<int>::max()),
       mLastClick(-1.0f) {
   SetPalette(GetDarkPalette());
-  SetLanguageDefinition(LanguageDefinition::HLSL());
+  // The grapher edits C
+  SetLanguageDefinition(LanguageDefinition::C());
   mLines.push_back(Line());
+  mLineStates.push_back(LineState());
 }
 
 TextEditor::~TextEditor() {}
@@ -54,6 +59,8 @@ void TextEditor::SetLanguageDefinition(const LanguageDefinition& aLanguageDef) {
   for (auto& r : mLanguageDefinition.mTokenRegexStrings)
     mRegexList.push_back(std::make_pair(
         std::regex(r.first, std::regex_constants::optimize), r.second));
+
+  Colorize();
 }
 
 void TextEditor::SetPalette(const Palette& aValue) { mPaletteBase = aValue; }
@@ -136,6 +143,7 @@ void TextEditor::DeleteRange(const Coordinates& aStart,
 
   if (aEnd == aStart) return;
 
+  LinesChanged(aStart.mLine, aStart.mLine);
   if (aStart.mLine == aEnd.mLine) {
     auto& line = mLines[aStart.mLine];
     if (aEnd.mColumn >= (int)line.size())
@@ -170,6 +178,7 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere,
     if (chr == '\r') {
       // skip
     } else if (chr == '\n') {
+      LinesChanged(aWhere.mLine, aWhere.mLine);
       if (aWhere.mColumn < (int)mLines[aWhere.mLine].size()) {
         auto& newLine = InsertLine(aWhere.mLine + 1);
         auto& line = mLines[aWhere.mLine];
@@ -183,6 +192,7 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere,
       aWhere.mColumn = 0;
       ++totalLines;
     } else {
+      LinesChanged(aWhere.mLine, aWhere.mLine);
       auto& line = mLines[aWhere.mLine];
       line.insert(line.begin() + aWhere.mColumn,
                   Glyph(chr, PaletteIndex::Default));
@@ -312,8 +322,13 @@ void TextEditor::RemoveLine(int aStart, int aEnd) {
   }
   mBreakpoints = std::move(btmp);
 
+  LinesChanged(aStart, aEnd - 1);
   mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
+  mLineStates.erase(mLineStates.begin() + aStart,
+                    mLineStates.begin() + aEnd);
   assert(!mLines.empty());
+  ShiftColorRange(aStart, aStart - aEnd);
+  Colorize(aStart - 1, 2);
 
   mTextChanged = true;
 }
@@ -338,8 +353,12 @@ void TextEditor::RemoveLine(int aIndex) {
   }
   mBreakpoints = std::move(btmp);
 
+  LinesChanged(aIndex, aIndex);
   mLines.erase(mLines.begin() + aIndex);
+  mLineStates.erase(mLineStates.begin() + aIndex);
   assert(!mLines.empty());
+  ShiftColorRange(aIndex, -1);
+  Colorize(aIndex - 1, 2);
 
   mTextChanged = true;
 }
@@ -347,7 +366,11 @@ void TextEditor::RemoveLine(int aIndex) {
 TextEditor::Line& TextEditor::InsertLine(int aIndex) {
   assert(!mReadOnly);
 
+  LinesChanged(aIndex, aIndex - 1);
   auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+  mLineStates.insert(mLineStates.begin() + aIndex, LineState());
+  ShiftColorRange(aIndex, 1);
+  Colorize(aIndex - 1, 2);
 
   ErrorMarkers etmp;
   for (auto& i : mErrorMarkers)
@@ -830,7 +853,7 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder) {
 
   HandleKeyboardInputs();
   HandleMouseInputs();
-  ColorizeInternal();
+  ColorizeStep();
   Render();
 
   ImGui::PopAllowKeyboardFocus();
@@ -853,6 +876,8 @@ void TextEditor::SetText(const std::string& aText) {
       mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
     }
   }
+  mLineStates.assign(mLines.size(), LineState());
+  mTextValid = false;
 
   mTextChanged = true;
   mScrollToTop = true;
@@ -879,6 +904,8 @@ void TextEditor::SetTextLines(const std::vector<std::string>& aLines) {
         mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
     }
   }
+  mLineStates.assign(mLines.size(), LineState());
+  mTextValid = false;
 
   mTextChanged = true;
   mScrollToTop = true;
@@ -917,6 +944,7 @@ void TextEditor::EnterCharacter(Char aChar, bool aShift) {
       bool modified = false;
 
       for (int i = start.mLine; i <= end.mLine; i++) {
+        LinesChanged(i, i);
         auto& line = mLines[i];
         if (aShift) {
           if (line.empty() == false) {
@@ -969,6 +997,7 @@ void TextEditor::EnterCharacter(Char aChar, bool aShift) {
 
   if (aChar == '\n') {
     InsertLine(coord.mLine + 1);
+    LinesChanged(coord.mLine, coord.mLine + 1);
     auto& line = mLines[coord.mLine];
     auto& newLine = mLines[coord.mLine + 1];
 
@@ -982,6 +1011,7 @@ void TextEditor::EnterCharacter(Char aChar, bool aShift) {
     line.erase(line.begin() + coord.mColumn, line.begin() + line.size());
     SetCursorPosition(Coordinates(coord.mLine + 1, (int)whitespaceSize));
   } else {
+    LinesChanged(coord.mLine, coord.mLine);
     auto& line = mLines[coord.mLine];
     if (mOverwrite && (int)line.size() > coord.mColumn)
       line[coord.mColumn] = Glyph(aChar, PaletteIndex::Default);
@@ -1310,6 +1340,7 @@ void TextEditor::Delete() {
       u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
       Advance(u.mRemovedEnd);
 
+      LinesChanged(pos.mLine, pos.mLine);
       auto& nextLine = mLines[pos.mLine + 1];
       line.insert(line.end(), nextLine.begin(), nextLine.end());
       RemoveLine(pos.mLine + 1);
@@ -1318,6 +1349,7 @@ void TextEditor::Delete() {
       u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
       u.mRemovedEnd.mColumn++;
 
+      LinesChanged(pos.mLine, pos.mLine);
       line.erase(line.begin() + pos.mColumn);
     }
 
@@ -1359,6 +1391,8 @@ void TextEditor::BackSpace() {
       auto& line = mLines[mState.mCursorPosition.mLine];
       auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
       auto prevSize = (int)prevLine.size();
+      LinesChanged(mState.mCursorPosition.mLine - 1,
+                   mState.mCursorPosition.mLine - 1);
       prevLine.insert(prevLine.end(), line.begin(), line.end());
 
       ErrorMarkers etmp;
@@ -1379,6 +1413,7 @@ void TextEditor::BackSpace() {
       --u.mRemovedStart.mColumn;
 
       --mState.mCursorPosition.mColumn;
+      LinesChanged(mState.mCursorPosition.mLine, mState.mCursorPosition.mLine);
       if (mState.mCursorPosition.mColumn < (int)line.size())
         line.erase(line.begin() + mState.mCursorPosition.mColumn);
     }
@@ -1558,8 +1593,59 @@ const TextEditor::Palette& TextEditor::GetRetroBluePalette() {
   return p;
 }
 
-std::string TextEditor::GetText() const {
-  return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
+const std::string& TextEditor::GetText() const {
+  const int count = (int)mLines.size();
+  if (!mTextValid) {
+    mText.clear();
+    mLineOffsets.resize(count + 1);
+    for (int i = 0; i < count; ++i) {
+      if (i > 0) mText.push_back('\n');
+      mLineOffsets[i] = mText.size();
+      for (auto& glyph : mLines[i]) mText.push_back(glyph.mChar);
+    }
+    mLineOffsets[count] = mText.size() + 1;
+    mTextValid = true;
+  } else if (mTextFirst != std::numeric_limits<int>::max()) {
+    // Replaces the edited lines, from mTextFirst to the mTextTail lines left
+    // alone at the end, in place. Lines before the tail are followed by
+    // their line break; without a tail they are preceded by the one of the
+    // line before instead, as the last line has none.
+    const int oldCount = (int)mLineOffsets.size() - 1;
+    const int first = mTextFirst;
+    const int tail =
+        std::max(0, std::min(mTextTail, std::min(oldCount, count) - first));
+    const int oldEnd = oldCount - tail, newEnd = count - tail;
+    size_t begin, end;
+    if (tail > 0) {
+      begin = mLineOffsets[first];
+      end = mLineOffsets[oldEnd];
+    } else {
+      begin = first > 0 ? mLineOffsets[first] - 1 : 0;
+      end = mText.size();
+    }
+
+    std::string middle;
+    std::vector<size_t> starts;
+    starts.reserve(newEnd - first);
+    for (int i = first; i < newEnd; ++i) {
+      if (tail == 0 && i > 0) middle.push_back('\n');
+      starts.push_back(begin + middle.size());
+      for (auto& glyph : mLines[i]) middle.push_back(glyph.mChar);
+      if (tail > 0) middle.push_back('\n');
+    }
+    mText.replace(begin, end - begin, middle);
+
+    if (newEnd > oldEnd)
+      mLineOffsets.insert(mLineOffsets.begin() + oldEnd, newEnd - oldEnd, 0);
+    else
+      mLineOffsets.erase(mLineOffsets.begin() + newEnd,
+                         mLineOffsets.begin() + oldEnd);
+    for (int i = newEnd; i <= count; ++i)
+      mLineOffsets[i] = mLineOffsets[i] - end + begin + middle.size();
+    std::copy(starts.begin(), starts.end(), mLineOffsets.begin() + first);
+  }
+  mTextFirst = mTextTail = std::numeric_limits<int>::max();
+  return mText;
 }
 
 std::vector<std::string> TextEditor::GetTextLines() const {
@@ -1599,211 +1685,216 @@ void TextEditor::Colorize(int aFromLine, int aLines) {
   mColorRangeMax = std::max(mColorRangeMax, toLine);
   mColorRangeMin = std::max(0, mColorRangeMin);
   mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
-  mCheckComments = true;
 }
 
-void TextEditor::ColorizeRange(int aFromLine, int aToLine) {
-  if (mLines.empty() || aFromLine >= aToLine) return;
-
-  std::string buffer;
-  std::cmatch results;
-  std::string id;
-
-  int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
-  for (int i = aFromLine; i < endLine; ++i) {
-    auto& line = mLines[i];
-
-    if (line.empty()) continue;
-
-    buffer.resize(line.size());
-    for (size_t j = 0; j < line.size(); ++j) {
-      auto& col = line[j];
-      buffer[j] = col.mChar;
-      col.mColorIndex = PaletteIndex::Default;
+void TextEditor::ShiftColorRange(int aIndex, int aDelta) {
+  if (mColorRangeMin >= mColorRangeMax) return;
+  // Lines after aIndex moved by aDelta; a negative aDelta removed lines
+  if (mColorRangeMin > aIndex)
+    mColorRangeMin = std::max(aIndex, mColorRangeMin + aDelta);
+  if (mColorRangeMax > aIndex)
+    mColorRangeMax = std::max(aIndex, mColorRangeMax + aDelta);
+}
+
+void TextEditor::LinesChanged(int aFirst, int aLast) {
+  mTextFirst = std::min(mTextFirst, aFirst);
+  mTextTail = std::min(mTextTail, (int)mLines.size() - 1 - aLast);
+  Colorize(aFirst, aLast - aFirst + 1);
+}
+
+bool TextEditor::ColorizeStep() {
+  const int count = (int)mLines.size();
+  assert(mLineStates.size() == mLines.size());
+  mColorRangeMax = std::min(mColorRangeMax, count);
+  // Regular expressions are slow; the hand-written lexers are not
+  const int increment =
+      (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
+  int line = mColorRangeMin;
+  for (int lexed = 0; lexed < increment && line < mColorRangeMax;
+       ++lexed, ++line) {
+    const LineState state =
+        ColorizeLine(line, line == 0 ? LineState() : mLineStates[line]);
+    if (line + 1 < count && !(state == mLineStates[line + 1])) {
+      // The change carries over into the next line, say an opened comment
+      mLineStates[line + 1] = state;
+      mColorRangeMax = std::max(mColorRangeMax, line + 2);
     }
+  }
+  mColorRangeMin = line;
 
-    const char* bufferBegin = &buffer.front();
-    const char* bufferEnd = bufferBegin + buffer.size();
-
-    auto last = bufferEnd;
-
-    for (auto first = bufferBegin; first != last;) {
-      const char* token_begin = nullptr;
-      const char* token_end = nullptr;
-      PaletteIndex token_color = PaletteIndex::Default;
-
-      bool hasTokenizeResult = false;
-
-      if (mLanguageDefinition.mTokenize != nullptr) {
-        if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end,
-                                          token_color))
-          hasTokenizeResult = true;
-      }
-
-      if (hasTokenizeResult == false) {
-        // todo : remove
-        // printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last -
-        // first), first);
-
-        for (auto& p : mRegexList) {
-          if (std::regex_search(first, last, results, p.first,
-                                std::regex_constants::match_continuous)) {
-            hasTokenizeResult = true;
-
-            auto& v = *results.begin();
-            token_begin = v.first;
-            token_end = v.second;
-            token_color = p.second;
-            break;
-          }
-        }
-      }
+  if (mColorRangeMin >= mColorRangeMax) {
+    mColorRangeMin = std::numeric_limits<int>::max();
+    mColorRangeMax = 0;
+    return false;
+  }
+  return true;
+}
 
-      if (hasTokenizeResult == false) {
-        first++;
+// Marks the comments, strings and preprocessor lines of one line, starting
+// in aState, and colors its tokens. Returns the state at its end.
+TextEditor::LineState TextEditor::ColorizeLine(int aIndex, LineState aState) {
+  auto& line = mLines[aIndex];
+  auto& state = aState;
+  if (!state.mConcatenate) {
+    state.mSingleLineComment = false;
+    state.mPreprocessor = false;
+    state.mFirstChar = true;
+  }
+  state.mConcatenate = false;
+
+  const auto& startStr = mLanguageDefinition.mCommentStart;
+  const auto& endStr = mLanguageDefinition.mCommentEnd;
+  const auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
+  const int size = (int)line.size();
+  auto at = [&](int aColumn, const std::string& aString) {
+    if (aString.empty() || aColumn + (int)aString.size() > size) return false;
+    for (size_t i = 0; i < aString.size(); ++i)
+      if (line[aColumn + i].mChar != aString[i]) return false;
+    return true;
+  };
+  auto mark = [&](int aColumn, bool aComment, bool aMultiLineComment) {
+    auto& glyph = line[aColumn];
+    glyph.mComment = aComment;
+    glyph.mMultiLineComment = aMultiLineComment;
+    glyph.mPreprocessor = state.mPreprocessor;
+  };
+
+  int commentFrom = 0;  // where the comment's end may start
+  for (int i = 0; i < size; ++i) {
+    const char c = line[i].mChar;
+    if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
+      state.mFirstChar = false;
+    if (i == size - 1 && c == '\\') state.mConcatenate = true;
+
+    if (state.mString) {
+      mark(i, false, false);
+      if (c == '\"' && i + 1 < size && line[i + 1].mChar == '\"')
+        mark(++i, false, false);
+      else if (c == '\"')
+        state.mString = false;
+      else if (c == '\\' && i + 1 < size)
+        mark(++i, false, false);
+    } else if (state.mMultiLineComment) {
+      mark(i, false, true);
+      if (i + 1 - (int)endStr.size() >= commentFrom &&
+          at(i + 1 - (int)endStr.size(), endStr))
+        state.mMultiLineComment = false;
+    } else if (state.mSingleLineComment) {
+      mark(i, true, false);
+    } else {
+      if (state.mFirstChar && c == mLanguageDefinition.mPreprocChar)
+        state.mPreprocessor = true;
+      if (at(i, singleStartStr)) {
+        state.mSingleLineComment = true;
+        mark(i, true, false);
+      } else if (at(i, startStr)) {
+        state.mMultiLineComment = true;
+        for (size_t j = 0; j < startStr.size(); ++j) mark(i + j, false, true);
+        i += (int)startStr.size() - 1;
+        commentFrom = i + 1;
+      } else if (c == '\'') {
+        // A character literal, so '"' starts no string
+        mark(i, false, false);
+        int end = i + 1;
+        if (end < size && line[end].mChar == '\\') ++end;
+        ++end;
+        if (end < size && line[end].mChar == '\'')
+          while (i < end) mark(++i, false, false);
       } else {
-        const size_t token_length = token_end - token_begin;
-
-        if (token_color == PaletteIndex::Identifier) {
-          id.assign(token_begin, token_end);
-
-          // todo : allmost all language definitions use lower case to specify
-          // keywords, so shouldn't this use ::tolower ?
-          if (!mLanguageDefinition.mCaseSensitive)
-            std::transform(id.begin(), id.end(), id.begin(), ::toupper);
-
-          if (!line[first - bufferBegin].mPreprocessor) {
-            if (mLanguageDefinition.mKeywords.count(id) != 0)
-              token_color = PaletteIndex::Keyword;
-            else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-              token_color = PaletteIndex::KnownIdentifier;
-            else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-              token_color = PaletteIndex::PreprocIdentifier;
-          } else {
-            if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-              token_color = PaletteIndex::PreprocIdentifier;
-          }
-        }
-
-        for (size_t j = 0; j < token_length; ++j)
-          line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
-
-        first = token_end;
+        state.mString = c == '\"';
+        mark(i, false, false);
       }
     }
   }
+
+  if (!state.mConcatenate) {
+    state.mSingleLineComment = false;
+    state.mPreprocessor = false;
+    state.mFirstChar = true;
+  }
+  ColorizeTokens(line);
+  return state;
 }
 
-void TextEditor::ColorizeInternal() {
-  if (mLines.empty()) return;
+void TextEditor::ColorizeTokens(Line& aLine) {
+  auto& line = aLine;
+  if (line.empty()) return;
 
-  if (mCheckComments) {
-    auto end = Coordinates((int)mLines.size(), 0);
-    auto commentStart = end;
-    auto withinString = false;
-    auto withinSingleLineComment = false;
-    auto withinPreproc = false;
-    auto firstChar =
-        true;  // there is no other non-whitespace characters in the line before
-    auto concatenate = false;  // '\' on the very end of the line
-
-    for (auto currentCoord = Coordinates(0, 0); currentCoord < end;
-         Advance(currentCoord)) {
-      auto& line = mLines[currentCoord.mLine];
-
-      if (currentCoord.mColumn == 0 && !concatenate) {
-        withinSingleLineComment = false;
-        withinPreproc = false;
-        firstChar = true;
-      }
+  auto& buffer = mLexBuffer;
+  auto& id = mLexIdentifier;
+  std::cmatch results;
 
-      concatenate = false;
+  buffer.resize(line.size());
+  for (size_t j = 0; j < line.size(); ++j) {
+    auto& col = line[j];
+    buffer[j] = col.mChar;
+    col.mColorIndex = PaletteIndex::Default;
+  }
 
-      if (!line.empty()) {
-        auto& g = line[currentCoord.mColumn];
-        auto c = g.mChar;
+  const char* bufferBegin = &buffer.front();
+  const char* bufferEnd = bufferBegin + buffer.size();
 
-        if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-          firstChar = false;
+  auto last = bufferEnd;
 
-        if (currentCoord.mColumn == line.size() - 1 &&
-            line[line.size() - 1].mChar == '\\')
-          concatenate = true;
+  for (auto first = bufferBegin; first != last;) {
+    const char* token_begin = nullptr;
+    const char* token_end = nullptr;
+    PaletteIndex token_color = PaletteIndex::Default;
 
-        bool inComment = commentStart <= currentCoord;
+    bool hasTokenizeResult = false;
 
-        if (withinString) {
-          line[currentCoord.mColumn].mMultiLineComment = inComment;
+    if (mLanguageDefinition.mTokenize != nullptr) {
+      if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end,
+                                        token_color))
+        hasTokenizeResult = true;
+    }
 
-          if (c == '\"') {
-            if (currentCoord.mColumn + 1 < (int)line.size() &&
-                line[currentCoord.mColumn + 1].mChar == '\"') {
-              Advance(currentCoord);
-              if (currentCoord.mColumn < (int)line.size())
-                line[currentCoord.mColumn].mMultiLineComment = inComment;
-            } else
-              withinString = false;
-          } else if (c == '\\') {
-            Advance(currentCoord);
-            if (currentCoord.mColumn < (int)line.size())
-              line[currentCoord.mColumn].mMultiLineComment = inComment;
-          }
-        } else {
-          if (firstChar && c == mLanguageDefinition.mPreprocChar)
-            withinPreproc = true;
+    if (hasTokenizeResult == false) {
+      for (auto& p : mRegexList) {
+        if (std::regex_search(first, last, results, p.first,
+                              std::regex_constants::match_continuous)) {
+          hasTokenizeResult = true;
 
-          if (c == '\"') {
-            withinString = true;
-            line[currentCoord.mColumn].mMultiLineComment = inComment;
-          } else {
-            auto pred = [](const char& a, const Glyph& b) {
-              return a == b.mChar;
-            };
-            auto from = line.begin() + currentCoord.mColumn;
-            auto& startStr = mLanguageDefinition.mCommentStart;
-            auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-            if (singleStartStr.size() > 0 &&
-                currentCoord.mColumn + singleStartStr.size() <= line.size() &&
-                equals(singleStartStr.begin(), singleStartStr.end(), from,
-                       from + singleStartStr.size(), pred))
-              withinSingleLineComment = true;
-            else if (!withinSingleLineComment &&
-                     currentCoord.mColumn + startStr.size() <= line.size() &&
-                     equals(startStr.begin(), startStr.end(), from,
-                            from + startStr.size(), pred))
-              commentStart = currentCoord;
-
-            inComment = commentStart <= currentCoord;
-
-            line[currentCoord.mColumn].mMultiLineComment = inComment;
-            line[currentCoord.mColumn].mComment = withinSingleLineComment;
-
-            auto& endStr = mLanguageDefinition.mCommentEnd;
-            if (currentCoord.mColumn + 1 >= (int)endStr.size() &&
-                equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(),
-                       from + 1, pred))
-              commentStart = end;
-          }
+          auto& v = *results.begin();
+          token_begin = v.first;
+          token_end = v.second;
+          token_color = p.second;
+          break;
         }
-        line[currentCoord.mColumn].mPreprocessor = withinPreproc;
       }
     }
-    mCheckComments = false;
-    return;
-  }
 
-  if (mColorRangeMin < mColorRangeMax) {
-    const int increment =
-        (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
-    const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
-    ColorizeRange(mColorRangeMin, to);
-    mColorRangeMin = to;
+    if (hasTokenizeResult == false) {
+      first++;
+    } else {
+      const size_t token_length = token_end - token_begin;
+
+      if (token_color == PaletteIndex::Identifier) {
+        id.assign(token_begin, token_end);
+
+        // todo : allmost all language definitions use lower case to specify
+        // keywords, so shouldn't this use ::tolower ?
+        if (!mLanguageDefinition.mCaseSensitive)
+          std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+
+        if (!line[first - bufferBegin].mPreprocessor) {
+          if (mLanguageDefinition.mKeywords.count(id) != 0)
+            token_color = PaletteIndex::Keyword;
+          else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
+            token_color = PaletteIndex::KnownIdentifier;
+          else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+            token_color = PaletteIndex::PreprocIdentifier;
+        } else {
+          if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+            token_color = PaletteIndex::PreprocIdentifier;
+        }
+      }
+
+      for (size_t j = 0; j < token_length; ++j)
+        line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
 
-    if (mColorRangeMax == mColorRangeMin) {
-      mColorRangeMin = std::numeric_limits<int>::max();
-      mColorRangeMax = 0;
+      first = token_end;
     }
-    return;
   }
 }
 
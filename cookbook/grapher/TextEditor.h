@@ -190,17 +190,24 @@ public:
 	void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
 	void SetText(const std::string& aText);
 	void SetTextLines(const std::vector<std::string>& aLines);
-	std::string GetText() const;
+	// The whole text, kept up to date a line at a time: only lines edited
+	// since the last call are copied in, so it can go to a compiler as is
+	const std::string& GetText() const;
 	std::vector<std::string> GetTextLines() const;
 	std::string GetSelectedText() const;
 	std::string GetCurrentLineText()const;
 	
 	int GetTotalLines() const { return (int)mLines.size(); }
+	// The glyphs and their colors, e.g. to check the lexer
+	const Lines& GetLines() const { return mLines; }
 	bool IsOverwrite() const { return mOverwrite; }
 
 	void SetReadOnly(bool aValue);
 	bool IsReadOnly() const { return mReadOnly; }
 	bool IsTextChanged() const { return mTextChanged; }
+	// Lexes up to a frame's share of the lines changed since the last call,
+	// as Render() does every frame. Returns whether lines are left.
+	bool ColorizeStep();
 	bool IsCursorPositionChanged() const { return mCursorPositionChanged; }
 
 	Coordinates GetCursorPosition() const { return GetActualCursorCoordinates(); }
@@ -284,10 +291,35 @@ private:
 
 	typedef std::vector<UndoRecord> UndoBuffer;
 
+	// What the lexer carries over from the end of one line to the next
+	struct LineState
+	{
+		bool mMultiLineComment = false;
+		bool mString = false;
+		bool mConcatenate = false; // the line ended in '\'
+		// Only carried over when concatenating
+		bool mSingleLineComment = false;
+		bool mPreprocessor = false;
+		bool mFirstChar = true; // nothing but white space yet
+
+		bool operator ==(const LineState& o) const
+		{
+			return
+				mMultiLineComment == o.mMultiLineComment &&
+				mString == o.mString &&
+				mConcatenate == o.mConcatenate &&
+				mSingleLineComment == o.mSingleLineComment &&
+				mPreprocessor == o.mPreprocessor &&
+				mFirstChar == o.mFirstChar;
+		}
+	};
+
 	void ProcessInputs();
 	void Colorize(int aFromLine = 0, int aCount = -1);
-	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
-	void ColorizeInternal();
+	LineState ColorizeLine(int aIndex, LineState aState);
+	void ColorizeTokens(Line& aLine);
+	void ShiftColorRange(int aIndex, int aDelta);
+	void LinesChanged(int aFirst, int aLast);
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -334,6 +366,8 @@ private:
 	int  mLeftMargin;
 	bool mCursorPositionChanged;
 	int mColorRangeMin, mColorRangeMax;
+	std::vector<LineState> mLineStates; // at the start of every line
+	std::string mLexBuffer, mLexIdentifier;
 	SelectionMode mSelectionMode;
 
 	Palette mPaletteBase;
@@ -341,7 +375,12 @@ private:
 	LanguageDefinition mLanguageDefinition;
 	RegexList mRegexList;
 
-	bool mCheckComments;
+	// GetText()'s copy of the text: mTextTail lines at the end and the lines
+	// before mTextFirst are up to date, the lines in between were edited
+	mutable std::string mText;
+	mutable std::vector<size_t> mLineOffsets; // and one past the end
+	mutable bool mTextValid;
+	mutable int mTextFirst, mTextTail;
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
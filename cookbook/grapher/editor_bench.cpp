@@ -0,0 +1,203 @@
+// Benchmark for the grapher's TextEditor: what a keystroke costs in a
+// 100000 line file, and how long the file takes to open.
+//
+// "open" is SetText, lexing every line and GetText once. "key" types a
+// line of code into the middle of the file one character at a time, and
+// splits each keystroke into "edit" (InsertText), "lex" (ColorizeStep until
+// nothing is left) and "text" (GetText, which hands the code to TCC). Before,
+// every keystroke also rescanned the whole file for comments and rebuilt
+// its text glyph by glyph; "join" is that rebuild, SelectAll and
+// GetSelectedText, for comparison. "comment" opens a /* on the first line,
+// which turns every line after it into a comment as the file has no */, and
+// closes it again: the lexing that takes, and the frames Render() spreads
+// it over.
+//
+// After typing and after opening and closing the comment, the bench checks
+// that GetText() matches the text joined from the lines, and that the
+// colors match a fresh editor lexing that text from scratch, so it also
+// guards the splicing and the incremental lexing.
+//
+// The second table is the lexers on their own, per line: the hand-written
+// one of the C language, which the grapher uses, against the std::regex
+// ones of HLSL.
+//
+// Build and run with ./run.sh cookbook/grapher/editor_bench.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "TextEditor.cpp"
+
+const int kLines = 100000;
+
+// kLines of C, a function of 20 lines over and over
+std::string makeFile(int lines) {
+  const char *const block[] = {
+      "// A function of x",
+      "// with a comment of two lines",
+      "#define SCALE 0.5",
+      "double tanh(double);",
+      "double f%d(double x) {",
+      "  const char *name = \"f\\\"%d\\\"\";",
+      "  double y = 0; // running sum",
+      "  int i;",
+      "  for (i = 0; i < 16; i++) {",
+      "    y += tanh(x * i) * SCALE;",
+      "  }",
+      "  if (y > 1.0e3 || y < -1.0e3) {",
+      "    return 0; // out of range",
+      "  }",
+      "  char c = '\"';",
+      "  return y / 16;",
+      "}",
+      "",
+      "// Next",
+      "",
+  };
+  const int size = int(sizeof(block) / sizeof(block[0]));
+  std::string text;
+  char line[128];
+  for (int i = 0; i < lines; i++) {
+    snprintf(line, sizeof(line), block[i % size], i / size, i / size);
+    text += line;
+    if (i + 1 < lines) text += '\n';
+  }
+  return text;
+}
+
+// Lexes until nothing is left; returns the calls it took
+int lexAll(TextEditor &editor) {
+  int frames = 1;
+  while (editor.ColorizeStep()) {
+    frames++;
+  }
+  return frames;
+}
+
+// Whether GetText() and the colors lexed incrementally match a rebuild:
+// the lines joined, and a new editor lexing them all. Prints what differs.
+bool matchesRebuild(TextEditor &editor, const char *after) {
+  const std::vector<std::string> lines = editor.GetTextLines();
+  std::string joined;
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (i > 0) joined += '\n';
+    joined += lines[i];
+  }
+  if (editor.GetText() != joined) {
+    printf("after %s: GetText() differs from the lines\n", after);
+    return false;
+  }
+  TextEditor fresh;
+  fresh.SetLanguageDefinition(editor.GetLanguageDefinition());
+  fresh.SetText(joined);
+  lexAll(fresh);
+  const TextEditor::Lines &a = editor.GetLines(), &b = fresh.GetLines();
+  for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+    for (size_t j = 0; j < a[i].size() && j < b[i].size(); j++) {
+      const TextEditor::Glyph &x = a[i][j], &y = b[i][j];
+      if (x.mColorIndex != y.mColorIndex || x.mComment != y.mComment ||
+          x.mMultiLineComment != y.mMultiLineComment ||
+          x.mPreprocessor != y.mPreprocessor) {
+        printf("after %s: line %zu column %zu lexed differently\n", after,
+               i + 1, j + 1);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Median per key of typing `line` at the end of line `at`
+void typeLine(TextEditor &editor, int at, const std::string &line) {
+  std::vector<double> edit, lex, text;
+  editor.SetCursorPosition(TextEditor::Coordinates(at, 0));
+  editor.InsertText("\n");
+  lexAll(editor);
+  for (char c : line) {
+    const char key[2] = {c, 0};
+    auto start = bench::Clock::now();
+    editor.InsertText(key);
+    edit.push_back(bench::secondsSince(start));
+    start = bench::Clock::now();
+    lexAll(editor);
+    lex.push_back(bench::secondsSince(start));
+    start = bench::Clock::now();
+    bench::keep(editor.GetText().size());
+    text.push_back(bench::secondsSince(start));
+  }
+  for (std::vector<double> *v : {&edit, &lex, &text}) {
+    std::sort(v->begin(), v->end());
+  }
+  const size_t m = line.size() / 2;
+  printf("%-8s %10.1f us\n", "edit", edit[m] * 1e6);
+  printf("%-8s %10.1f us\n", "lex", lex[m] * 1e6);
+  printf("%-8s %10.1f us\n", "text", text[m] * 1e6);
+  printf("%-8s %10.1f us\n", "key", (edit[m] + lex[m] + text[m]) * 1e6);
+}
+
+// Seconds per line to lex lines of the file with the language
+double lexPerLine(const TextEditor::LanguageDefinition &language, int lines) {
+  TextEditor editor;
+  editor.SetText(makeFile(lines));
+  editor.SetLanguageDefinition(language);
+  lexAll(editor);
+  return bench::measure([&] {
+    // Changing the language marks every line
+    editor.SetLanguageDefinition(language);
+    lexAll(editor);
+  }) / lines;
+}
+
+int main() {
+  const std::string file = makeFile(kLines);
+  printf("%d lines, %.1f MB\n", kLines, file.size() / 1e6);
+
+  TextEditor editor;
+  auto start = bench::Clock::now();
+  editor.SetText(file);
+  lexAll(editor);
+  bench::keep(editor.GetText().size());
+  printf("%-8s %10.1f ms\n", "open", bench::secondsSince(start) * 1e3);
+
+  typeLine(editor, kLines / 2, "  y = y * 0.5 + sin(x); /* typed */");
+  if (!matchesRebuild(editor, "typing")) {
+    return 1;
+  }
+
+  const double join = bench::measure([&] {
+    editor.SelectAll();
+    bench::keep(editor.GetSelectedText().size());
+  });
+  printf("%-8s %10.1f ms\n", "join", join * 1e3);
+  editor.SetSelection(TextEditor::Coordinates(), TextEditor::Coordinates());
+
+  editor.SetCursorPosition(TextEditor::Coordinates(0, 0));
+  start = bench::Clock::now();
+  editor.InsertText("/*");
+  const int opened = lexAll(editor);
+  const double open = bench::secondsSince(start);
+  if (!matchesRebuild(editor, "opening the comment")) {
+    return 1;
+  }
+  editor.SetCursorPosition(TextEditor::Coordinates(0, 2));
+  start = bench::Clock::now();
+  editor.InsertText("*/");
+  const int closed = lexAll(editor);
+  const double close = bench::secondsSince(start);
+  if (!matchesRebuild(editor, "closing the comment")) {
+    return 1;
+  }
+  printf("%-8s %10.1f ms in %d frames, closing it %.1f ms in %d\n",
+         "comment", open * 1e3, opened, close * 1e3, closed);
+
+  printf("\nLexing, us per line\n");
+  printf("%-8s %10.2f\n", "C", lexPerLine(TextEditor::LanguageDefinition::C(),
+                                          kLines) * 1e6);
+  printf("%-8s %10.2f\n", "HLSL",
+         lexPerLine(TextEditor::LanguageDefinition::HLSL(), 2000) * 1e6);
+  return 0;
+}
@@ -8,82 +8,16 @@ using std::cout;
 using std::endl;
 using std::vector;
 
-#include "libtcc.h"
-
-const char* starterCode = R"(
-double tanh(double);
-double sin(double);
-double exp(double);
-double modf(double, double*);
-double fmod(double, double);
-
-double function(double x) {
-  return 0.3;
-  //return x;
-  //return tanh(6 * x);
-  //return x += .4, x *= 5, exp(-x * x);
-  //return x *= 100, sin(x) / x;
-  //return x += 1, sin(220 * x) * exp(-x * 5);
-  //return x *= 2, x * x * x - x * x - x / 10;
-  //return x + sin(x * 10) / 10;
-  //return modf(3 * x, &x);
-  //return fmod(x, .3333);
-}
-)";
-
-void tcc_error_handler(void* tcc, const char* msg);
-
-struct TCC {
-  using FunctionPointer = double (*)(double);
-  FunctionPointer function = nullptr;
-  TCCState* instance = nullptr;
-  std::string error;
-
-  bool compile(std::string source) {
-    if (instance) tcc_delete(instance);
-    instance = tcc_new();
-    assert(instance != nullptr);
-
-    tcc_set_options(instance, "-nostdinc -Wall -Werror");
-    // tcc_set_options(instance, "-nostdinc -nostdlib -Wall -Werror");
-    tcc_set_error_func(instance, this, tcc_error_handler);
-    tcc_set_output_type(instance, TCC_OUTPUT_MEMORY);
-
-    if (tcc_compile_string(instance, source.c_str()) == -1)  //
-      return false;
-
-    if (tcc_relocate(instance, TCC_RELOCATE_AUTO) < 0) {
-      error = "failed to relocate code";
-      return false;
-    }
-
-    FunctionPointer foo =
-        (FunctionPointer)(tcc_get_symbol(instance, "function"));
-    if (foo == nullptr) {
-      error = "could not find the symbol 'foo'";
-      return false;
-    }
-
-    error = "";
-    function = foo;
-    return true;
-  }
-
-  double operator()(double x) {
-    if (function == nullptr) return 0;
-    return function(x);
-  }
-};
-
-void tcc_error_handler(void* tcc, const char* msg) { ((TCC*)tcc)->error = msg; }
-
-const int N = 2000;
+#include "FunctionSampler.hpp"
+#include "GraphFunction.hpp"
 
 struct Appp : App {
   TCC tcc;
   char buffer[10000];
   char error[10000];
-  Mesh mesh;
+  // Sampled again only when the function changes, and uploaded once then
+  FunctionSampler sampler;
+  VAOMesh mesh;
   TextEditor editor;
 
   Appp() { strcpy(buffer, starterCode); }
@@ -92,20 +26,24 @@ struct Appp : App {
 
   void onCreate() override {
     mesh.primitive(Mesh::LINE_STRIP);
-    for (int i = 0; i < N; i++) {
-      float x = 2.0f * i / (N - 1) - 1;
-      mesh.vertex(x, 0, 0);
-    }
-
     if (tcc.compile(buffer)) {
-      vector<Vec3f>& vertex(mesh.vertices());
-      for (int i = 0; i < N; i++) {
-        vertex[i].y = tcc(vertex[i].x);
-      }
+      resample();
     }
     editor.SetText(starterCode);
   }
 
+  // Samples the function if it changed and uploads the points
+  void resample() {
+    if (!sampler.update(tcc.batch, tcc.generation)) return;
+    const vector<FunctionSampler::Point>& points(sampler.points());
+    vector<Vec3f>& vertex(mesh.vertices());
+    vertex.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+      vertex[i].set(points[i].x, points[i].y, 0);
+    }
+    mesh.update();
+  }
+
   bool compile_error = false;
 
   void onAnimate(double dt) override {
@@ -120,9 +58,8 @@ struct Appp : App {
       ImGui::Text("%s", tcc.error.c_str());
       ImGui::Separator();
     } else {
-      vector<Vec3f>& vertex(mesh.vertices());
-      for (int i = 0; i < N; i++)  //
-        vertex[i].y = tcc(vertex[i].x);
+      resample();
+      ImGui::Text("%zu points", mesh.vertices().size());
     }
 
     editor.Render("Text Editor");
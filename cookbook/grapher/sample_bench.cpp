@@ -0,0 +1,153 @@
+// Benchmark for FunctionSampler.hpp: millions of points per second of the
+// functions in starterCode, compiled by TCC, and how closely the adaptive
+// polyline follows them.
+//
+// "point" is how the app used to evaluate: one call through the function
+// pointer per point. "batch" is one call of the compiled batch loop over
+// the same 2^20 points, and "uniform" and "uniform N" the sampler taking
+// 2^20 uniform samples on one and on N threads, making the polyline too.
+// "fine" is the sampler refining down to 1e-7 and 12 halvings, which puts
+// far more points where the function curves; "fine pts" is the size of its
+// polyline and "fine" the points made per second.
+//
+// The second table is the sampler with the app's settings: the size of
+// its polyline and the time to make it. "error" is the largest distance
+// along y between the polyline and the function, checked at 2^20 points,
+// and "uniform" the same for uniform samples as many as the polyline has
+// (the jumps of modf and fmod count as errors for both). The app used to
+// make 2000 calls every frame; it now makes none in a frame where the
+// function did not change.
+//
+// Build and run with ./run.sh cookbook/grapher/sample_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "FunctionSampler.hpp"
+#include "GraphFunction.hpp"
+
+const int kPoints = 1 << 20;
+
+// Largest |polyline(x) - f(x)| at kPoints points of [-1, 1], the
+// polyline interpolated linearly; points where f is not finite are skipped
+double maxError(const std::vector<FunctionSampler::Point> &polyline,
+                TCC &module) {
+  std::vector<double> x(kPoints), y(kPoints);
+  for (int i = 0; i < kPoints; i++) {
+    x[i] = -1 + 2.0 * (i + 0.5) / kPoints;
+  }
+  module.batch(x.data(), y.data(), kPoints);
+  double worst = 0;
+  size_t k = 0;
+  for (int i = 0; i < kPoints; i++) {
+    while (k + 2 < polyline.size() && polyline[k + 1].x <= x[i]) {
+      k++;
+    }
+    const FunctionSampler::Point &a = polyline[k], &b = polyline[k + 1];
+    if (!std::isfinite(y[i]) || !std::isfinite(a.y) || !std::isfinite(b.y)) {
+      continue;
+    }
+    const double t = b.x > a.x ? (x[i] - a.x) / (b.x - a.x) : 0;
+    worst = std::max(worst, std::abs(a.y + t * (b.y - a.y) - y[i]));
+  }
+  return worst;
+}
+
+struct Row {
+  std::string function;
+  double point, batch, uniform, uniformN;
+  size_t finePoints;
+  double fine;
+  size_t points;
+  double ms, error, uniformError;
+};
+
+Row run(TCC &module, FunctionSampler &single, FunctionSampler &parallel) {
+  Row row;
+  std::vector<double> x(kPoints), y(kPoints);
+  for (int i = 0; i < kPoints; i++) {
+    x[i] = -1 + 2.0 * i / (kPoints - 1);
+  }
+  row.point = bench::measure([&] {
+    for (int i = 0; i < kPoints; i++) {
+      y[i] = module(x[i]);
+    }
+    bench::keep(y[0]);
+  });
+  row.batch = bench::measure([&] {
+    module.batch(x.data(), y.data(), kPoints);
+    bench::keep(y[0]);
+  });
+
+  // Uniform only
+  for (FunctionSampler *sampler : {&single, &parallel}) {
+    sampler->settings = FunctionSampler::Settings();
+    sampler->settings.samples = kPoints - 1;
+    sampler->settings.maxDepth = 0;
+  }
+  row.uniform = bench::measure([&] { single.sample(module.batch); });
+  row.uniformN = bench::measure([&] { parallel.sample(module.batch); });
+
+  parallel.settings = FunctionSampler::Settings();
+  parallel.settings.maxDepth = 12;
+  parallel.settings.tolerance = 1e-7;
+  row.fine = bench::measure([&] { parallel.sample(module.batch); });
+  row.finePoints = parallel.points().size();
+
+  // The app's
+  parallel.settings = FunctionSampler::Settings();
+  row.ms = bench::measure([&] { parallel.sample(module.batch); }) * 1e3;
+  row.points = parallel.points().size();
+  row.error = maxError(parallel.points(), module);
+  parallel.settings.samples = int(row.points) - 1;
+  parallel.settings.maxDepth = 0;
+  parallel.sample(module.batch);
+  row.uniformError = maxError(parallel.points(), module);
+  return row;
+}
+
+int main() {
+  FunctionSampler single(1), parallel;
+  std::vector<Row> rows;
+  for (const std::string &source : starterFunctions()) {
+    TCC module;
+    if (!module.compile(source)) {
+      printf("did not compile: %s\n", module.error.c_str());
+      continue;
+    }
+    rows.push_back(run(module, single, parallel));
+    // The function without the code around it, abbreviated
+    std::string &function = rows.back().function;
+    function = source.substr(source.find("return") + 7);
+    function = function.substr(0, function.find(";\n"));
+    if (function.size() > 36) function = function.substr(0, 33) + "...";
+  }
+
+  printf("Millions of points per second, %d uniform samples; fine is "
+         "adaptive\nto 1e-7 and 12 halvings (N = %u threads)\n",
+         kPoints, parallel.pool().size());
+  printf("%-3s %-36s %7s %7s %7s %9s %9s %7s\n", "#", "function", "point",
+         "batch", "uniform", "uniform N", "fine pts", "fine");
+  for (size_t i = 0; i < rows.size(); i++) {
+    const Row &r = rows[i];
+    printf("%-3zu %-36s %7.1f %7.1f %7.1f %9.1f %9zu %7.1f\n", i,
+           r.function.c_str(), kPoints / r.point * 1e-6,
+           kPoints / r.batch * 1e-6, kPoints / r.uniform * 1e-6,
+           kPoints / r.uniformN * 1e-6, r.finePoints,
+           r.finePoints / r.fine * 1e-6);
+  }
+  printf("\nAdaptive with the app's settings\n");
+  printf("%-3s %-36s %9s %7s %10s %10s\n", "#", "function", "points", "ms",
+         "error", "uniform");
+  for (size_t i = 0; i < rows.size(); i++) {
+    const Row &r = rows[i];
+    printf("%-3zu %-36s %9zu %7.2f %10.2e %10.2e\n", i, r.function.c_str(),
+           r.points, r.ms, r.error, r.uniformError);
+  }
+  return 0;
+}
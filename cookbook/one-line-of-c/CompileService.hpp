@@ -0,0 +1,263 @@
+#pragma once
+#ifndef COMPILE_SERVICE_HPP
+#define COMPILE_SERVICE_HPP
+
+// Compiles live-coded modules (LiveKernel.hpp) on a background thread, so
+// typing never waits for TCC.
+//
+// The UI thread calls edit() with the new source every time the text
+// changes, tagged with what it is for (a voice, say). Edits are debounced:
+// a source is compiled once it has been left alone for debounceSeconds,
+// and an edit replaces any earlier one with the same tag still waiting.
+// Compiled modules are cached, keyed by a hash of their source (and checked
+// against the source itself). A source compiled before, like the text
+// before an undo or a formula typed in again, is answered from the cache
+// right away, without a debounce. poll() returns the results, at most one
+// per edit, and never one that a later edit with the same tag has made
+// obsolete.
+//
+// Every result with a module holds a use of it, which keeps the cache from
+// deleting the module; give it back with release() once the module no
+// longer plays (VoiceBank::released()). The cache keeps up to capacity
+// modules and deletes the least recently requested of those not in use.
+//
+// TCC is only ever called from the service's thread (libtcc before 0.9.28
+// is not thread safe), apart from deleting what is left when the service is
+// destroyed.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LiveKernel.hpp"
+
+class CompileService {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Result {
+    int tag{0};
+    TCC *module{nullptr}; // nullptr if the source did not compile
+    std::string error;
+    bool cached{false};       // found in the cache, not compiled
+    double seconds{0};        // from the edit to the result
+    double compileSeconds{0}; // in TCC
+  };
+
+  explicit CompileService(double debounceSeconds = 0.1, size_t capacity = 32)
+      : mDebounce(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(debounceSeconds))),
+        mCapacity(std::max<size_t>(1, capacity)) {
+    mThread = std::thread([this] { run(); });
+  }
+
+  // Modules still in use must have stopped playing
+  ~CompileService() {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+  }
+
+  CompileService(const CompileService &) = delete;
+  CompileService &operator=(const CompileService &) = delete;
+
+  // UI thread: the source for tag changed
+  void edit(int tag, const std::string &source) {
+    const size_t hash = std::hash<std::string>()(source);
+    const Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mMutex);
+    const uint64_t sequence = ++mSequence;
+    mLatest[tag] = sequence;
+    auto sameTag = [&](const Job &job) { return job.tag == tag; };
+    mPending.erase(std::remove_if(mPending.begin(), mPending.end(), sameTag),
+                   mPending.end());
+    Job job{tag, source, hash, sequence, now};
+    if (Entry *entry = find(hash, source)) {
+      publish(job, entry, "", true, 0);
+      return;
+    }
+    mPending.push_back(std::move(job));
+    mWake.notify_one();
+  }
+
+  // UI thread: the next result, if there is one
+  bool poll(Result &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mResults.empty()) {
+      return false;
+    }
+    result = std::move(mResults.front());
+    mResults.pop_front();
+    return true;
+  }
+
+  // Gives back the use of a module that came with a result
+  void release(TCC *module) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &entry : mCache) {
+      if (entry->module.get() == module) {
+        entry->uses--;
+        return;
+      }
+    }
+  }
+
+  // Modules in the cache
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCache.size();
+  }
+
+private:
+  struct Job {
+    int tag;
+    std::string source;
+    size_t hash;
+    uint64_t sequence;
+    Clock::time_point edited;
+  };
+
+  struct Entry {
+    std::unique_ptr<TCC> module;
+    std::string source;
+    size_t hash;
+    int uses{0};           // results handed out and not released
+    uint64_t requested{0}; // sequence of the last edit asking for it
+  };
+
+  // With mMutex held
+  Entry *find(size_t hash, const std::string &source) {
+    for (auto &entry : mCache) {
+      if (entry->hash == hash && entry->source == source) {
+        return entry.get();
+      }
+    }
+    return nullptr;
+  }
+
+  // With mMutex held. Drops the result if a later edit replaced the job.
+  void publish(const Job &job, Entry *entry, const std::string &error,
+               bool cached, double compileSeconds) {
+    if (mLatest[job.tag] != job.sequence) {
+      return;
+    }
+    Result result;
+    result.tag = job.tag;
+    result.error = error;
+    result.cached = cached;
+    result.compileSeconds = compileSeconds;
+    result.seconds =
+        std::chrono::duration<double>(Clock::now() - job.edited).count();
+    if (entry) {
+      entry->uses++;
+      entry->requested = job.sequence;
+      result.module = entry->module.get();
+    }
+    mResults.push_back(std::move(result));
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStop) {
+      if (mPending.empty()) {
+        mWake.wait(lock);
+        continue;
+      }
+      // The job left alone the longest, once its debounce has passed
+      auto oldest = std::min_element(
+          mPending.begin(), mPending.end(),
+          [](const Job &a, const Job &b) { return a.edited < b.edited; });
+      const Clock::time_point due = oldest->edited + mDebounce;
+      if (Clock::now() < due) {
+        mWake.wait_until(lock, due);
+        continue;
+      }
+      Job job = std::move(*oldest);
+      mPending.erase(oldest);
+      // The same source may have been compiled for another tag meanwhile
+      if (Entry *entry = find(job.hash, job.source)) {
+        publish(job, entry, "", true, 0);
+        continue;
+      }
+
+      lock.unlock();
+      const Clock::time_point start = Clock::now();
+      std::unique_ptr<TCC> module(new TCC);
+      const bool compiled = module->compile(job.source);
+      const double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      const std::string error = module->error;
+      if (!compiled) {
+        module.reset();
+      }
+      lock.lock();
+
+      if (!compiled) {
+        publish(job, nullptr, error, false, seconds);
+        continue;
+      }
+      std::unique_ptr<Entry> entry(new Entry);
+      entry->module = std::move(module);
+      entry->source = std::move(job.source);
+      entry->hash = job.hash;
+      entry->requested = job.sequence;
+      mCache.push_back(std::move(entry));
+      publish(job, mCache.back().get(), "", false, seconds);
+      std::vector<std::unique_ptr<Entry>> evicted = evict();
+      if (!evicted.empty()) {
+        // Deleted without the lock
+        lock.unlock();
+        evicted.clear();
+        lock.lock();
+      }
+    }
+  }
+
+  // With mMutex held: takes the least recently requested modules not in
+  // use out of the cache until it is back to capacity
+  std::vector<std::unique_ptr<Entry>> evict() {
+    std::vector<std::unique_ptr<Entry>> evicted;
+    while (mCache.size() > mCapacity) {
+      auto victim = mCache.end();
+      for (auto it = mCache.begin(); it != mCache.end(); ++it) {
+        const bool older =
+            victim == mCache.end() || (*it)->requested < (*victim)->requested;
+        if ((*it)->uses == 0 && older) {
+          victim = it;
+        }
+      }
+      if (victim == mCache.end()) {
+        break; // everything is playing
+      }
+      evicted.push_back(std::move(*victim));
+      mCache.erase(victim);
+    }
+    return evicted;
+  }
+
+  const Clock::duration mDebounce;
+  const size_t mCapacity;
+  mutable std::mutex mMutex;
+  std::condition_variable mWake;
+  bool mStop{false};
+  std::vector<Job> mPending;       // at most one per tag
+  std::map<int, uint64_t> mLatest; // sequence of the last edit, per tag
+  uint64_t mSequence{0};
+  std::vector<std::unique_ptr<Entry>> mCache;
+  std::deque<Result> mResults;
+  std::thread mThread;
+};
+
+#endif // COMPILE_SERVICE_HPP
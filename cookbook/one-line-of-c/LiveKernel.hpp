@@ -0,0 +1,193 @@
+#pragma once
+#ifndef LIVE_KERNEL_HPP
+#define LIVE_KERNEL_HPP
+
+// Live-coded audio for the one-line-of-c app: C source compiled in memory by
+// Fabrice Bellard's Tiny C Compiler, run a block of samples at a time, and
+// swapped for newly compiled code without a click or a lock.
+//
+// The user writes `char foo(int t)`, one sample of a bytebeat. Every
+// compile appends a loop around it,
+//
+//   void process(int t0, float *out, int n)
+//
+// which renders n samples starting at time t0 as floats in [-1, 1). The
+// audio thread makes one indirect call per block instead of one per sample,
+// and the per-sample work runs inside the compiled code. When foo is a
+// single return statement, one line of C, its expression is pasted into the
+// loop; otherwise (static variables, several statements) the loop calls
+// foo, since TCC does not inline.
+//
+// VoiceBank.hpp plays the modules and CompileService.hpp compiles them on
+// a background thread.
+
+#include <cassert>
+#include <cctype>
+#include <string>
+
+#include "libtcc.h"
+
+// Appended to the user's code: the block loop around a call to foo, for
+// any code
+const char *const kBlockWrapper = R"(
+void process(int t0, float *out, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    out[i] = foo(t0 + i) / 128.0f;
+  }
+}
+)";
+
+// The same loop with foo's expression pasted in between, for one line of C
+const char *const kExpressionBefore = R"(
+void process(int t0, float *out, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    int t = t0 + i;
+    out[i] = (char)()";
+const char *const kExpressionAfter = R"() / 128.0f;
+  }
+}
+)";
+
+// The expression of `char foo(int t) { return expression; }`, the whole of
+// source but for comments and white space, or an empty string for any other
+// code. Code with string or character literals is left to the block loop, as
+// stripping white space and comments inside them would change them
+inline std::string oneLiner(const std::string &source) {
+  if (source.find_first_of("\"'") != std::string::npos) {
+    return "";
+  }
+  auto word = [](char c) { return std::isalnum((unsigned char)c) || c == '_'; };
+  // Without comments, and white space only where it separates two words
+  std::string code;
+  bool space = false;
+  for (size_t i = 0; i < source.size(); i++) {
+    if (source.compare(i, 2, "//") == 0) {
+      i = source.find('\n', i);
+      if (i == std::string::npos) break;
+      space = true;
+    } else if (source.compare(i, 2, "/*") == 0) {
+      i = source.find("*/", i + 2);
+      if (i == std::string::npos) return "";
+      i++;
+      space = true;
+    } else if (std::isspace((unsigned char)source[i])) {
+      space = true;
+    } else {
+      if (space && !code.empty() && word(code.back()) && word(source[i])) {
+        code += ' ';
+      }
+      code += source[i];
+      space = false;
+    }
+  }
+  const std::string head = "char foo(int t){return";
+  const size_t end = code.find(';');
+  // One statement, then the end of the function and nothing after it
+  if (code.compare(0, head.size(), head) != 0 || end == std::string::npos ||
+      code.compare(end, std::string::npos, ";}") != 0) {
+    return "";
+  }
+  const std::string expression = code.substr(head.size(), end - head.size());
+  // "return x" or "return(x)", not "returnx"
+  if (expression.empty() || word(expression[0])) {
+    return "";
+  }
+  return expression;
+}
+
+inline void tccErrorHandler(void *tcc, const char *msg);
+
+// One module: the user's code and the block loop, compiled and relocated
+struct TCC {
+  using SampleFunction = char (*)(int);
+  using BlockFunction = void (*)(int, float *, int);
+  SampleFunction sample = nullptr;
+  BlockFunction process = nullptr;
+  TCCState *instance = nullptr;
+  std::string error;
+
+  TCC() = default;
+  TCC(const TCC &) = delete;
+  TCC &operator=(const TCC &) = delete;
+  ~TCC() { destroy(); }
+
+  void destroy() {
+    if (instance) {
+      tcc_delete(instance);
+      instance = nullptr;
+    }
+    sample = nullptr;
+    process = nullptr;
+  }
+
+  bool compile(const std::string &source) {
+    destroy();
+    instance = tcc_new();
+    assert(instance != nullptr);
+
+    // set up the compiler
+    tcc_set_options(instance, "-nostdinc -Wall -Werror");
+    tcc_set_error_func(instance, this, tccErrorHandler);
+    tcc_set_output_type(instance, TCC_OUTPUT_MEMORY);
+
+    const std::string expression = oneLiner(source);
+    const std::string unit =
+        expression.empty()
+            ? source + kBlockWrapper
+            : source + kExpressionBefore + expression + kExpressionAfter;
+    if (tcc_compile_string(instance, unit.c_str()) == -1) {
+      // error string is set by the TCC handler
+      destroy();
+      return false;
+    }
+
+    if (tcc_relocate(instance, TCC_RELOCATE_AUTO) < 0) {
+      error = "failed to relocate code";
+      destroy();
+      return false;
+    }
+
+    SampleFunction foo = (SampleFunction)(tcc_get_symbol(instance, "foo"));
+    BlockFunction block = (BlockFunction)(tcc_get_symbol(instance, "process"));
+    if (foo == nullptr || block == nullptr) {
+      error = "could not find the symbol 'foo'";
+      destroy();
+      return false;
+    }
+
+    // maybe we should go a step further and try a few calls to see if it
+    // crashes
+
+    error = "";
+    sample = foo;
+    process = block;
+    return true;
+  }
+
+  // One sample, through a call per sample
+  float operator()(int t) {
+    if (sample == nullptr) return 0;
+    char c = sample(t);
+    return c / 128.0f;
+  }
+
+  // n samples from time t0
+  void operator()(int t0, float *out, int n) {
+    if (process == nullptr) {
+      for (int i = 0; i < n; i++) out[i] = 0;
+      return;
+    }
+    process(t0, out, n);
+  }
+};
+
+inline void tccErrorHandler(void *tcc, const char *msg) {
+  ((TCC *)tcc)->error = msg;
+  // TODO:
+  // - remove file name prefix which is "<string>"
+  // - correct line number which is off by about 20
+}
+
+#endif // LIVE_KERNEL_HPP
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef STARTER_CODE_HPP
+#define STARTER_CODE_HPP
+
+// The code the app starts out with: a sawtooth, and bytebeat formulas to
+// try in the comments. The benchmarks run every one of them.
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+const char *const starterCode = R"(
+char foo(int t) {
+  return t; // sawtooth
+
+  // static int v = 0;
+  // return (v=(v>>1)+(v>>4)+t*(((t>>16)|(t>>6))&(69&(t>>9))));
+  // return (t*((t>>12|t>>8)&63&t>>4));
+  // return (t*((t>>5|t>>8)>>(t>>16)));
+  // return (t*((t>>9|t>>13)&25&t>>6));
+  // return (t*(t>>11&t>>8&123*t>>3));
+  // return (t*(t>>8*(t>>15|t>>8)&(20|(t>>19)*5>>t|t>>3)));
+  // return (((-t&4095)*(255&t*(t&t>>13))>>12)+(127&t*(234&t>>8&t>>3)>>(3&t>>14)));
+  // return (t*(t>>((t>>9|t>>8))&63&t>>4));
+  // return ((t>>6|t|t>>(t>>16))*10+((t>>11)&7));
+  // return ((t|(t>>9|t>>7))*t&(t>>11|t>>9));
+  // return (t*5&(t>>7)|t*3&(t*4>>10));
+  // return ((t>>7|t|t>>6)*10+4*(t&t>>13|t>>6));
+  // return (((t&4096)?((t*(t^t%255)|(t>>4))>>1):(t>>3)|((t&8192)?t<<2:t)));
+  // return (((t*(t>>8|t>>9)&46&t>>8))^(t&t>>13|t>>6));
+}
+)";
+
+// The sawtooth and every formula commented out in starterCode, as sources of
+// foo
+inline std::vector<std::string> starterFormulas() {
+  std::vector<std::string> sources;
+  std::istringstream lines(starterCode);
+  std::string line;
+  while (std::getline(lines, line)) {
+    const size_t at = line.find("return");
+    if (at == std::string::npos) continue;
+    // Up to the semicolon, without the comment after the sawtooth
+    std::string body = line.substr(at);
+    body = body.substr(0, body.find(';') + 1);
+    std::string source = "char foo(int t) {\n";
+    if (body.find("v=") != std::string::npos) {
+      source += "  static int v = 0;\n";
+    }
+    sources.push_back(source + "  " + body + "\n}\n");
+  }
+  return sources;
+}
+
+#endif // STARTER_CODE_HPP
@@ -0,0 +1,181 @@
+#pragma once
+#ifndef VOICE_BANK_HPP
+#define VOICE_BANK_HPP
+
+// Several live-coded modules playing at once, mixed on the audio thread.
+//
+// Every voice plays one compiled module at its own level. play() switches a
+// voice to another module (or to silence, with nullptr) by crossfading from
+// the old code to the new over fadeSeconds, and level() ramps the voice's
+// gain over the same time, so neither clicks. If a voice is asked to switch
+// again while it is still fading, the newest module waits for the fade to
+// end and any module queued before it is skipped.
+//
+// The UI thread sends commands through a lock-free queue, which the audio
+// thread reads at the start of every block (the queue's release and acquire
+// make the compiled code visible to it). Modules the audio thread stops
+// playing are handed back through a second queue, released(): only then may
+// the UI thread let them be deleted. Nothing on the audio thread waits,
+// allocates or frees.
+//
+// play(), level() and released() belong to one thread, process() to
+// another.
+
+#include <algorithm>
+#include <vector>
+
+#include "common/SpscQueue.hpp"
+
+#include "LiveKernel.hpp"
+
+class VoiceBank {
+public:
+  static const int kVoices = 4;
+
+  // Blocks of any size are rendered maxFrames at a time
+  explicit VoiceBank(double sampleRate = 44100, float fadeSeconds = 0.05f,
+                     int maxFrames = 1024)
+      : mFadeStep(float(1 / std::max(1.0, fadeSeconds * sampleRate))),
+        mMaxFrames(std::max(1, maxFrames)), mIncoming(mMaxFrames),
+        mOutgoing(mMaxFrames) {}
+
+  // UI thread: crossfades the voice to module (nullptr fades it out).
+  // Returns false if the command queue is full; try again later.
+  bool play(int voice, TCC *module) {
+    return mCommands.push(Command{voice, kPlay, module, 0});
+  }
+
+  // UI thread: ramps the voice's gain to a linear gain
+  bool level(int voice, float gain) {
+    return mCommands.push(Command{voice, kLevel, nullptr, gain});
+  }
+
+  // UI thread: a module that was playing and no longer is, or that was
+  // queued and skipped. Call until it returns false.
+  bool released(TCC *&module) { return mReleased.pop(module); }
+
+  // Audio thread: adds n samples from time t0 of every voice to out
+  void process(int t0, float *out, int n) {
+    Command command;
+    while (mCommands.pop(command)) {
+      Voice &voice = mVoices[command.voice];
+      if (command.type == kLevel) {
+        voice.target = command.gain;
+      } else if (voice.fade < 1) {
+        // Waits for the fade in progress
+        release(voice.next);
+        voice.next = command.module;
+        voice.queued = true;
+      } else {
+        start(voice, command.module);
+      }
+    }
+    for (int done = 0; done < n; done += mMaxFrames) {
+      const int frames = std::min(mMaxFrames, n - done);
+      for (Voice &voice : mVoices) {
+        render(voice, t0 + done, out + done, frames);
+      }
+    }
+  }
+
+private:
+  enum Type { kPlay, kLevel };
+
+  struct Command {
+    int voice;
+    Type type;
+    TCC *module;
+    float gain;
+  };
+
+  struct Voice {
+    TCC *current{nullptr};  // playing, or fading in
+    TCC *previous{nullptr}; // fading out
+    TCC *next{nullptr};     // waiting for the fade to end
+    bool queued{false};     // next is set, possibly to silence
+    float fade{1};          // from previous (0) to current (1)
+    float gain{0}, target{1};
+  };
+
+  void release(TCC *module) {
+    // Only fails if the UI stopped reading; the module is then never
+    // deleted, which is the safe way to fail
+    if (module) {
+      mReleased.push(module);
+    }
+  }
+
+  void start(Voice &voice, TCC *module) {
+    release(voice.previous);
+    voice.previous = voice.current;
+    voice.current = module;
+    voice.fade = 0;
+  }
+
+  void render(Voice &voice, int t0, float *out, int n) {
+    const bool silent = voice.gain == 0 && voice.target == 0;
+    if ((voice.current == nullptr && voice.previous == nullptr) || silent) {
+      // Nothing to hear: ramps finish at once
+      voice.gain = voice.target;
+      finishFade(voice);
+      return;
+    }
+    float *incoming = mIncoming.data(), *outgoing = mOutgoing.data();
+    if (voice.current) {
+      (*voice.current)(t0, incoming, n);
+    } else {
+      std::fill(incoming, incoming + n, 0.0f);
+    }
+    const bool fading = voice.fade < 1;
+    if (!fading && voice.gain == voice.target) {
+      // Steady, which is most of the time
+      const float gain = voice.gain;
+      for (int i = 0; i < n; i++) {
+        out[i] += gain * incoming[i];
+      }
+      return;
+    }
+    if (fading && voice.previous) {
+      (*voice.previous)(t0, outgoing, n);
+    } else {
+      std::fill(outgoing, outgoing + n, 0.0f);
+    }
+    // Linear ramps, per sample: the crossfade and the gain move by the same
+    // step towards their ends
+    float fade = voice.fade, gain = voice.gain;
+    const float gainStep = mFadeStep * (voice.target > gain ? 1 : -1);
+    for (int i = 0; i < n; i++) {
+      fade = std::min(1.0f, fade + mFadeStep);
+      gain = gainStep > 0 ? std::min(voice.target, gain + gainStep)
+                          : std::max(voice.target, gain + gainStep);
+      out[i] += gain * (outgoing[i] + fade * (incoming[i] - outgoing[i]));
+    }
+    voice.gain = gain;
+    voice.fade = fade;
+    if (fading && fade >= 1) {
+      finishFade(voice);
+    }
+  }
+
+  void finishFade(Voice &voice) {
+    voice.fade = 1;
+    release(voice.previous);
+    voice.previous = nullptr;
+    if (voice.queued) {
+      voice.queued = false;
+      start(voice, voice.next);
+      voice.next = nullptr;
+    }
+  }
+
+  const float mFadeStep; // per sample
+  const int mMaxFrames;
+  Voice mVoices[kVoices];
+  std::vector<float> mIncoming, mOutgoing; // one voice's block
+  SpscQueue<Command, 64> mCommands;
+  // Each command releases at most one module and queued modules can't pile
+  // up, so this holds everything released between two UI frames
+  SpscQueue<TCC *, 256> mReleased;
+};
+
+#endif // VOICE_BANK_HPP
@@ -0,0 +1,94 @@
+// Benchmark for LiveKernel.hpp: millions of samples per second of the bytebeat
+// formulas in starterCode, compiled by TCC, called once per sample against
+// once per block.
+//
+// "sample" is how onSound() used to run the code: for every sample, a check
+// for a new module (now an acquire load, as it would have to be) and a call
+// through the function pointer to foo. "block 64" and "block 1024" run a
+// VoiceBank with one voice, which calls process() once per audio block of
+// that many frames (1024 being what the app configures) and mixes it in.
+// "pasted" tells whether the formula is one line of C, its expression pasted
+// into the block loop, or the loop calls foo. Every formula renders ten
+// seconds at 44.1 kHz per run; "same" checks that both ways give the same
+// samples from a fresh compile (one formula keeps state in a static
+// variable).
+//
+// Build and run with ./run.sh cookbook/one-line-of-c/bytebeat_bench.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "LiveKernel.hpp"
+#include "StarterCode.hpp"
+#include "VoiceBank.hpp"
+
+const int kSamples = 44100 * 10;
+
+double perSample(TCC &module, std::vector<float> &out) {
+  std::atomic<bool> pending{false};
+  return bench::measure([&] {
+    int t = 0;
+    for (int start = 0; start < kSamples; start += 1024) {
+      for (int i = 0; i < 1024; i++) {
+        if (pending.load(std::memory_order_acquire)) {
+          pending.store(false);
+        }
+        out[i] = module(t++);
+      }
+      bench::keep(out[0]);
+    }
+  });
+}
+
+double perBlock(VoiceBank &voices, std::vector<float> &out, int block) {
+  return bench::measure([&] {
+    for (int t = 0; t < kSamples; t += block) {
+      std::fill(out.begin(), out.begin() + block, 0.0f);
+      voices.process(t, out.data(), block);
+      bench::keep(out[0]);
+    }
+  });
+}
+
+int main() {
+  printf("%d samples per run\n", kSamples);
+  printf("%-3s %-44s %6s %9s %9s %10s %7s %5s\n", "#", "formula", "pasted",
+         "sample", "block 64", "block 1024", "speedup", "same");
+  int index = 0;
+  for (const std::string &source : starterFormulas()) {
+    TCC module;
+    TCC blockModule;
+    if (!module.compile(source) || !blockModule.compile(source)) {
+      printf("%-3d did not compile: %s\n", index++, module.error.c_str());
+      continue;
+    }
+    std::vector<float> out(1024), check(4096);
+    // Without fades, so the first block is the module's at full gain
+    VoiceBank voices(44100, 0, 4096);
+    voices.play(0, &blockModule);
+    voices.process(0, check.data(), 4096);
+    bool same = true;
+    for (int t = 0; t < 4096; t++) {
+      same = same && module(t) == check[t];
+    }
+
+    const double sample = kSamples / perSample(module, out) * 1e-6;
+    const double block64 = kSamples / perBlock(voices, out, 64) * 1e-6;
+    const double block1024 = kSamples / perBlock(voices, out, 1024) * 1e-6;
+    // The formula without the function around it, abbreviated
+    std::string formula = source.substr(source.find("return") + 7);
+    formula = formula.substr(0, formula.find(";\n"));
+    if (formula.size() > 44) formula = formula.substr(0, 41) + "...";
+    printf("%-3d %-44s %6s %9.1f %9.1f %10.1f %6.2fx %5s\n", index++,
+           formula.c_str(), oneLiner(source).empty() ? "no" : "yes", sample,
+           block64, block1024, block1024 / sample, same ? "yes" : "NO");
+    fflush(stdout);
+  }
+  printf("(millions of samples per second)\n");
+  return 0;
+}
@@ -0,0 +1,181 @@
+// Benchmark for CompileService: how long typing holds up the UI frame, and
+// how long it takes for what was typed to play, against compiling in the
+// frame as the app used to.
+//
+// A simulated user types the bytebeat formulas of starterCode into the
+// editor, one character every kFramesPerKey frames of a 60 Hz UI (15
+// characters per second), each formula after a "return " already there.
+// "sync" compiles the whole text in the frame whenever it changed; "service"
+// hands it to CompileService and picks up results. "frame ms" is the UI's
+// own work per frame, "max ms" the longest, and "hitches" the frames whose
+// work did not fit in 16.7 ms. "compiles" counts the texts TCC compiled,
+// and "latency" is the time from the last key of a formula to its module
+// being ready, on average. "paste" then types every formula in again at
+// once, as a paste or an undo would, and times the same.
+//
+// Build and run with ./run.sh cookbook/one-line-of-c/compile_bench.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "CompileService.hpp"
+#include "StarterCode.hpp"
+
+const double kFrame = 1.0 / 60;
+const int kFramesPerKey = 4;
+const std::string kHead = "char foo(int t) {\n  return ";
+const std::string kTail = ";\n}\n";
+
+struct Stats {
+  std::vector<double> frames;
+  int compiles = 0;
+  double latency = 0, pasteLatency = 0;
+
+  void print(const char *name) const {
+    double total = 0, longest = 0;
+    int hitches = 0;
+    for (double f : frames) {
+      total += f;
+      longest = std::max(longest, f);
+      hitches += f > kFrame ? 1 : 0;
+    }
+    printf("%-8s %7zu %9.3f %8.2f %8d %9d %10.1f %10.3f\n", name,
+           frames.size(), total / frames.size() * 1e3, longest * 1e3, hitches,
+           compiles, latency * 1e3, pasteLatency * 1e3);
+  }
+};
+
+// The expressions of the one-line formulas
+std::vector<std::string> expressions() {
+  std::vector<std::string> result;
+  for (const std::string &source : starterFormulas()) {
+    const std::string expression = oneLiner(source);
+    if (!expression.empty()) {
+      result.push_back(expression.substr(expression[0] == ' ' ? 1 : 0));
+    }
+  }
+  return result;
+}
+
+// Runs frames of the UI at 60 Hz, calling frame() for the work of each and
+// timing it, until frame() returns false
+template <class Function> void runFrames(Stats &stats, Function &&frame) {
+  auto next = bench::Clock::now();
+  for (bool more = true; more;) {
+    const auto start = bench::Clock::now();
+    more = frame();
+    stats.frames.push_back(bench::secondsSince(start));
+    next += std::chrono::duration_cast<bench::Clock::duration>(
+        std::chrono::duration<double>(kFrame));
+    std::this_thread::sleep_until(next);
+  }
+}
+
+Stats typeSync(const std::vector<std::string> &formulas) {
+  Stats stats;
+  TCC module;
+  size_t formula = 0, typed = 0;
+  int frame = 0;
+  auto lastKey = bench::Clock::now();
+  runFrames(stats, [&] {
+    if (frame++ % kFramesPerKey != 0) {
+      return true;
+    }
+    const std::string &expression = formulas[formula];
+    const std::string text = kHead + expression.substr(0, ++typed) + kTail;
+    lastKey = bench::Clock::now();
+    module.compile(text);
+    stats.compiles++;
+    if (typed == expression.size()) {
+      stats.latency += bench::secondsSince(lastKey);
+      typed = 0;
+      formula++;
+    }
+    return formula < formulas.size();
+  });
+  // Pasting is typing a whole formula at once
+  for (const std::string &expression : formulas) {
+    const auto start = bench::Clock::now();
+    module.compile(kHead + expression + kTail);
+    stats.pasteLatency += bench::secondsSince(start);
+  }
+  stats.latency /= formulas.size();
+  stats.pasteLatency /= formulas.size();
+  return stats;
+}
+
+Stats typeService(const std::vector<std::string> &formulas) {
+  Stats stats;
+  CompileService service;
+  size_t formula = 0, typed = 0, ready = 0;
+  int frame = 0;
+  std::vector<bench::Clock::time_point> lastKey(formulas.size());
+  // Nothing plays the modules: they go straight back
+  auto collect = [&](const CompileService::Result &result) {
+    if (result.module) {
+      service.release(result.module);
+    }
+    if (!result.cached) {
+      stats.compiles++;
+    }
+  };
+  runFrames(stats, [&] {
+    CompileService::Result result;
+    while (service.poll(result)) {
+      collect(result);
+      // Tagged with the formula: done once it is all typed in
+      const size_t index = size_t(result.tag);
+      if (index < formula) {
+        stats.latency += bench::secondsSince(lastKey[index]);
+        ready++;
+      }
+    }
+    if (formula < formulas.size() && frame++ % kFramesPerKey == 0) {
+      const std::string &expression = formulas[formula];
+      service.edit(int(formula),
+                   kHead + expression.substr(0, ++typed) + kTail);
+      if (typed == expression.size()) {
+        lastKey[formula] = bench::Clock::now();
+        typed = 0;
+        formula++;
+      }
+    }
+    return ready < formulas.size();
+  });
+  // Every formula was compiled before, so these come from the cache
+  for (size_t f = 0; f < formulas.size(); f++) {
+    const auto start = bench::Clock::now();
+    service.edit(int(f), kHead + formulas[f] + kTail);
+    CompileService::Result result;
+    while (!service.poll(result)) {
+      std::this_thread::yield();
+    }
+    stats.pasteLatency += bench::secondsSince(start);
+    collect(result);
+  }
+  stats.latency /= formulas.size();
+  stats.pasteLatency /= formulas.size();
+  return stats;
+}
+
+int main() {
+  const std::vector<std::string> formulas = expressions();
+  size_t keys = 0;
+  for (const std::string &expression : formulas) {
+    keys += expression.size();
+  }
+  printf("%zu formulas, %zu keys\n", formulas.size(), keys);
+  printf("%-8s %7s %9s %8s %8s %9s %10s %10s\n", "mode", "frames",
+         "frame ms", "max ms", "hitches", "compiles", "latency ms",
+         "paste ms");
+  typeSync(formulas).print("sync");
+  fflush(stdout);
+  typeService(formulas).print("service");
+  return 0;
+}
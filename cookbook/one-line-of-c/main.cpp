@@ -1,123 +1,71 @@
 #include "al/app/al_App.hpp"
 #include "al/io/al_Imgui.hpp"
+#include <memory>
 using namespace al;
 
 using std::cout;
 using std::endl;
 
-#include "libtcc.h"
+#include "CompileService.hpp"
+#include "StarterCode.hpp"
+#include "VoiceBank.hpp"
 
 inline float mtof(float m) { return 8.175799f * powf(2.0f, m / 12.0f); }
 inline float dbtoa(float db) { return 1.0f * powf(10.0f, db / 20.0f); }
 
-const char* starterCode = R"(
-char foo(int t) {
-  return t; // sawtooth
-
-  // static int v = 0;
-  // return (v=(v>>1)+(v>>4)+t*(((t>>16)|(t>>6))&(69&(t>>9))));
-  // return (t*((t>>12|t>>8)&63&t>>4));
-  // return (t*((t>>5|t>>8)>>(t>>16)));
-  // return (t*((t>>9|t>>13)&25&t>>6));
-  // return (t*(t>>11&t>>8&123*t>>3));
-  // return (t*(t>>8*(t>>15|t>>8)&(20|(t>>19)*5>>t|t>>3)));
-  // return (((-t&4095)*(255&t*(t&t>>13))>>12)+(127&t*(234&t>>8&t>>3)>>(3&t>>14)));
-  // return (t*(t>>((t>>9|t>>8))&63&t>>4));
-  // return ((t>>6|t|t>>(t>>16))*10+((t>>11)&7));
-  // return ((t|(t>>9|t>>7))*t&(t>>11|t>>9));
-  // return (t*5&(t>>7)|t*3&(t*4>>10));
-  // return ((t>>7|t|t>>6)*10+4*(t&t>>13|t>>6));
-  // return (((t&4096)?((t*(t^t%255)|(t>>4))>>1):(t>>3)|((t&8192)?t<<2:t)));
-  // return (((t*(t>>8|t>>9)&46&t>>8))^(t&t>>13|t>>6));
-}
-)";
-
-// Fabrice Bellard's Tiny C Compiler can compile simple C programs quickly and
-// "in memory". Given a string, we create a callable function that generates a
-// sequence of audio samples.
-void tcc_error_handler(void* tcc, const char* msg);
-struct TCC {
-  using FunctionPointer = char (*)(int);
-  FunctionPointer process = nullptr;
-  TCCState* instance = nullptr;
-  std::string error;
-
-  void destroy() {
-    if (instance) {
-      tcc_delete(instance);
-    }
-  }
-
-  bool compile(std::string source) {
-    destroy();
-    instance = tcc_new();
-    assert(instance != nullptr);
-
-    // set up the compiler
-    tcc_set_options(instance, "-nostdinc -Wall -Werror");
-    tcc_set_error_func(instance, this, tcc_error_handler);
-    tcc_set_output_type(instance, TCC_OUTPUT_MEMORY);
-    //
-
-    if (tcc_compile_string(instance, source.c_str()) == -1) {
-      //
-      // error string is set by the TCC handler
-      return false;
-    }
-
-    if (tcc_relocate(instance, TCC_RELOCATE_AUTO) < 0) {
-      error = "failed to relocate code";
-      return false;
-    }
-
-    FunctionPointer foo = (FunctionPointer)(tcc_get_symbol(instance, "foo"));
-    if (foo == nullptr) {
-      error = "could not find the symbol 'foo'";
-      return false;
-    }
-
-    // maybe we should go a step further and try a few calls to see if it
-    // crashes
-
-    error = "";
-    process = foo;
-    return true;
-  }
-
-  float operator()(int t) {
-    if (process == nullptr) return 0;
-    char c = process(t);
-    return c / 128.0f;
-  }
-};
-void tcc_error_handler(void* tcc, const char* msg) {
-  ((TCC*)tcc)->error = msg;
-  // TODO:
-  // - remove file name prefix which is "<string>"
-  // - correct line number which is off by about 20
-}
-
 struct Appp : App {
-  TCC tcc[2];
-  unsigned active = 0;
-  bool shouldSwap = false;
-  char buffer[10000];
-  char error[10000];
+  static const int kVoices = VoiceBank::kVoices;
+
+  // compiles the code in the background, caching what it compiled (see
+  // CompileService.hpp)
+  CompileService compiler;
+  // plays a compiled module per voice, crossfading when it changes (see
+  // VoiceBank.hpp). Made in onInit, at the rate audio was configured with
+  std::unique_ptr<VoiceBank> voices;
+  char buffer[kVoices][10000];
+  std::string error[kVoices];
+  float level[kVoices];
+  int voice = 0;
   float gain = 0;
   int t = 0;
 
   Appp() {
-    // start out with some code
-    strcpy(buffer, starterCode);
+    // start out with some code; voice 0 plays it, the others are silent
+    for (int v = 0; v < kVoices; v++) {
+      strcpy(buffer[v], starterCode);
+      level[v] = v == 0 ? 0.0f : -60.0f;
+    }
+  }
+
+  void onInit() override {
+    voices.reset(new VoiceBank(audioIO().framesPerSecond(), 0.05f,
+                               (int)audioIO().framesPerBuffer()));
   }
 
   void onExit() override { imguiShutdown(); }
   void onCreate() override {
     imguiInit();
-    tcc[active].compile(buffer);
+    for (int v = 0; v < kVoices; v++) {
+      voices->level(v, v == 0 ? 1.0f : 0.0f);
+      compiler.edit(v, buffer[v]);
+    }
   }
 
   void onAnimate(double dt) override {
+    // compiled code goes to its voice, and modules no voice plays anymore
+    // go back to the cache
+    CompileService::Result result;
+    while (compiler.poll(result)) {
+      error[result.tag] = result.error;
+      if (result.module && !voices->play(result.tag, result.module)) {
+        compiler.release(result.module);
+      }
+    }
+    TCC* released;
+    while (voices->released(released)) {
+      compiler.release(released);
+    }
+
     imguiBeginFrame();
 
     static float db = -20;
@@ -130,18 +78,26 @@ struct Appp : App {
 
     ImGui::Separator();
 
-    bool update =
-        ImGui::InputTextMultiline("", buffer, sizeof(buffer), ImVec2(640, 480));
+    ImGui::SliderInt("voice", &voice, 0, kVoices - 1);
+    if (ImGui::SliderFloat("level", &level[voice], -60.0f, 0.0f)) {
+      voices->level(voice, level[voice] <= -60.0f ? 0.0f : dbtoa(level[voice]));
+    }
+
+    // every voice has its own editor state
+    ImGui::PushID(voice);
+    bool update = ImGui::InputTextMultiline("", buffer[voice],
+                                            sizeof(buffer[voice]),
+                                            ImVec2(640, 480));
+    ImGui::PopID();
 
+    // compiled once typing pauses, without holding up the frame
     if (update) {
-      if (tcc[1 - active].compile(buffer)) {
-        shouldSwap = true;
-      }
+      compiler.edit(voice, buffer[voice]);
     }
 
     ImGui::Separator();
 
-    ImGui::Text(tcc[1 - active].error.c_str());
+    ImGui::Text(error[voice].c_str());
     imguiEndFrame();
   }
 
@@ -151,19 +107,18 @@ struct Appp : App {
   }
 
   void onSound(AudioIOData& io) override {
-    while (io()) {
-      float s = 0;
-
-      if (shouldSwap) {
-        active = 1 - active;  // the only spot we change this
-        shouldSwap = false;
-      }
-
-      s = gain * tcc[active](t);
-      io.out(0) = s;
-      io.out(1) = s;
-      t++;
+    // the voices render the whole block into the left channel, then it is
+    // scaled and copied to the right
+    const int n = (int)io.framesPerBuffer();
+    float* left = io.outBuffer(0);
+    float* right = io.outBuffer(1);
+    std::fill(left, left + n, 0.0f);
+    voices->process(t, left, n);
+    for (int i = 0; i < n; i++) {
+      left[i] *= gain;
+      right[i] = left[i];
     }
+    t += n;
   }
 };
 
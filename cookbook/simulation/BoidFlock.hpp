@@ -0,0 +1,216 @@
+#pragma once
+#ifndef BOID_FLOCK_HPP
+#define BOID_FLOCK_HPP
+
+// Flock state and update for flocking.cpp, laid out for parallel updates.
+//
+// Boids are stored as separate x, y, vx, vy arrays, twice: step() reads the
+// current state and writes the next one, then swaps. Every boid computes its
+// own new position and velocity from the current state of its neighbors
+// (found with BoidGrid), so nothing is written that another boid reads and
+// the boids can be split across threads freely. The random "hunting" motion
+// comes from a hash of (seed, step, boid), so the result of a step is the
+// same bit for bit with any number of threads.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "common/ThreadPool.hpp"
+
+#include "BoidGrid.hpp"
+
+class BoidFlock {
+public:
+  struct Params {
+    double pushRadius = 0.05;    // collision avoidance
+    double pushStrength = 1;
+    double matchRadius = 0.125;  // velocity matching
+    double centerRadius = 0.125; // flock centering
+    double centerStrength = 0.1;
+    double huntUrge = 0.2;       // random walk
+    double gaussianCutoff = 3;   // Gaussians are ignored beyond this many radii
+    double bound = 1;            // boids bounce inside [-bound, bound]
+  };
+
+  Params params;
+
+  // Random positions inside a disc of the given radius, velocities inside
+  // the unit disc
+  void reset(int n, uint64_t seed = 1, double radius = 1) {
+    mSeed = seed;
+    mStep = 0;
+    for (auto &state : mState) {
+      state.resize(n);
+    }
+    State &s = mState[mFront];
+    for (int i = 0; i < n; i++) {
+      double p[2], v[2];
+      randomInDisc(i, 0, p);
+      randomInDisc(i, 1, v);
+      s.x[i] = p[0] * radius;
+      s.y[i] = p[1] * radius;
+      s.vx[i] = v[0];
+      s.vy[i] = v[1];
+    }
+  }
+
+  int size() const { return int(mState[mFront].x.size()); }
+
+  // Current state
+  const double *x() const { return mState[mFront].x.data(); }
+  const double *y() const { return mState[mFront].y.data(); }
+  const double *vx() const { return mState[mFront].vx.data(); }
+  const double *vy() const { return mState[mFront].vy.data(); }
+
+  // Advances the flock by dt, splitting the boids across pool
+  void step(double dt, ThreadPool &pool) {
+    const int n = size();
+    if (n == 0) {
+      return;
+    }
+    const State &cur = mState[mFront];
+    State &next = mState[1 - mFront];
+    const double cutoff =
+        params.gaussianCutoff *
+        std::max(params.pushRadius,
+                 std::max(params.matchRadius, params.centerRadius));
+    mGrid.build(cur.x.data(), cur.y.data(), 1, n, cutoff);
+
+    // Boids in grid order, so each chunk works on one neighborhood
+    const int *order = mGrid.order();
+    pool.parallelFor(
+        size_t(n),
+        [&](size_t k, unsigned) {
+          updateBoid(order[k], dt, cutoff, cur, next);
+        },
+        256);
+
+    mFront = 1 - mFront;
+    mStep++;
+  }
+
+private:
+  struct State {
+    std::vector<double> x, y, vx, vy;
+    void resize(int n) {
+      x.assign(n, 0.0);
+      y.assign(n, 0.0);
+      vx.assign(n, 0.0);
+      vy.assign(n, 0.0);
+    }
+  };
+
+  void updateBoid(int i, double dt, double cutoff, const State &cur,
+                  State &next) const {
+    const double xi = cur.x[i], yi = cur.y[i];
+    const double vxi = cur.vx[i], vyi = cur.vy[i];
+    const double cutoffSqr = cutoff * cutoff;
+    const double pushCutoff = params.gaussianCutoff * params.pushRadius;
+    const double pushScale = 1.0 / (params.pushRadius * params.pushRadius);
+    const double matchScale = 1.0 / (params.matchRadius * params.matchRadius);
+    const double centerScale =
+        1.0 / (params.centerRadius * params.centerRadius);
+    const bool sameRadius = params.centerRadius == params.matchRadius;
+
+    double pushX = 0, pushY = 0;
+    double matchWeight = 0, matchX = 0, matchY = 0;
+    double centerWeight = 0, centerX = 0, centerY = 0;
+    mGrid.forEachNear(xi, yi, [&](int j) {
+      const double dx = xi - cur.x[j], dy = yi - cur.y[j];
+      const double distSqr = dx * dx + dy * dy;
+      if (distSqr > cutoffSqr || distSqr == 0) {
+        return; // also skips i itself
+      }
+      const double dist = std::sqrt(distSqr);
+
+      // 1) Collision avoidance
+      if (dist < pushCutoff) {
+        double push =
+            std::exp(-distSqr * pushScale) * params.pushStrength / dist;
+        pushX += dx * push;
+        pushY += dy * push;
+      }
+
+      // 2) Velocity matching, weighted by nearness
+      const double nearness = std::exp(-distSqr * matchScale);
+      matchWeight += nearness;
+      matchX += nearness * (cur.vx[j] - vxi);
+      matchY += nearness * (cur.vy[j] - vyi);
+
+      // 3) Flock centering: towards the nearness weighted mean position
+      const double pull =
+          sameRadius ? nearness : std::exp(-distSqr * centerScale);
+      centerWeight += pull;
+      centerX -= pull * dx;
+      centerY -= pull * dy;
+    });
+
+    double px = xi + pushX, py = yi + pushY;
+    // Pairwise, each neighbor pulled velocity halfway by its nearness; taking
+    // the mean keeps a crowded boid from overshooting
+    double matchNorm = 0.5 / std::max(1.0, matchWeight);
+    double vx = vxi + matchX * matchNorm;
+    double vy = vyi + matchY * matchNorm;
+    if (centerWeight > 0) {
+      vx += params.centerStrength * centerX / centerWeight;
+      vy += params.centerStrength * centerY / centerWeight;
+    }
+
+    // Random "hunting" motion, cubed to make small jumps more frequent
+    double hunt[2];
+    randomInDisc(i, mStep + 2, hunt);
+    double huntMagSqr = hunt[0] * hunt[0] + hunt[1] * hunt[1];
+    vx += hunt[0] * huntMagSqr * params.huntUrge;
+    vy += hunt[1] * huntMagSqr * params.huntUrge;
+
+    // Bound boid into a box
+    const double bound = params.bound;
+    if (px > bound || px < -bound) {
+      px = px > 0 ? bound : -bound;
+      vx = -vx;
+    }
+    if (py > bound || py < -bound) {
+      py = py > 0 ? bound : -bound;
+      vy = -vy;
+    }
+
+    next.x[i] = px + vx * dt;
+    next.y[i] = py + vy * dt;
+    next.vx[i] = vx;
+    next.vy[i] = vy;
+  }
+
+  // Uniform point in the unit disc from a hash of (seed, boid, stream)
+  void randomInDisc(int boid, uint64_t stream, double *out) const {
+    uint64_t state =
+        mSeed ^ (uint64_t(boid) << 32) ^ (stream * 0x9E3779B97F4A7C15ull);
+    while (true) {
+      double u = uniform(state) * 2 - 1;
+      double v = uniform(state) * 2 - 1;
+      if (u * u + v * v <= 1) {
+        out[0] = u;
+        out[1] = v;
+        return;
+      }
+    }
+  }
+
+  // splitmix64
+  static double uniform(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  State mState[2];
+  int mFront{0};
+  uint64_t mSeed{1};
+  uint64_t mStep{0};
+  BoidGrid mGrid;
+};
+
+#endif // BOID_FLOCK_HPP
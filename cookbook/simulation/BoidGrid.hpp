@@ -0,0 +1,146 @@
+#pragma once
+#ifndef BOID_GRID_HPP
+#define BOID_GRID_HPP
+
+// Uniform grid for finding nearby pairs of 2D points in O(N).
+//
+// build() bins the points into square cells of the given size with a
+// counting sort: one pass to count, a prefix sum, one pass to scatter. The
+// grid covers the bounding box of the points, so nothing has to stay inside
+// fixed bounds. With the cell size set to the interaction cutoff, every pair
+// closer than the cutoff is in the same or in adjacent cells.
+//
+// forEachPair() visits each such pair once by looking at a cell's own points
+// and at 4 of its 8 neighbors (the other 4 see the cell in turn).
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+class BoidGrid {
+public:
+  // Points are read as x[i * stride], y[i * stride]
+  void build(const double *x, const double *y, size_t stride, int n,
+             double cellSize) {
+    mN = n;
+    mOrder.resize(n);
+    mCellOf.resize(n);
+    if (n == 0) {
+      mCols = mRows = 0;
+      mStart.assign(1, 0);
+      return;
+    }
+    double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (int i = 1; i < n; i++) {
+      minX = std::min(minX, x[i * stride]);
+      maxX = std::max(maxX, x[i * stride]);
+      minY = std::min(minY, y[i * stride]);
+      maxY = std::max(maxY, y[i * stride]);
+    }
+    // Don't allocate more cells than a few per point if points scatter far
+    double extent = std::max(maxX - minX, maxY - minY);
+    double maxCells = 4.0 * n + 64.0;
+    if ((extent / cellSize) * (extent / cellSize) > maxCells) {
+      cellSize = extent / std::sqrt(maxCells);
+    }
+    mCellSize = cellSize;
+    mInvCellSize = 1.0 / cellSize;
+    mMinX = minX;
+    mMinY = minY;
+    mCols = int((maxX - minX) * mInvCellSize) + 1;
+    mRows = int((maxY - minY) * mInvCellSize) + 1;
+
+    const int numCells = mCols * mRows;
+    mStart.assign(numCells + 1, 0);
+    for (int i = 0; i < n; i++) {
+      int cell = cellIndex(x[i * stride], y[i * stride]);
+      mCellOf[i] = cell;
+      mStart[cell + 1]++;
+    }
+    for (int c = 0; c < numCells; c++) {
+      mStart[c + 1] += mStart[c];
+    }
+    mFill.assign(mStart.begin(), mStart.end() - 1);
+    for (int i = 0; i < n; i++) {
+      mOrder[mFill[mCellOf[i]]++] = i;
+    }
+  }
+
+  int size() const { return mN; }
+  int columns() const { return mCols; }
+  int rows() const { return mRows; }
+  double cellSize() const { return mCellSize; }
+
+  // Point indices sorted by cell; iterating in this order keeps neighbors
+  // close in memory
+  const int *order() const { return mOrder.data(); }
+
+  // Calls fn(i, j) once for every pair of points in the same or adjacent
+  // cells. Points further apart than cellSize() may be visited too.
+  template <class Function> void forEachPair(Function &&fn) const {
+    // Half of the neighborhood: right, and the three cells above
+    static const int offsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+    for (int row = 0; row < mRows; row++) {
+      for (int col = 0; col < mCols; col++) {
+        const int cell = row * mCols + col;
+        const int begin = mStart[cell], end = mStart[cell + 1];
+        if (begin == end) {
+          continue;
+        }
+        for (int a = begin; a < end; a++) {
+          for (int b = a + 1; b < end; b++) {
+            fn(mOrder[a], mOrder[b]);
+          }
+        }
+        for (const auto &offset : offsets) {
+          int c = col + offset[0], r = row + offset[1];
+          if (c < 0 || c >= mCols || r >= mRows) {
+            continue;
+          }
+          const int other = r * mCols + c;
+          for (int a = begin; a < end; a++) {
+            for (int b = mStart[other]; b < mStart[other + 1]; b++) {
+              fn(mOrder[a], mOrder[b]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Calls fn(j) for every point in the 3x3 cells around (px, py)
+  template <class Function>
+  void forEachNear(double px, double py, Function &&fn) const {
+    int col = int(std::floor((px - mMinX) * mInvCellSize));
+    int row = int(std::floor((py - mMinY) * mInvCellSize));
+    const int rowEnd = std::min(mRows - 1, row + 1);
+    const int colEnd = std::min(mCols - 1, col + 1);
+    for (int r = std::max(0, row - 1); r <= rowEnd; r++) {
+      for (int c = std::max(0, col - 1); c <= colEnd; c++) {
+        const int cell = r * mCols + c;
+        for (int k = mStart[cell]; k < mStart[cell + 1]; k++) {
+          fn(mOrder[k]);
+        }
+      }
+    }
+  }
+
+private:
+  int cellIndex(double px, double py) const {
+    int col = std::min(mCols - 1, int((px - mMinX) * mInvCellSize));
+    int row = std::min(mRows - 1, int((py - mMinY) * mInvCellSize));
+    return row * mCols + col;
+  }
+
+  int mN{0};
+  int mCols{0}, mRows{0};
+  double mCellSize{1}, mInvCellSize{1};
+  double mMinX{0}, mMinY{0};
+  std::vector<int> mStart; // first sorted index of each cell, plus the end
+  std::vector<int> mFill;
+  std::vector<int> mOrder;  // point indices sorted by cell
+  std::vector<int> mCellOf; // cell of each point
+};
+
+#endif // BOID_GRID_HPP
@@ -0,0 +1,548 @@
+#pragma once
+#ifndef NBODY_HPP
+#define NBODY_HPP
+
+// Self-gravitating bodies for gravityWell.cpp: mutual gravity between all
+// bodies on top of the pull of the fixed well at the origin.
+//
+// Forces are computed with a Barnes-Hut octree. Every step sorts the bodies
+// along a Morton (Z-order) curve with a radix sort, so that each octree node
+// covers a contiguous range of bodies, and builds the tree over that range
+// top-down. The tree is then walked once per leaf, treating cells that are
+// small enough as seen from the leaf (size / distance < theta) as a single
+// mass, and the bodies of the leaf sum over the resulting list with SIMD.
+// Leaves only write their own bodies, so they are split across a ThreadPool
+// without any locking. The sort also keeps bodies that are close in space
+// close in memory. Direct mode sums over all pairs instead, as a reference
+// for small N.
+//
+// Bodies are advanced with a kick-drift-kick leapfrog, which needs a fixed
+// time step to conserve energy over long runs; see step().
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/ThreadPool.hpp"
+
+class NBody {
+public:
+  enum class Mode { BarnesHut, Direct };
+
+  struct Params {
+    bool mutual = true;         // body-body gravity; off = the well only
+    Mode mode = Mode::BarnesHut;
+    float totalMass = 0.1f;     // shared equally by all bodies (G = 1)
+    float softening = 0.02f;    // Plummer softening length, > 0
+    float theta = 0.5f;         // Barnes-Hut opening angle, below 1/sqrt(3)
+    float wellMass = 0.1f;      // fixed mass at the origin
+    float wellMinDistance = 0.1f; // prevents high velocities near the well
+  };
+
+  Params params;
+
+  // n bodies at rest at the origin
+  void resize(int n) {
+    for (auto *a : {&mX, &mY, &mZ, &mVx, &mVy, &mVz, &mAx, &mAy, &mAz}) {
+      a->assign(n, 0.0f);
+    }
+    mForcesValid = false;
+  }
+
+  int size() const { return int(mX.size()); }
+
+  void position(int i, float x, float y, float z) {
+    mX[i] = x;
+    mY[i] = y;
+    mZ[i] = z;
+    mForcesValid = false;
+  }
+  void velocity(int i, float x, float y, float z) {
+    mVx[i] = x;
+    mVy[i] = y;
+    mVz[i] = z;
+  }
+
+  // Barnes-Hut mode reorders the bodies, so indices are only meaningful
+  // until the next step() or computeForces()
+  const float *x() const { return mX.data(); }
+  const float *y() const { return mY.data(); }
+  const float *z() const { return mZ.data(); }
+  const float *vx() const { return mVx.data(); }
+  const float *vy() const { return mVy.data(); }
+  const float *vz() const { return mVz.data(); }
+  const float *ax() const { return mAx.data(); }
+  const float *ay() const { return mAy.data(); }
+  const float *az() const { return mAz.data(); }
+
+  // Advances by dt with kick-drift-kick leapfrog
+  void step(float dt, ThreadPool &pool) {
+    if (!mForcesValid) {
+      computeForces(pool);
+    }
+    const float half = 0.5f * dt;
+    forEachChunk(pool, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        mVx[i] += mAx[i] * half;
+        mVy[i] += mAy[i] * half;
+        mVz[i] += mAz[i] * half;
+        mX[i] += mVx[i] * dt;
+        mY[i] += mVy[i] * dt;
+        mZ[i] += mVz[i] * dt;
+      }
+    });
+    computeForces(pool);
+    forEachChunk(pool, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        mVx[i] += mAx[i] * half;
+        mVy[i] += mAy[i] * half;
+        mVz[i] += mAz[i] * half;
+      }
+    });
+  }
+
+  // Accelerations of the current positions
+  void computeForces(ThreadPool &pool) {
+    const int n = size();
+    const bool tree = params.mutual && params.mode == Mode::BarnesHut;
+    if (params.mutual && !tree) {
+      mMass.assign(n, bodyMass());
+    }
+    if (tree && n > 0) {
+      sortBodies();
+      buildTree();
+      mLists.resize(pool.size());
+      pool.parallelFor(
+          mLeaves.size(),
+          [&](size_t l, unsigned worker) {
+            leafAccelerations(mNodes[mLeaves[l]], mLists[worker]);
+          },
+          16);
+    }
+    forEachChunk(pool, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        float a[3] = {0, 0, 0};
+        if (params.mutual) {
+          if (tree) {
+            a[0] = mAx[i];
+            a[1] = mAy[i];
+            a[2] = mAz[i];
+          } else {
+            directSum(i, a);
+          }
+        }
+        wellAcceleration(i, a);
+        mAx[i] = a[0];
+        mAy[i] = a[1];
+        mAz[i] = a[2];
+      }
+    });
+    mForcesValid = true;
+  }
+
+  // Acceleration of body i summed over all bodies in double precision, for
+  // checking the other modes
+  void referenceAcceleration(int i, double out[3]) const {
+    out[0] = out[1] = out[2] = 0;
+    const int n = size();
+    if (params.mutual) {
+      const double m = bodyMass();
+      const double eps2 = double(params.softening) * params.softening;
+      for (int j = 0; j < n; j++) {
+        double dx = double(mX[j]) - mX[i];
+        double dy = double(mY[j]) - mY[i];
+        double dz = double(mZ[j]) - mZ[i];
+        double r2 = dx * dx + dy * dy + dz * dz + eps2;
+        double s = m / (r2 * std::sqrt(r2));
+        out[0] += dx * s;
+        out[1] += dy * s;
+        out[2] += dz * s;
+      }
+    }
+    float a[3] = {0, 0, 0};
+    wellAcceleration(i, a);
+    for (int k = 0; k < 3; k++) {
+      out[k] += a[k];
+    }
+  }
+
+  // Kinetic plus potential energy, summed over all pairs (O(N^2))
+  double energy() const {
+    const int n = size();
+    const double m = bodyMass();
+    const double eps2 = double(params.softening) * params.softening;
+    double e = 0;
+    for (int i = 0; i < n; i++) {
+      double v2 = double(mVx[i]) * mVx[i] + double(mVy[i]) * mVy[i] +
+                  double(mVz[i]) * mVz[i];
+      e += 0.5 * m * v2;
+      double r = std::sqrt(double(mX[i]) * mX[i] + double(mY[i]) * mY[i] +
+                           double(mZ[i]) * mZ[i]);
+      if (r >= params.wellMinDistance) {
+        e -= m * params.wellMass / r;
+      } else { // the clamped force is linear inside wellMinDistance
+        double d = params.wellMinDistance;
+        e -= m * params.wellMass * (1.5 / d - 0.5 * r * r / (d * d * d));
+      }
+      if (params.mutual) {
+        for (int j = i + 1; j < n; j++) {
+          double dx = double(mX[j]) - mX[i];
+          double dy = double(mY[j]) - mY[i];
+          double dz = double(mZ[j]) - mZ[i];
+          e -= m * m / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+        }
+      }
+    }
+    return e;
+  }
+
+  int treeNodes() const { return int(mNodes.size()); }
+
+private:
+  static const int kLeafSize = 16;
+  static const int kLevels = 10; // bits per axis of the Morton codes
+  static const int kChunk = 256;
+
+  // Interaction list of a leaf
+  struct PointMasses {
+    std::vector<float> x, y, z, m;
+    void clear() {
+      x.clear();
+      y.clear();
+      z.clear();
+      m.clear();
+    }
+    void add(float px, float py, float pz, float mass) {
+      x.push_back(px);
+      y.push_back(py);
+      z.push_back(pz);
+      m.push_back(mass);
+    }
+  };
+
+  struct Node {
+    float x, y, z, mass; // center of mass
+    float sizeSqr;       // squared edge length of the cell
+    int child;           // first of numChildren contiguous children, or -1
+    int numChildren;
+    int begin, end;      // bodies, in sorted order
+  };
+
+  float bodyMass() const {
+    return size() > 0 ? params.totalMass / size() : 0.0f;
+  }
+
+  template <class Function>
+  void forEachChunk(ThreadPool &pool, Function &&fn) {
+    const int n = size();
+    const size_t chunks = size_t((n + kChunk - 1) / kChunk);
+    pool.parallelFor(chunks, [&](size_t c, unsigned) {
+      fn(int(c) * kChunk, std::min(n, int(c + 1) * kChunk));
+    });
+  }
+
+  void wellAcceleration(int i, float *a) const {
+    float rx = -mX[i], ry = -mY[i], rz = -mZ[i];
+    float dist = std::sqrt(rx * rx + ry * ry + rz * rz);
+    dist = std::max(dist, params.wellMinDistance);
+    float s = params.wellMass / (dist * dist * dist);
+    a[0] += rx * s;
+    a[1] += ry * s;
+    a[2] += rz * s;
+  }
+
+  void directSum(int i, float *a) const {
+    attract(mX.data(), mY.data(), mZ.data(), mMass.data(), size_t(size()),
+            mX[i], mY[i], mZ[i], params.softening * params.softening, a);
+  }
+
+  // Accelerations of the bodies in a leaf. The tree is walked once for the
+  // whole leaf, opening cells by their distance to the leaf's bounding box,
+  // into a list of point masses that every body of the leaf then sums over.
+  void leafAccelerations(const Node &leaf, PointMasses &list) {
+    float lo[3] = {mX[leaf.begin], mY[leaf.begin], mZ[leaf.begin]};
+    float hi[3] = {lo[0], lo[1], lo[2]};
+    for (int j = leaf.begin + 1; j < leaf.end; j++) {
+      const float p[3] = {mX[j], mY[j], mZ[j]};
+      for (int k = 0; k < 3; k++) {
+        lo[k] = std::min(lo[k], p[k]);
+        hi[k] = std::max(hi[k], p[k]);
+      }
+    }
+
+    const float theta2 = params.theta * params.theta;
+    const float m = bodyMass();
+    list.clear();
+    // At most 7 pending siblings per level
+    int stack[8 * (kLevels + 2)];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      const Node &node = mNodes[stack[--top]];
+      const float c[3] = {node.x, node.y, node.z};
+      float d2 = 0;
+      for (int k = 0; k < 3; k++) {
+        float d = std::max(0.0f, std::max(lo[k] - c[k], c[k] - hi[k]));
+        d2 += d * d;
+      }
+      if (node.sizeSqr < theta2 * d2) {
+        // Far enough from every body in the leaf: the cell as one mass
+        list.add(node.x, node.y, node.z, node.mass);
+      } else if (node.child < 0) {
+        for (int j = node.begin; j < node.end; j++) {
+          list.add(mX[j], mY[j], mZ[j], m);
+        }
+      } else {
+        for (int k = 0; k < node.numChildren; k++) {
+          stack[top++] = node.child + k;
+        }
+      }
+    }
+
+    const float eps2 = params.softening * params.softening;
+    for (int i = leaf.begin; i < leaf.end; i++) {
+      float a[3] = {0, 0, 0};
+      attract(list.x.data(), list.y.data(), list.z.data(), list.m.data(),
+              list.x.size(), mX[i], mY[i], mZ[i], eps2, a);
+      mAx[i] = a[0];
+      mAy[i] = a[1];
+      mAz[i] = a[2];
+    }
+  }
+
+  // Adds the pull of n point masses on a body at (px, py, pz) to a
+  static void attract(const float *x, const float *y, const float *z,
+                      const float *m, size_t n, float px, float py, float pz,
+                      float eps2, float *a) {
+    size_t k = 0;
+    float ax = 0, ay = 0, az = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+    const __m128 vx = _mm_set1_ps(px), vy = _mm_set1_ps(py),
+                 vz = _mm_set1_ps(pz), ve = _mm_set1_ps(eps2);
+    __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+    for (; k + 4 <= n; k += 4) {
+      __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + k), vx);
+      __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + k), vy);
+      __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + k), vz);
+      __m128 r2 = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+          _mm_add_ps(_mm_mul_ps(dz, dz), ve));
+      __m128 s = _mm_div_ps(_mm_loadu_ps(m + k),
+                            _mm_mul_ps(r2, _mm_sqrt_ps(r2)));
+      sx = _mm_add_ps(sx, _mm_mul_ps(dx, s));
+      sy = _mm_add_ps(sy, _mm_mul_ps(dy, s));
+      sz = _mm_add_ps(sz, _mm_mul_ps(dz, s));
+    }
+    float lanes[3][4];
+    _mm_storeu_ps(lanes[0], sx);
+    _mm_storeu_ps(lanes[1], sy);
+    _mm_storeu_ps(lanes[2], sz);
+    ax = (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+    ay = (lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]);
+    az = (lanes[2][0] + lanes[2][1]) + (lanes[2][2] + lanes[2][3]);
+#elif defined(PLAYGROUND_SIMD_NEON)
+    const float32x4_t ve = vdupq_n_f32(eps2);
+    float32x4_t sx = vdupq_n_f32(0), sy = vdupq_n_f32(0), sz = vdupq_n_f32(0);
+    for (; k + 4 <= n; k += 4) {
+      float32x4_t dx = vsubq_f32(vld1q_f32(x + k), vdupq_n_f32(px));
+      float32x4_t dy = vsubq_f32(vld1q_f32(y + k), vdupq_n_f32(py));
+      float32x4_t dz = vsubq_f32(vld1q_f32(z + k), vdupq_n_f32(pz));
+      float32x4_t r2 =
+          vmlaq_f32(vmlaq_f32(vmlaq_f32(ve, dx, dx), dy, dy), dz, dz);
+      // 1 / sqrt(r2) from the estimate and two Newton-Raphson steps
+      float32x4_t rs = vrsqrteq_f32(r2);
+      rs = vmulq_f32(rs, vrsqrtsq_f32(vmulq_f32(r2, rs), rs));
+      rs = vmulq_f32(rs, vrsqrtsq_f32(vmulq_f32(r2, rs), rs));
+      float32x4_t s =
+          vmulq_f32(vld1q_f32(m + k), vmulq_f32(rs, vmulq_f32(rs, rs)));
+      sx = vmlaq_f32(sx, dx, s);
+      sy = vmlaq_f32(sy, dy, s);
+      sz = vmlaq_f32(sz, dz, s);
+    }
+    float lanes[3][4];
+    vst1q_f32(lanes[0], sx);
+    vst1q_f32(lanes[1], sy);
+    vst1q_f32(lanes[2], sz);
+    ax = (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+    ay = (lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]);
+    az = (lanes[2][0] + lanes[2][1]) + (lanes[2][2] + lanes[2][3]);
+#endif
+    for (; k < n; k++) {
+      float dx = x[k] - px, dy = y[k] - py, dz = z[k] - pz;
+      float r2 = dx * dx + dy * dy + dz * dz + eps2;
+      float s = m[k] / (r2 * std::sqrt(r2));
+      ax += dx * s;
+      ay += dy * s;
+      az += dz * s;
+    }
+    a[0] += ax;
+    a[1] += ay;
+    a[2] += az;
+  }
+
+  // Spreads the lowest 10 bits of v to every third bit
+  static uint32_t spreadBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+  }
+
+  // Sorts the bodies by Morton code of their position in the bounding cube
+  void sortBodies() {
+    const int n = size();
+    float lo[3] = {mX[0], mY[0], mZ[0]}, hi[3] = {mX[0], mY[0], mZ[0]};
+    for (int i = 1; i < n; i++) {
+      const float p[3] = {mX[i], mY[i], mZ[i]};
+      for (int k = 0; k < 3; k++) {
+        lo[k] = std::min(lo[k], p[k]);
+        hi[k] = std::max(hi[k], p[k]);
+      }
+    }
+    float side = std::max(hi[0] - lo[0], hi[1] - lo[1]);
+    side = std::max(side, hi[2] - lo[2]) * 1.0001f + 1e-6f;
+    mSide = side;
+
+    const float scale = (1 << kLevels) / side;
+    auto cell = [&](float p, float o) {
+      return uint32_t(std::min(int((p - o) * scale), (1 << kLevels) - 1));
+    };
+    mCodes.resize(n);
+    mOrder.resize(n);
+    for (int i = 0; i < n; i++) {
+      mCodes[i] = (spreadBits(cell(mX[i], lo[0])) << 2) |
+                  (spreadBits(cell(mY[i], lo[1])) << 1) |
+                  spreadBits(cell(mZ[i], lo[2]));
+      mOrder[i] = i;
+    }
+
+    // LSD radix sort, 8 bits per pass, carrying the body indices along
+    mCodesTmp.resize(n);
+    mOrderTmp.resize(n);
+    for (int shift = 0; shift < 3 * kLevels; shift += 8) {
+      int count[257] = {0};
+      for (int i = 0; i < n; i++) {
+        count[((mCodes[i] >> shift) & 0xff) + 1]++;
+      }
+      for (int b = 0; b < 256; b++) {
+        count[b + 1] += count[b];
+      }
+      for (int i = 0; i < n; i++) {
+        int dst = count[(mCodes[i] >> shift) & 0xff]++;
+        mCodesTmp[dst] = mCodes[i];
+        mOrderTmp[dst] = mOrder[i];
+      }
+      mCodes.swap(mCodesTmp);
+      mOrder.swap(mOrderTmp);
+    }
+
+    mScratch.resize(n);
+    for (auto *a : {&mX, &mY, &mZ, &mVx, &mVy, &mVz}) {
+      for (int i = 0; i < n; i++) {
+        mScratch[i] = (*a)[mOrder[i]];
+      }
+      a->swap(mScratch);
+    }
+  }
+
+  void buildTree() {
+    mNodes.clear();
+    mNodes.reserve(size_t(size()) / 2 + 16);
+    mNodes.push_back(Node());
+    mLeaves.clear();
+    buildNode(0, 0, size(), 0);
+  }
+
+  // Fills in node for the sorted bodies [begin, end), which share the top
+  // level octants of their codes
+  void buildNode(int index, int begin, int end, int level) {
+    const float size = mSide / float(1 << level);
+    Node node;
+    node.sizeSqr = size * size;
+    node.begin = begin;
+    node.end = end;
+    node.child = -1;
+    node.numChildren = 0;
+
+    if (end - begin <= kLeafSize || level == kLevels) {
+      double sx = 0, sy = 0, sz = 0;
+      for (int j = begin; j < end; j++) {
+        sx += mX[j];
+        sy += mY[j];
+        sz += mZ[j];
+      }
+      const double count = end - begin;
+      node.x = float(sx / count);
+      node.y = float(sy / count);
+      node.z = float(sz / count);
+      node.mass = float(count) * bodyMass();
+      mNodes[index] = node;
+      mLeaves.push_back(index);
+      return;
+    }
+
+    // Octant of each body at this level; the codes are sorted, so octants
+    // are contiguous ranges
+    const int shift = 3 * (kLevels - 1 - level);
+    int bounds[9];
+    bounds[0] = begin;
+    for (int o = 0; o < 8; o++) {
+      const uint32_t limit = uint32_t(o + 1);
+      bounds[o + 1] = int(
+          std::partition_point(mCodes.begin() + bounds[o], mCodes.begin() + end,
+                               [&](uint32_t code) {
+                                 return ((code >> shift) & 7) < limit;
+                               }) -
+          mCodes.begin());
+    }
+    // Children are allocated together so they are contiguous
+    node.child = int(mNodes.size());
+    for (int o = 0; o < 8; o++) {
+      if (bounds[o + 1] > bounds[o]) {
+        node.numChildren++;
+      }
+    }
+    mNodes.resize(mNodes.size() + node.numChildren);
+    int c = node.child;
+    for (int o = 0; o < 8; o++) {
+      if (bounds[o + 1] > bounds[o]) {
+        buildNode(c++, bounds[o], bounds[o + 1], level + 1);
+      }
+    }
+
+    // All bodies weigh the same: weight the children by their body counts
+    double sx = 0, sy = 0, sz = 0;
+    for (int k = 0; k < node.numChildren; k++) {
+      const Node &child = mNodes[node.child + k];
+      const double count = child.end - child.begin;
+      sx += child.x * count;
+      sy += child.y * count;
+      sz += child.z * count;
+    }
+    const double count = end - begin;
+    node.x = float(sx / count);
+    node.y = float(sy / count);
+    node.z = float(sz / count);
+    node.mass = float(count) * bodyMass();
+    mNodes[index] = node;
+  }
+
+  std::vector<float> mX, mY, mZ, mVx, mVy, mVz, mAx, mAy, mAz;
+  bool mForcesValid{false};
+
+  std::vector<uint32_t> mCodes, mCodesTmp;
+  std::vector<int> mOrder, mOrderTmp;
+  std::vector<float> mScratch;
+  std::vector<Node> mNodes;
+  std::vector<int> mLeaves;
+  std::vector<PointMasses> mLists; // one per worker
+  std::vector<float> mMass;        // all bodies, for direct mode
+  float mSide{1};
+};
+
+#endif // NBODY_HPP
@@ -0,0 +1,192 @@
+#pragma once
+#ifndef PARTICLE_EMITTER_HPP
+#define PARTICLE_EMITTER_HPP
+
+// Ring buffer particle emitter for particleSystem.cpp, laid out for SIMD.
+//
+// Positions, velocities and accelerations are stored as one float array per
+// component, so integrating is three runs of simd::integrate() over
+// contiguous memory instead of a loop over Vec3f structs. Large emitters split
+// the arrays into chunks across a ThreadPool.
+//
+// How new particles start out is a policy type: Behavior is called as
+// behavior(rnd, spawn) for every emitted particle and fills in a
+// ParticleSpawn. Fountain and Spray are the behaviors of the original
+// example; Either<A, B> picks one of two at random. Since the behavior is a
+// template parameter, emitting is inlined for each combination.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/ThreadPool.hpp"
+
+// Same ranges as al::rnd
+class ParticleRandom {
+public:
+  explicit ParticleRandom(uint64_t seed = 1) : mState(seed) {}
+
+  // [0, 1)
+  float uniform() { return (next() >> 40) * (1.0f / 16777216.0f); }
+  // [0, hi)
+  float uniform(float hi) { return uniform() * hi; }
+  // [lo, hi)
+  float uniform(float lo, float hi) { return lo + uniform() * (hi - lo); }
+  // [-x, x)
+  float uniformS(float x) { return (uniform() * 2.0f - 1.0f) * x; }
+  bool prob(float p) { return uniform() < p; }
+
+private:
+  // splitmix64
+  uint64_t next() {
+    uint64_t z = (mState += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t mState;
+};
+
+// Initial state of an emitted particle. pos starts at the emitter's origin,
+// vel and acc at zero.
+struct ParticleSpawn {
+  float pos[3];
+  float vel[3];
+  float acc[3];
+};
+
+// Jet up and to the left, falling back down
+struct Fountain {
+  void operator()(ParticleRandom &rnd, ParticleSpawn &p) const {
+    p.vel[0] = rnd.uniform(-0.1f, -0.05f);
+    p.vel[1] = rnd.uniform(0.12f, 0.14f);
+    p.vel[2] = rnd.uniform(0.01f);
+    p.acc[1] = -0.002f;
+  }
+};
+
+// Slow drift in all directions
+struct Spray {
+  void operator()(ParticleRandom &rnd, ParticleSpawn &p) const {
+    p.vel[0] = rnd.uniformS(0.01f);
+    p.vel[1] = rnd.uniformS(0.01f);
+    p.vel[2] = rnd.uniformS(0.01f);
+  }
+};
+
+// A with probability probA, B otherwise
+template <class A, class B> struct Either {
+  float probA = 0.95f;
+  A a;
+  B b;
+
+  void operator()(ParticleRandom &rnd, ParticleSpawn &p) const {
+    if (rnd.prob(probA)) {
+      a(rnd, p);
+    } else {
+      b(rnd, p);
+    }
+  }
+};
+
+template <class Behavior> class ParticleEmitter {
+public:
+  Behavior behavior;
+
+  explicit ParticleEmitter(size_t count = 0, uint64_t seed = 1)
+      : mRandom(seed) {
+    resize(count);
+  }
+
+  // All particles start out unborn, with an age of count
+  void resize(size_t count) {
+    for (auto &c : mPos) {
+      c.assign(count, 0.0f);
+    }
+    for (auto &c : mVel) {
+      c.assign(count, 0.0f);
+    }
+    for (auto &c : mAcc) {
+      c.assign(count, 0.0f);
+    }
+    mAge.assign(count, int(count));
+    mTap = 0;
+  }
+
+  size_t size() const { return mAge.size(); }
+
+  // Where new particles appear
+  void origin(float x, float y, float z) {
+    mOrigin[0] = x;
+    mOrigin[1] = y;
+    mOrigin[2] = z;
+  }
+
+  // Moves every particle one step, ages it by emit, then emits emit new
+  // particles in place of the oldest ones
+  void update(int emit) {
+    integrate(0, size(), emit);
+    spawn(emit);
+  }
+
+  // Same, with the particles split across pool
+  void update(int emit, ThreadPool &pool) {
+    const size_t chunks = (size() + kChunk - 1) / kChunk;
+    pool.parallelFor(chunks, [&](size_t c, unsigned) {
+      integrate(c * kChunk, std::min(size(), (c + 1) * kChunk), emit);
+    });
+    spawn(emit);
+  }
+
+  const float *x() const { return mPos[0].data(); }
+  const float *y() const { return mPos[1].data(); }
+  const float *z() const { return mPos[2].data(); }
+  // Number of particles emitted since each one was
+  const int *age() const { return mAge.data(); }
+
+private:
+  static const size_t kChunk = 16384;
+
+  void integrate(size_t begin, size_t end, int ageStep) {
+    const size_t n = end - begin;
+    for (int c = 0; c < 3; c++) {
+      simd::integrate(&mPos[c][begin], &mVel[c][begin], &mAcc[c][begin], n);
+    }
+    int *age = &mAge[begin];
+    for (size_t i = 0; i < n; i++) {
+      age[i] += ageStep;
+    }
+  }
+
+  void spawn(int emit) {
+    const size_t n = size();
+    if (n == 0) {
+      return;
+    }
+    for (int k = 0; k < emit; k++) {
+      ParticleSpawn p{};
+      std::copy(mOrigin, mOrigin + 3, p.pos);
+      behavior(mRandom, p);
+      for (int c = 0; c < 3; c++) {
+        mPos[c][mTap] = p.pos[c];
+        mVel[c][mTap] = p.vel[c];
+        mAcc[c][mTap] = p.acc[c];
+      }
+      mAge[mTap] = 0;
+      if (++mTap >= n) {
+        mTap = 0;
+      }
+    }
+  }
+
+  std::vector<float> mPos[3], mVel[3], mAcc[3];
+  std::vector<int> mAge;
+  size_t mTap{0};
+  float mOrigin[3]{0, 0, 0};
+  ParticleRandom mRandom;
+};
+
+#endif // PARTICLE_EMITTER_HPP
@@ -0,0 +1,135 @@
+#pragma once
+#ifndef POINT_MESH_HPP
+#define POINT_MESH_HPP
+
+// Mesh of points or lines whose vertices are rewritten in place every frame.
+//
+// Same interface as PointBuffer (common/PointBuffer.hpp), but the arrays are
+// OpenGL vertex buffers mapped into memory: the app writes positions straight
+// into the buffer that is drawn, without rebuilding an al::Mesh, and only maps
+// the colors when they change. Positions are 3 floats per vertex and are
+// mapped with GL_MAP_INVALIDATE_BUFFER_BIT, so the driver hands out fresh
+// memory instead of waiting for the previous frame to be drawn. Colors are
+// RGBA8 (see point_color), a quarter of the size of al::Color.
+//
+// Map, write and draw from the graphics thread (onAnimate() and onDraw()).
+// The mapped pointers may be filled from other threads in between.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "al/graphics/al_BufferObject.hpp"
+#include "al/graphics/al_Graphics.hpp"
+#include "al/graphics/al_Mesh.hpp"
+#include "al/graphics/al_VAO.hpp"
+
+#include "common/PointBuffer.hpp"
+
+class PointMesh {
+public:
+  explicit PointMesh(unsigned primitive = al::Mesh::POINTS)
+      : mPrimitive(primitive) {}
+
+  // Number of vertices. GL storage is only reallocated when it grows.
+  // Changing the count invalidates the colors, see colorsValid().
+  void resize(size_t count) {
+    create();
+    if (count > mCapacity) {
+      mCapacity = count + count / 2;
+      mPositions.bind();
+      mPositions.data(mCapacity * 3 * sizeof(float), nullptr);
+      mColors.bind();
+      mColors.data(mCapacity * sizeof(uint32_t), nullptr);
+      mColors.unbind();
+    }
+    if (count != mCount) {
+      mCount = count;
+      mColorsValid = false;
+    }
+  }
+
+  size_t size() const { return mCount; }
+
+  // x, y, z per vertex. Every position must be written before unmapping.
+  float *mapPositions() {
+    return static_cast<float *>(map(mPositions, mCount * 3 * sizeof(float)));
+  }
+  void unmapPositions() { unmap(mPositions); }
+
+  // Packed RGBA8 per vertex. Every color must be written before unmapping.
+  uint32_t *mapColors() {
+    return static_cast<uint32_t *>(map(mColors, mCount * sizeof(uint32_t)));
+  }
+  void unmapColors() {
+    unmap(mColors);
+    mColorsValid = true;
+  }
+
+  // False after resize() until the colors have been written again
+  bool colorsValid() const { return mColorsValid; }
+
+  // Draws with the current shader, e.g. after g.meshColor()
+  void draw(al::Graphics &g) {
+    if (mCount == 0) {
+      return;
+    }
+    g.update(); // send the matrices to the shader
+    mVao.bind();
+    glDrawArrays(mPrimitive, 0, GLsizei(mCount));
+    mVao.unbind();
+  }
+
+private:
+  void create() {
+    if (mCreated) {
+      return;
+    }
+    mPositions.bufferType(GL_ARRAY_BUFFER);
+    mPositions.usage(GL_STREAM_DRAW);
+    mPositions.create();
+    mColors.bufferType(GL_ARRAY_BUFFER);
+    mColors.usage(GL_DYNAMIC_DRAW);
+    mColors.create();
+
+    // Attribute locations of the allolib mesh shaders
+    mVao.create();
+    mVao.bind();
+    mPositions.bind();
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    mColors.bind();
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, nullptr);
+    mVao.unbind();
+    mColors.unbind();
+    mCreated = true;
+  }
+
+  void *map(al::BufferObject &buffer, size_t bytes) {
+    if (bytes == 0) {
+      return nullptr;
+    }
+    buffer.bind();
+    return glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  }
+
+  void unmap(al::BufferObject &buffer) {
+    if (mCount == 0) {
+      return;
+    }
+    buffer.bind();
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    buffer.unbind();
+  }
+
+  unsigned mPrimitive;
+  al::VAO mVao;
+  al::BufferObject mPositions, mColors;
+  size_t mCount{0};
+  size_t mCapacity{0};
+  bool mColorsValid{false};
+  bool mCreated{false};
+};
+
+#endif // POINT_MESH_HPP
@@ -0,0 +1,248 @@
+#pragma once
+#ifndef WAVE_SOLVER_HPP
+#define WAVE_SOLVER_HPP
+
+// Toroidal 2D wave equation solver for waveEquation.cpp, with the surface
+// normals of the result computed in the same pass.
+//
+// The two time steps are kept as two separate row-major planes. A step reads
+// the current plane and overwrites the previous one with the next values, so
+// each row only touches three rows of one plane and one row of the other. The
+// wrap-around is handled per row (the rows above and below) and by two scalar
+// edge cells per row; everything in between is a branch-free SIMD loop.
+//
+// Rows are processed in bands split across a ThreadPool. The heights of the
+// new step, before decay, go to a separate display buffer, and every band
+// computes the normals of its rows from it as soon as the rows around them
+// are done. The first and last row of each band need rows of the neighboring
+// bands, so they are finished in a second, short parallel pass. Normals are
+// the analytic normals of the height field from central differences, which
+// replaces Mesh::generateNormals().
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/ThreadPool.hpp"
+
+class WaveSolver {
+public:
+  float decay = 0.96f;   // Decay factor of waves, in (0, 1]
+  float velocity = 0.5f; // Velocity of wave propagation, in (0, 0.5]
+
+  // Grid of nx by ny cells, drawn as a surface of the given size (see
+  // al::addSurface())
+  void resize(int nx, int ny, float width = 2, float height = 2) {
+    mNx = std::max(nx, 2);
+    mNy = std::max(ny, 2);
+    mDx = width / (mNx - 1);
+    mDy = height / (mNy - 1);
+    const size_t cells = size_t(mNx) * mNy;
+    mCurrent.assign(cells, 0.0f);
+    mPrevious.assign(cells, 0.0f);
+    mHeights.assign(cells, 0.0f);
+  }
+
+  int columns() const { return mNx; }
+  int rows() const { return mNy; }
+
+  // Adds a Gaussian-shaped droplet centered on cell (ix, iy) to both time
+  // steps. Cells past the edges wrap around.
+  void addDrop(int ix, int iy, float amplitude = 0.5f, int radius = 4) {
+    for (int j = -radius; j <= radius; ++j) {
+      for (int i = -radius; i <= radius; ++i) {
+        float x = float(i) / radius;
+        float y = float(j) / radius;
+        float v = amplitude * std::exp(-(x * x + y * y) / (0.5f * 0.5f));
+        size_t idx = index(wrap(ix + i, mNx), wrap(iy + j, mNy));
+        mCurrent[idx] += v;
+        mPrevious[idx] += v;
+      }
+    }
+  }
+
+  // Advances one time step. If given, writes the new heights into the z
+  // coordinates of positions and the unit normals into normals, both
+  // interleaved x, y, z per cell in row-major order.
+  void step(ThreadPool &pool, float *positions = nullptr,
+            float *normals = nullptr) {
+    const int numBands = (mNy + kBandRows - 1) / kBandRows;
+    pool.parallelFor(size_t(numBands), [&](size_t b, unsigned) {
+      const int begin = int(b) * kBandRows;
+      const int end = std::min(mNy, begin + kBandRows);
+      for (int j = begin; j < end; j++) {
+        waveRow(j);
+        // The row above is complete once this one is done
+        if (j - 1 > begin) {
+          surfaceRow(j - 1, positions, normals);
+        }
+      }
+    });
+    pool.parallelFor(size_t(numBands), [&](size_t b, unsigned) {
+      const int begin = int(b) * kBandRows;
+      const int end = std::min(mNy, begin + kBandRows);
+      surfaceRow(begin, positions, normals);
+      if (end - 1 > begin) {
+        surfaceRow(end - 1, positions, normals);
+      }
+    });
+    std::swap(mCurrent, mPrevious);
+  }
+
+  // Heights of the last step, before decay
+  const float *heights() const { return mHeights.data(); }
+
+  // Current and previous time steps
+  const float *current() const { return mCurrent.data(); }
+  const float *previous() const { return mPrevious.data(); }
+
+private:
+  static const int kBandRows = 16;
+
+  static int wrap(int i, int n) { return ((i % n) + n) % n; }
+  size_t index(int i, int j) const { return size_t(j) * mNx + i; }
+
+  // Next values of row j: previous plane <- (next * decay), heights <- next
+  void waveRow(int j) {
+    const int nx = mNx;
+    const int jm1 = j != 0 ? j - 1 : mNy - 1;
+    const int jp1 = j != mNy - 1 ? j + 1 : 0;
+    const float *c = &mCurrent[index(0, j)];
+    const float *d = &mCurrent[index(0, jm1)];
+    const float *u = &mCurrent[index(0, jp1)];
+    float *p = &mPrevious[index(0, j)];
+    float *h = &mHeights[index(0, j)];
+    const float v = velocity, k = decay;
+
+    auto cell = [&](int i, float l, float r) {
+      float vc = c[i];
+      float val =
+          2 * vc - p[i] + v * ((l - 2 * vc + r) + (d[i] - 2 * vc + u[i]));
+      p[i] = val * k;
+      h[i] = val;
+    };
+    cell(0, c[nx - 1], c[1]);
+    int i = 1;
+#if defined(PLAYGROUND_SIMD_SSE)
+    const __m128 two = _mm_set1_ps(2.0f), vv = _mm_set1_ps(v),
+                 kk = _mm_set1_ps(k);
+    for (; i + 4 <= nx - 1; i += 4) {
+      __m128 vc = _mm_loadu_ps(c + i);
+      __m128 vc2 = _mm_mul_ps(two, vc);
+      __m128 lr = _mm_add_ps(_mm_sub_ps(_mm_loadu_ps(c + i - 1), vc2),
+                             _mm_loadu_ps(c + i + 1));
+      __m128 du = _mm_add_ps(_mm_sub_ps(_mm_loadu_ps(d + i), vc2),
+                             _mm_loadu_ps(u + i));
+      __m128 val = _mm_add_ps(_mm_sub_ps(vc2, _mm_loadu_ps(p + i)),
+                              _mm_mul_ps(vv, _mm_add_ps(lr, du)));
+      _mm_storeu_ps(p + i, _mm_mul_ps(val, kk));
+      _mm_storeu_ps(h + i, val);
+    }
+#elif defined(PLAYGROUND_SIMD_NEON)
+    const float32x4_t vv = vdupq_n_f32(v), kk = vdupq_n_f32(k);
+    for (; i + 4 <= nx - 1; i += 4) {
+      float32x4_t vc = vld1q_f32(c + i);
+      float32x4_t vc2 = vaddq_f32(vc, vc);
+      float32x4_t lr =
+          vaddq_f32(vsubq_f32(vld1q_f32(c + i - 1), vc2), vld1q_f32(c + i + 1));
+      float32x4_t du =
+          vaddq_f32(vsubq_f32(vld1q_f32(d + i), vc2), vld1q_f32(u + i));
+      float32x4_t val = vaddq_f32(vsubq_f32(vc2, vld1q_f32(p + i)),
+                                  vmulq_f32(vv, vaddq_f32(lr, du)));
+      vst1q_f32(p + i, vmulq_f32(val, kk));
+      vst1q_f32(h + i, val);
+    }
+#endif
+    for (; i < nx - 1; i++) {
+      cell(i, c[i - 1], c[i + 1]);
+    }
+    cell(nx - 1, c[nx - 2], c[0]);
+  }
+
+  // Normals (and position z) of row j from the heights of rows j - 1 ... j + 1
+  void surfaceRow(int j, float *positions, float *normals) {
+    const int nx = mNx;
+    const float *h = &mHeights[index(0, j)];
+    if (positions) {
+      float *z = positions + index(0, j) * 3 + 2;
+      for (int i = 0; i < nx; i++) {
+        z[i * 3] = h[i];
+      }
+    }
+    if (!normals) {
+      return;
+    }
+    // The surface does not wrap: one-sided differences along the edges
+    const int jm1 = std::max(j - 1, 0), jp1 = std::min(j + 1, mNy - 1);
+    const float *d = &mHeights[index(0, jm1)];
+    const float *u = &mHeights[index(0, jp1)];
+    const float sx = -1.0f / (2 * mDx);
+    const float sy = -1.0f / ((jp1 - jm1) * mDy);
+    float *n = normals + index(0, j) * 3;
+
+    auto cell = [&](int i, int im1, int ip1) {
+      float gx = (h[ip1] - h[im1]) * (ip1 - im1 == 2 ? sx : 2 * sx);
+      float gy = (u[i] - d[i]) * sy;
+      float len = 1.0f / std::sqrt(gx * gx + gy * gy + 1.0f);
+      n[i * 3] = gx * len;
+      n[i * 3 + 1] = gy * len;
+      n[i * 3 + 2] = len;
+    };
+    cell(0, 0, 1);
+    int i = 1;
+#if defined(PLAYGROUND_SIMD_SSE)
+    const __m128 vsx = _mm_set1_ps(sx), vsy = _mm_set1_ps(sy),
+                 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= nx - 1; i += 4) {
+      __m128 gx = _mm_mul_ps(
+          _mm_sub_ps(_mm_loadu_ps(h + i + 1), _mm_loadu_ps(h + i - 1)), vsx);
+      __m128 gy =
+          _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(u + i), _mm_loadu_ps(d + i)), vsy);
+      __m128 len = _mm_div_ps(
+          one, _mm_sqrt_ps(_mm_add_ps(
+                   _mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), one)));
+      __m128 x = _mm_mul_ps(gx, len), y = _mm_mul_ps(gy, len), z = len;
+      // Transpose to x, y, z per cell
+      __m128 xy0 = _mm_unpacklo_ps(x, y), xy1 = _mm_unpackhi_ps(x, y);
+      __m128 zx0 = _mm_unpacklo_ps(z, x), zx1 = _mm_unpackhi_ps(z, x);
+      __m128 yz0 = _mm_unpacklo_ps(y, z), yz1 = _mm_unpackhi_ps(y, z);
+      float *out = n + i * 3;
+      _mm_storeu_ps(out, _mm_shuffle_ps(xy0, zx0, _MM_SHUFFLE(3, 0, 1, 0)));
+      _mm_storeu_ps(out + 4, _mm_shuffle_ps(yz0, xy1, _MM_SHUFFLE(1, 0, 3, 2)));
+      _mm_storeu_ps(out + 8, _mm_shuffle_ps(zx1, yz1, _MM_SHUFFLE(3, 2, 3, 0)));
+    }
+#elif defined(PLAYGROUND_SIMD_NEON)
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    for (; i + 4 <= nx - 1; i += 4) {
+      float32x4_t gx = vmulq_n_f32(
+          vsubq_f32(vld1q_f32(h + i + 1), vld1q_f32(h + i - 1)), sx);
+      float32x4_t gy =
+          vmulq_n_f32(vsubq_f32(vld1q_f32(u + i), vld1q_f32(d + i)), sy);
+      float lanes[4];
+      vst1q_f32(lanes, vmlaq_f32(vmlaq_f32(one, gx, gx), gy, gy));
+      for (float &l : lanes) {
+        l = 1.0f / std::sqrt(l);
+      }
+      float32x4_t len = vld1q_f32(lanes);
+      float32x4x3_t xyz;
+      xyz.val[0] = vmulq_f32(gx, len);
+      xyz.val[1] = vmulq_f32(gy, len);
+      xyz.val[2] = len;
+      vst3q_f32(n + i * 3, xyz);
+    }
+#endif
+    for (; i < nx - 1; i++) {
+      cell(i, i - 1, i + 1);
+    }
+    cell(nx - 1, nx - 2, nx - 1);
+  }
+
+  int mNx{0}, mNy{0};
+  float mDx{1}, mDy{1};
+  std::vector<float> mCurrent, mPrevious; // time steps t and t - 1
+  std::vector<float> mHeights;            // display buffer
+};
+
+#endif // WAVE_SOLVER_HPP
@@ -0,0 +1,66 @@
+// Scaling benchmark for BoidFlock: time per step with 1 to 8 threads (or the
+// number of cores, if larger), and a check that every thread count produces
+// exactly the same flock.
+//
+// The box grows with the number of boids so the density matches the 32 boid
+// demo.
+//
+// Build and run with ./run.sh cookbook/simulation/flock_scaling_bench.cpp
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "common/Benchmark.hpp"
+
+#include "BoidFlock.hpp"
+
+const int kSteps = 20;
+
+// Hash of the bits of the whole state
+uint64_t checksum(const BoidFlock &flock) {
+  uint64_t h = 1469598103934665603ull;
+  const double *arrays[4] = {flock.x(), flock.y(), flock.vx(), flock.vy()};
+  for (const double *a : arrays) {
+    for (int i = 0; i < flock.size(); i++) {
+      uint64_t bits;
+      std::memcpy(&bits, &a[i], sizeof(bits));
+      h = (h ^ bits) * 1099511628211ull;
+    }
+  }
+  return h;
+}
+
+int main() {
+  unsigned maxThreads = std::max(8u, std::thread::hardware_concurrency());
+  printf("%u hardware threads, %d steps per run\n",
+         std::thread::hardware_concurrency(), kSteps);
+  printf("%8s %8s %12s %10s %18s\n", "boids", "threads", "ms/step", "speedup",
+         "checksum");
+  for (int n : {10000, 100000}) {
+    double single = 0;
+    uint64_t reference = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads++) {
+      ThreadPool pool(threads);
+      BoidFlock flock;
+      double radius = std::sqrt(n / 32.0);
+      flock.params.bound = radius;
+      flock.reset(n, 7, radius);
+      auto start = bench::Clock::now();
+      for (int step = 0; step < kSteps; step++) {
+        flock.step(1 / 60.0, pool);
+      }
+      double perStep = bench::secondsSince(start) / kSteps;
+      uint64_t sum = checksum(flock);
+      if (threads == 1) {
+        single = perStep;
+        reference = sum;
+      }
+      printf("%8d %8u %12.3f %9.2fx %18llx%s\n", n, threads, perStep * 1e3,
+             single / perStep, (unsigned long long)sum,
+             sum == reference ? "" : "  MISMATCH");
+    }
+  }
+  return 0;
+}
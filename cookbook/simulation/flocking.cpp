@@ -9,12 +9,25 @@ algorithm [1] consists of three main interactions between flockmates ("boids"):
     2) Velocity matching (of nearby flockmates)
     3) Flock centering (of nearby flockmates)
 
-Here, we implement 1) and 2) only. Another change from the reference source is
+Flock centering steers each boid towards the mean position of its flockmates,
+weighted by nearness. Another change from the reference source is
 the use of Gaussian functions rather than inverse-squared functions for
 calculating the "nearness" of flockmates. This is done primarily to avoid
 infinities, but also to give smoother motions. Lastly, we give each boid a
 random walk motion which helps both dissolve and redirect the flocks.
 
+Since the Gaussians are practically zero a few radii away, flockmates are only
+looked for in a uniform grid (see BoidGrid.hpp) whose cells are as wide as
+that cutoff distance. This keeps each step close to O(N), so the flock can
+grow to 100k boids: press '=' and '-' to change the number of boids.
+
+The flock lives in BoidFlock.hpp. Every boid computes its next state from the
+current state of its neighbors, so the update is split across all cores and
+gives the same result whatever the number of threads. The heads and tails
+are written in place into mapped vertex buffers (see PointMesh.hpp) rather
+than rebuilt as a Mesh every frame, and their colors are only written when
+the number of boids changes.
+
 [1] Reynolds, C. W. (1987). Flocks, herds, and schools: A distributed behavioral
     model. Computer Graphics, 21(4):25–34.
 
@@ -29,22 +42,20 @@ Lance Putnam, Oct. 2014
 #include "al/math/al_Functions.hpp"
 #include "al/math/al_Random.hpp"
 
-using namespace al;
-
-// A "boid" (play on bird) is one member of a flock.
-class Boid {
- public:
-  // Each boid has a position and velocity.
-  Vec2d pos, vel;
+#include "BoidFlock.hpp"
+#include "PointMesh.hpp"
 
-  // Update position based on velocity and delta time
-  void update(double dt) { pos += vel * dt; }
-};
+using namespace al;
 
+// A "boid" (play on bird) is one member of a flock. Each boid has a position
+// and velocity, stored in the arrays of a BoidFlock.
 struct MyApp : public App {
-  static const int Nb = 32;  // Number of boids
-  Boid boids[Nb];
-  Mesh heads, tails;
+  static const int maxBoids = 100000;
+  int Nb = 32;  // Number of boids
+  BoidFlock flock;
+  ThreadPool pool;
+  PointMesh heads{Mesh::POINTS};
+  PointMesh tails{Mesh::LINES};
   Mesh box;
 
   void onCreate() {
@@ -59,85 +70,53 @@ struct MyApp : public App {
   }
 
   // Randomize boid positions/velocities uniformly inside unit disc
-  void resetBoids() {
-    for (auto& b : boids) {
-      b.pos = rnd::ball<Vec2f>();
-      b.vel = rnd::ball<Vec2f>();
-    }
-  }
+  void resetBoids() { flock.reset(Nb, rnd::uniform(1u << 30)); }
 
   void onAnimate(double dt_ms) {
     double dt = dt_ms;
 
-    // Compute boid-boid interactions
-    for (int i = 0; i < Nb - 1; ++i) {
-      for (int j = i + 1; j < Nb; ++j) {
-        // printf("checking boids %d and %d\n", i,j);
-
-        auto ds = boids[i].pos - boids[j].pos;
-        auto dist = ds.mag();
-
-        // Collision avoidance
-        double pushRadius = 0.05;
-        double pushStrength = 1;
-        double push = exp(-al::pow2(dist / pushRadius)) * pushStrength;
-
-        auto pushVector = ds.normalized() * push;
-        boids[i].pos += pushVector;
-        boids[j].pos -= pushVector;
-
-        // Velocity matching
-        double matchRadius = 0.125;
-        double nearness = exp(-al::pow2(dist / matchRadius));
-        Vec2d veli = boids[i].vel;
-        Vec2d velj = boids[j].vel;
-
-        // Take a weighted average of velocities according to nearness
-        boids[i].vel = veli * (1 - 0.5 * nearness) + velj * (0.5 * nearness);
-        boids[j].vel = velj * (1 - 0.5 * nearness) + veli * (0.5 * nearness);
-
-        // TODO: Flock centering
+    // Interactions, independent behaviors and position update
+    flock.step(dt, pool);
+
+    // Write the meshes in place: positions every frame, colors only when
+    // the number of boids changed
+    heads.resize(Nb);
+    tails.resize(2 * Nb);
+    float* headPos = heads.mapPositions();
+    float* tailPos = tails.mapPositions();
+    const double* x = flock.x();
+    const double* y = flock.y();
+    const double* vx = flock.vx();
+    const double* vy = flock.vy();
+    pool.parallelFor(
+        size_t(Nb),
+        [&](size_t i, unsigned) {
+          float* head = headPos + 3 * i;
+          float* tail = tailPos + 6 * i;
+          head[0] = tail[0] = float(x[i]);
+          head[1] = tail[1] = float(y[i]);
+          head[2] = tail[2] = 0;
+          double speed = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+          double len = speed > 0 ? 0.07 / speed : 0;
+          tail[3] = float(x[i] - vx[i] * len);
+          tail[4] = float(y[i] - vy[i] * len);
+          tail[5] = 0;
+        },
+        4096);
+    heads.unmapPositions();
+    tails.unmapPositions();
+
+    if (!heads.colorsValid() || !tails.colorsValid()) {
+      uint32_t* headColor = heads.mapColors();
+      uint32_t* tailColor = tails.mapColors();
+      const uint32_t gray = point_color::rgba(0.5f, 0.5f, 0.5f);
+      for (int i = 0; i < Nb; ++i) {
+        headColor[i] = point_color::hsv(float(i) / Nb * 0.3f + 0.3f, 0.7f, 1);
+        tailColor[2 * i] = headColor[i];
+        tailColor[2 * i + 1] = gray;
       }
-    }
-
-    // Update boid independent behaviors
-    for (auto& b : boids) {
-      // Random "hunting" motion
-      float huntUrge = 0.2f;
-      auto hunt = rnd::ball<Vec2f>();
-      // Use cubed distribution to make small jumps more frequent
-      hunt *= hunt.magSqr();
-      b.vel += hunt * huntUrge;
-
-      // Bound boid into a box
-      if (b.pos.x > 1 || b.pos.x < -1) {
-        b.pos.x = b.pos.x > 0 ? 1 : -1;
-        b.vel.x = -b.vel.x;
-      }
-      if (b.pos.y > 1 || b.pos.y < -1) {
-        b.pos.y = b.pos.y > 0 ? 1 : -1;
-        b.vel.y = -b.vel.y;
-      }
-    }
-
-    // Generate meshes
-    heads.reset();
-    heads.primitive(Mesh::POINTS);
-
-    tails.reset();
-    tails.primitive(Mesh::LINES);
-
-    for (size_t i = 0; i < Nb; ++i) {
-      boids[i].update(dt);
-
-      heads.vertex(boids[i].pos);
-      heads.color(HSV(float(i) / Nb * 0.3f + 0.3f, 0.7f));
-
-      tails.vertex(boids[i].pos);
-      tails.vertex(boids[i].pos - boids[i].vel.normalized(0.07));
-
-      tails.color(heads.colors()[i]);
-      tails.color(RGB(0.5));
+      heads.unmapColors();
+      tails.unmapColors();
     }
   }
 
@@ -148,8 +127,8 @@ struct MyApp : public App {
     // g.nicest();
     // g.stroke(8);
     g.meshColor();
-    g.draw(heads);
-    g.draw(tails);
+    heads.draw(g);
+    tails.draw(g);
 
     // g.stroke(1);
     g.color(1);
@@ -161,6 +140,14 @@ struct MyApp : public App {
       case 'r':
         resetBoids();
         break;
+      case '=':
+        Nb = std::min(Nb * 4, int(maxBoids));
+        resetBoids();
+        break;
+      case '-':
+        Nb = std::max(Nb / 4, 2);
+        resetBoids();
+        break;
     }
     return true;
   }
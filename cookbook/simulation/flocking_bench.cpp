@@ -0,0 +1,147 @@
+// Benchmark for the flocking interaction pass: all-pairs loop versus the
+// BoidGrid neighbor search, for N = 32 ... 100k boids.
+//
+// "same box" keeps the [-1, 1] box of flocking.cpp, so the number of
+// flockmates in range grows with N. "same density" grows the box with N,
+// which is what a larger flock spreading out looks like.
+//
+// Build and run with ./run.sh cookbook/simulation/flocking_bench.cpp
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "BoidGrid.hpp"
+
+struct Boid {
+  double x, y, vx, vy;
+};
+
+const double pushRadius = 0.05;
+const double pushStrength = 1;
+const double matchRadius = 0.125;
+const double gaussianCutoff = 3;
+
+// Interaction of one pair, as in flocking.cpp. Returns true if in range.
+inline bool interact(Boid &a, Boid &b, double cutoffSqr) {
+  double dx = a.x - b.x, dy = a.y - b.y;
+  double distSqr = dx * dx + dy * dy;
+  if (distSqr > cutoffSqr || distSqr == 0) {
+    return false;
+  }
+  double dist = std::sqrt(distSqr);
+  if (dist < gaussianCutoff * pushRadius) {
+    double push = std::exp(-distSqr / (pushRadius * pushRadius)) *
+                  pushStrength / dist;
+    a.x += dx * push;
+    a.y += dy * push;
+    b.x -= dx * push;
+    b.y -= dy * push;
+  }
+  double nearness = std::exp(-distSqr / (matchRadius * matchRadius));
+  double avx = a.vx, avy = a.vy;
+  a.vx = avx * (1 - 0.5 * nearness) + b.vx * (0.5 * nearness);
+  a.vy = avy * (1 - 0.5 * nearness) + b.vy * (0.5 * nearness);
+  b.vx = b.vx * (1 - 0.5 * nearness) + avx * (0.5 * nearness);
+  b.vy = b.vy * (1 - 0.5 * nearness) + avy * (0.5 * nearness);
+  return true;
+}
+
+// The original loop: two Gaussians for every pair
+void allPairs(std::vector<Boid> &boids) {
+  const int n = int(boids.size());
+  for (int i = 0; i < n - 1; ++i) {
+    for (int j = i + 1; j < n; ++j) {
+      Boid &a = boids[i], &b = boids[j];
+      double dx = a.x - b.x, dy = a.y - b.y;
+      double dist = std::sqrt(dx * dx + dy * dy);
+      double push = std::exp(-std::pow(dist / pushRadius, 2)) * pushStrength;
+      double scale = dist > 0 ? push / dist : 0;
+      a.x += dx * scale;
+      a.y += dy * scale;
+      b.x -= dx * scale;
+      b.y -= dy * scale;
+      double nearness = std::exp(-std::pow(dist / matchRadius, 2));
+      double avx = a.vx, avy = a.vy;
+      a.vx = avx * (1 - 0.5 * nearness) + b.vx * (0.5 * nearness);
+      a.vy = avy * (1 - 0.5 * nearness) + b.vy * (0.5 * nearness);
+      b.vx = b.vx * (1 - 0.5 * nearness) + avx * (0.5 * nearness);
+      b.vy = b.vy * (1 - 0.5 * nearness) + avy * (0.5 * nearness);
+    }
+  }
+}
+
+long long gridPairs(std::vector<Boid> &boids, BoidGrid &grid) {
+  const double cutoff = gaussianCutoff * std::max(pushRadius, matchRadius);
+  grid.build(&boids[0].x, &boids[0].y, sizeof(Boid) / sizeof(double),
+             int(boids.size()), cutoff);
+  long long inRange = 0;
+  grid.forEachPair([&](int i, int j) {
+    inRange += interact(boids[i], boids[j], cutoff * cutoff);
+  });
+  return inRange;
+}
+
+std::vector<Boid> makeFlock(int n, double halfSize) {
+  std::mt19937 rng(n);
+  std::uniform_real_distribution<double> pos(-halfSize, halfSize);
+  std::uniform_real_distribution<double> vel(-1, 1);
+  std::vector<Boid> boids(n);
+  for (auto &b : boids) {
+    b = {pos(rng), pos(rng), vel(rng), vel(rng)};
+  }
+  return boids;
+}
+
+// Average seconds per call, running fn for about maxSeconds (at least once)
+template <class Function> double timeSteps(Function &&fn, double maxSeconds) {
+  int runs = 0;
+  auto start = bench::Clock::now();
+  do {
+    fn();
+    runs++;
+  } while (bench::secondsSince(start) < maxSeconds);
+  return bench::secondsSince(start) / runs;
+}
+
+int main() {
+  printf("%8s %12s %14s %14s %16s %14s\n", "boids", "layout", "all pairs ms",
+         "grid ms", "pairs in range", "speedup");
+  for (int n : {32, 100, 1000, 10000, 100000}) {
+    for (int sameDensity = 0; sameDensity < 2; sameDensity++) {
+      double halfSize = sameDensity ? std::sqrt(n / 32.0) : 1.0;
+      if (sameDensity && n == 32) {
+        continue; // same as the first row
+      }
+      std::vector<Boid> flock = makeFlock(n, halfSize);
+
+      double all = -1;
+      if (n <= 10000) {
+        std::vector<Boid> boids = flock;
+        all = timeSteps([&]() { allPairs(boids); }, 0.3);
+      }
+      std::vector<Boid> boids = flock;
+      BoidGrid grid;
+      long long inRange = 0;
+      double gridTime =
+          timeSteps([&]() { inRange = gridPairs(boids, grid); }, 0.3);
+
+      printf("%8d %12s", n, sameDensity ? "same density" : "same box");
+      if (all >= 0) {
+        printf(" %14.3f", all * 1e3);
+      } else {
+        printf(" %14s", "-");
+      }
+      printf(" %14.3f %16lld", gridTime * 1e3, inRange);
+      if (all >= 0) {
+        printf(" %13.1fx\n", all / gridTime);
+      } else {
+        printf(" %14s\n", "-");
+      }
+    }
+  }
+  return 0;
+}
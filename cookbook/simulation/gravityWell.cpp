@@ -5,7 +5,16 @@ Description:
 The demonstrates how to make many lightweight bodies interact with the
 gravitational pull of a single heavy body.
 
+The bodies also attract each other. With many bodies, summing the pull of all
+others on each body takes O(N^2) time, so NBody.hpp approximates far away
+groups of bodies by their total mass with a Barnes-Hut octree, split across
+all cores. The bodies are moved with a leapfrog integrator at a fixed time
+step, which keeps the orbits' energy from drifting.
+
 Press the number keys to reset the particles with different initial conditions.
+Press 'g' to turn the mutual gravity on and off, 'd' to switch between the
+octree and direct summation (up to 6400 bodies, the octree beyond), and '='
+and '-' to change the number of bodies.
 
 Author:
 Lance Putnam, Nov. 2015
@@ -19,31 +28,28 @@ Lance Putnam, Nov. 2015
 #include "al/system/al_Time.hpp"
 #include <algorithm> // max
 #include <cmath>
+#include <cstdint>
+
+#include "NBody.hpp"
+#include "PointMesh.hpp"
 
 using namespace al;
 using namespace std;
 
-// A particle with acceleration
-class Particle {
-public:
-  Vec3f pos;
-  Vec3f vel;
-  Vec3f acc;
-
-  void update(double dt) {
-    // Semi-implicit Euler method:
-    vel += acc * dt;
-    pos += vel * dt;
-  }
-};
-
 class MyApp : public App {
 public:
-  static const int M = 20;
-  static const int N = M * M;
-  Particle particles[N];
-  Particle well;
+  static const int maxBodies = 409600;
+  static const int maxDrawnSolids = 1000; // more are drawn as points
+  static const int maxDirectBodies = 6400; // more always use the octree
+  const float timeStep = 1.f / 120;        // fixed step of the integrator
+  int N = 400;                             // changed with '=' and '-'
+  int preset = '1';
+  bool direct = false; // direct summation instead of the octree, with 'd'
+  NBody bodies; // positions, velocities and accelerations of the particles
+  ThreadPool pool;
+  double timeLeft = 0; // not yet simulated part of the elapsed time
   Mesh body1, body2;
+  PointMesh points{Mesh::POINTS};
   Light light1, light2;
 
   void onCreate() override {
@@ -57,69 +63,76 @@ public:
     nav().faceToward(Vec3f(0, 0.7, -1));
   }
 
-  void reset(int preset = '1') {
-    switch (preset) {
-    case '1': // dust cloud
-      for (auto &p : particles) {
-        p.pos = rnd::ball<Vec3f>() * 0.2 + Vec3f(-0.7, 0, 0);
-        p.vel = Vec3f(0, -0.3, 0);
-      }
-      break;
-    case '2': // hourglass
-      for (auto &p : particles) {
-        p.pos = rnd::ball<Vec3f>().mag(1);
-        p.vel = clone(p.pos).rotate(M_PI / 2) * Vec3f(1, 1, -1) * 0.2;
-      }
-      break;
-    case '3': // line orbit 1
-      for (int i = 0; i < N; ++i) {
-        particles[i].pos = Vec3f(float(i) / N * 0.5 - 1, 0, 0);
-        particles[i].vel = Vec3f(0, -0.3, 0);
-      }
-      break;
-    case '4': // line orbit 2
-      for (int i = 0; i < N; ++i) {
+  void reset(int key = '1') {
+    if (key < '1' || key > '6') {
+      return;
+    }
+    preset = key;
+    const int M = int(std::ceil(std::sqrt(double(N))));
+    bodies.resize(N);
+    bodies.params.wellMass = 0.1; // mass of particle is 10
+    for (int i = 0; i < N; ++i) {
+      Vec3f pos, vel;
+      switch (preset) {
+      case '1': // dust cloud
+        pos = rnd::ball<Vec3f>() * 0.2 + Vec3f(-0.7, 0, 0);
+        vel = Vec3f(0, -0.3, 0);
+        break;
+      case '2': // hourglass
+        pos = rnd::ball<Vec3f>().mag(1);
+        vel = clone(pos).rotate(M_PI / 2) * Vec3f(1, 1, -1) * 0.2;
+        break;
+      case '3': // line orbit 1
+        pos = Vec3f(float(i) / N * 0.5 - 1, 0, 0);
+        vel = Vec3f(0, -0.3, 0);
+        break;
+      case '4': { // line orbit 2
         float frac = float(i) / N;
-        particles[i].pos = Vec3f(-0.8, frac, 0);
-        particles[i].vel = Vec3f(-0.1, -0.2, 0.2);
-      }
-      break;
-    case '5': // grid formation (side)
-      for (int i = 0; i < N; ++i) {
-        particles[i].pos = Vec3f(-1, float(i % M) / (M - 1) * 2 - 1,
-                                 float(i / M) / (M - 1) * 2 - 1);
-        particles[i].vel = Vec3f(0, 0, 0);
+        pos = Vec3f(-0.8, frac, 0);
+        vel = Vec3f(-0.1, -0.2, 0.2);
+      } break;
+      case '5': // grid formation (side)
+        pos = Vec3f(-1, float(i % M) / (M - 1) * 2 - 1,
+                    float(i / M) / (M - 1) * 2 - 1);
+        vel = Vec3f(0, 0, 0);
+        break;
+      case '6': // grid formation (front)
+        pos = Vec3f(float(i % M) / (M - 1) - 0.5, float(i / M) / (M - 1) - 0.5,
+                    1);
+        vel = Vec3f(0.1, 0, 0);
+        break;
       }
-      break;
-    case '6': // grid formation (front)
-      for (int i = 0; i < N; ++i) {
-        particles[i].pos = Vec3f(float(i % M) / (M - 1) - 0.5,
-                                 float(i / M) / (M - 1) - 0.5, 1);
-        particles[i].vel = Vec3f(0.1, 0, 0);
-      }
-      break;
+      bodies.position(i, pos.x, pos.y, pos.z);
+      bodies.velocity(i, vel.x, vel.y, vel.z);
     }
+    timeLeft = 0;
   }
 
-  void onAnimate(double dt_ms) override {
-    // convert millisecond to second
-    float dt = dt_ms;
-
-    // Compute forces
-    for (auto &p : particles) {
-      // Newton's law of gravity
-      auto r21 = well.pos - p.pos; // distance vector between well and particle
-      auto dist = r21.mag();       // distance between well and particle
-      dist = std::max(dist, 0.1f); // prevent high velocities
-      auto F = r21 / (dist * dist * dist); // force vector acting on particle
-
-      // Newton's second law of motion, F = ma -> a = F/m
-      p.acc = F * (1. / 10); // mass of particle is 10
+  void onAnimate(double dt) override {
+    // Step with a fixed time step, as the leapfrog integrator needs, to catch
+    // up with the frame time. Forces (Newton's law of gravity from the well
+    // and, if on, from all other particles) are computed inside each step.
+    timeLeft = std::min(timeLeft + dt, 4.0 * timeStep);
+    while (timeLeft >= timeStep) {
+      bodies.step(timeStep, pool);
+      timeLeft -= timeStep;
     }
 
-    // Update particles
-    for (auto &p : particles)
-      p.update(dt);
+    if (N > maxDrawnSolids) {
+      points.resize(N);
+      float *p = points.mapPositions();
+      for (int i = 0; i < N; ++i) {
+        p[3 * i] = bodies.x()[i];
+        p[3 * i + 1] = bodies.y()[i];
+        p[3 * i + 2] = bodies.z()[i];
+      }
+      points.unmapPositions();
+      if (!points.colorsValid()) {
+        uint32_t *c = points.mapColors();
+        std::fill(c, c + N, point_color::hsv(0.67, 0.2, 0.5));
+        points.unmapColors();
+      }
+    }
   }
 
   void onDraw(Graphics &g) override {
@@ -148,12 +161,19 @@ public:
     g.draw(body2);
 
     // Draw the particles
-    g.color(HSV(0.67, 0.2, 0.5));
-    for (auto &p : particles) {
-      g.pushMatrix();
-      g.translate(p.pos);
-      g.draw(body1);
-      g.popMatrix();
+    if (N > maxDrawnSolids) {
+      g.lighting(false);
+      g.meshColor();
+      gl::pointSize(2);
+      points.draw(g);
+    } else {
+      g.color(HSV(0.67, 0.2, 0.5));
+      for (int i = 0; i < N; ++i) {
+        g.pushMatrix();
+        g.translate(bodies.x()[i], bodies.y()[i], bodies.z()[i]);
+        g.draw(body1);
+        g.popMatrix();
+      }
     }
 
     // cout << "\rfps: " << fps() << rnd::uniform() << flush;
@@ -163,9 +183,30 @@ public:
   bool onKeyDown(const Keyboard &k) override {
     reset(k.key());
 
-    if (k.key() == ' ') {
+    switch (k.key()) {
+    case ' ':
       graphics().toggleLight(1);
+      break;
+    case 'g': // mutual gravity on/off
+      bodies.params.mutual = !bodies.params.mutual;
+      break;
+    case 'd': // Barnes-Hut or direct summation
+      direct = !direct;
+      break;
+    case '=':
+      N = std::min(N * 4, int(maxBodies));
+      reset(preset);
+      break;
+    case '-':
+      N = std::max(N / 4, 25);
+      reset(preset);
+      break;
     }
+    // Direct summation takes O(N^2) time, which stalls every frame for many
+    // bodies; nbody_bench.cpp compares the two
+    bodies.params.mode = direct && N <= maxDirectBodies
+                             ? NBody::Mode::Direct
+                             : NBody::Mode::BarnesHut;
     return true;
   }
 };
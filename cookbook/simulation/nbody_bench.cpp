@@ -0,0 +1,128 @@
+// Benchmark for the NBody engine of gravityWell.cpp: Barnes-Hut steps for
+// 10k to 1M bodies, against direct summation where that is still feasible.
+//
+// Accuracy is checked by comparing the accelerations of 1000 sampled bodies
+// with a double precision direct sum, and the leapfrog's energy drift over a
+// thousand fixed steps is reported.
+//
+// Build and run with ./run.sh cookbook/simulation/nbody_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "NBody.hpp"
+
+// A dust cloud: uniform in a ball, orbiting the well
+void makeCloud(NBody &bodies, int n, unsigned seed = 1) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> uni(-1.0f, 1.0f);
+  bodies.resize(n);
+  for (int i = 0; i < n; i++) {
+    float p[3];
+    do {
+      for (float &c : p) {
+        c = uni(rng);
+      }
+    } while (p[0] * p[0] + p[1] * p[1] + p[2] * p[2] > 1);
+    bodies.position(i, p[0] * 0.5f - 0.7f, p[1] * 0.5f, p[2] * 0.5f);
+    bodies.velocity(i, 0, -0.3f, 0);
+  }
+}
+
+// Median and maximum relative error of 1000 sampled accelerations
+void accelerationError(NBody &bodies, ThreadPool &pool, double &median,
+                       double &maximum) {
+  bodies.computeForces(pool);
+  std::vector<double> errors;
+  const int n = bodies.size();
+  for (int k = 0; k < 1000; k++) {
+    int i = int((long long)k * n / 1000);
+    double ref[3];
+    bodies.referenceAcceleration(i, ref);
+    double dx = bodies.ax()[i] - ref[0], dy = bodies.ay()[i] - ref[1],
+           dz = bodies.az()[i] - ref[2];
+    errors.push_back(std::sqrt((dx * dx + dy * dy + dz * dz) /
+                               (ref[0] * ref[0] + ref[1] * ref[1] +
+                                ref[2] * ref[2])));
+  }
+  std::sort(errors.begin(), errors.end());
+  median = errors[errors.size() / 2];
+  maximum = errors.back();
+}
+
+int main() {
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  ThreadPool pool;
+  printf("%d hardware threads\n\n", int(cores));
+
+  printf("acceleration error against a double precision direct sum, 100k "
+         "bodies\n");
+  {
+    NBody bodies;
+    makeCloud(bodies, 100000);
+    for (float theta : {0.3f, 0.5f, 0.7f}) {
+      double median, maximum;
+      bodies.params.theta = theta;
+      accelerationError(bodies, pool, median, maximum);
+      printf("  Barnes-Hut theta %.1f: median %.2e, max %.2e\n", theta, median,
+             maximum);
+    }
+    bodies.params.mode = NBody::Mode::Direct;
+    double median, maximum;
+    accelerationError(bodies, pool, median, maximum);
+    printf("  direct, single precision: median %.2e, max %.2e\n\n", median,
+           maximum);
+  }
+
+  printf("relative energy drift over 1000 steps of 1/120 s, 2000 bodies\n");
+  {
+    NBody bodies;
+    makeCloud(bodies, 2000);
+    bodies.params.totalMass = 0.2f; // more self-gravity than the demo
+    double e0 = bodies.energy();
+    for (int s = 0; s < 1000; s++) {
+      bodies.step(1.0f / 120, pool);
+    }
+    printf("  leapfrog, Barnes-Hut: %.2e\n\n",
+           std::abs(bodies.energy() - e0) / std::abs(e0));
+  }
+
+  printf("%8s %8s %14s %14s %10s\n", "bodies", "threads", "Barnes-Hut ms",
+         "direct ms", "nodes");
+  std::vector<unsigned> threadCounts = {1};
+  for (unsigned t = 2; t <= cores && t <= 16; t *= 2) {
+    threadCounts.push_back(t);
+  }
+  for (int n : {10000, 100000, 1000000}) {
+    NBody bodies;
+    makeCloud(bodies, n);
+    for (unsigned t : threadCounts) {
+      ThreadPool threads(t);
+      const double seconds = n >= 1000000 ? 0.0 : 0.5;
+      const int runs = n >= 1000000 ? 1 : 3;
+      bodies.params.mode = NBody::Mode::BarnesHut;
+      double tree = bench::measure(
+          [&]() { bodies.step(1.0f / 120, threads); }, seconds, runs);
+      double direct = -1;
+      if (n <= 10000) {
+        bodies.params.mode = NBody::Mode::Direct;
+        direct = bench::measure(
+            [&]() { bodies.step(1.0f / 120, threads); }, seconds, runs);
+      }
+      printf("%8d %8u %14.1f", n, t, tree * 1e3);
+      if (direct >= 0) {
+        printf(" %14.1f", direct * 1e3);
+      } else {
+        printf(" %14s", "-");
+      }
+      printf(" %10d\n", bodies.treeNodes());
+    }
+  }
+  return 0;
+}
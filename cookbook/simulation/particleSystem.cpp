@@ -5,85 +5,93 @@ Description:
 This demonstrates how to build a particle system with a simple fountain-like
 behavior.
 
+The particles are drawn from a PointMesh (PointMesh.hpp) whose vertex buffers
+are written in place every frame, instead of rebuilding a Mesh. Colors come
+from a palette by age computed once, rather than an HSV conversion and a
+random number per particle per frame.
+
+The emitter (ParticleEmitter.hpp) keeps each coordinate of the particles in
+its own array and integrates them with SIMD across all cores. How particles
+are emitted is a policy type, here a mix of the Fountain and Spray behaviors.
+Press '=' and '-' to change the number of particles, up to 8 million.
+
 Author(s):
 Lance Putnam, 4/25/2011
 */
 
+#include <algorithm>
+#include <cstdint>
+
 #include "al/app/al_App.hpp"
 #include "al/math/al_Random.hpp"
 
-using namespace al;
+#include "ParticleEmitter.hpp"
+#include "PointMesh.hpp"
 
-struct Particle {
-  Vec3f pos, vel, acc;
-  int age = 0;
-
-  void update(int ageInc) {
-    vel += acc;
-    pos += vel;
-    age += ageInc;
-  }
-};
-
-template <int N> struct Emitter {
-  Particle particles[N];
-  int tap = 0;
-
-  Emitter() {
-    for (auto &p : particles)
-      p.age = N;
-  }
-
-  template <int M> void update() {
-    for (auto &p : particles)
-      p.update(M);
-
-    for (int i = 0; i < M; ++i) {
-      auto &p = particles[tap];
+using namespace al;
 
-      // fountain
-      if (rnd::prob(0.95)) {
-        p.vel.set(rnd::uniform(-0.1, -0.05), rnd::uniform(0.12, 0.14),
-                  rnd::uniform(0.01));
-        p.acc.set(0, -0.002, 0);
+// 95% of the particles come out of the fountain, the rest spray
+using FountainSpray = Either<Fountain, Spray>;
 
-        // spray
-      } else {
-        p.vel.set(rnd::uniformS(0.01), rnd::uniformS(0.01),
-                  rnd::uniformS(0.01));
-        p.acc.set(0, 0, 0);
+struct MyApp : public App {
+  static const int kMaxParticles = 8192000;
+  static const int kLifetime = 200; // frames from emission to being replaced
+  static const int kShades = 16;
+  int numParticles = 8000;
+  ParticleEmitter<FountainSpray> em1;
+  ThreadPool pool;
+  PointMesh mesh{Mesh::POINTS};
+
+  // Colors by age (in frames) and random saturation, computed once. The last
+  // age is black, for particles not emitted yet.
+  uint32_t palette[kLifetime + 1][kShades];
+  unsigned frame = 0;
+
+  void onCreate() {
+    nav().pullBack(16);
+    for (int a = 0; a <= kLifetime; ++a) {
+      float age = float(a) / kLifetime;
+      for (int s = 0; s < kShades; ++s) {
+        palette[a][s] = point_color::hsv(0.6, rnd::uniform(), (1 - age) * 0.4);
       }
-      p.pos.set(4, -2, 0);
-
-      p.age = 0;
-      ++tap;
-      if (tap >= N)
-        tap = 0;
     }
+    resetParticles();
   }
 
-  int size() { return N; }
-};
-
-struct MyApp : public App {
-  Emitter<8000> em1;
-  Mesh mesh;
+  void resetParticles() {
+    em1.resize(numParticles);
+    em1.origin(4, -2, 0);
+  }
 
-  void onCreate() { nav().pullBack(16); }
+  // Particles emitted (and age added) per frame
+  int emitRate() const { return std::max(numParticles / kLifetime, 1); }
 
   void onAnimate(double dt) {
-    em1.update<40>();
-
-    mesh.reset();
-    mesh.primitive(Mesh::POINTS);
-
-    for (int i = 0; i < em1.size(); ++i) {
-      Particle &p = em1.particles[i];
-      float age = float(p.age) / em1.size();
-
-      mesh.vertex(p.pos);
-      mesh.color(HSV(0.6, rnd::uniform(), (1 - age) * 0.4));
-    }
+    const int emit = emitRate();
+    em1.update(emit, pool);
+    ++frame;
+
+    // Positions and colors are written straight into the vertex buffers
+    mesh.resize(em1.size());
+    float *pos = mesh.mapPositions();
+    uint32_t *color = mesh.mapColors();
+    const float *x = em1.x();
+    const float *y = em1.y();
+    const float *z = em1.z();
+    const int *age = em1.age();
+    pool.parallelFor(
+        em1.size(),
+        [&](size_t i, unsigned) {
+          pos[3 * i] = x[i];
+          pos[3 * i + 1] = y[i];
+          pos[3 * i + 2] = z[i];
+          // Saturation flickers as before, picked from the palette's shades
+          int a = std::min(age[i] / emit, int(kLifetime));
+          color[i] = palette[a][(i + frame) % kShades];
+        },
+        16384);
+    mesh.unmapPositions();
+    mesh.unmapColors();
   }
 
   void onDraw(Graphics &g) {
@@ -91,7 +99,21 @@ struct MyApp : public App {
     g.blendAdd();
     gl::pointSize(6);
     g.meshColor();
-    g.draw(mesh);
+    mesh.draw(g);
+  }
+
+  bool onKeyDown(const Keyboard &k) {
+    switch (k.key()) {
+    case '=':
+      numParticles = std::min(numParticles * 4, int(kMaxParticles));
+      resetParticles();
+      break;
+    case '-':
+      numParticles = std::max(numParticles / 4, 1000);
+      resetParticles();
+      break;
+    }
+    return true;
   }
 };
 
@@ -0,0 +1,109 @@
+// Benchmark for the particle update of particleSystem.cpp: the original array
+// of Particle structs against ParticleEmitter's per-component arrays, on one
+// thread and split across a ThreadPool, for 8000 to 4M particles.
+//
+// Every frame moves all particles and emits 1/200th of them with the
+// fountain/spray behavior, as the example does.
+//
+// Build and run with ./run.sh cookbook/simulation/particle_bench.cpp
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "ParticleEmitter.hpp"
+
+// The original layout, with the same behaviors
+struct Particle {
+  float pos[3], vel[3], acc[3];
+  int age = 0;
+};
+
+struct StructEmitter {
+  std::vector<Particle> particles;
+  size_t tap = 0;
+  ParticleRandom rnd;
+  Either<Fountain, Spray> behavior;
+
+  explicit StructEmitter(size_t n) : particles(n) {
+    for (auto &p : particles) {
+      p = Particle{};
+      p.age = int(n);
+    }
+  }
+
+  void update(int emit) {
+    for (auto &p : particles) {
+      for (int c = 0; c < 3; c++) {
+        p.vel[c] += p.acc[c];
+        p.pos[c] += p.vel[c];
+      }
+      p.age += emit;
+    }
+    for (int k = 0; k < emit; k++) {
+      ParticleSpawn s{{4, -2, 0}, {0, 0, 0}, {0, 0, 0}};
+      behavior(rnd, s);
+      Particle &p = particles[tap];
+      for (int c = 0; c < 3; c++) {
+        p.pos[c] = s.pos[c];
+        p.vel[c] = s.vel[c];
+        p.acc[c] = s.acc[c];
+      }
+      p.age = 0;
+      if (++tap >= particles.size()) {
+        tap = 0;
+      }
+    }
+  }
+};
+
+int main() {
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  printf("%d hardware threads. Million particles per second:\n", int(cores));
+  printf("%9s %12s %12s", "particles", "structs", "SoA SIMD");
+  std::vector<unsigned> threadCounts;
+  for (unsigned t = 2; t <= cores && t <= 16; t *= 2) {
+    threadCounts.push_back(t);
+    printf(" %10u thr", t);
+  }
+  printf("\n");
+
+  for (int n : {8000, 128000, 1 << 20, 1 << 22}) {
+    const int emit = std::max(n / 200, 1);
+    const double seconds = n > 200000 ? 0.5 : 0.2;
+
+    StructEmitter structs(n);
+    double structTime = bench::measure(
+        [&]() {
+          structs.update(emit);
+          bench::keep(structs.particles[0]);
+        },
+        seconds);
+
+    ParticleEmitter<Either<Fountain, Spray>> soa(n);
+    soa.origin(4, -2, 0);
+    double soaTime = bench::measure(
+        [&]() {
+          soa.update(emit);
+          bench::keep(soa.x()[0]);
+        },
+        seconds);
+
+    printf("%9d %12.1f %12.1f", n, n / structTime * 1e-6, n / soaTime * 1e-6);
+    for (unsigned t : threadCounts) {
+      ThreadPool pool(t);
+      double poolTime = bench::measure(
+          [&]() {
+            soa.update(emit, pool);
+            bench::keep(soa.x()[0]);
+          },
+          seconds);
+      printf(" %14.1f", n / poolTime * 1e-6);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,189 @@
+// Benchmark for the per-frame CPU cost of streaming 1M points to the GPU:
+// rebuilding a Mesh every frame (as flocking.cpp and particleSystem.cpp used
+// to) versus writing a PointBuffer in place.
+//
+// "rebuild" resets and refills position and color vectors laid out like
+// al::Mesh (3 float positions, 4 float colors), converting HSV per point, and
+// then copies them once more, as drawing a Mesh hands its arrays to
+// glBufferData. "in place" writes positions into the persistent arrays, which
+// PointMesh maps from the vertex buffers, so no further copy is made; colors
+// are RGBA8 and only written when they change. Driver and GPU time are not
+// included.
+//
+// Build and run with ./run.sh cookbook/simulation/point_stream_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+#include "common/PointBuffer.hpp"
+
+const int kPoints = 1 << 20;
+
+struct Vec3 {
+  float x, y, z;
+};
+struct Rgba {
+  float r, g, b, a;
+};
+
+// Stand-in for al::Mesh: vectors that are cleared and pushed back into
+struct RebuiltMesh {
+  std::vector<Vec3> vertices;
+  std::vector<Rgba> colors;
+  std::vector<char> uploaded; // what glBufferData copies out of the mesh
+
+  void reset() {
+    vertices.clear();
+    colors.clear();
+  }
+  void upload() {
+    size_t v = vertices.size() * sizeof(Vec3);
+    size_t c = colors.size() * sizeof(Rgba);
+    uploaded.resize(v + c);
+    std::memcpy(uploaded.data(), vertices.data(), v);
+    std::memcpy(uploaded.data() + v, colors.data(), c);
+  }
+};
+
+// al::HSV to al::RGB, in floats
+Rgba hsvColor(float h, float s, float v) {
+  uint32_t packed = point_color::hsv(h, s, v);
+  const unsigned char *b = reinterpret_cast<const unsigned char *>(&packed);
+  return {b[0] / 255.f, b[1] / 255.f, b[2] / 255.f, 1.f};
+}
+
+int main() {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> uni(0.f, 1.f);
+  std::vector<double> x(kPoints), y(kPoints), vx(kPoints), vy(kPoints);
+  std::vector<int> age(kPoints);
+  for (int i = 0; i < kPoints; i++) {
+    x[i] = uni(rng) * 2 - 1;
+    y[i] = uni(rng) * 2 - 1;
+    vx[i] = uni(rng) - 0.5;
+    vy[i] = uni(rng) - 0.5;
+    age[i] = int(uni(rng) * kPoints);
+  }
+
+  // Flocking: heads (1 vertex per boid) and tails (2 per boid)
+  RebuiltMesh heads, tails;
+  double flockRebuild = bench::measure([&]() {
+    heads.reset();
+    tails.reset();
+    for (int i = 0; i < kPoints; i++) {
+      Vec3 pos{float(x[i]), float(y[i]), 0};
+      double speed = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+      double len = speed > 0 ? 0.07 / speed : 0;
+      heads.vertices.push_back(pos);
+      float hue = float(i) / kPoints * 0.3f + 0.3f;
+      heads.colors.push_back(hsvColor(hue, 0.7f, 1));
+      tails.vertices.push_back(pos);
+      tails.vertices.push_back(
+          {float(x[i] - vx[i] * len), float(y[i] - vy[i] * len), 0});
+      tails.colors.push_back(heads.colors[i]);
+      tails.colors.push_back({0.5f, 0.5f, 0.5f, 1});
+    }
+    heads.upload();
+    tails.upload();
+    bench::keep(tails.uploaded[0]);
+  });
+
+  PointBuffer headBuf, tailBuf;
+  double flockInPlace = bench::measure([&]() {
+    headBuf.resize(kPoints);
+    tailBuf.resize(2 * kPoints);
+    float *headPos = headBuf.mapPositions();
+    float *tailPos = tailBuf.mapPositions();
+    for (int i = 0; i < kPoints; i++) {
+      float *head = headPos + 3 * i;
+      float *tail = tailPos + 6 * i;
+      head[0] = tail[0] = float(x[i]);
+      head[1] = tail[1] = float(y[i]);
+      head[2] = tail[2] = 0;
+      double speed = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+      double len = speed > 0 ? 0.07 / speed : 0;
+      tail[3] = float(x[i] - vx[i] * len);
+      tail[4] = float(y[i] - vy[i] * len);
+      tail[5] = 0;
+    }
+    headBuf.unmapPositions();
+    tailBuf.unmapPositions();
+    if (!headBuf.colorsValid() || !tailBuf.colorsValid()) {
+      uint32_t *headColor = headBuf.mapColors();
+      uint32_t *tailColor = tailBuf.mapColors();
+      for (int i = 0; i < kPoints; i++) {
+        float hue = float(i) / kPoints * 0.3f + 0.3f;
+        headColor[i] = point_color::hsv(hue, 0.7f, 1);
+        tailColor[2 * i] = headColor[i];
+        tailColor[2 * i + 1] = point_color::rgba(0.5f, 0.5f, 0.5f);
+      }
+      headBuf.unmapColors();
+      tailBuf.unmapColors();
+    }
+    bench::keep(tailPos[0]);
+  });
+
+  // Particles: colors change with age every frame
+  RebuiltMesh particles;
+  double particleRebuild = bench::measure([&]() {
+    particles.reset();
+    for (int i = 0; i < kPoints; i++) {
+      particles.vertices.push_back({float(x[i]), float(y[i]), 0});
+      float a = float(age[i]) / kPoints;
+      particles.colors.push_back(hsvColor(0.6f, uni(rng), (1 - a) * 0.4f));
+      age[i] = (age[i] + 40) % kPoints;
+    }
+    particles.upload();
+    bench::keep(particles.uploaded[0]);
+  });
+
+  const int kSteps = 40, kShades = 16, kAges = 8000 / kSteps + 1;
+  std::vector<uint32_t> palette(kAges * kShades);
+  for (int a = 0; a < kAges; a++) {
+    float fade = std::min(float(a) / (kAges - 1), 1.f);
+    for (int s = 0; s < kShades; s++) {
+      palette[a * kShades + s] =
+          point_color::hsv(0.6f, uni(rng), (1 - fade) * 0.4f);
+    }
+  }
+  PointBuffer particleBuf;
+  unsigned frame = 0;
+  double particleInPlace = bench::measure([&]() {
+    particleBuf.resize(kPoints);
+    float *pos = particleBuf.mapPositions();
+    uint32_t *color = particleBuf.mapColors();
+    frame++;
+    for (int i = 0; i < kPoints; i++) {
+      pos[3 * i] = float(x[i]);
+      pos[3 * i + 1] = float(y[i]);
+      pos[3 * i + 2] = 0;
+      int a = int(int64_t(age[i]) * (kAges - 1) / kPoints);
+      color[i] = palette[a * kShades + (i + frame) % kShades];
+      age[i] = (age[i] + 40) % kPoints;
+    }
+    particleBuf.unmapPositions();
+    particleBuf.unmapColors();
+    bench::keep(pos[0]);
+  });
+
+  printf("%d points, CPU time per frame\n", kPoints);
+  printf("%-34s %10s %10s %9s\n", "", "rebuild ms", "in place ms", "speedup");
+  printf("%-34s %10.2f %10.2f %8.1fx\n", "flock heads + tails, fixed colors",
+         flockRebuild * 1e3, flockInPlace * 1e3, flockRebuild / flockInPlace);
+  printf("%-34s %10.2f %10.2f %8.1fx\n", "particles, colors by age",
+         particleRebuild * 1e3, particleInPlace * 1e3,
+         particleRebuild / particleInPlace);
+  printf("bytes per frame: flock %.1f MB -> %.1f MB, particles %.1f MB -> "
+         "%.1f MB\n",
+         3.0 * kPoints * (sizeof(Vec3) + sizeof(Rgba)) / 1e6,
+         3.0 * kPoints * 3 * sizeof(float) / 1e6,
+         kPoints * (sizeof(Vec3) + sizeof(Rgba)) / 1e6,
+         kPoints * (3 * sizeof(float) + sizeof(uint32_t)) / 1e6);
+  return 0;
+}
@@ -17,33 +17,40 @@ The simulation adds random Gaussian-shaped drops to simulate water droplets
 falling into a pool. A minor artifact is increased rippling along the wavefronts
 in the x and y directions.
 
+The solver lives in WaveSolver.hpp: the two time steps are separate planes,
+rows are updated with SIMD in bands spread across all cores, and the surface
+normals are computed analytically from the new heights in the same pass
+instead of calling Mesh::generateNormals(). Press '=' and '-' to change the
+grid size, from 64x64 up to 2048x2048.
+
 See also: http://locklessinc.com/articles/wave_eqn/
 
 Author:
 Lance Putnam, Oct. 2014
 */
 
+#include <algorithm>
+
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
 #include "al/math/al_Random.hpp"
+
+#include "WaveSolver.hpp"
+
 using namespace al;
 
 struct MyApp : public App {
-  static const int Nx = 256, Ny = Nx;
-  float wave[Nx * Ny * 2];  // Values of wave for current and previous time step
-  int zcurr = 0;            // The current "plane" coordinate representing time
-  float decay = 0.96f;      // Decay factor of waves, in (0, 1]
-  float velocity = 0.5f;    // Velocity of wave propagation, in (0, 0.5]
+  static const int maxN = 2048;
+  int Nx = 256, Ny = Nx;  // Grid size, changed with '=' and '-'
+  WaveSolver wave;        // Current and previous time steps, and normals
+  ThreadPool pool;
 
   Mesh mesh;
   Light light;
   Material mtrl;
 
   void onCreate() {
-    for (auto& v : wave) v = 0;
-
-    // Add a tessellated plane
-    addSurface(mesh, Nx, Ny);
+    resetGrid();
 
     nav().pullBack(4);
 
@@ -52,64 +59,28 @@ struct MyApp : public App {
     mtrl.shininess(30);
   }
 
-  int indexAt(int x, int y, int z) {
-    // return (z*Nx + y)*Ny + x;
-    return (y * Nx + x) * 2 + z;  // may give slightly faster accessing
+  void resetGrid() {
+    wave.resize(Nx, Ny);
+
+    // Add a tessellated plane, with room for the normals the solver writes
+    mesh.reset();
+    addSurface(mesh, Nx, Ny);
+    mesh.normals().resize(mesh.vertices().size());
   }
 
   void onAnimate(double /*dt*/) {
-    int zprev = 1 - zcurr;
-
-    // Add some random droplets
+    // Add some random droplets, the same size in proportion to the grid
+    int radius = std::max(4 * Nx / 256, 1);
     for (int k = 0; k < 3; ++k) {
       if (rnd::prob(0.01)) {
-        // Add a Gaussian-shaped droplet
-        int ix = rnd::uniform(Nx - 8) + 4;
-        int iy = rnd::uniform(Ny - 8) + 4;
-        for (int j = -4; j <= 4; ++j) {
-          for (int i = -4; i <= 4; ++i) {
-            float x = float(i) / 4;
-            float y = float(j) / 4;
-            float v = 0.5 * exp(-(x * x + y * y) / (0.5 * 0.5));
-            wave[indexAt(ix + i, iy + j, zcurr)] += v;
-            wave[indexAt(ix + i, iy + j, zprev)] += v;
-          }
-        }
-      }
-    }
-
-    // Update wave equation
-    for (int j = 0; j < Ny; ++j) {
-      for (int i = 0; i < Nx; ++i) {
-        // Neighbor indices; wrap toroidally
-        int im1 = i != 0 ? i - 1 : Nx - 1;
-        int ip1 = i != Nx - 1 ? i + 1 : 0;
-        int jm1 = j != 0 ? j - 1 : Ny - 1;
-        int jp1 = j != Nx - 1 ? j + 1 : 0;
-
-        // Get neighborhood of samples
-        auto vp = wave[indexAt(i, j, zprev)];    // previous value
-        auto vc = wave[indexAt(i, j, zcurr)];    // current value
-        auto vl = wave[indexAt(im1, j, zcurr)];  // neighbor left
-        auto vr = wave[indexAt(ip1, j, zcurr)];  // neighbor right
-        auto vd = wave[indexAt(i, jm1, zcurr)];  // neighbor up
-        auto vu = wave[indexAt(i, jp1, zcurr)];  // neighbor down
-
-        // Compute next value of wave equation at (i,j)
-        auto val =
-            2 * vc - vp + velocity * ((vl - 2 * vc + vr) + (vd - 2 * vc + vu));
-
-        // Store in previous value since we don't need it again
-        wave[indexAt(i, j, zprev)] = val * decay;
-
-        int idx = j * Nx + i;
-        mesh.vertices()[idx].z = val;
+        int ix = rnd::uniform(Nx - 2 * radius) + radius;
+        int iy = rnd::uniform(Ny - 2 * radius) + radius;
+        wave.addDrop(ix, iy, 0.5f, radius);
       }
     }
 
-    mesh.generateNormals();
-
-    zcurr = zprev;
+    // Update wave equation, writing heights and normals into the mesh
+    wave.step(pool, &mesh.vertices()[0].x, &mesh.normals()[0].x);
   }
 
   void onDraw(Graphics& g) {
@@ -120,6 +91,20 @@ struct MyApp : public App {
     g.material(mtrl);
     g.draw(mesh);
   }
+
+  bool onKeyDown(const Keyboard& k) {
+    switch (k.key()) {
+      case '=':
+        Nx = Ny = std::min(Nx * 2, int(maxN));
+        resetGrid();
+        break;
+      case '-':
+        Nx = Ny = std::max(Nx / 2, 64);
+        resetGrid();
+        break;
+    }
+    return true;
+  }
 };
 
 int main() { MyApp().start(); }
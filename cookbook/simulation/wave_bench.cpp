@@ -0,0 +1,198 @@
+// Benchmark for the wave equation step of waveEquation.cpp, 256x256 up to
+// 2048x2048 cells.
+//
+// "original" is the old loop: interleaved time planes, wrap-around branches
+// per cell and the height stored into the mesh vertices, followed by a
+// stand-in for Mesh::generateNormals() (face normals of the surface's
+// triangles accumulated per vertex, then normalized). WaveSolver is timed on
+// one thread and across a ThreadPool, heights and normals included. The
+// solver's heights are also checked against the original loop, and its
+// normals against the face-averaged ones, which differ most where the
+// ripples are a few cells wide.
+//
+// Build and run with ./run.sh cookbook/simulation/wave_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "WaveSolver.hpp"
+
+struct Vec3 {
+  float x, y, z;
+};
+
+// The original app, minus drawing
+struct OriginalWave {
+  int nx, ny, zcurr = 0;
+  std::vector<float> wave;
+  std::vector<Vec3> vertices, normals;
+  std::vector<int> indices; // triangles of the surface
+
+  OriginalWave(int n) : nx(n), ny(n), wave(size_t(n) * n * 2, 0.0f) {
+    for (int j = 0; j < ny; j++) {
+      for (int i = 0; i < nx; i++) {
+        vertices.push_back(
+            {2.0f * i / (nx - 1) - 1.0f, 2.0f * j / (ny - 1) - 1.0f, 0.0f});
+      }
+    }
+    normals.resize(vertices.size());
+    for (int j = 0; j < ny - 1; j++) {
+      for (int i = 0; i < nx - 1; i++) {
+        int a = j * nx + i, b = a + 1, c = a + nx, d = c + 1;
+        indices.insert(indices.end(), {a, b, d, a, d, c});
+      }
+    }
+  }
+
+  int indexAt(int x, int y, int z) const { return (y * nx + x) * 2 + z; }
+
+  void addDrop(int ix, int iy) {
+    for (int j = -4; j <= 4; ++j) {
+      for (int i = -4; i <= 4; ++i) {
+        float x = float(i) / 4, y = float(j) / 4;
+        float v = 0.5f * std::exp(-(x * x + y * y) / (0.5f * 0.5f));
+        wave[indexAt(ix + i, iy + j, zcurr)] += v;
+        wave[indexAt(ix + i, iy + j, 1 - zcurr)] += v;
+      }
+    }
+  }
+
+  void step() {
+    const float velocity = 0.5f, decay = 0.96f;
+    int zprev = 1 - zcurr;
+    for (int j = 0; j < ny; ++j) {
+      for (int i = 0; i < nx; ++i) {
+        int im1 = i != 0 ? i - 1 : nx - 1;
+        int ip1 = i != nx - 1 ? i + 1 : 0;
+        int jm1 = j != 0 ? j - 1 : ny - 1;
+        int jp1 = j != nx - 1 ? j + 1 : 0;
+        float vp = wave[indexAt(i, j, zprev)];
+        float vc = wave[indexAt(i, j, zcurr)];
+        float vl = wave[indexAt(im1, j, zcurr)];
+        float vr = wave[indexAt(ip1, j, zcurr)];
+        float vd = wave[indexAt(i, jm1, zcurr)];
+        float vu = wave[indexAt(i, jp1, zcurr)];
+        float val =
+            2 * vc - vp + velocity * ((vl - 2 * vc + vr) + (vd - 2 * vc + vu));
+        wave[indexAt(i, j, zprev)] = val * decay;
+        vertices[j * nx + i].z = val;
+      }
+    }
+    zcurr = zprev;
+  }
+
+  void generateNormals() {
+    std::fill(normals.begin(), normals.end(), Vec3{0, 0, 0});
+    for (size_t t = 0; t < indices.size(); t += 3) {
+      const Vec3 &a = vertices[indices[t]], &b = vertices[indices[t + 1]],
+                 &c = vertices[indices[t + 2]];
+      Vec3 e1{b.x - a.x, b.y - a.y, b.z - a.z};
+      Vec3 e2{c.x - a.x, c.y - a.y, c.z - a.z};
+      Vec3 n{e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z,
+             e1.x * e2.y - e1.y * e2.x};
+      for (int k = 0; k < 3; k++) {
+        Vec3 &m = normals[indices[t + k]];
+        m.x += n.x;
+        m.y += n.y;
+        m.z += n.z;
+      }
+    }
+    for (auto &n : normals) {
+      float s = 1.0f / std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+      n.x *= s;
+      n.y *= s;
+      n.z *= s;
+    }
+  }
+};
+
+int main() {
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  // Same drops into both, then compare heights and normals after a while
+  {
+    const int n = 256;
+    OriginalWave original(n);
+    WaveSolver solver;
+    solver.resize(n, n);
+    ThreadPool pool(std::min(cores, 4u));
+    std::vector<float> normals(size_t(n) * n * 3);
+    for (int s = 0; s < 200; s++) {
+      if (s % 50 == 0) {
+        int ix = 20 + s % 200, iy = 30 + s / 2;
+        original.addDrop(ix, iy);
+        solver.addDrop(ix, iy);
+      }
+      original.step();
+      solver.step(pool, nullptr, normals.data());
+    }
+    original.generateNormals();
+    float heightError = 0, normalError = 0;
+    double normalSum = 0;
+    for (int k = 0; k < n * n; k++) {
+      heightError = std::max(
+          heightError, std::abs(original.vertices[k].z - solver.heights()[k]));
+      const Vec3 &m = original.normals[k];
+      const float *v = &normals[k * 3];
+      float dot = m.x * v[0] + m.y * v[1] + m.z * v[2];
+      float angle = std::acos(std::min(dot, 1.0f));
+      normalError = std::max(normalError, angle);
+      normalSum += angle;
+    }
+    printf("after 200 steps at %dx%d: max height difference %g, normal angle "
+           "to generateNormals() mean %.3f max %.2f degrees\n\n",
+           n, n, heightError, normalSum / (n * n) * 180 / 3.14159265,
+           normalError * 180 / 3.14159265f);
+  }
+
+  printf("%d hardware threads. Million cells per second (step + normals):\n",
+         int(cores));
+  printf("%6s %10s %12s %10s", "grid", "original", "orig+normals",
+         "solver");
+  std::vector<unsigned> threadCounts;
+  for (unsigned t = 2; t <= cores && t <= 16; t *= 2) {
+    threadCounts.push_back(t);
+    printf(" %6u thr", t);
+  }
+  printf("\n");
+
+  for (int n : {256, 512, 1024, 2048}) {
+    const double cells = double(n) * n;
+    const double seconds = n >= 1024 ? 0.5 : 0.2;
+    OriginalWave original(n);
+    original.addDrop(n / 2, n / 2);
+    double stepOnly = bench::measure([&]() { original.step(); }, seconds);
+    double withNormals = bench::measure(
+        [&]() {
+          original.step();
+          original.generateNormals();
+        },
+        seconds);
+
+    WaveSolver solver;
+    solver.resize(n, n);
+    solver.addDrop(n / 2, n / 2);
+    std::vector<float> positions(size_t(n) * n * 3), normals(positions.size());
+    printf("%6d %10.1f %12.1f", n, cells / stepOnly * 1e-6,
+           cells / withNormals * 1e-6);
+    ThreadPool single(1);
+    double one = bench::measure(
+        [&]() { solver.step(single, positions.data(), normals.data()); },
+        seconds);
+    printf(" %10.1f", cells / one * 1e-6);
+    for (unsigned t : threadCounts) {
+      ThreadPool pool(t);
+      double time = bench::measure(
+          [&]() { solver.step(pool, positions.data(), normals.data()); },
+          seconds);
+      printf(" %10.1f", cells / time * 1e-6);
+    }
+    printf("\n");
+  }
+  return 0;
+}
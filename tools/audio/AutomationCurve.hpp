@@ -0,0 +1,195 @@
+#pragma once
+#ifndef AUTOMATION_CURVE_HPP
+#define AUTOMATION_CURVE_HPP
+
+// Position automation compiled from preset sequence files.
+//
+// A sequence file (see readme_spatial_sequencer.md) lists pose changes:
+//
+//   +<delta time>:/_pose:x,y,z[,qw,qx,qy,qz]:<morph time>
+//
+// AutomationCurve turns it into a piecewise linear curve with the same
+// timing as PresetSequencer + PresetHandler: each line starts a linear morph
+// from the current position, and a line that arrives before the previous
+// morph finished interrupts it where it is. Breakpoints are stored as sorted
+// arrays, so the curve can be evaluated at any time without replaying the
+// sequence. The first line sets the starting position (most files start with
+// a zero length morph). Orientation values are ignored.
+//
+// AutomationLibrary parses each file once and hands out shared, immutable
+// curves.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class AutomationCurve {
+public:
+  // Parses sequence text. Lines that don't set a pose are skipped.
+  void parse(std::istream &in) {
+    mTime.clear();
+    mX.clear();
+    mY.clear();
+    mZ.clear();
+    double eventTime = 0.0;
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.size() < 2 || line[0] != '+') {
+        continue;
+      }
+      // +delta:address:values:morph
+      size_t c1 = line.find(':');
+      size_t c2 = line.find(':', c1 + 1);
+      size_t c3 = line.find(':', c2 + 1);
+      if (c1 == std::string::npos || c2 == std::string::npos ||
+          c3 == std::string::npos) {
+        continue;
+      }
+      const char *text = line.c_str();
+      double delta = std::strtod(text + 1, nullptr);
+      double morph = std::strtod(text + c3 + 1, nullptr);
+      eventTime += delta;
+      if (c2 - c1 - 1 < 5 || line.compare(c2 - 5, 5, "_pose") != 0) {
+        continue;
+      }
+      float p[3] = {0, 0, 0};
+      const char *value = text + c2 + 1;
+      for (int i = 0; i < 3 && value < text + c3; i++) {
+        char *end;
+        p[i] = std::strtof(value, &end);
+        value = end + 1; // skip the comma
+      }
+      addEvent(eventTime, p, morph);
+    }
+  }
+
+  bool load(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.good()) {
+      return false;
+    }
+    parse(file);
+    return true;
+  }
+
+  size_t size() const { return mTime.size(); }
+  bool empty() const { return mTime.empty(); }
+  double duration() const { return mTime.empty() ? 0.0 : mTime.back(); }
+
+  // Breakpoints, sorted by time. Equal times mark a jump.
+  const double *times() const { return mTime.data(); }
+  const float *x() const { return mX.data(); }
+  const float *y() const { return mY.data(); }
+  const float *z() const { return mZ.data(); }
+
+  // Index of the last breakpoint at or before t, or 0 before the start.
+  // Starting from a previous result makes sequential evaluation O(1).
+  size_t seek(double t, size_t hint = 0) const {
+    const size_t n = mTime.size();
+    if (hint >= n || mTime[hint] > t) {
+      hint = 0;
+    }
+    // A few linear steps cover playback; fall back to bisection for jumps
+    for (int step = 0; step < 4; step++) {
+      if (hint + 1 >= n || mTime[hint + 1] > t) {
+        return hint;
+      }
+      hint++;
+    }
+    auto it = std::upper_bound(mTime.begin() + hint, mTime.end(), t);
+    return size_t(it - mTime.begin()) - 1;
+  }
+
+  // Position at time t given the index returned by seek()
+  void evaluate(double t, size_t index, float *out) const {
+    if (mTime.empty()) {
+      out[0] = out[1] = out[2] = 0.0f;
+      return;
+    }
+    if (index + 1 >= mTime.size() || t <= mTime[index]) {
+      out[0] = mX[index];
+      out[1] = mY[index];
+      out[2] = mZ[index];
+      return;
+    }
+    float a = float((t - mTime[index]) / (mTime[index + 1] - mTime[index]));
+    out[0] = mX[index] + a * (mX[index + 1] - mX[index]);
+    out[1] = mY[index] + a * (mY[index + 1] - mY[index]);
+    out[2] = mZ[index] + a * (mZ[index + 1] - mZ[index]);
+  }
+
+  void evaluate(double t, float *out) const { evaluate(t, seek(t), out); }
+
+private:
+  void addEvent(double t, const float *p, double morph) {
+    if (mTime.empty()) {
+      push(t, p);
+      return;
+    }
+    size_t last = mTime.size() - 1;
+    if (mTime[last] > t) {
+      // Morph still running: cut it at its current value
+      float current[3];
+      evaluate(t, last - 1, current);
+      mTime[last] = t;
+      mX[last] = current[0];
+      mY[last] = current[1];
+      mZ[last] = current[2];
+    } else if (mTime[last] < t) {
+      // Hold the current value until this event
+      float current[3] = {mX[last], mY[last], mZ[last]};
+      push(t, current);
+    }
+    push(t + std::max(0.0, morph), p);
+  }
+
+  void push(double t, const float *p) {
+    mTime.push_back(t);
+    mX.push_back(p[0]);
+    mY.push_back(p[1]);
+    mZ.push_back(p[2]);
+  }
+
+  std::vector<double> mTime;
+  std::vector<float> mX, mY, mZ;
+};
+
+class AutomationLibrary {
+public:
+  // Returns the curve for path, parsing the file the first time it is
+  // requested. Returns null if the file can't be read. Thread safe; don't
+  // call from the audio thread.
+  std::shared_ptr<const AutomationCurve> get(const std::string &path) {
+    std::lock_guard<std::mutex> lk(mMutex);
+    auto found = mCurves.find(path);
+    if (found != mCurves.end()) {
+      return found->second;
+    }
+    auto curve = std::make_shared<AutomationCurve>();
+    if (!curve->load(path)) {
+      std::cerr << "ERROR: reading automation file: " << path << std::endl;
+      curve.reset();
+    }
+    mCurves[path] = curve;
+    return curve;
+  }
+
+  // Forgets all curves, e.g. after the files changed on disk. Curves in use
+  // stay alive until released.
+  void clear() {
+    std::lock_guard<std::mutex> lk(mMutex);
+    mCurves.clear();
+  }
+
+private:
+  std::mutex mMutex;
+  std::map<std::string, std::shared_ptr<const AutomationCurve>> mCurves;
+};
+
+#endif // AUTOMATION_CURVE_HPP
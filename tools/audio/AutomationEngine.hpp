@@ -0,0 +1,236 @@
+#pragma once
+#ifndef AUTOMATION_ENGINE_HPP
+#define AUTOMATION_ENGINE_HPP
+
+// Plays AutomationCurves for many objects at once.
+//
+// The control side attaches a curve to an owner (usually a voice) with
+// start() and detaches it with stop(). Once per audio block the audio thread
+// calls process(), which advances every track by the block duration and
+// evaluates all positions in one pass into flat arrays; the spatializer reads
+// them with find() and position(). Each track remembers where it is in its
+// curve, so evaluation costs the same whatever the curve length.
+//
+// The audio thread shares no track state with the control side: start() and
+// stop() send their changes to it through an SpscQueue, and process()
+// applies them before evaluating. The audio thread counts the changes it
+// applied, and a curve that was stopped or replaced is only freed, on the
+// control side, once that count shows the audio thread has let go of it.
+//
+// The control side may be called from several threads (a sequencer starts
+// voices, the update thread stops them): start(), stop() and
+// currentPosition() take a mutex, which the audio thread never touches.
+//
+// Positions are evaluated at the end of the block, which is where the panner
+// ramps its gains to.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "common/SpscQueue.hpp"
+
+#include "AutomationCurve.hpp"
+
+class AutomationEngine {
+public:
+  static constexpr int kMaxTracks = 128;
+
+  // Control side. Starts playing curve from time 0 for owner and returns
+  // the track index, or -1 if all tracks are taken. The curve is kept alive
+  // until the audio thread has let go of it.
+  int start(const void *owner, std::shared_ptr<const AutomationCurve> curve) {
+    if (!curve || curve->empty()) {
+      return -1;
+    }
+    std::lock_guard<std::mutex> lock(mControl);
+    stopTrack(controlTrack(owner));
+    for (int i = 0; i < kMaxTracks; i++) {
+      // Round robin, so a track that was just stopped is reused last
+      int track = (mNextTrack + i) % kMaxTracks;
+      if (mOwners[track] == nullptr) {
+        mOwners[track] = owner;
+        mStarted[track] = send({track, curve.get(), owner}, nullptr);
+        mHolds[track] = std::move(curve);
+        mNextTrack = (track + 1) % kMaxTracks;
+        return track;
+      }
+    }
+    return -1;
+  }
+
+  void stop(const void *owner) {
+    std::lock_guard<std::mutex> lock(mControl);
+    stopTrack(controlTrack(owner));
+  }
+
+  // Control side: position after the last processed block, or false if
+  // owner has no automation.
+  bool currentPosition(const void *owner, float *out) {
+    std::lock_guard<std::mutex> lock(mControl);
+    flush();
+    release();
+    int track = controlTrack(owner);
+    if (track < 0) {
+      return false;
+    }
+    // Until the audio thread has started the track it is still at time 0
+    const bool started =
+        mApplied.load(std::memory_order_acquire) >= mStarted[track];
+    mHolds[track]->evaluate(
+        started ? mTime[track].load(std::memory_order_relaxed) : 0.0, out);
+    return true;
+  }
+
+  // Audio thread: takes the control thread's changes, then advances all
+  // tracks by seconds and evaluates them
+  void process(double seconds) {
+    receive();
+    for (int track = 0; track < mNumTracks; track++) {
+      const AutomationCurve *curve = mCurves[track];
+      if (!curve) {
+        continue;
+      }
+      double t = mTime[track].load(std::memory_order_relaxed) + seconds;
+      mTime[track].store(t, std::memory_order_relaxed);
+      size_t cursor = curve->seek(t, mCursor[track]);
+      mCursor[track] = cursor;
+      float p[3];
+      curve->evaluate(t, cursor, p);
+      mX[track] = p[0];
+      mY[track] = p[1];
+      mZ[track] = p[2];
+    }
+  }
+
+  // Audio thread: track playing for owner as of the last process(), or -1
+  int find(const void *owner) const {
+    if (!owner) {
+      return -1;
+    }
+    for (int track = 0; track < mNumTracks; track++) {
+      if (mPlaying[track] == owner) {
+        return track;
+      }
+    }
+    return -1;
+  }
+
+  // Audio thread, after process()
+  void position(int track, float *out) const {
+    out[0] = mX[track];
+    out[1] = mY[track];
+    out[2] = mZ[track];
+  }
+
+private:
+  // A track (re)started with curve, or stopped when curve is null
+  struct Command {
+    int track;
+    const AutomationCurve *curve;
+    const void *owner;
+  };
+
+  // Control side
+  void stopTrack(int track) {
+    if (track >= 0) {
+      send({track, nullptr, nullptr}, mHolds[track]);
+      mHolds[track].reset();
+      mOwners[track] = nullptr;
+    }
+  }
+
+  // Control side: queues command and keeps old, the curve it replaces,
+  // alive until the audio thread has applied it. Returns the command's
+  // number, which mApplied reaches once it is applied.
+  uint64_t send(const Command &command,
+                std::shared_ptr<const AutomationCurve> old) {
+    release();
+    mWaiting.push_back(command);
+    const uint64_t number = ++mIssued;
+    if (old) {
+      mRetired.emplace_back(number, std::move(old));
+    }
+    flush();
+    return number;
+  }
+
+  // Control side: moves waiting commands into the queue as it has room
+  void flush() {
+    size_t pushed = 0;
+    while (pushed < mWaiting.size() && mCommands.push(mWaiting[pushed])) {
+      pushed++;
+    }
+    mWaiting.erase(mWaiting.begin(), mWaiting.begin() + pushed);
+  }
+
+  // Control side: frees the curves the audio thread no longer uses
+  void release() {
+    const uint64_t applied = mApplied.load(std::memory_order_acquire);
+    size_t done = 0;
+    while (done < mRetired.size() && mRetired[done].first <= applied) {
+      done++;
+    }
+    mRetired.erase(mRetired.begin(), mRetired.begin() + done);
+  }
+
+  // Audio thread
+  void receive() {
+    Command command;
+    uint64_t applied = mApplied.load(std::memory_order_relaxed);
+    while (mCommands.pop(command)) {
+      const int track = command.track;
+      mCurves[track] = command.curve;
+      mPlaying[track] = command.owner;
+      mTime[track].store(0.0, std::memory_order_relaxed);
+      mCursor[track] = 0;
+      mNumTracks = std::max(mNumTracks, track + 1);
+      applied++;
+    }
+    mApplied.store(applied, std::memory_order_release);
+  }
+
+  // Control side
+  int controlTrack(const void *owner) const {
+    if (!owner) {
+      return -1;
+    }
+    for (int track = 0; track < kMaxTracks; track++) {
+      if (mOwners[track] == owner) {
+        return track;
+      }
+    }
+    return -1;
+  }
+
+  // Control thread to audio thread
+  SpscQueue<Command, 2 * kMaxTracks> mCommands;
+  std::atomic<uint64_t> mApplied{0}; // commands the audio thread applied
+  std::atomic<double> mTime[kMaxTracks] = {};
+
+  // Control side. The private control side functions run with mControl held.
+  std::mutex mControl;
+  const void *mOwners[kMaxTracks] = {};
+  std::shared_ptr<const AutomationCurve> mHolds[kMaxTracks];
+  uint64_t mStarted[kMaxTracks] = {}; // command that started each track
+  std::vector<Command> mWaiting;      // for room in mCommands
+  std::vector<std::pair<uint64_t, std::shared_ptr<const AutomationCurve>>>
+      mRetired; // curves to free once mApplied reaches the number
+  uint64_t mIssued{0};
+  int mNextTrack{0};
+
+  // Audio thread
+  const AutomationCurve *mCurves[kMaxTracks] = {};
+  const void *mPlaying[kMaxTracks] = {};
+  int mNumTracks{0};
+  size_t mCursor[kMaxTracks] = {0};
+  float mX[kMaxTracks] = {0};
+  float mY[kMaxTracks] = {0};
+  float mZ[kMaxTracks] = {0};
+};
+
+#endif // AUTOMATION_ENGINE_HPP
@@ -0,0 +1,168 @@
+#pragma once
+#ifndef BLOCK_LBAP_HPP
+#define BLOCK_LBAP_HPP
+
+// al::Spatializer that pans with LbapPanner: gains are computed once per
+// block per source, interpolated across the block and applied with SIMD
+// kernels to the speaker channels the source actually reaches.
+//
+// Use it wherever al::Lbap is used, and tell it which scene it renders:
+//   auto lbap = scene.setSpatializer<BlockLbap>(speakerLayout);
+//   lbap->follow(&scene);
+//
+// al::Spatializer::renderBuffer() does not say which source is being
+// rendered, so prepare() matches the scene's active voices to panner slots
+// by identity, and renderBuffer() takes them in the order the scene renders
+// them (DynamicScene walks its active voice list in order). Each voice keeps
+// its slot, and so its cached gains, for as long as it is active. Without
+// follow() the sources can't be told apart and take slots in render order:
+// a source that keeps its place and position keeps its gains, and when the
+// sources change order a slot ramps from its last source's gains over one
+// block.
+
+#include <algorithm>
+#include <vector>
+
+#include "al/scene/al_PolySynth.hpp"
+#include "al/sound/al_Spatializer.hpp"
+#include "al/sound/al_Speaker.hpp"
+
+#include "LbapPanner.hpp"
+
+class BlockLbap : public al::Spatializer {
+public:
+  // Most voices panned in one block; voices beyond this are not rendered
+  static constexpr int kMaxSources = LbapPanner::kDefaultMaxSources;
+
+  BlockLbap(const al::Speakers &sl) : al::Spatializer(sl) {}
+
+  // al::DynamicScene gives directions in graphics axes (y up, -z ahead),
+  // LbapPanner takes them in al::Speaker::vec() axes (z up, y ahead)
+  static al::Vec3f layoutDirection(const al::Vec3f &reldir) {
+    return al::Vec3f(reldir.x, -reldir.z, reldir.y);
+  }
+
+  void compile() override {
+    std::vector<PanSpeaker> speakers;
+    for (const auto &spkr : mSpeakers) {
+      speakers.push_back({spkr.azimuth, spkr.elevation, spkr.deviceChannel});
+    }
+    mPanner.setLayout(speakers, kMaxSources);
+    mOuts.resize(speakers.size(), nullptr);
+    mFrameGains.resize(speakers.size(), 0.0f);
+    mSlotVoices.assign(kMaxSources, nullptr);
+    mSlotSeen.assign(kMaxSources, false);
+    mOrder.reserve(kMaxSources);
+  }
+
+  // Scene whose voices renderBuffer() is called for
+  void follow(al::PolySynth *scene) { mScene = scene; }
+
+  void prepare(al::AudioIOData &io) override {
+    mNextSource = 0;
+    if (mScene) {
+      assignSlots(mScene->getActiveVoices());
+    }
+    const auto &speakers = mPanner.speakers();
+    for (size_t k = 0; k < speakers.size(); k++) {
+      int channel = speakers[k].deviceChannel;
+      mOuts[k] = channel < int(io.channelsOut()) ? io.outBuffer(channel)
+                                                 : nullptr;
+    }
+  }
+
+  // Gives the active voices of a voice list panner slots, in list order: a
+  // voice that had a slot last time keeps it, a new voice gets a free slot
+  // with its cached gains forgotten. Voices past kMaxSources get -1.
+  void assignSlots(al::SynthVoice *voices) {
+    mOrder.clear();
+    std::fill(mSlotSeen.begin(), mSlotSeen.end(), false);
+    for (auto *voice = voices; voice; voice = voice->next) {
+      if (!voice->active()) {
+        continue;
+      }
+      if (int(mOrder.size()) == kMaxSources) {
+        break;
+      }
+      int slot = -1;
+      for (int s = 0; s < kMaxSources; s++) {
+        if (mSlotVoices[s] == voice) {
+          slot = s;
+          mSlotSeen[s] = true;
+          break;
+        }
+      }
+      mOrder.push_back(slot);
+    }
+
+    // Voices that went away free their slots for new ones
+    size_t index = 0;
+    for (auto *voice = voices; voice && index < mOrder.size();
+         voice = voice->next) {
+      if (!voice->active()) {
+        continue;
+      }
+      if (mOrder[index] < 0) {
+        for (int s = 0; s < kMaxSources; s++) {
+          if (!mSlotSeen[s]) {
+            mSlotVoices[s] = voice;
+            mSlotSeen[s] = true;
+            mPanner.resetSource(s);
+            mOrder[index] = s;
+            break;
+          }
+        }
+      }
+      index++;
+    }
+  }
+
+  // Panner slot of the index-th active voice of the last assignSlots(), -1
+  // for none
+  int slot(size_t index) const {
+    return index < mOrder.size() ? mOrder[index] : -1;
+  }
+
+  void renderBuffer(al::AudioIOData &io, const al::Vec3f &reldir,
+                    const float *samples,
+                    const unsigned int &numFrames) override {
+    const int source = mNextSource++;
+    const int slot = mScene ? this->slot(source) : source;
+    if (slot < 0 || slot >= kMaxSources) {
+      return;
+    }
+    const al::Vec3f direction = layoutDirection(reldir);
+    mPanner.renderSource(slot, direction.x, direction.y, direction.z,
+                         samples, mOuts.data(), numFrames);
+  }
+
+  // Per sample rendering has no block to amortize the gain computation over,
+  // so gains are computed on every call. Prefer renderBuffer().
+  void renderSample(al::AudioIOData &io, const al::Vec3f &reldir,
+                    const float &sample,
+                    const unsigned int &frameIndex) override {
+    const al::Vec3f direction = layoutDirection(reldir);
+    mPanner.computeGains(direction.x, direction.y, direction.z,
+                         mFrameGains.data());
+    for (size_t k = 0; k < mFrameGains.size(); k++) {
+      if (mFrameGains[k] != 0.0f && mOuts[k]) {
+        mOuts[k][frameIndex] += sample * mFrameGains[k];
+      }
+    }
+  }
+
+  LbapPanner &panner() { return mPanner; }
+
+private:
+  LbapPanner mPanner;
+  std::vector<float *> mOuts; // speaker output buffers for the current block
+  std::vector<float> mFrameGains;
+
+  al::PolySynth *mScene{nullptr};
+  std::vector<const al::SynthVoice *> mSlotVoices; // voice holding each slot
+  std::vector<bool> mSlotSeen;
+  std::vector<int> mOrder; // slot of each active voice, in list order
+  int mNextSource{0};      // active voice renderBuffer() is called for next
+};
+
+#endif // BLOCK_LBAP_HPP
@@ -0,0 +1,334 @@
+#pragma once
+#ifndef LBAP_PANNER_HPP
+#define LBAP_PANNER_HPP
+
+// Layer based amplitude panning computed per block.
+//
+// Speakers are grouped into horizontal rings by elevation. A source is panned
+// with 2D VBAP inside the two rings that enclose its elevation and the two
+// ring results are crossfaded with a constant power law, so at most four
+// speakers sound at once (above the top ring, or below the bottom ring, the
+// source spreads evenly over that ring as it approaches the pole).
+//
+// Unlike al::Lbap, gains are computed once per block for each source and
+// interpolated linearly across the block, and a source whose direction did not
+// change since the previous block reuses its gains without recomputing them.
+// Sources are identified by a slot number chosen by the caller. Once enough
+// slots are reserved, renderSource() may be called concurrently for different
+// slots as long as each call writes to its own output buffers.
+//
+// This header only depends on the standard library so the panning can be
+// benchmarked and reused outside an al::Spatializer (see BlockLbap.hpp).
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+
+struct PanSpeaker {
+  float azimuth;   // degrees, as in al::Speaker
+  float elevation; // degrees, as in al::Speaker
+  int deviceChannel;
+};
+
+class LbapPanner {
+public:
+  // Sources are expected to be numbered below this; more slots are allocated
+  // on demand, which is not real-time safe.
+  static constexpr int kDefaultMaxSources = 128;
+
+  void setLayout(const std::vector<PanSpeaker> &speakers,
+                 int maxSources = kDefaultMaxSources) {
+    mSpeakers = speakers;
+    mRings.clear();
+
+    std::vector<int> order(speakers.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = int(i);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return speakers[a].elevation < speakers[b].elevation;
+    });
+    // Speakers within ringTolerance degrees of the first speaker of a ring
+    // belong to that ring
+    const float ringTolerance = 10.0f;
+    for (int index : order) {
+      if (mRings.empty() || speakers[index].elevation -
+                                    speakers[mRings.back().speakers[0]]
+                                        .elevation >
+                                ringTolerance) {
+        mRings.emplace_back();
+      }
+      mRings.back().speakers.push_back(index);
+    }
+    for (auto &ring : mRings) {
+      compileRing(ring);
+    }
+
+    mSlots.clear();
+    reserveSources(maxSources);
+  }
+
+  int numSpeakers() const { return int(mSpeakers.size()); }
+  const std::vector<PanSpeaker> &speakers() const { return mSpeakers; }
+  int numRings() const { return int(mRings.size()); }
+
+  void reserveSources(int count) {
+    if (int(mSlots.size()) < count) {
+      mSlots.resize(count);
+      for (auto &slot : mSlots) {
+        slot.current.resize(mSpeakers.size(), 0.0f);
+        slot.target.resize(mSpeakers.size(), 0.0f);
+        slot.active.reserve(mSpeakers.size());
+      }
+    }
+  }
+
+  // Forget cached gains so the next block of every slot starts without a
+  // ramp (e.g. after the audio device restarts).
+  void resetSources() {
+    for (auto &slot : mSlots) {
+      slot.valid = false;
+    }
+  }
+
+  // Forget the cached gains of one slot, e.g. when it is given to a new
+  // source.
+  void resetSource(int slotIndex) {
+    if (slotIndex < int(mSlots.size())) {
+      mSlots[slotIndex].valid = false;
+    }
+  }
+
+  // Dense gains for direction (x, y, z), indexed like the speaker layout.
+  // Uses the same axes as al::Speaker::vec() (z up).
+  void computeGains(float x, float y, float z, float *gains) const {
+    std::fill(gains, gains + mSpeakers.size(), 0.0f);
+    if (mRings.empty()) {
+      return;
+    }
+    float horizontal = std::sqrt(x * x + y * y);
+    float azimuth = std::atan2(x, y);
+    float elevation = toDegrees(std::atan2(z, horizontal));
+
+    const Ring &bottom = mRings.front();
+    const Ring &top = mRings.back();
+    if (elevation >= top.elevation) {
+      float frac = top.elevation < 90.0f
+                       ? (elevation - top.elevation) / (90.0f - top.elevation)
+                       : 0.0f;
+      addRingGains(top, azimuth, std::cos(frac * kHalfPi), gains);
+      addSpreadGains(top, std::sin(frac * kHalfPi), gains);
+      return;
+    }
+    if (elevation <= bottom.elevation) {
+      float frac =
+          bottom.elevation > -90.0f
+              ? (bottom.elevation - elevation) / (bottom.elevation + 90.0f)
+              : 0.0f;
+      addRingGains(bottom, azimuth, std::cos(frac * kHalfPi), gains);
+      addSpreadGains(bottom, std::sin(frac * kHalfPi), gains);
+      return;
+    }
+    size_t upper = 1;
+    while (mRings[upper].elevation < elevation) {
+      upper++;
+    }
+    const Ring &below = mRings[upper - 1];
+    const Ring &above = mRings[upper];
+    float frac =
+        (elevation - below.elevation) / (above.elevation - below.elevation);
+    addRingGains(below, azimuth, std::cos(frac * kHalfPi), gains);
+    addRingGains(above, azimuth, std::sin(frac * kHalfPi), gains);
+  }
+
+  // Mixes numFrames samples of a source into speakerOuts, which is indexed
+  // like the speaker layout (null entries are skipped). Gains ramp from the
+  // slot's previous block to the gains for the new direction.
+  void renderSource(int slotIndex, float x, float y, float z,
+                    const float *samples, float *const *speakerOuts,
+                    size_t numFrames) {
+    if (slotIndex >= int(mSlots.size())) {
+      reserveSources(slotIndex + 1);
+    }
+    SourceSlot &slot = mSlots[slotIndex];
+    const float moved = (x - slot.x) * (x - slot.x) +
+                        (y - slot.y) * (y - slot.y) +
+                        (z - slot.z) * (z - slot.z);
+
+    if (slot.valid && moved < kStillThreshold) {
+      // Source did not move: constant gains, no recomputation
+      for (int k : slot.active) {
+        if (speakerOuts[k]) {
+          simd::addScaled(speakerOuts[k], samples, slot.current[k], numFrames);
+        }
+      }
+      return;
+    }
+
+    computeGains(x, y, z, slot.target.data());
+    slot.x = x;
+    slot.y = y;
+    slot.z = z;
+    if (!slot.valid) {
+      slot.current = slot.target;
+      slot.valid = true;
+    }
+
+    // Ramp over every speaker that sounds at either end of the block
+    const float invFrames = 1.0f / numFrames;
+    slot.active.clear();
+    for (size_t k = 0; k < mSpeakers.size(); k++) {
+      float from = slot.current[k];
+      float to = slot.target[k];
+      if (from == 0.0f && to == 0.0f) {
+        continue;
+      }
+      if (speakerOuts[k]) {
+        if (from == to) {
+          simd::addScaled(speakerOuts[k], samples, to, numFrames);
+        } else {
+          simd::addRamp(speakerOuts[k], samples, from, (to - from) * invFrames,
+                        numFrames);
+        }
+      }
+      slot.current[k] = to;
+      if (to != 0.0f) {
+        slot.active.push_back(int(k));
+      }
+    }
+  }
+
+private:
+  static constexpr float kHalfPi = 1.57079632679f;
+  // Squared distance below which a source is considered not to have moved
+  static constexpr float kStillThreshold = 1e-10f;
+
+  struct PairMatrix {
+    // Inverse of the 2x2 matrix made from the two speaker unit vectors
+    float m00, m01, m10, m11;
+    bool valid;
+  };
+
+  struct Ring {
+    std::vector<int> speakers;     // layout indices sorted by azimuth
+    std::vector<float> azimuths;   // radians, ascending
+    std::vector<PairMatrix> pairs; // pair i is speakers i and i + 1 (wrapped)
+    float elevation = 0;           // mean elevation in degrees
+  };
+
+  struct SourceSlot {
+    std::vector<float> current; // gains at the end of the previous block
+    std::vector<float> target;  // gains for the last known direction
+    std::vector<int> active;    // speakers with non-zero current gain
+    float x = 0, y = 0, z = 0;
+    bool valid = false;
+  };
+
+  static float toDegrees(float radians) {
+    return radians * 57.2957795131f;
+  }
+  static float toRadians(float degrees) {
+    return degrees * 0.0174532925199f;
+  }
+
+  void compileRing(Ring &ring) {
+    std::sort(ring.speakers.begin(), ring.speakers.end(), [&](int a, int b) {
+      return wrapAzimuth(toRadians(mSpeakers[a].azimuth)) <
+             wrapAzimuth(toRadians(mSpeakers[b].azimuth));
+    });
+    ring.elevation = 0;
+    for (int index : ring.speakers) {
+      ring.azimuths.push_back(wrapAzimuth(toRadians(mSpeakers[index].azimuth)));
+      ring.elevation += mSpeakers[index].elevation;
+    }
+    ring.elevation /= ring.speakers.size();
+
+    size_t count = ring.speakers.size();
+    for (size_t i = 0; i < count; i++) {
+      float a1 = ring.azimuths[i];
+      float a2 = ring.azimuths[(i + 1) % count];
+      // Unit vectors in the (x, y) plane of al::Speaker::vec()
+      float x1 = std::sin(a1), y1 = std::cos(a1);
+      float x2 = std::sin(a2), y2 = std::cos(a2);
+      float det = x1 * y2 - x2 * y1;
+      PairMatrix m;
+      m.valid = std::fabs(det) > 1e-4f;
+      if (m.valid) {
+        m.m00 = y2 / det;
+        m.m01 = -x2 / det;
+        m.m10 = -y1 / det;
+        m.m11 = x1 / det;
+      } else {
+        m.m00 = m.m01 = m.m10 = m.m11 = 0;
+      }
+      ring.pairs.push_back(m);
+    }
+  }
+
+  // Maps radians to [-pi, pi)
+  static float wrapAzimuth(float a) {
+    const float twoPi = 6.28318530718f;
+    a = std::fmod(a + 3.14159265359f, twoPi);
+    if (a < 0) {
+      a += twoPi;
+    }
+    return a - 3.14159265359f;
+  }
+
+  void addRingGains(const Ring &ring, float azimuth, float weight,
+                    float *gains) const {
+    if (weight <= 0.0f) {
+      return;
+    }
+    size_t count = ring.speakers.size();
+    if (count == 1) {
+      gains[ring.speakers[0]] += weight;
+      return;
+    }
+    // Find the pair whose arc contains the azimuth. The pair that wraps
+    // around from the last to the first speaker is the fallback.
+    size_t first = count - 1;
+    for (size_t i = 0; i + 1 < count; i++) {
+      if (azimuth >= ring.azimuths[i] && azimuth < ring.azimuths[i + 1]) {
+        first = i;
+        break;
+      }
+    }
+    size_t second = (first + 1) % count;
+    const PairMatrix &m = ring.pairs[first];
+    float g1, g2;
+    if (m.valid) {
+      float px = std::sin(azimuth), py = std::cos(azimuth);
+      g1 = px * m.m00 + py * m.m10;
+      g2 = px * m.m01 + py * m.m11;
+      // Arcs wider than 180 degrees give a negative solution; clamp it
+      g1 = std::max(g1, 0.0f);
+      g2 = std::max(g2, 0.0f);
+    } else {
+      g1 = g2 = 1.0f;
+    }
+    float norm = std::sqrt(g1 * g1 + g2 * g2);
+    if (norm > 0.0f) {
+      gains[ring.speakers[first]] += weight * g1 / norm;
+      gains[ring.speakers[second]] += weight * g2 / norm;
+    }
+  }
+
+  void addSpreadGains(const Ring &ring, float weight, float *gains) const {
+    if (weight <= 0.0f) {
+      return;
+    }
+    float g = weight / std::sqrt(float(ring.speakers.size()));
+    for (int index : ring.speakers) {
+      gains[index] += g;
+    }
+  }
+
+  std::vector<PanSpeaker> mSpeakers;
+  std::vector<Ring> mRings;
+  std::vector<SourceSlot> mSlots;
+};
+
+#endif // LBAP_PANNER_HPP
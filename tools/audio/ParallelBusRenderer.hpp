@@ -0,0 +1,98 @@
+#pragma once
+#ifndef PARALLEL_BUS_RENDERER_HPP
+#define PARALLEL_BUS_RENDERER_HPP
+
+// Renders independent audio jobs (e.g. scene voices) on a thread pool.
+//
+// Every worker owns a private multichannel accumulation bus, so jobs never
+// write to shared memory while they run. Once all jobs are done the buses of
+// the workers that did any work are summed into the output channels with a
+// SIMD reduction, itself split across the pool by channel.
+//
+// A bus is cleared by its worker right before its first job in a block, so
+// idle workers cost nothing.
+
+#include <algorithm>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/ThreadPool.hpp"
+
+class ParallelBusRenderer {
+public:
+  // numThreads counts the calling (audio) thread; 0 uses every core
+  explicit ParallelBusRenderer(unsigned numThreads = 0)
+      : mPool(numThreads, true), mBuses(mPool.size()) {}
+
+  unsigned numWorkers() const { return mPool.size(); }
+  int numChannels() const { return mNumChannels; }
+  int framesPerBuffer() const { return mFramesPerBuffer; }
+
+  // Allocates the worker buses. Call outside the audio callback whenever the
+  // channel count or block size changes.
+  void prepare(int numChannels, int framesPerBuffer) {
+    mNumChannels = numChannels;
+    mFramesPerBuffer = framesPerBuffer;
+    for (auto &bus : mBuses) {
+      bus.samples.assign(size_t(numChannels) * framesPerBuffer, 0.0f);
+      bus.channels.resize(numChannels);
+      for (int ch = 0; ch < numChannels; ch++) {
+        bus.channels[ch] = bus.samples.data() + size_t(ch) * framesPerBuffer;
+      }
+      bus.used = false;
+    }
+  }
+
+  // Calls job(index, worker, bus) for every index in [0, numJobs), where bus
+  // is an array of numChannels() cleared channel buffers private to the
+  // worker. Jobs accumulate into the bus; call mixInto() afterwards.
+  template <class Job> void render(size_t numJobs, Job &&job) {
+    for (auto &bus : mBuses) {
+      bus.used = false;
+    }
+    mPool.parallelFor(numJobs, [&](size_t index, unsigned worker) {
+      WorkerBus &bus = mBuses[worker];
+      if (!bus.used) {
+        std::fill(bus.samples.begin(), bus.samples.end(), 0.0f);
+        bus.used = true;
+      }
+      job(index, worker, bus.channels.data());
+    });
+  }
+
+  // Adds the buses used in the last render() into outs (numChannels()
+  // buffers of framesPerBuffer() samples; null entries are skipped).
+  void mixInto(float *const *outs) {
+    const size_t frames = mFramesPerBuffer;
+    mPool.parallelFor(
+        size_t(mNumChannels),
+        [&](size_t ch, unsigned) {
+          if (!outs[ch]) {
+            return;
+          }
+          for (auto &bus : mBuses) {
+            if (bus.used) {
+              simd::add(outs[ch], bus.channels[ch], frames);
+            }
+          }
+        },
+        4);
+  }
+
+  ThreadPool &pool() { return mPool; }
+
+private:
+  struct WorkerBus {
+    std::vector<float> samples; // numChannels x framesPerBuffer
+    std::vector<float *> channels;
+    bool used = false;
+    char padding[64]; // keeps the used flags of workers off one cache line
+  };
+
+  ThreadPool mPool;
+  std::vector<WorkerBus> mBuses;
+  int mNumChannels{0};
+  int mFramesPerBuffer{0};
+};
+
+#endif // PARALLEL_BUS_RENDERER_HPP
@@ -0,0 +1,216 @@
+#pragma once
+#ifndef PARALLEL_SCENE_HPP
+#define PARALLEL_SCENE_HPP
+
+// Scene that renders and spatializes its voices on a thread pool.
+//
+// ParallelScene wraps al::DynamicScene or al::DistributedScene:
+//
+//   ParallelScene<DistributedScene> scene{"name", 0,
+//                                         TimeMasterMode::TIME_MASTER_UPDATE};
+//   scene.setSpatializer<BlockLbap>(speakerLayout);
+//   scene.renderThreads(4);
+//   scene.prepare(audioIO()); // before audio starts
+//
+// Each worker renders whole voices into its own scratch buffer, pans them with
+// the scene's BlockLbap into a private speaker bus, and the worker buses are
+// summed into the device outputs at the end of the block (see
+// ParallelBusRenderer.hpp). With any other spatializer the scene renders
+// serially, exactly like the wrapped scene, and no threads are started.
+//
+// With automation() set, voices that have a track in the AutomationEngine
+// are panned from the engine's block accurate positions instead of pose().
+//
+// Voices must be safe to process on any thread, and should not keep large
+// buffers on the stack (worker threads may have small stacks). Voices are
+// started, stopped and freed as in the wrapped scene's render(), in any
+// time master mode.
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+#include "al/scene/al_DynamicScene.hpp"
+
+#include "AutomationEngine.hpp"
+#include "BlockLbap.hpp"
+#include "ParallelBusRenderer.hpp"
+
+template <class Scene> class ParallelScene : public Scene {
+public:
+  template <class... Args>
+  ParallelScene(Args &&...args) : Scene(std::forward<Args>(args)...) {}
+
+  // Hides Scene::setSpatializer() to find out whether the spatializer can be
+  // used from the render threads.
+  template <class TSpatializer>
+  std::shared_ptr<TSpatializer> setSpatializer(al::Speakers &sl) {
+    auto spatializer = Scene::template setSpatializer<TSpatializer>(sl);
+    mLbap = std::dynamic_pointer_cast<BlockLbap>(spatializer);
+    if (mLbap) {
+      mLbap->follow(this);
+    }
+    return spatializer;
+  }
+
+  // Number of threads that render voices, including the audio thread. 0
+  // leaves one core free for graphics. Call before audio starts, then
+  // prepare().
+  void renderThreads(unsigned numThreads = 0) {
+    if (numThreads == 0) {
+      numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    mNumThreads = numThreads;
+    mRenderer.reset();
+    mPreparedFrames = 0;
+  }
+
+  // Engine whose tracks override voice poses; advanced from render()
+  void automation(AutomationEngine *engine) { mAutomation = engine; }
+
+  // Sizes the worker buffers for io and starts the render threads, if the
+  // spatializer is a BlockLbap. Call before audio starts and whenever the
+  // block size or the channels change; until then render() renders
+  // serially, so nothing is allocated or started on the audio thread.
+  void prepare(al::AudioIOData &io) {
+    Scene::prepare(io);
+    if (mLbap) {
+      prepareWorkers(io);
+    }
+  }
+
+  void render(al::AudioIOData &io) override {
+    if (mAutomation) {
+      mAutomation->process(io.framesPerBuffer() / io.framesPerSecond());
+    }
+    if (!mLbap || !mRenderer || io.framesPerBuffer() != mPreparedFrames ||
+        io.channelsOut() != mPreparedChannels ||
+        mRenderer->numChannels() != mLbap->panner().numSpeakers()) {
+      Scene::render(io);
+      return;
+    }
+    const unsigned fpb = io.framesPerBuffer();
+    const bool audioMaster =
+        this->m_timeMasterMode == al::TimeMasterMode::TIME_MASTER_AUDIO;
+    if (audioMaster) {
+      this->processVoices();
+      this->processVoiceTurnOff();
+    }
+
+    mLbap->prepare(io);
+    gatherVoices(fpb);
+
+    mRenderer->render(mJobs.size(), [&](size_t index, unsigned worker,
+                                        float *const *bus) {
+      const VoiceJob &job = mJobs[index];
+      if (job.slot < 0) {
+        return;
+      }
+      al::AudioIOData &voiceIO = *mVoiceIO[worker];
+      voiceIO.zeroOut();
+      voiceIO.frame(job.offset);
+      job.voice->onProcess(voiceIO);
+      float *samples = voiceIO.outBuffer(0);
+      if (job.gain != 1.0f) {
+        simd::scale(samples, job.gain, fpb);
+      }
+      mLbap->panner().renderSource(job.slot, job.direction.x, job.direction.y,
+                                   job.direction.z, samples, bus, fpb);
+    });
+
+    const auto &speakers = mLbap->panner().speakers();
+    for (size_t k = 0; k < speakers.size(); k++) {
+      int channel = speakers[k].deviceChannel;
+      mOuts[k] = channel < int(io.channelsOut()) ? io.outBuffer(channel)
+                                                 : nullptr;
+    }
+    mRenderer->mixInto(mOuts.data());
+    mLbap->finalize(io);
+
+    if (audioMaster) {
+      this->processInactiveVoices();
+    }
+  }
+
+private:
+  static constexpr int kMaxSources = BlockLbap::kMaxSources;
+
+  struct VoiceJob {
+    al::SynthVoice *voice;
+    int slot;
+    int offset;          // first frame of the block the voice renders
+    al::Vec3f direction; // listener relative, in speaker layout axes
+    float gain;          // distance attenuation
+  };
+
+  void prepareWorkers(al::AudioIOData &io) {
+    if (!mRenderer) {
+      if (mNumThreads == 0) {
+        renderThreads(0);
+      }
+      mRenderer.reset(new ParallelBusRenderer(mNumThreads));
+    }
+    int numSpeakers = mLbap ? mLbap->panner().numSpeakers() : 0;
+    mRenderer->prepare(numSpeakers, io.framesPerBuffer());
+    mVoiceIO.clear();
+    for (unsigned w = 0; w < mRenderer->numWorkers(); w++) {
+      mVoiceIO.emplace_back(new al::AudioIOData);
+      auto &voiceIO = *mVoiceIO.back();
+      voiceIO.framesPerBuffer(io.framesPerBuffer());
+      voiceIO.framesPerSecond(io.framesPerSecond());
+      voiceIO.channelsIn(io.channelsIn());
+      voiceIO.channelsOut(1);
+    }
+    mOuts.assign(numSpeakers, nullptr);
+    mJobs.reserve(kMaxSources);
+    mPreparedFrames = io.framesPerBuffer();
+    mPreparedChannels = io.channelsOut();
+  }
+
+  // Builds the job list on the audio thread: voice, start offset, direction,
+  // attenuation and the panner slot BlockLbap keeps for the voice from block
+  // to block (assigned by its prepare()).
+  void gatherVoices(unsigned framesPerBuffer) {
+    mJobs.clear();
+    const al::Pose listener = this->listenerPose();
+
+    for (auto *voice = this->getActiveVoices(); voice; voice = voice->next) {
+      if (!voice->active() || int(mJobs.size()) == kMaxSources) {
+        continue;
+      }
+      auto *posVoice = static_cast<al::PositionedVoice *>(voice);
+      al::Vec3d position = posVoice->pose().vec();
+      int track = mAutomation ? mAutomation->find(voice) : -1;
+      if (track >= 0) {
+        float p[3];
+        mAutomation->position(track, p);
+        position.set(p[0], p[1], p[2]);
+      }
+      al::Vec3d direction = position - listener.vec();
+      float gain = 1.0f;
+      if (posVoice->useDistanceAttenuation()) {
+        gain = this->distanceAttenuation().attenuation(direction.mag());
+      }
+      // Rotate according to listener orientation
+      direction = listener.quat().rotate(direction);
+      mJobs.push_back({voice, mLbap->slot(mJobs.size()),
+                       voice->getStartOffsetFrames(framesPerBuffer),
+                       BlockLbap::layoutDirection(al::Vec3f(direction)),
+                       gain});
+    }
+  }
+
+  std::shared_ptr<BlockLbap> mLbap;
+  AutomationEngine *mAutomation{nullptr};
+  unsigned mNumThreads{0}; // set by renderThreads()
+  std::unique_ptr<ParallelBusRenderer> mRenderer;
+  std::vector<std::unique_ptr<al::AudioIOData>> mVoiceIO; // one per worker
+  std::vector<VoiceJob> mJobs;
+  std::vector<float *> mOuts;
+  unsigned mPreparedFrames{0};
+  unsigned mPreparedChannels{0};
+};
+
+#endif // PARALLEL_SCENE_HPP
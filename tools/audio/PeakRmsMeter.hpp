@@ -0,0 +1,96 @@
+#pragma once
+#ifndef PEAK_RMS_METER_HPP
+#define PEAK_RMS_METER_HPP
+
+// Multichannel peak and RMS metering for the audio callback.
+//
+// process() runs a single SIMD pass per channel (see
+// simd::peakAndSumSquares) and accumulates peak and energy over a window of
+// frames. When the window is full the values are written to a MeterSnapshot
+// and published through a lock-free triple buffer; readers on other threads
+// pick up the newest snapshot with fetch(). Nothing else happens on the audio
+// thread: conversion to dB and meter ballistics are left to the reader.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "common/SimdOps.hpp"
+#include "common/TripleBuffer.hpp"
+
+struct MeterSnapshot {
+  static constexpr int kMaxChannels = 64;
+
+  int numChannels{0};
+  uint64_t frame{0};   // frames processed when the snapshot was taken
+  float peak[kMaxChannels] = {0};       // linear, over the window
+  float meanSquare[kMaxChannels] = {0}; // RMS squared, over the window
+};
+
+class PeakRmsMeter {
+public:
+  // Channels beyond MeterSnapshot::kMaxChannels are ignored. A snapshot is
+  // published every windowFrames frames (rounded up to whole blocks); pick
+  // about one graphics frame so that readers see every window.
+  void setup(int numChannels, int windowFrames) {
+    mNumChannels = std::min(numChannels, int(MeterSnapshot::kMaxChannels));
+    mWindowFrames = std::max(1, windowFrames);
+    reset();
+  }
+
+  void reset() {
+    std::fill(mPeak, mPeak + MeterSnapshot::kMaxChannels, 0.0f);
+    std::fill(mSumSquares, mSumSquares + MeterSnapshot::kMaxChannels, 0.0f);
+    mWindowCount = 0;
+  }
+
+  int numChannels() const { return mNumChannels; }
+
+  // Audio thread. channels holds at least numChannels() buffers of
+  // numFrames samples.
+  void process(const float *const *channels, int numFrames) {
+    for (int ch = 0; ch < mNumChannels; ch++) {
+      float peak = simd::peakAndSumSquares(channels[ch], size_t(numFrames),
+                                           mSumSquares[ch]);
+      mPeak[ch] = std::max(mPeak[ch], peak);
+    }
+    mWindowCount += numFrames;
+    mFrame += numFrames;
+    if (mWindowCount >= mWindowFrames) {
+      MeterSnapshot &snapshot = mSnapshots.writeBuffer();
+      const float norm = 1.0f / float(mWindowCount);
+      snapshot.numChannels = mNumChannels;
+      snapshot.frame = mFrame;
+      for (int ch = 0; ch < mNumChannels; ch++) {
+        snapshot.peak[ch] = mPeak[ch];
+        snapshot.meanSquare[ch] = mSumSquares[ch] * norm;
+      }
+      mSnapshots.publish();
+      reset();
+    }
+  }
+
+  // Reader thread. Returns true if a new snapshot is available in latest().
+  bool fetch() { return mSnapshots.fetch(); }
+  const MeterSnapshot &latest() const { return mSnapshots.readBuffer(); }
+
+  // Reader side conversions
+  static float peakToDb(float peak, float floorDb = -120.0f) {
+    return peak > 0.0f ? std::max(floorDb, 20.0f * std::log10(peak)) : floorDb;
+  }
+  static float meanSquareToDb(float meanSquare, float floorDb = -120.0f) {
+    return meanSquare > 0.0f ? std::max(floorDb, 10.0f * std::log10(meanSquare))
+                             : floorDb;
+  }
+
+private:
+  int mNumChannels{0};
+  int mWindowFrames{1024};
+  int mWindowCount{0};
+  uint64_t mFrame{0};
+  float mPeak[MeterSnapshot::kMaxChannels] = {0};
+  float mSumSquares[MeterSnapshot::kMaxChannels] = {0};
+  TripleBuffer<MeterSnapshot> mSnapshots;
+};
+
+#endif // PEAK_RMS_METER_HPP
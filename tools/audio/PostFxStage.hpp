@@ -0,0 +1,487 @@
+#pragma once
+#ifndef POST_FX_STAGE_HPP
+#define POST_FX_STAGE_HPP
+
+// Post-spatialization effects for the speaker outputs, run once per block:
+//
+//  1. LFE bass management: the stereo downmix bus is low passed and added to
+//     the subwoofer channel.
+//  2. Global reverb: the downmix bus is sent to an 8 line feedback delay
+//     network whose outputs are spread over the speaker channels.
+//  3. Limiter: a linked lookahead peak limiter over all outputs. Outputs
+//     and bus are delayed by kLimiterLookahead frames, and the gain ramps
+//     down over the lookahead before a peak arrives. A clamp at full scale
+//     follows, as a safety net only.
+//
+// Everything works on whole channel buffers with the simd:: kernels; only the
+// recursive filters (LFE crossover, reverb damping) run sample by sample on a
+// handful of channels.
+//
+// With setAsync(true) the stage runs on its own thread: each process() call
+// hands the current block to the worker and returns the block processed
+// during the previous period, so the outputs and the downmix bus are delayed
+// by one block.
+//
+// Settings can be changed from any thread.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+
+class PostFxStage {
+public:
+  static constexpr int kReverbLines = 8;
+  static constexpr int kLimiterLookahead = 64; // frames, 1.3 ms at 48 kHz
+
+  PostFxStage() = default;
+  ~PostFxStage() { stopWorker(); }
+
+  PostFxStage(const PostFxStage &) = delete;
+  PostFxStage &operator=(const PostFxStage &) = delete;
+
+  // Call with audio stopped: the buffers process() works in are reallocated
+  // and the worker thread is restarted. lfeChannel < 0 disables bass
+  // management. reverbChannels lists the output channels that receive the
+  // reverb (usually the device channels of the speaker layout).
+  void prepare(int numOutputs, int maxFrames, double sampleRate,
+               int lfeChannel, const std::vector<int> &reverbChannels) {
+    stopWorker();
+    mNumOutputs = numOutputs;
+    mMaxFrames = maxFrames;
+    mSampleRate = sampleRate;
+    mLfeChannel = lfeChannel < numOutputs ? lfeChannel : -1;
+    mReverbChannels.clear();
+    for (int ch : reverbChannels) {
+      if (ch >= 0 && ch < numOutputs && ch != mLfeChannel) {
+        mReverbChannels.push_back(ch);
+      }
+    }
+
+    mSend.assign(maxFrames, 0.0f);
+    mPieceOuts.assign(numOutputs, nullptr);
+    mLfe.assign(maxFrames, 0.0f);
+    mLfeState[0] = mLfeState[1] = 0.0f;
+    prepareReverb();
+    prepareLimiter();
+
+    // Double buffered copies of outputs and the two bus channels
+    int stride = numOutputs + 2;
+    for (auto &block : mPipe) {
+      block.samples.assign(size_t(stride) * maxFrames, 0.0f);
+      block.channels.resize(stride);
+      for (int ch = 0; ch < stride; ch++) {
+        block.channels[ch] = block.samples.data() + size_t(ch) * maxFrames;
+      }
+      block.frames = 0;
+    }
+    mFront = 0;
+    if (mAsync) {
+      startWorker();
+    }
+  }
+
+  // Takes effect at the next prepare()
+  void setAsync(bool async) { mAsync = async; }
+  bool async() const { return mAsync; }
+
+  void lfeLevel(float level) { mLfeLevel = level; }
+  void lfeCutoff(float hz) { mLfeCutoff = hz; }
+  void reverbSend(float level) { mReverbSend = level; }
+  void reverbLevel(float level) { mReverbLevel = level; }
+  void reverbTime(float seconds) { mReverbTime = seconds; } // T60
+  void reverbDamping(float amount) { mReverbDamping = amount; } // 0..1
+  void limiterThreshold(float linear) { mLimiterThreshold = linear; }
+  void limiterRelease(float seconds) { mLimiterRelease = seconds; }
+  void limiterEnabled(bool enabled) { mLimiterEnabled = enabled; }
+
+  // Current limiter gain reduction, for display
+  float limiterGain() const { return mLimiterGainOut.load(); }
+
+  // Audio thread. outs holds numOutputs channels, busL/busR the stereo
+  // downmix, which is delayed along with the outputs. Blocks longer than the maxFrames given to prepare() are
+  // processed maxFrames at a time on the calling thread, even with
+  // setAsync(true); the block then pending on the worker is dropped.
+  void process(float *const *outs, float *busL, float *busR, int frames) {
+    if (mMaxFrames == 0) {
+      return; // not prepared
+    }
+    if (frames > mMaxFrames) {
+      processPieces(outs, busL, busR, frames);
+      return;
+    }
+    if (!mAsync) {
+      run(outs, busL, busR, frames);
+      return;
+    }
+    waitForWorker();
+    PipeBlock &done = mPipe[mFront];
+    PipeBlock &next = mPipe[1 - mFront];
+    for (int ch = 0; ch < mNumOutputs + 2; ch++) {
+      float *buffer =
+          ch < mNumOutputs ? outs[ch] : ch == mNumOutputs ? busL : busR;
+      std::memcpy(next.channels[ch], buffer, frames * sizeof(float));
+      if (done.frames == frames) {
+        std::memcpy(buffer, done.channels[ch], frames * sizeof(float));
+      } else {
+        std::memset(buffer, 0, frames * sizeof(float)); // size changed
+      }
+    }
+    next.frames = frames;
+    mFront = 1 - mFront;
+
+    mWorkerBusy.store(true, std::memory_order_release);
+    if (mWorkerSleeping.load()) {
+      { std::lock_guard<std::mutex> lk(mMutex); }
+      mWake.notify_one();
+    }
+  }
+
+private:
+  struct PipeBlock {
+    std::vector<float> samples;
+    std::vector<float *> channels;
+    int frames{0};
+  };
+
+  void processPieces(float *const *outs, float *busL, float *busR,
+                     int frames) {
+    if (mAsync) {
+      waitForWorker();
+      for (auto &block : mPipe) {
+        block.frames = 0;
+      }
+    }
+    for (int offset = 0; offset < frames; offset += mMaxFrames) {
+      const int n = std::min(mMaxFrames, frames - offset);
+      for (int ch = 0; ch < mNumOutputs; ch++) {
+        mPieceOuts[ch] = outs[ch] + offset;
+      }
+      run(mPieceOuts.data(), busL + offset, busR + offset, n);
+    }
+  }
+
+  // Waits for the block handed to the worker (normally finished long ago)
+  void waitForWorker() {
+    unsigned spins = 0;
+    while (mWorkerBusy.load(std::memory_order_acquire)) {
+      if (++spins > 1000) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  void run(float *const *outs, float *busL, float *busR, int frames) {
+    // Mono send shared by LFE and reverb
+    float *send = mSend.data();
+    std::memcpy(send, busL, frames * sizeof(float));
+    simd::add(send, busR, frames);
+
+    if (mLfeChannel >= 0 && mLfeLevel.load() != 0.0f) {
+      processLfe(outs[mLfeChannel], send, frames);
+    }
+    if (mReverbSend.load() != 0.0f && !mReverbChannels.empty()) {
+      // The reverb reads mMinDelay samples back, so longer blocks are split
+      for (int offset = 0; offset < frames; offset += mMinDelay) {
+        int n = std::min(mMinDelay, frames - offset);
+        processReverb(outs, send + offset, offset, n);
+      }
+    }
+    const bool limit = mLimiterEnabled;
+    if (limit && !mLimiting) {
+      // No stale lookahead from the last time it ran
+      std::fill(mLimiterHeld.begin(), mLimiterHeld.end(), 0.0f);
+      mLimiterGain = 1.0f;
+    }
+    mLimiting = limit;
+    if (limit) {
+      processLimiter(outs, busL, busR, frames);
+    }
+  }
+
+  // Second order Butterworth low pass (RBJ), added to the LFE channel
+  void processLfe(float *lfe, const float *send, int frames) {
+    const float w = 2.0f * float(M_PI) * mLfeCutoff.load() / float(mSampleRate);
+    const float alpha = std::sin(w) / (2.0f * 0.70710678f);
+    const float cosw = std::cos(w);
+    const float a0 = 1.0f + alpha;
+    const float b0 = (1.0f - cosw) * 0.5f / a0;
+    const float b1 = (1.0f - cosw) / a0;
+    const float a1 = -2.0f * cosw / a0;
+    const float a2 = (1.0f - alpha) / a0;
+    const float gain = mLfeLevel.load();
+    float s1 = mLfeState[0], s2 = mLfeState[1];
+    float *filtered = mLfe.data();
+    for (int i = 0; i < frames; i++) {
+      // Transposed direct form II
+      float x = send[i];
+      float y = b0 * x + s1;
+      s1 = b1 * x - a1 * y + s2;
+      s2 = b0 * x - a2 * y;
+      filtered[i] = y;
+    }
+    mLfeState[0] = flushDenormal(s1);
+    mLfeState[1] = flushDenormal(s2);
+    simd::addScaled(lfe, filtered, gain, frames);
+  }
+
+  void prepareReverb() {
+    // Mutually prime lengths, scaled from 48 kHz
+    static const int lengths48k[kReverbLines] = {1117, 1277, 1423, 1597,
+                                                 1777, 1931, 2113, 2297};
+    int bufferSize = 1;
+    for (int j = 0; j < kReverbLines; j++) {
+      mDelay[j] = std::max(16, int(lengths48k[j] * mSampleRate / 48000.0));
+      while (bufferSize < mDelay[j] + mMaxFrames) {
+        bufferSize *= 2;
+      }
+    }
+    mMinDelay = *std::min_element(mDelay, mDelay + kReverbLines);
+    mLineMask = bufferSize - 1;
+    for (int j = 0; j < kReverbLines; j++) {
+      mLines[j].assign(bufferSize, 0.0f);
+      mTaps[j].assign(mMaxFrames, 0.0f);
+      mDamping[j] = 0.0f;
+    }
+    mWritePos = 0;
+  }
+
+  void processReverb(float *const *outs, const float *send, int offset,
+                     int n) {
+    const float time = std::max(0.05f, mReverbTime.load());
+    const float damping = std::min(0.95f, std::max(0.0f, mReverbDamping.load()));
+    const float input = mReverbSend.load() * 0.5f;
+
+    // Read n delayed samples from every line
+    for (int j = 0; j < kReverbLines; j++) {
+      int read = (mWritePos - mDelay[j]) & mLineMask;
+      copyFromRing(mLines[j], read, mTaps[j].data(), n);
+    }
+    // Outputs: channel k gets line k % kReverbLines
+    const float wet = mReverbLevel.load() / std::sqrt(float(kReverbLines));
+    for (size_t k = 0; k < mReverbChannels.size(); k++) {
+      simd::addScaled(outs[mReverbChannels[k]] + offset,
+                      mTaps[k % kReverbLines].data(), wet, n);
+    }
+    // Feedback: damping, Hadamard mix, decay gain, input
+    for (int j = 0; j < kReverbLines; j++) {
+      float *tap = mTaps[j].data();
+      float z = mDamping[j];
+      for (int i = 0; i < n; i++) {
+        z += (1.0f - damping) * (tap[i] - z);
+        tap[i] = z;
+      }
+      mDamping[j] = flushDenormal(z);
+    }
+    for (int span = 1; span < kReverbLines; span *= 2) {
+      for (int j = 0; j < kReverbLines; j += 2 * span) {
+        for (int m = j; m < j + span; m++) {
+          simd::sumDiff(mTaps[m].data(), mTaps[m + span].data(), n);
+        }
+      }
+    }
+    for (int j = 0; j < kReverbLines; j++) {
+      float decay = std::pow(10.0f, -3.0f * mDelay[j] /
+                                        (time * float(mSampleRate)));
+      simd::scale(mTaps[j].data(), decay / std::sqrt(float(kReverbLines)), n);
+      simd::addScaled(mTaps[j].data(), send, (j & 1) ? -input : input, n);
+      copyToRing(mTaps[j].data(), mLines[j], mWritePos, n);
+    }
+    mWritePos = (mWritePos + n) & mLineMask;
+  }
+
+  // Keeps the recursive filters from decaying into slow denormal numbers
+  static float flushDenormal(float x) {
+    return std::fabs(x) < 1e-15f ? 0.0f : x;
+  }
+
+  void copyFromRing(const std::vector<float> &ring, int pos, float *dst,
+                    int n) const {
+    int first = std::min(n, mLineMask + 1 - pos);
+    std::memcpy(dst, ring.data() + pos, first * sizeof(float));
+    std::memcpy(dst + first, ring.data(), (n - first) * sizeof(float));
+  }
+
+  void copyToRing(const float *src, std::vector<float> &ring, int pos,
+                  int n) const {
+    int first = std::min(n, mLineMask + 1 - pos);
+    std::memcpy(ring.data() + pos, src, first * sizeof(float));
+    std::memcpy(ring.data(), src + first, (n - first) * sizeof(float));
+  }
+
+  void prepareLimiter() {
+    const int lookahead = kLimiterLookahead;
+    mLimiterHeld.assign(size_t(mNumOutputs + 2) * lookahead, 0.0f);
+    mLimiterLine.assign(size_t(mMaxFrames) + lookahead, 0.0f);
+    mLimiterGains.assign(mMaxFrames, 1.0f);
+    mLimiterPeaks.assign((mMaxFrames + lookahead - 1) / lookahead + 1, 0.0f);
+    mLimiterGain = 1.0f;
+    mLimiting = false;
+  }
+
+  // The signal is delayed by one lookahead segment and cut into segments of
+  // that length. Over each segment the gain ramps to a value that holds both
+  // it and the segment after it under the threshold, so a peak is met by a
+  // gain that got there during the segment before.
+  void processLimiter(float *const *outs, float *busL, float *busR,
+                      int frames) {
+    const int lookahead = kLimiterLookahead;
+    // Segments of the delayed block, and the one after it
+    const int segments = (frames + lookahead - 1) / lookahead + 1;
+    std::fill(mLimiterPeaks.begin(), mLimiterPeaks.begin() + segments, 0.0f);
+    float *line = mLimiterLine.data();
+    for (int ch = 0; ch < mNumOutputs + 2; ch++) {
+      float *buffer =
+          ch < mNumOutputs ? outs[ch] : ch == mNumOutputs ? busL : busR;
+      float *held = mLimiterHeld.data() + size_t(ch) * lookahead;
+      std::memcpy(line, held, lookahead * sizeof(float));
+      std::memcpy(line + lookahead, buffer, frames * sizeof(float));
+      std::memcpy(buffer, line, frames * sizeof(float));
+      std::memcpy(held, line + frames, lookahead * sizeof(float));
+      if (ch >= mNumOutputs) {
+        continue; // the bus is only delayed
+      }
+      for (int k = 0; k < segments; k++) {
+        const int start = k * lookahead;
+        const int n = std::min(lookahead, frames + lookahead - start);
+        mLimiterPeaks[k] =
+            std::max(mLimiterPeaks[k], simd::absMax(line + start, n));
+      }
+    }
+
+    const float threshold = mLimiterThreshold.load();
+    const float release =
+        std::max(0.001f, mLimiterRelease.load()) * float(mSampleRate);
+    auto target = [&](float peak) {
+      return peak > threshold ? threshold / peak : 1.0f;
+    };
+    float gain = mLimiterGain;
+    bool unity = gain == 1.0f;
+    float *gains = mLimiterGains.data();
+    for (int k = 0; k + 1 < segments; k++) {
+      const int start = k * lookahead;
+      const int n = std::min(lookahead, frames - start);
+      float next = std::min(target(mLimiterPeaks[k]),
+                            target(mLimiterPeaks[k + 1]));
+      if (next >= gain) {
+        // Release towards the target
+        next = gain + (1.0f - std::exp(-n / release)) * (next - gain);
+        next = next > 0.9999f ? 1.0f : next;
+      }
+      const float step = (next - gain) / n;
+      for (int i = 0; i < n; i++) {
+        gains[start + i] = gain + step * i;
+      }
+      unity = unity && next == 1.0f;
+      gain = next;
+    }
+    if (!unity) {
+      for (int ch = 0; ch < mNumOutputs; ch++) {
+        simd::multiply(outs[ch], outs[ch], gains, frames);
+        simd::clamp(outs[ch], 1.0f, frames);
+      }
+    }
+    mLimiterGain = gain;
+    mLimiterGainOut.store(gain);
+  }
+
+  void startWorker() {
+    mStop = false;
+    mWorkerBusy = false;
+    mWorker = std::thread([this]() { workerLoop(); });
+  }
+
+  void stopWorker() {
+    if (!mWorker.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lk(mMutex);
+      mStop = true;
+    }
+    mWake.notify_one();
+    mWorker.join();
+  }
+
+  void workerLoop() {
+    while (true) {
+      unsigned spins = 0;
+      while (!mWorkerBusy.load(std::memory_order_acquire) && !mStop) {
+        if (++spins > 20000) {
+          std::unique_lock<std::mutex> lk(mMutex);
+          mWorkerSleeping = true;
+          mWake.wait(lk, [this]() {
+            return mWorkerBusy.load(std::memory_order_acquire) ||
+                   mStop.load();
+          });
+          mWorkerSleeping = false;
+        }
+      }
+      if (mStop) {
+        return;
+      }
+      // The audio thread just made the front block the one to process
+      PipeBlock &block = mPipe[mFront];
+      run(block.channels.data(), block.channels[mNumOutputs],
+          block.channels[mNumOutputs + 1], block.frames);
+      mWorkerBusy.store(false, std::memory_order_release);
+    }
+  }
+
+  // Layout
+  int mNumOutputs{0};
+  int mMaxFrames{0};
+  double mSampleRate{48000.0};
+  int mLfeChannel{-1};
+  std::vector<int> mReverbChannels;
+
+  // Settings
+  std::atomic<float> mLfeLevel{0.1f};
+  std::atomic<float> mLfeCutoff{80.0f};
+  std::atomic<float> mReverbSend{0.0f};
+  std::atomic<float> mReverbLevel{0.3f};
+  std::atomic<float> mReverbTime{2.5f};
+  std::atomic<float> mReverbDamping{0.3f};
+  std::atomic<float> mLimiterThreshold{0.89f}; // -1 dBFS
+  std::atomic<float> mLimiterRelease{0.15f};
+  std::atomic<bool> mLimiterEnabled{true};
+  std::atomic<float> mLimiterGainOut{1.0f};
+
+  // Processing state
+  std::vector<float> mSend;
+  std::vector<float *> mPieceOuts; // outs offset to a piece of a long block
+  std::vector<float> mLfe;
+  float mLfeState[2] = {0, 0};
+  std::vector<float> mLines[kReverbLines];
+  std::vector<float> mTaps[kReverbLines];
+  float mDamping[kReverbLines] = {0};
+  int mDelay[kReverbLines] = {0};
+  int mMinDelay{1};
+  int mLineMask{0};
+  int mWritePos{0};
+  float mLimiterGain{1.0f};
+  bool mLimiting{false};
+  std::vector<float> mLimiterHeld;  // last lookahead of every channel and bus
+  std::vector<float> mLimiterLine;  // held frames followed by the block
+  std::vector<float> mLimiterGains; // gain of every frame of the block
+  std::vector<float> mLimiterPeaks; // peak of every lookahead segment
+
+  // Asynchronous mode
+  bool mAsync{false};
+  PipeBlock mPipe[2];
+  int mFront{0}; // block last handed to the worker
+  std::thread mWorker;
+  std::atomic<bool> mWorkerBusy{false};
+  std::atomic<bool> mWorkerSleeping{false};
+  std::atomic<bool> mStop{false};
+  std::mutex mMutex;
+  std::condition_variable mWake;
+};
+
+#endif // POST_FX_STAGE_HPP
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef SPEAKER_METER_HPP
+#define SPEAKER_METER_HPP
+
+// Speaker level meter for the AlloSphere audio tools.
+//
+// The audio callback only calls processSound(), which feeds a PeakRmsMeter.
+// The graphics thread calls update() once per frame: it fetches the newest
+// snapshot, converts it to dB and applies the meter ballistics before draw().
+// On a distributed setup the primary copies the raw snapshot into the shared
+// state with exportValues() and the other nodes feed it back with
+// setMeterValues(), so each node runs the same display code.
+
+#include <algorithm>
+
+#include "al/graphics/al_Graphics.hpp"
+#include "al/graphics/al_Shapes.hpp"
+#include "al/io/al_AudioIOData.hpp"
+#include "al/sound/al_Speaker.hpp"
+
+#include "PeakRmsMeter.hpp"
+
+class SpeakerMeter {
+public:
+  static constexpr int kMaxChannels = MeterSnapshot::kMaxChannels;
+
+  // snapshotsPerSecond should be close to the graphics frame rate
+  void init(const al::Speakers &sl, double framesPerSecond = 48000.0,
+            double snapshotsPerSecond = 60.0) {
+    al::addCube(mMesh);
+    mSl = sl;
+    mWindowFrames = int(framesPerSecond / snapshotsPerSecond);
+  }
+
+  // Audio thread
+  void processSound(al::AudioIOData &io) {
+    int numChannels = std::min(int(io.channelsOut()), int(kMaxChannels));
+    if (numChannels != mMeter.numChannels()) {
+      mMeter.setup(numChannels, mWindowFrames);
+    }
+    const float *channels[kMaxChannels];
+    for (int ch = 0; ch < numChannels; ch++) {
+      channels[ch] = io.outBuffer(ch);
+    }
+    mMeter.process(channels, int(io.framesPerBuffer()));
+  }
+
+  // Graphics thread, once per frame. Returns true if new levels arrived.
+  bool update() {
+    bool fresh = mMeter.fetch();
+    if (fresh) {
+      const MeterSnapshot &snapshot = mMeter.latest();
+      std::copy(snapshot.peak, snapshot.peak + kMaxChannels, mPeak);
+      std::copy(snapshot.meanSquare, snapshot.meanSquare + kMaxChannels,
+                mMeanSquare);
+      mNumChannels = snapshot.numChannels;
+    }
+    applyLevels();
+    return fresh;
+  }
+
+  // Raw levels of the last update(), indexed by device channel (linear peak
+  // and RMS squared). Arrays hold kMaxChannels values.
+  void exportValues(float *peaks, float *meanSquares) const {
+    std::copy(mPeak, mPeak + kMaxChannels, peaks);
+    std::copy(mMeanSquare, mMeanSquare + kMaxChannels, meanSquares);
+  }
+
+  // For nodes that get levels from the shared state instead of the audio
+  // callback. Call once per frame in place of update().
+  void setMeterValues(const float *peaks, const float *meanSquares,
+                      size_t count) {
+    count = std::min(count, size_t(kMaxChannels));
+    std::copy(peaks, peaks + count, mPeak);
+    std::copy(meanSquares, meanSquares + count, mMeanSquare);
+    mNumChannels = int(count);
+    applyLevels();
+  }
+
+  // Outline cube scaled by peak level, solid inner cube by RMS level
+  void draw(al::Graphics &g) {
+    for (const auto &speaker : mSl) {
+      int ch = speaker.deviceChannel;
+      if (ch < 0 || ch >= mNumChannels) {
+        continue;
+      }
+      g.pushMatrix();
+      g.scale(1 / 5.0f);
+      g.translate(speaker.vecGraphics());
+      g.pushMatrix();
+      g.scale(0.1 + mPeakDisplay[ch] * 5);
+      g.polygonLine();
+      g.color(1);
+      g.draw(mMesh);
+      g.popMatrix();
+      g.scale(0.1 + mRmsDisplay[ch] * 5);
+      g.polygonFill();
+      g.color(0.4);
+      g.draw(mMesh);
+      g.popMatrix();
+    }
+    g.polygonLine();
+  }
+
+private:
+  // Maps -60..0 dB to the 0.01..0.31 cube size used by the sphere tools
+  static float displayLevel(float db) {
+    return db < -60.0f ? 0.01f : 0.01f + 0.005f * (60.0f + db);
+  }
+
+  void applyLevels() {
+    for (int ch = 0; ch < mNumChannels; ch++) {
+      float peak = displayLevel(PeakRmsMeter::peakToDb(mPeak[ch]));
+      float rms = displayLevel(PeakRmsMeter::meanSquareToDb(mMeanSquare[ch]));
+      // Instant attack, exponential release
+      mPeakDisplay[ch] = std::max(peak, release(mPeakDisplay[ch], peak));
+      mRmsDisplay[ch] = std::max(rms, release(mRmsDisplay[ch], rms));
+    }
+  }
+
+  // Per graphics frame; about the same fall time as the old per audio block
+  // 0.05 factor at 60 fps
+  static float release(float current, float target) {
+    return current - 0.08f * (current - target);
+  }
+
+  PeakRmsMeter mMeter; // written by the audio thread only
+  int mWindowFrames{800};
+
+  // Graphics thread
+  al::Mesh mMesh;
+  al::Speakers mSl;
+  int mNumChannels{0};
+  float mPeak[kMaxChannels] = {0};
+  float mMeanSquare[kMaxChannels] = {0};
+  float mPeakDisplay[kMaxChannels] = {0};
+  float mRmsDisplay[kMaxChannels] = {0};
+};
+
+#endif // SPEAKER_METER_HPP
@@ -0,0 +1,222 @@
+// Benchmark for AutomationCurve / AutomationEngine with 64 automated objects:
+// parsing cost when each object parses its own file versus sharing parsed
+// curves, the per block cost of evaluating all positions and feeding them to
+// the panner, and the cost of start() and stop() called from two control
+// threads at once (as the sequencer and update threads do) while a third
+// thread processes blocks. That last run fails if a curve outlives its
+// tracks.
+//
+// Build and run with ./run.sh tools/audio/automation_bench.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "AutomationEngine.hpp"
+#include "LbapPanner.hpp"
+
+const int kObjects = 64;
+const int kFiles = 8; // objects share files, as in the sequencer sessions
+const int kLinesPerFile = 2000;
+const int kBlockSize = 512;
+const double kSampleRate = 48000.0;
+
+std::string makeSequence(int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> delta(0.05f, 2.0f);
+  std::ostringstream out;
+  out << "+0:/_pose:0,1,0:0.0\n";
+  for (int i = 0; i < kLinesPerFile; i++) {
+    out << "+" << delta(rng) << ":/_pose:" << pos(rng) << "," << pos(rng)
+        << "," << pos(rng) << ":" << delta(rng) << "\n";
+  }
+  out << "::\n";
+  return out.str();
+}
+
+int main() {
+  std::vector<std::string> files;
+  for (int f = 0; f < kFiles; f++) {
+    files.push_back(makeSequence(f + 1));
+  }
+
+  // Parsing: one parse per object versus one per file
+  double perObject = bench::measure(
+      [&]() {
+        for (int o = 0; o < kObjects; o++) {
+          AutomationCurve curve;
+          std::istringstream in(files[o % kFiles]);
+          curve.parse(in);
+          bench::keep(curve);
+        }
+      },
+      0.5, 3);
+  std::vector<std::shared_ptr<const AutomationCurve>> curves;
+  double shared = bench::measure(
+      [&]() {
+        curves.clear();
+        for (int f = 0; f < kFiles; f++) {
+          auto curve = std::make_shared<AutomationCurve>();
+          std::istringstream in(files[f]);
+          curve->parse(in);
+          curves.push_back(curve);
+        }
+      },
+      0.5, 3);
+
+  // Per block evaluation
+  AutomationEngine engine;
+  int owners[kObjects];
+  int tracks[kObjects];
+  for (int o = 0; o < kObjects; o++) {
+    tracks[o] = engine.start(&owners[o], curves[o % kFiles]);
+  }
+  const double blockSeconds = kBlockSize / kSampleRate;
+  double batch = bench::measure([&]() {
+    engine.process(blockSeconds);
+    float p[3];
+    for (int o = 0; o < kObjects; o++) {
+      engine.position(tracks[o], p);
+      bench::keep(p);
+    }
+  });
+  // Looking tracks up by owner, as the scene does for its voices
+  double lookup = bench::measure([&]() {
+    float p[3];
+    for (int o = 0; o < kObjects; o++) {
+      engine.position(engine.find(&owners[o]), p);
+      bench::keep(p);
+    }
+  });
+
+  // Same positions without cursors: bisection into every curve each block
+  double time = 0.0;
+  double bisect = bench::measure([&]() {
+    time += blockSeconds;
+    float p[3];
+    for (int o = 0; o < kObjects; o++) {
+      curves[o % kFiles]->evaluate(time, p);
+      bench::keep(p);
+    }
+  });
+
+  // Automation feeding the panner directly, 60 speakers
+  LbapPanner panner;
+  std::vector<PanSpeaker> speakers;
+  for (int i = 0; i < 60; i++) {
+    speakers.push_back({360.0f * (i % 30) / 30.0f, i < 30 ? 0.0f : 40.0f, i});
+  }
+  panner.setLayout(speakers);
+  panner.reserveSources(kObjects);
+  std::vector<float> samples(kBlockSize, 0.1f);
+  std::vector<std::vector<float>> outs(60, std::vector<float>(kBlockSize));
+  std::vector<float *> outPtrs;
+  for (auto &out : outs) {
+    outPtrs.push_back(out.data());
+  }
+  double rendered = bench::measure([&]() {
+    engine.process(blockSeconds);
+    for (int o = 0; o < kObjects; o++) {
+      float p[3];
+      engine.position(engine.find(&owners[o]), p);
+      // graphics axes (y up, -z ahead) to layout axes (z up, y ahead)
+      panner.renderSource(o, p[0], -p[2], p[1], samples.data(),
+                          outPtrs.data(), kBlockSize);
+    }
+    bench::keep(outs[0][0]);
+  });
+
+  // start() from one thread, stop() and currentPosition() from another, on
+  // the same owners, while audio processes. Every started curve is a fresh
+  // copy, so the ones still alive at the end have leaked.
+  const int kControlCalls = 20000;
+  AutomationCurve shortCurve;
+  {
+    std::istringstream in("+0:/_pose:0,1,0:0.0\n+1:/_pose:1,0,0:0.5\n::\n");
+    shortCurve.parse(in);
+  }
+  AutomationEngine concurrent;
+  std::vector<std::weak_ptr<const AutomationCurve>> started(kControlCalls);
+  std::atomic<bool> audioRunning{true};
+  std::thread audio([&]() {
+    float p[3];
+    while (audioRunning) {
+      concurrent.process(blockSeconds);
+      for (int o = 0; o < kObjects; o++) {
+        int track = concurrent.find(&owners[o]);
+        if (track >= 0) {
+          concurrent.position(track, p);
+          bench::keep(p);
+        }
+      }
+    }
+  });
+  auto controlStart = bench::Clock::now();
+  std::thread sequencer([&]() {
+    for (int i = 0; i < kControlCalls; i++) {
+      auto curve = std::make_shared<AutomationCurve>(shortCurve);
+      started[i] = curve;
+      concurrent.start(&owners[i % kObjects], std::move(curve));
+    }
+  });
+  for (int i = 0; i < kControlCalls; i++) {
+    float p[3];
+    concurrent.stop(&owners[(i * 7) % kObjects]);
+    concurrent.currentPosition(&owners[i % kObjects], p);
+  }
+  sequencer.join();
+  const double control = bench::secondsSince(controlStart);
+  for (int o = 0; o < kObjects; o++) {
+    concurrent.stop(&owners[o]);
+  }
+  // Wait for audio to apply the stops, then let the control side free
+  float p[3];
+  while (concurrent.currentPosition(&owners[0], p) ||
+         std::any_of(started.begin(), started.end(),
+                     [](const std::weak_ptr<const AutomationCurve> &curve) {
+                       return !curve.expired();
+                     })) {
+    std::this_thread::yield();
+    if (bench::secondsSince(controlStart) > control + 5.0) {
+      break;
+    }
+  }
+  audioRunning = false;
+  audio.join();
+  const long leaked = std::count_if(
+      started.begin(), started.end(),
+      [](const std::weak_ptr<const AutomationCurve> &curve) {
+        return !curve.expired();
+      });
+
+  printf("%d objects, %d files of %d lines, %d frame blocks\n", kObjects,
+         kFiles, kLinesPerFile, kBlockSize);
+  printf("%-40s %10.2f ms\n", "parse at trigger, one file per object",
+         perObject * 1e3);
+  printf("%-40s %10.2f ms\n", "parse once per file (AutomationLibrary)",
+         shared * 1e3);
+  printf("%-40s %10.2f us\n", "batch evaluation per block", batch * 1e6);
+  printf("%-40s %10.2f us\n", "track lookup by owner", lookup * 1e6);
+  printf("%-40s %10.2f us\n", "bisection per object per block",
+         bisect * 1e6);
+  printf("%-40s %10.2f us (%.2f%% of block)\n", "evaluation + panning 60 spk",
+         rendered * 1e6, 100.0 * rendered / blockSeconds);
+  printf("%-40s %10.2f us\n", "start + stop from two threads",
+         control / kControlCalls * 1e6);
+  if (leaked > 0) {
+    printf("FAILED: %ld of %d curves still alive after stopping every "
+           "track\n",
+           leaked, kControlCalls);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Benchmark for LbapPanner: cost of spatializing one audio block as the
+// number of sources and speakers grows.
+//
+// Three strategies are compared for each sources x speakers combination:
+//   per-sample   gains computed per block, applied sample by sample over
+//                every speaker (the way the scene spatializer used to work)
+//   block/moving LbapPanner with every source moving each block, so gains
+//                are recomputed and ramped
+//   block/still  LbapPanner with still sources, reusing cached gains
+//
+// Build and run with ./run.sh tools/audio/lbap_bench.cpp
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "LbapPanner.hpp"
+
+// Three rings, like the AlloSphere: a quarter of the speakers below, half at
+// ear level and a quarter above
+std::vector<PanSpeaker> ringLayout(int numSpeakers) {
+  std::vector<PanSpeaker> speakers;
+  int counts[3] = {numSpeakers / 4, numSpeakers - 2 * (numSpeakers / 4),
+                   numSpeakers / 4};
+  float elevations[3] = {-32.5f, 0.0f, 41.0f};
+  int channel = 0;
+  for (int ring = 0; ring < 3; ring++) {
+    for (int i = 0; i < counts[ring]; i++) {
+      speakers.push_back(
+          {360.0f * i / counts[ring] - 180.0f, elevations[ring], channel++});
+    }
+  }
+  return speakers;
+}
+
+int main() {
+  const int blockSize = 512;
+  const double sampleRate = 48000.0;
+  const double budget = blockSize / sampleRate;
+  const int speakerCounts[] = {8, 16, 32, 60, 128};
+  const int sourceCounts[] = {1, 8, 16, 32, 64, 128};
+
+  std::vector<float> input(blockSize);
+  for (int i = 0; i < blockSize; i++) {
+    input[i] = std::sin(0.05f * i);
+  }
+
+  printf("block %d frames @ %.0f Hz, budget %.1f us\n", blockSize, sampleRate,
+         budget * 1e6);
+  printf("%8s %8s %14s %14s %14s %10s\n", "speakers", "sources",
+         "per-sample us", "moving us", "still us", "moving %");
+
+  for (int numSpeakers : speakerCounts) {
+    LbapPanner panner;
+    panner.setLayout(ringLayout(numSpeakers));
+    std::vector<std::vector<float>> outs(numSpeakers,
+                                         std::vector<float>(blockSize));
+    std::vector<float *> outPtrs(numSpeakers);
+    for (int k = 0; k < numSpeakers; k++) {
+      outPtrs[k] = outs[k].data();
+    }
+    std::vector<float> gains(numSpeakers);
+
+    for (int numSources : sourceCounts) {
+      auto direction = [&](int source, float phase, float *d) {
+        float az = 6.2831853f * source / numSources + phase;
+        float el = 0.6f * std::sin(1.7f * source + phase);
+        d[0] = std::sin(az) * std::cos(el);
+        d[1] = std::cos(az) * std::cos(el);
+        d[2] = std::sin(el);
+      };
+
+      float phase = 0.0f;
+      double perSample = bench::measure([&]() {
+        phase += 0.01f;
+        for (int s = 0; s < numSources; s++) {
+          float d[3];
+          direction(s, phase, d);
+          panner.computeGains(d[0], d[1], d[2], gains.data());
+          for (int i = 0; i < blockSize; i++) {
+            for (int k = 0; k < numSpeakers; k++) {
+              if (gains[k] != 0.0f) {
+                outPtrs[k][i] += input[i] * gains[k];
+              }
+            }
+          }
+        }
+      });
+
+      double moving = bench::measure([&]() {
+        phase += 0.01f;
+        for (int s = 0; s < numSources; s++) {
+          float d[3];
+          direction(s, phase, d);
+          panner.renderSource(s, d[0], d[1], d[2], input.data(),
+                              outPtrs.data(), blockSize);
+        }
+      });
+
+      double still = bench::measure([&]() {
+        for (int s = 0; s < numSources; s++) {
+          float d[3];
+          direction(s, 0.0f, d);
+          panner.renderSource(s, d[0], d[1], d[2], input.data(),
+                              outPtrs.data(), blockSize);
+        }
+      });
+      bench::keep(outs[0][0]);
+
+      printf("%8d %8d %14.1f %14.1f %14.1f %9.1f%%\n", numSpeakers, numSources,
+             perSample * 1e6, moving * 1e6, still * 1e6,
+             100.0 * moving / budget);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Benchmark for PeakRmsMeter: audio callback cost of metering 64 channels of
+// 1024 frames, compared with the previous scalar meter that tracked the peak
+// with a branch per sample and took log10 per channel on the audio thread.
+//
+// Build and run with ./run.sh tools/audio/meter_bench.cpp
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "PeakRmsMeter.hpp"
+
+const int kChannels = 64;
+const int kFrames = 1024;
+
+// The per block work of the old Meter::processSound()
+struct ScalarMeter {
+  float temp[kChannels];
+  float values[kChannels] = {0};
+
+  void process(float *const *channels, int frames) {
+    for (int i = 0; i < kChannels; i++) {
+      temp[i] = 0;
+      const float *outBuf = channels[i];
+      for (int samp = 0; samp < frames; samp++) {
+        float val = std::fabs(*outBuf);
+        if (temp[i] < val) {
+          temp[i] = val;
+        }
+        outBuf++;
+      }
+      if (temp[i] == 0) {
+        temp[i] = 0.01f;
+      } else {
+        float db = 20.0f * std::log10(temp[i]);
+        temp[i] = db < -60 ? 0.01f : 0.01f + 0.005f * (60 + db);
+      }
+      if (values[i] > temp[i]) {
+        values[i] = values[i] - 0.05f * (values[i] - temp[i]);
+      } else {
+        values[i] = temp[i];
+      }
+    }
+  }
+};
+
+int main() {
+  std::vector<float> samples(size_t(kChannels) * kFrames);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (auto &s : samples) {
+    s = dist(rng) * dist(rng);
+  }
+  float *channels[kChannels];
+  for (int ch = 0; ch < kChannels; ch++) {
+    channels[ch] = samples.data() + size_t(ch) * kFrames;
+  }
+
+  ScalarMeter scalar;
+  double scalarTime = bench::measure([&]() {
+    scalar.process(channels, kFrames);
+    bench::keep(scalar.values);
+  });
+
+  PeakRmsMeter meter;
+  meter.setup(kChannels, kFrames); // publishes every block (worst case)
+  double simdTime = bench::measure([&]() { meter.process(channels, kFrames); });
+
+  // Reader side: fetch plus dB conversion of all channels
+  float db[2 * kChannels];
+  double readTime = bench::measure([&]() {
+    meter.process(channels, kFrames);
+    meter.fetch();
+    const MeterSnapshot &s = meter.latest();
+    for (int ch = 0; ch < s.numChannels; ch++) {
+      db[ch] = PeakRmsMeter::peakToDb(s.peak[ch]);
+      db[kChannels + ch] = PeakRmsMeter::meanSquareToDb(s.meanSquare[ch]);
+    }
+    bench::keep(db);
+  }) - simdTime;
+
+  const double budget = kFrames / 48000.0;
+  printf("%d channels x %d frames (%.2f ms @ 48 kHz)\n", kChannels, kFrames,
+         budget * 1000.0);
+  printf("%-28s %10.2f us %8.3f%% of block\n", "scalar peak + log10",
+         scalarTime * 1e6, 100.0 * scalarTime / budget);
+  printf("%-28s %10.2f us %8.3f%% of block\n", "simd peak/rms + publish",
+         simdTime * 1e6, 100.0 * simdTime / budget);
+  printf("%-28s %10.2f us (graphics thread)\n", "fetch + dB conversion",
+         std::max(0.0, readTime) * 1e6);
+  printf("speedup %.1fx\n", scalarTime / simdTime);
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Benchmark for PostFxStage: CPU cost per block of the post-spatialization
+// effects on 60 speaker outputs, stage by stage, and the cost left on the
+// audio thread when the stage runs asynchronously.
+//
+// Build and run with ./run.sh tools/audio/postfx_bench.cpp
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "PostFxStage.hpp"
+
+const int kOutputs = 60;
+const int kLfeChannel = 47;
+const double kSampleRate = 48000.0;
+
+struct Buffers {
+  std::vector<float> samples;
+  std::vector<float *> outs;
+  std::vector<float> busL, busR;
+
+  Buffers(int frames, float level)
+      : samples(size_t(kOutputs) * frames), outs(kOutputs), busL(frames),
+        busR(frames) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> dist(-level, level);
+    for (auto &s : samples) {
+      s = dist(rng);
+    }
+    for (int i = 0; i < frames; i++) {
+      busL[i] = dist(rng);
+      busR[i] = dist(rng);
+    }
+    for (int ch = 0; ch < kOutputs; ch++) {
+      outs[ch] = samples.data() + size_t(ch) * frames;
+    }
+  }
+};
+
+int main() {
+  std::vector<int> speakerChannels;
+  for (int ch = 0; ch < kOutputs; ch++) {
+    if (ch != kLfeChannel) {
+      speakerChannels.push_back(ch);
+    }
+  }
+
+  printf("%d outputs @ %.0f Hz, times per block\n", kOutputs, kSampleRate);
+  printf("%6s %14s %12s %12s %12s %12s %10s\n", "frames", "old lfe loop",
+         "lfe", "+reverb", "+limiter", "async call", "% block");
+
+  for (int frames : {128, 256, 512, 1024, 2048}) {
+    // Hot signal so the limiter is always working
+    Buffers buffers(frames, 1.5f);
+
+    // Previous code: per sample loop adding the bus to the LFE channel
+    double legacy = bench::measure([&]() {
+      float *lfe = buffers.outs[kLfeChannel];
+      for (int i = 0; i < frames; i++) {
+        float lfeLevel = 0.1f;
+        lfe[i] += buffers.busL[i] * lfeLevel;
+        lfe[i] += buffers.busR[i] * lfeLevel;
+      }
+      bench::keep(lfe[0]);
+    });
+
+    PostFxStage stage;
+    stage.prepare(kOutputs, frames, kSampleRate, kLfeChannel,
+                  speakerChannels);
+    auto run = [&]() {
+      stage.process(buffers.outs.data(), buffers.busL.data(),
+                    buffers.busR.data(), frames);
+      bench::keep(buffers.outs[0][0]);
+    };
+
+    stage.reverbSend(0.0f);
+    stage.limiterEnabled(false);
+    double lfe = bench::measure(run);
+    stage.reverbSend(0.5f);
+    double reverb = bench::measure(run);
+    stage.limiterEnabled(true);
+    double all = bench::measure(run);
+
+    // Asynchronous: time spent in the callback, paced like real blocks so
+    // the worker has a period to finish
+    stage.setAsync(true);
+    stage.prepare(kOutputs, frames, kSampleRate, kLfeChannel,
+                  speakerChannels);
+    const auto period = std::chrono::duration<double>(frames / kSampleRate);
+    std::vector<double> calls;
+    auto deadline = bench::Clock::now();
+    for (int block = 0; block < 200; block++) {
+      deadline += std::chrono::duration_cast<bench::Clock::duration>(period);
+      auto start = bench::Clock::now();
+      run();
+      calls.push_back(bench::secondsSince(start));
+      std::this_thread::sleep_until(deadline);
+    }
+    std::sort(calls.begin(), calls.end());
+    double async = calls[calls.size() / 2];
+
+    printf("%6d %11.2f us %9.2f us %9.2f us %9.2f us %9.2f us %9.3f%%\n",
+           frames, legacy * 1e6, lfe * 1e6, reverb * 1e6, all * 1e6,
+           async * 1e6, 100.0 * all / period.count());
+  }
+  return 0;
+}
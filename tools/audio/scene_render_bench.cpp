@@ -0,0 +1,147 @@
+// Benchmark for ParallelBusRenderer: how many scene objects can be rendered
+// and spatialized onto the 60 AlloSphere speakers without an xrun, for 1 to 8
+// render threads.
+//
+// Each object runs a small synthesis voice (oscillator, envelope follower and
+// a filter) and is panned with LbapPanner while it slowly moves. Blocks are
+// paced in real time like an audio callback; a block that takes longer than
+// its period counts as an xrun.
+//
+// Build and run with ./run.sh tools/audio/scene_render_bench.cpp
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "LbapPanner.hpp"
+#include "ParallelBusRenderer.hpp"
+
+const int kBlockSize = 512;
+const double kSampleRate = 48000.0;
+const int kBlocksPerTrial = 48;
+
+struct TestVoice {
+  float phase = 0, freq = 0, env = 0, lp = 0;
+
+  void process(float *out, int n) {
+    for (int i = 0; i < n; i++) {
+      float s = std::sin(phase);
+      phase += freq;
+      if (phase > 6.2831853f) {
+        phase -= 6.2831853f;
+      }
+      lp += 0.1f * (s - lp);
+      env += 0.001f * (std::fabs(lp) - env);
+      out[i] = lp * 0.1f;
+    }
+  }
+};
+
+std::vector<PanSpeaker> allosphereLikeLayout() {
+  std::vector<PanSpeaker> speakers;
+  int counts[3] = {12, 30, 18};
+  float elevations[3] = {-32.5f, 0.0f, 41.0f};
+  int channel = 0;
+  for (int ring = 0; ring < 3; ring++) {
+    for (int i = 0; i < counts[ring]; i++) {
+      speakers.push_back(
+          {360.0f * i / counts[ring] - 180.0f, elevations[ring], channel++});
+    }
+  }
+  return speakers;
+}
+
+// Renders kBlocksPerTrial paced blocks; returns true if none overran
+bool runTrial(ParallelBusRenderer &renderer, LbapPanner &panner,
+              int numObjects, double *worstBlock) {
+  std::vector<TestVoice> voices(numObjects);
+  for (int v = 0; v < numObjects; v++) {
+    voices[v].freq = 0.01f + 0.0005f * (v % 97);
+  }
+  panner.reserveSources(numObjects);
+  panner.resetSources();
+  const int numSpeakers = panner.numSpeakers();
+  std::vector<std::vector<float>> scratch(renderer.numWorkers(),
+                                          std::vector<float>(kBlockSize));
+  std::vector<std::vector<float>> outs(numSpeakers,
+                                       std::vector<float>(kBlockSize));
+  std::vector<float *> outPtrs(numSpeakers);
+  for (int k = 0; k < numSpeakers; k++) {
+    outPtrs[k] = outs[k].data();
+  }
+
+  const auto period = std::chrono::duration<double>(kBlockSize / kSampleRate);
+  auto deadline = bench::Clock::now();
+  bool ok = true;
+  *worstBlock = 0;
+  for (int block = 0; block < kBlocksPerTrial; block++) {
+    deadline += std::chrono::duration_cast<bench::Clock::duration>(period);
+    auto start = bench::Clock::now();
+    for (auto &out : outs) {
+      std::fill(out.begin(), out.end(), 0.0f);
+    }
+    renderer.render(numObjects, [&](size_t v, unsigned worker,
+                                    float *const *bus) {
+      float *samples = scratch[worker].data();
+      voices[v].process(samples, kBlockSize);
+      float az = 0.01f * block + 0.37f * v;
+      panner.renderSource(int(v), std::sin(az), std::cos(az),
+                          0.3f * std::sin(0.7f * v), samples, bus, kBlockSize);
+    });
+    renderer.mixInto(outPtrs.data());
+    double elapsed = bench::secondsSince(start);
+    *worstBlock = std::max(*worstBlock, elapsed);
+    if (elapsed > period.count()) {
+      ok = false;
+      break;
+    }
+    std::this_thread::sleep_until(deadline);
+  }
+  bench::keep(outs[0][0]);
+  return ok;
+}
+
+int main() {
+  LbapPanner panner;
+  panner.setLayout(allosphereLikeLayout());
+  const int maxObjects = 8192;
+
+  printf("block %d frames @ %.0f Hz (%.2f ms), %d speakers, %u cores\n",
+         kBlockSize, kSampleRate, 1000.0 * kBlockSize / kSampleRate,
+         panner.numSpeakers(), std::thread::hardware_concurrency());
+  printf("%8s %14s %18s\n", "threads", "max objects", "worst block ms");
+
+  for (unsigned threads = 1; threads <= 8; threads++) {
+    ParallelBusRenderer renderer(threads);
+    renderer.prepare(panner.numSpeakers(), kBlockSize);
+
+    // Double until an xrun, then bisect
+    int good = 0, bad = 0;
+    double worst = 0, goodWorst = 0;
+    for (int n = 16; n <= maxObjects; n *= 2) {
+      if (runTrial(renderer, panner, n, &worst)) {
+        good = n;
+        goodWorst = worst;
+      } else {
+        bad = n;
+        break;
+      }
+    }
+    while (bad && bad - good > std::max(4, good / 32)) {
+      int mid = (good + bad) / 2;
+      if (runTrial(renderer, panner, mid, &worst)) {
+        good = mid;
+        goodWorst = worst;
+      } else {
+        bad = mid;
+      }
+    }
+    printf("%8u %13d%s %18.2f\n", threads, good, bad ? " " : "+",
+           goodWorst * 1000.0);
+  }
+  return 0;
+}
@@ -8,11 +8,9 @@
 #include "al/math/al_Spherical.hpp"
 #include "al/scene/al_DistributedScene.hpp"
 #include "al/sound/al_DownMixer.hpp"
-#include "al/sound/al_Lbap.hpp"
 #include "al/sound/al_Speaker.hpp"
 #include "al/sound/al_SpeakerAdjustment.hpp"
 #include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
-#include "al/sphere/al_Meter.hpp"
 #include "al/sphere/al_SphereUtils.hpp"
 #include "al/ui/al_FileSelector.hpp"
 #include "al/ui/al_ParameterGUI.hpp"
@@ -23,10 +21,17 @@
 #include "Gamma/Analysis.h"
 #include "Gamma/scl.h"
 
+#include "AutomationEngine.hpp"
+#include "BlockLbap.hpp"
+#include "ParallelScene.hpp"
+#include "PostFxStage.hpp"
+#include "SpeakerMeter.hpp"
+
 using namespace al;
 
 struct SharedState {
-  float meterValues[64] = {0};
+  float meterValues[64] = {0};      // linear peak per device channel
+  float meterMeanSquares[64] = {0}; // RMS squared per device channel
 };
 
 struct MappedAudioFile {
@@ -40,6 +45,8 @@ struct MappedAudioFile {
 
 struct AudioObjectData {
   std::string rootPath;
+  AutomationLibrary *automationFiles;
+  AutomationEngine *automation;
   uint16_t audioSampleRate;
   uint16_t audioBlockSize;
   Mesh *mesh;
@@ -62,16 +69,26 @@ public:
     registerTriggerParameters(file, automation, gain);
     registerParameters(env);             // Propagate from audio rendering node
     registerParameters(parameterPose()); // Update position in secondary nodes
+  }
 
-    mSequencer << parameterPose();
-    mPresetHandler << parameterPose();
-    mSequencer << mPresetHandler; // For morphing
+  void update(double dt) override {
+    // The spatializer reads positions from the automation engine directly;
+    // the pose is only updated for graphics and secondary nodes
+    auto objData = static_cast<AudioObjectData *>(userData());
+    float p[3];
+    if (isPrimary() && objData->automation->currentPosition(this, p)) {
+      setPose(Pose(Vec3d(p[0], p[1], p[2]), pose().quat()));
+    }
   }
 
   void onProcess(AudioIOData &io) override {
-    float buffer[2048 * 60];
     int numChannels = soundfile.channels();
     assert(io.framesPerBuffer() < INT32_MAX);
+    if (mReadBuffer.size() < io.framesPerBuffer() * numChannels) {
+      // Only when the block size grows after the voice was triggered
+      mReadBuffer.resize(io.framesPerBuffer() * numChannels);
+    }
+    float *buffer = mReadBuffer.data();
     auto framesRead =
         soundfile.read(buffer, static_cast<int>(io.framesPerBuffer()));
     int outIndex = 0;
@@ -107,12 +124,14 @@ public:
         std::cerr << "ERROR: opening audio file: "
                   << File::conformPathToOS(rootPath) + file.get() << std::endl;
       }
-
-      float seqStep = (float)objData->audioBlockSize / objData->audioSampleRate;
-      mSequencer.setSequencerStepTime(seqStep);
-
-      mSequencer.playSequence(File::conformPathToOS(rootPath) +
-                              automation.get());
+      // Voices may be rendered on worker threads with small stacks, so the
+      // read buffer lives on the heap
+      mReadBuffer.resize(objData->audioBlockSize * soundfile.channels());
+
+      // Parsed once per file and shared by all objects using it
+      auto curve = objData->automationFiles->get(
+          File::conformPathToOS(rootPath) + automation.get());
+      objData->automation->start(this, curve);
     }
     auto colorIndex = automation.get()[0] - 'A';
     c = HSV(colorIndex / 6.0f, 1.0f, 1.0f);
@@ -120,18 +139,19 @@ public:
 
   void onTriggerOff() override {
     if (isPrimary()) {
-      mPresetHandler.stopMorphing();
-      mSequencer.stopSequence();
+      static_cast<AudioObjectData *>(userData())->automation->stop(this);
       soundfile.close();
     }
   }
 
-  void onFree() override { soundfile.close(); }
+  void onFree() override {
+    static_cast<AudioObjectData *>(userData())->automation->stop(this);
+    soundfile.close();
+  }
 
 private:
-  PresetSequencer mSequencer;
-  PresetHandler mPresetHandler{""};
   SoundFileBuffered soundfile{8192};
+  std::vector<float> mReadBuffer;
   Color c;
 
   gam::EnvFollow<> mEnvFollow;
@@ -141,10 +161,14 @@ class SpatialSequencer : public DistributedAppWithState<SharedState> {
 public:
   std::string rootDir{""};
 
-  DistributedScene scene{"spatial_sequencer", 0,
-                         TimeMasterMode::TIME_MASTER_UPDATE};
+  // Voices are rendered in parallel on all cores but one
+  ParallelScene<DistributedScene> scene{"spatial_sequencer", 0,
+                                        TimeMasterMode::TIME_MASTER_UPDATE};
 
   ParameterBool downMix{"downMix"};
+  Parameter reverbSend{"reverbSend", "", 0.0, 0.0, 1.0};
+  Parameter reverbTime{"reverbTime", "", 2.5, 0.1, 10.0};
+  Parameter lfeLevel{"lfeLevel", "", 0.1, 0.0, 1.0};
 
   PersistentConfig config;
   DownMixer downMixer;
@@ -158,6 +182,8 @@ public:
     // Prepare scene shared data
     mObjectData.mesh = &this->mObjectMesh;
     mObjectData.rootPath = rootDir;
+    mObjectData.automationFiles = &mAutomationFiles;
+    mObjectData.automation = &mAutomation;
     mObjectData.audioSampleRate = audioIO().framesPerSecond();
     mObjectData.audioBlockSize = audioIO().framesPerBuffer();
     scene.setDefaultUserData(&mObjectData);
@@ -165,7 +191,8 @@ public:
     if (al::sphere::isSimulatorMachine()) {
     }
     auto sl = al::AlloSphereSpeakerLayoutCompensated();
-    mSpatializer = scene.setSpatializer<Lbap>(sl);
+    mSpatializer = scene.setSpatializer<BlockLbap>(sl);
+    scene.automation(&mAutomation);
 
     audioIO().channelsOut(60);
     audioIO().print();
@@ -173,6 +200,13 @@ public:
     downMixer.layoutToStereo(sl, audioIO());
     downMixer.setStereoOutput();
 
+    // LFE, reverb and limiter run on their own core, one block behind
+    for (const auto &speaker : sl) {
+      mReverbChannels.push_back(speaker.deviceChannel);
+    }
+    mPostFx.setAsync(true);
+    preparePostFx();
+
     mSequencer << scene;
 
     registerDynamicScene(scene);
@@ -183,10 +217,21 @@ public:
     if (isPrimary()) {
       auto guiDomain = GUIDomain::enableGUI(defaultWindowDomain());
       auto &gui = guiDomain->newGUI();
-      gui << downMix << mSequencer << audioDomain()->parameters()[0];
+      gui << downMix << reverbSend << reverbTime << lfeLevel << mSequencer
+          << audioDomain()->parameters()[0];
       gui.drawFunction = [&]() {
         if (ParameterGUI::drawAudioIO(audioIO())) {
+          // The render threads and the effects reallocate the buffers
+          // onSound() works in, so audio stops while they are resized
+          const bool running = audioIO().isRunning();
+          if (running) {
+            audioIO().stop();
+          }
           scene.prepare(audioIO());
+          preparePostFx();
+          if (running) {
+            audioIO().start();
+          }
           mObjectData.audioSampleRate = audioIO().framesPerSecond();
           mObjectData.audioBlockSize = audioIO().framesPerBuffer();
         }
@@ -201,17 +246,21 @@ public:
     mSphereMesh.update();
     addSphere(mObjectMesh, 0.1, 8, 4);
     mObjectMesh.update();
-    mMeter.init(mSpatializer->speakerLayout());
+    mMeter.init(mSpatializer->speakerLayout(), audioIO().framesPerSecond(),
+                graphicsDomain()->fps());
+    // Start the render threads and size their buffers before audio starts
+    scene.renderThreads();
+    scene.prepare(audioIO());
   }
 
   void onAnimate(double dt) override {
     mSequencer.update(dt);
     if (isPrimary()) {
-      auto &values = mMeter.getMeterValues();
-      assert(values.size() < 65);
-      memcpy(state().meterValues, values.data(), values.size() * sizeof(float));
+      mMeter.update();
+      mMeter.exportValues(state().meterValues, state().meterMeanSquares);
     } else {
-      mMeter.setMeterValues(state().meterValues, 64);
+      mMeter.setMeterValues(state().meterValues, state().meterMeanSquares,
+                            64);
     }
   }
 
@@ -241,11 +290,16 @@ public:
     mMeter.processSound(io);
     // downmix to stereo to bus 0 and 1
     downMixer.downMixToBus(io);
-    // This can be used to create a global reverb
-    while (io()) {
-      float lfeLevel = 0.1;
-      io.out(47) += io.bus(0) * lfeLevel;
-      io.out(47) += io.bus(1) * lfeLevel;
+    // LFE bass management, global reverb and limiter on the speaker outputs
+    mPostFx.lfeLevel(lfeLevel);
+    mPostFx.reverbSend(reverbSend);
+    mPostFx.reverbTime(reverbTime);
+    if (mOuts.size() == io.channelsOut()) {
+      for (unsigned ch = 0; ch < io.channelsOut(); ch++) {
+        mOuts[ch] = io.outBuffer(ch);
+      }
+      mPostFx.process(mOuts.data(), io.busBuffer(0), io.busBuffer(1),
+                      io.framesPerBuffer());
     }
     if (downMix) {
       downMixer.copyBusToOuts(io);
@@ -255,13 +309,24 @@ public:
   void onExit() override {}
 
 private:
+  void preparePostFx() {
+    mOuts.resize(audioIO().channelsOut());
+    mPostFx.prepare(audioIO().channelsOut(), audioIO().framesPerBuffer(),
+                    audioIO().framesPerSecond(), 47, mReverbChannels);
+  }
+
   VAOMesh mObjectMesh;
   VAOMesh mSphereMesh;
 
   SynthSequencer mSequencer{TimeMasterMode::TIME_MASTER_CPU};
   AudioObjectData mObjectData;
+  AutomationLibrary mAutomationFiles;
+  AutomationEngine mAutomation;
   SpeakerDistanceGainAdjustmentProcessor gainAdjustment;
-  Meter mMeter;
+  SpeakerMeter mMeter;
+  PostFxStage mPostFx;
+  std::vector<int> mReverbChannels;
+  std::vector<float *> mOuts;
   std::shared_ptr<Spatializer> mSpatializer;
 };
 
@@ -10,7 +10,6 @@
 #include "al/math/al_Spherical.hpp"
 #include "al/scene/al_DistributedScene.hpp"
 #include "al/sound/al_DownMixer.hpp"
-#include "al/sound/al_Lbap.hpp"
 #include "al/sound/al_Speaker.hpp"
 #include "al/sound/al_SpeakerAdjustment.hpp"
 #include "al/sphere/al_AlloSphereSpeakerLayout.hpp"
@@ -26,10 +25,15 @@
 #include "Gamma/Noise.h"
 #include "Gamma/scl.h"
 
+#include "BlockLbap.hpp"
+#include "ParallelScene.hpp"
+#include "SpeakerMeter.hpp"
+
 using namespace al;
 
 struct SharedState {
-  float meterValues[64] = {0};
+  float meterValues[64] = {0};      // linear peak per device channel
+  float meterMeanSquares[64] = {0}; // RMS squared per device channel
   Pose pose;
 };
 
@@ -39,96 +43,6 @@ struct AudioObjectData {
   Mesh *mesh;
 };
 
-class Meter {
-public:
-  void init(const Speakers &sl) {
-    addCube(mMesh);
-    mSl = sl;
-  }
-
-  void processSound(AudioIOData &io) {
-
-    if (tempValues.size() != io.channelsOut()) {
-      tempValues.resize(io.channelsOut());
-      values.resize(io.channelsOut());
-      std::cout << "Resizing Meter buffers" << std::endl;
-    }
-    for (int i = 0; i < io.channelsOut(); i++) {
-      tempValues[i] = FLT_MIN;
-      auto *outBuf = io.outBuffer(i);
-      auto fpb = io.framesPerBuffer();
-      for (int samp = 0; samp < fpb; samp++) {
-        float val = fabs(*outBuf);
-        if (tempValues[i] < val) {
-          tempValues[i] = val;
-        }
-        outBuf++;
-      }
-      if (tempValues[i] == 0) {
-        tempValues[i] = 0.01;
-      } else {
-        float db = 20.0 * log10(tempValues[i]);
-        if (db < -60) {
-          tempValues[i] = 0.01;
-        } else {
-          tempValues[i] = 0.01 + 0.005 * (60 + db);
-        }
-      }
-      if (values[i] > tempValues[i]) {
-        values[i] = values[i] - 0.05 * (values[i] - tempValues[i]);
-      } else {
-        values[i] = tempValues[i];
-      }
-    }
-  }
-
-  void draw(Graphics &g) {
-    g.polygonLine();
-    int index = 0;
-    auto spkrIt = mSl.begin();
-    g.color(1);
-    for (const auto &v : values) {
-      if (spkrIt != mSl.end()) {
-        // FIXME assumes speakers are sorted by device channel index
-        // Should sort inside init()
-        if (spkrIt->deviceChannel == index) {
-          g.pushMatrix();
-          g.scale(1 / 5.0f);
-          g.translate(spkrIt->vecGraphics());
-          g.scale(0.1 + v * 5);
-          g.draw(mMesh);
-          g.popMatrix();
-          spkrIt++;
-        }
-      } else {
-        spkrIt = mSl.begin();
-      }
-      index++;
-    }
-  }
-
-  const std::vector<float> &getMeterValues() { return values; }
-
-  void setMeterValues(float *newValues, size_t count) {
-    if (tempValues.size() != count) {
-      tempValues.resize(count);
-      values.resize(count);
-      std::cout << "Resizing Meter buffers" << std::endl;
-    }
-    count = values.size();
-    for (int i = 0; i < count; i++) {
-      values[i] = *newValues;
-      newValues++;
-    }
-  }
-
-private:
-  Mesh mMesh;
-  std::vector<float> values;
-  std::vector<float> tempValues;
-  Speakers mSl;
-};
-
 class AudioObject : public PositionedVoice {
 public:
   // Variable params
@@ -227,8 +141,8 @@ class SpatialSequencer : public DistributedAppWithState<SharedState> {
 public:
   std::string rootDir{""};
 
-  DistributedScene scene{"spatial_sequencer", 0,
-                         TimeMasterMode::TIME_MASTER_GRAPHICS};
+  ParallelScene<DistributedScene> scene{"spatial_sequencer", 0,
+                                        TimeMasterMode::TIME_MASTER_GRAPHICS};
 
   PersistentConfig config;
 
@@ -245,7 +159,7 @@ public:
     scene.setDefaultUserData(&mObjectData);
 
     auto sl = al::AlloSphereSpeakerLayoutCompensated();
-    mSpatializer = scene.setSpatializer<Lbap>(sl);
+    mSpatializer = scene.setSpatializer<BlockLbap>(sl);
 
     audioIO().channelsOut(60);
     audioIO().print();
@@ -296,18 +210,22 @@ public:
     mSphereMesh.update();
     addSphere(mObjectMesh, 0.1, 8, 4);
     mObjectMesh.update();
-    mMeter.init(mSpatializer->speakerLayout());
+    mMeter.init(mSpatializer->speakerLayout(), audioIO().framesPerSecond(),
+                graphicsDomain()->fps());
+    // Start the render threads and size their buffers before audio starts
+    scene.renderThreads();
+    scene.prepare(audioIO());
   }
 
   void onAnimate(double dt) override {
     mSequencer.update(dt);
     if (isPrimary()) {
-      auto &values = mMeter.getMeterValues();
-      assert(values.size() < 65);
-      memcpy(state().meterValues, values.data(), values.size() * sizeof(float));
+      mMeter.update();
+      mMeter.exportValues(state().meterValues, state().meterMeanSquares);
       state().pose = nav();
     } else {
-      mMeter.setMeterValues(state().meterValues, 64);
+      mMeter.setMeterValues(state().meterValues, state().meterMeanSquares,
+                            64);
       nav().set(state().pose);
     }
   }
@@ -363,7 +281,7 @@ private:
   SynthSequencer mSequencer{TimeMasterMode::TIME_MASTER_CPU};
   AudioObjectData mObjectData;
   SpeakerDistanceGainAdjustmentProcessor gainAdjustment;
-  Meter mMeter;
+  SpeakerMeter mMeter;
   std::shared_ptr<Spatializer> mSpatializer;
 };
 
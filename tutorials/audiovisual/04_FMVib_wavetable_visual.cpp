@@ -22,10 +22,12 @@
 #include "al/ui/al_ControlGUI.hpp"
 #include "al/ui/al_Parameter.hpp"
 
+#include "SpectrumAnalyzer.hpp"
+
 // using namespace gam;
 using namespace al;
 using namespace std;
-#define FFT_SIZE 4048
+#define FFT_SIZE 4096
 
 // tables for oscillator
 gam::ArrayPow2<float> tbSaw(2048), tbSqr(2048), tbImp(2048), tbSin(2048),
@@ -312,7 +314,9 @@ public:
   bool showGUI = true;
   bool showSpectro = true;
   bool navi = false;
-  gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+  // Analyzes the output on a thread of its own; the audio callback only
+  // hands it the samples
+  SpectrumAnalyzer analyzer{FFT_SIZE, FFT_SIZE / 4};
 
   void onInit() override
   {
@@ -322,6 +326,7 @@ public:
                                 // will be using keyboard for note triggering
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    analyzer.start(audioIO().framesPerSecond());
     // Check for connected MIDI devices
     if (midiIn.getPortCount() > 0)
     {
@@ -353,21 +358,13 @@ public:
   void onSound(AudioIOData &io) override
   {
     synthManager.render(io); // Render audio
-    // STFT
     while (io())
     {
       io.out(0) = tanh(io.out(0));
       io.out(1) = tanh(io.out(1));
-      if (stft(io.out(0)))
-      { // Loop through all the frequency bins
-        for (unsigned k = 0; k < stft.numBins(); ++k)
-        {
-          // Here we simply scale the complex sample
-          spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-          // spectrum[k] = stft.bin(k).real();
-        }
-      }
     }
+    // STFT, on the analyzer's thread
+    analyzer.push(io.outBuffer(0), io.framesPerBuffer());
   }
 
   void onAnimate(double dt) override
@@ -384,6 +381,15 @@ public:
   {
     g.clear();
     synthManager.render(g);
+    // The newest spectrum, if the analysis thread published one
+    if (analyzer.fetch())
+    {
+      const vector<float> &bins = analyzer.spectrum().bins;
+      for (unsigned k = 0; k < bins.size(); ++k)
+      {
+        spectrum[k] = tanh(pow(bins[k], 1.3));
+      }
+    }
     // // Draw Spectrum
     mSpectrogram.reset();
     mSpectrogram.primitive(Mesh::LINE_STRIP);
@@ -496,7 +502,11 @@ public:
     return true;
   }
 
-  void onExit() override { imguiShutdown(); }
+  void onExit() override
+  {
+    analyzer.stop();
+    imguiShutdown();
+  }
 };
 
 int main()
@@ -31,6 +31,8 @@
 #include <cstdint>   
 #include <vector>
 
+#include "SpectrumAnalyzer.hpp"
+
 using namespace gam;
 using namespace al;
 using namespace std;
@@ -38,7 +40,7 @@ using namespace std;
 // tables for oscillator
 gam::ArrayPow2<float>
     tbSin(2048), tbSqr(2048), tbPls(2048), tbDin(2048);
-#define FFT_SIZE 4048
+#define FFT_SIZE 4096
 Vec3f randomVec3f(float scale)
 {
   return Vec3f(al::rnd::uniformS(), al::rnd::uniformS(), al::rnd::uniformS()) * scale;
@@ -246,7 +248,9 @@ public:
   bool showGUI = true;
   bool showSpectro = true;
   bool navi = false;
-  gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+  // Analyzes the output on a thread of its own; the audio callback only
+  // hands it the samples
+  SpectrumAnalyzer analyzer{FFT_SIZE, FFT_SIZE / 4};
 
   virtual void onInit() override
   {
@@ -273,6 +277,7 @@ public:
                                 // will be using keyboard for note triggering
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    analyzer.start(audioIO().framesPerSecond());
 
     gam::addWave(tbSin, SINE);
     gam::addWave(tbSqr, SQUARE);
@@ -302,16 +307,9 @@ public:
     {
       io.out(0) = tanh(io.out(0));
       io.out(1) = tanh(io.out(1));
-      if (stft(io.out(0)))
-      { // Loop through all the frequency bins
-        for (unsigned k = 0; k < stft.numBins(); ++k)
-        {
-          // Here we simply scale the complex sample
-          spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-          // spectrum[k] = stft.bin(k).real();
-        }
-      }
     }
+    // STFT, on the analyzer's thread
+    analyzer.push(io.outBuffer(0), io.framesPerBuffer());
   }
 
   void onAnimate(double dt) override
@@ -329,6 +327,15 @@ public:
   {
     g.clear(0);
     synthManager.render(g);
+    // The newest spectrum, if the analysis thread published one
+    if (analyzer.fetch())
+    {
+      const vector<float> &bins = analyzer.spectrum().bins;
+      for (unsigned k = 0; k < bins.size(); ++k)
+      {
+        spectrum[k] = tanh(pow(bins[k], 1.3));
+      }
+    }
     // // Draw Spectrum
     mSpectrogram.reset();
     mSpectrogram.primitive(Mesh::LINE_STRIP);
@@ -436,7 +443,11 @@ public:
     return true;
   }
 
-  void onExit() override { imguiShutdown(); }
+  void onExit() override
+  {
+    analyzer.stop();
+    imguiShutdown();
+  }
 };
 
 int main()
@@ -4,6 +4,7 @@
 // Myungin Lee
 
 // Press '[' or ']' to turn on & off GUI
+// '\\' to switch the spectrum between waterfall and line
 // '=' to navigate pov
 // Able to play with MIDI device
 // To change the default instrument, change <FMWT> in line 43 to .. 
@@ -28,11 +29,12 @@
 #include "al/io/al_MIDI.hpp"
 #include "al/math/al_Random.hpp"
 #include "_instrument_classes.cpp"
+#include "SpectrogramView.hpp"
 
 using namespace gam;
 using namespace al;
 using namespace std;
-#define FFT_SIZE 4048
+#define FFT_SIZE 4096
 
 class MyApp : public App, public MIDIMessageHandler
 {
@@ -48,12 +50,16 @@ public:
   float halfStepInterval = 1.05946309; // 2^(1/12)
   RtMidiIn midiIn;                     // MIDI input carrier
 
-  Mesh mSpectrogram;
-  vector<float> spectrum;
+  // Spectra scroll through a texture drawn on a single quad
+  SpectrogramView spectrogram;
   bool showGUI = true;
   bool showSpectro = true;
+  bool waterfall = true;
   bool navi = false;
-  gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
+  // Analyzes the output on a thread of its own; the audio callback only
+  // hands it the samples
+  SpectrumAnalyzer analyzer{FFT_SIZE, FFT_SIZE / 4,
+                            SpectrumAnalyzer::kDecibels};
 
   virtual void onInit() override
   {
@@ -73,14 +79,12 @@ public:
     {
       printf("Error: No MIDI devices found.\n");
     }
-    // Declare the size of the spectrum
-    spectrum.resize(FFT_SIZE / 2 + 1);
-
     imguiInit();
     navControl().active(false); // Disable navigation via keyboard, since we
                                 // will be using keyboard for note triggering
     // Set sampling rate for Gamma objects from app's audio
     gam::sampleRate(audioIO().framesPerSecond());
+    analyzer.start(audioIO().framesPerSecond());
   }
 
   void onCreate() override
@@ -88,6 +92,9 @@ public:
     // Play example sequence. Comment this line to start from scratch
     //    synthManager.synthSequencer().playSequence("synth7.synthSequence");
     synthManager.synthRecorder().verbose(true);
+    // Frequencies on a log scale from 20 Hz
+    spectrogram.create(analyzer.bins());
+    spectrogram.lowest = 20 / (audioIO().framesPerSecond() / 2);
         // Add another class used
         synthManager.synth().registerSynthClass<SineEnv>();
         synthManager.synth().registerSynthClass<OscEnv>();
@@ -104,19 +111,8 @@ public:
   void onSound(AudioIOData &io) override
   {
     synthManager.render(io); // Render audio
-    // STFT
-    while (io())
-    {
-      if (stft(io.out(0)))
-      { // Loop through all the frequency bins
-        for (unsigned k = 0; k < stft.numBins(); ++k)
-        {
-          // Here we simply scale the complex sample
-          spectrum[k] = tanh(pow(stft.bin(k).real(), 1.3));
-          // spectrum[k] = stft.bin(k).real();
-        }
-      }
-    }
+    // STFT, on the analyzer's thread
+    analyzer.push(io.outBuffer(0), io.framesPerBuffer());
   }
 
   void onAnimate(double dt) override
@@ -132,22 +128,21 @@ public:
     g.clear();
     // Render the synth's graphics
     synthManager.render(g);
+    // The newest spectrum, if the analysis thread published one, goes
+    // into the spectrogram's texture
+    spectrogram.update(analyzer);
     // // Draw Spectrum
-    mSpectrogram.reset();
-    mSpectrogram.primitive(Mesh::LINE_STRIP);
     if (showSpectro)
     {
-      for (int i = 0; i < FFT_SIZE / 2; i++)
-      {
-        mSpectrogram.color(HSV(0.5 - spectrum[i] * 100));
-        mSpectrogram.vertex(i, spectrum[i], 0.0);
-      }
-      g.meshColor(); // Use the color in the mesh
+      g.blending(true);
+      g.blendTrans();
       g.pushMatrix();
-      g.translate(-3.0, -3, -15);
-      g.scale(10.0 / FFT_SIZE, 1000, 1.0);
-      g.draw(mSpectrogram);
+      g.translate(-0.5, -2, -15);
+      g.scale(2.5, 1, 1.0);
+      spectrogram.draw(g, waterfall ? SpectrogramView::kWaterfall
+                                    : SpectrogramView::kLine);
       g.popMatrix();
+      g.blending(false);
     }
     // GUI is drawn here
     if (showGUI)
@@ -220,6 +215,9 @@ public:
     case '[':
       showSpectro = !showSpectro;
       break;
+    case '\\':
+      waterfall = !waterfall;
+      break;
     case '=':
       navi = !navi;
       break;
@@ -237,7 +235,11 @@ public:
     return true;
   }
 
-  void onExit() override { imguiShutdown(); }
+  void onExit() override
+  {
+    analyzer.stop();
+    imguiShutdown();
+  }
 };
 
 int main()
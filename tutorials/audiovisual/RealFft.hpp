@@ -0,0 +1,117 @@
+#pragma once
+#ifndef REAL_FFT_HPP
+#define REAL_FFT_HPP
+
+// Forward FFT of a real signal whose size is a power of two, for
+// SpectrumAnalyzer.hpp.
+//
+// The N real samples are packed into N / 2 complex ones, even samples as
+// real parts and odd ones as imaginary parts, which an iterative radix-2
+// FFT transforms in place; the N / 2 + 1 bins of the real signal are then
+// unpacked from the result. That does half the work of a complex FFT of
+// size N. Complex numbers live in separate real and imaginary arrays, and
+// every stage of the FFT reads its twiddle factors from a contiguous table,
+// so the butterfly loops run over consecutive memory. The tables are made
+// once by the constructor; forward() allocates nothing.
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+class RealFft {
+public:
+  // Sizes that are not a power of two are rounded up to one, at least 4
+  explicit RealFft(int size) {
+    mSize = 4;
+    while (mSize < size) {
+      mSize *= 2;
+    }
+    mHalf = mSize / 2;
+    const double pi = 3.14159265358979323846;
+
+    mReverse.resize(mHalf);
+    int bits = 0;
+    while ((1 << bits) < mHalf) {
+      bits++;
+    }
+    for (int i = 0; i < mHalf; i++) {
+      int r = 0;
+      for (int b = 0; b < bits; b++) {
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      }
+      mReverse[i] = r;
+    }
+
+    // The stage joining transforms of `half` points uses e^(-2 pi i k /
+    // (2 half)) for k < half, stored from offset half - 1
+    mTwiddleRe.resize(mHalf);
+    mTwiddleIm.resize(mHalf);
+    for (int half = 1; half < mHalf; half *= 2) {
+      for (int k = 0; k < half; k++) {
+        const double angle = -pi * k / half;
+        mTwiddleRe[half - 1 + k] = float(std::cos(angle));
+        mTwiddleIm[half - 1 + k] = float(std::sin(angle));
+      }
+    }
+    // e^(-2 pi i k / N) for the unpacking
+    mUnpackRe.resize(mHalf + 1);
+    mUnpackIm.resize(mHalf + 1);
+    for (int k = 0; k <= mHalf; k++) {
+      const double angle = -2 * pi * k / mSize;
+      mUnpackRe[k] = float(std::cos(angle));
+      mUnpackIm[k] = float(std::sin(angle));
+    }
+    mRe.resize(mHalf);
+    mIm.resize(mHalf);
+  }
+
+  int size() const { return mSize; }
+  int bins() const { return mHalf + 1; }
+
+  // X[k] = sum of in[n] e^(-2 pi i k n / N) for the bins() k from 0 to
+  // N / 2, unnormalized. in holds size() samples; re and im get bins()
+  // values each and must not overlap in.
+  void forward(const float *in, float *re, float *im) {
+    float *zr = mRe.data(), *zi = mIm.data();
+    for (int j = 0; j < mHalf; j++) {
+      zr[mReverse[j]] = in[2 * j];
+      zi[mReverse[j]] = in[2 * j + 1];
+    }
+    for (int half = 1; half < mHalf; half *= 2) {
+      const float *wr = &mTwiddleRe[half - 1], *wi = &mTwiddleIm[half - 1];
+      for (int start = 0; start < mHalf; start += 2 * half) {
+        float *ar = zr + start, *ai = zi + start;
+        float *br = ar + half, *bi = ai + half;
+        for (int k = 0; k < half; k++) {
+          const float tr = br[k] * wr[k] - bi[k] * wi[k];
+          const float ti = br[k] * wi[k] + bi[k] * wr[k];
+          br[k] = ar[k] - tr;
+          bi[k] = ai[k] - ti;
+          ar[k] += tr;
+          ai[k] += ti;
+        }
+      }
+    }
+
+    // Z[k] holds E[k] + i O[k], the transforms of the even and the odd
+    // samples, so E[k] = (Z[k] + conj(Z[-k])) / 2,
+    // O[k] = -i (Z[k] - conj(Z[-k])) / 2 and X[k] = E[k] + W^k O[k]
+    for (int k = 0; k <= mHalf; k++) {
+      const int a = k == mHalf ? 0 : k, b = k == 0 ? 0 : mHalf - k;
+      const float er = 0.5f * (zr[a] + zr[b]), ei = 0.5f * (zi[a] - zi[b]);
+      const float odr = 0.5f * (zi[a] + zi[b]), odi = -0.5f * (zr[a] - zr[b]);
+      const float wr = mUnpackRe[k], wi = mUnpackIm[k];
+      re[k] = er + wr * odr - wi * odi;
+      im[k] = ei + wr * odi + wi * odr;
+    }
+  }
+
+private:
+  int mSize, mHalf;
+  std::vector<int> mReverse;
+  std::vector<float> mTwiddleRe, mTwiddleIm;
+  std::vector<float> mUnpackRe, mUnpackIm;
+  std::vector<float> mRe, mIm; // the packed signal, transformed in place
+};
+
+#endif // REAL_FFT_HPP
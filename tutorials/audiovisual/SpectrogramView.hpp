@@ -0,0 +1,224 @@
+#pragma once
+#ifndef SPECTROGRAM_VIEW_HPP
+#define SPECTROGRAM_VIEW_HPP
+
+// Scrolling spectrogram drawn by the GPU, for the audiovisual tutorials.
+//
+// Spectra are kept in a single-channel float texture, one spectrum per row,
+// the rows used as a ring: push() writes a new spectrum over the oldest row
+// with one glTexSubImage2D of a row, and nothing else changes. draw() then
+// renders one textured quad, made once, whose fragment shader does the
+// rest: it reads the ring from the newest row back, maps frequencies to x
+// (linearly, or logarithmically from `lowest`), and colors values with a
+// colormap. As a waterfall the newest spectrum is at the top of the quad
+// and older ones scroll down; as a line only the newest is drawn, as a
+// curve over a faint fill, transparent elsewhere (enable blending for
+// smooth edges). Where there are more bins than pixels each pixel shows
+// the largest of a few bins under it, so narrow peaks don't fall between
+// pixels.
+//
+// The quad spans -1 to 1 in x and y; place it with the graphics matrices.
+// Values from `low` to `high` span the colormap and the height of the line,
+// [0, 1] by default, which suits SpectrumAnalyzer's decibels.
+//
+// Everything here needs the GL context.
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "al/graphics/al_Graphics.hpp"
+#include "al/graphics/al_OpenGL.hpp"
+#include "al/graphics/al_Shader.hpp"
+#include "al/graphics/al_Texture.hpp"
+#include "al/graphics/al_VAOMesh.hpp"
+
+#include "SpectrumAnalyzer.hpp"
+
+const char *const kSpectrogramVertex = R"(
+#version 330
+uniform mat4 al_ModelViewMatrix;
+uniform mat4 al_ProjectionMatrix;
+
+layout (location = 0) in vec3 position;
+layout (location = 2) in vec2 texcoord;
+
+out vec2 T;
+
+void main() {
+  T = texcoord;
+  gl_Position = al_ProjectionMatrix * al_ModelViewMatrix * vec4(position, 1.0);
+}
+)";
+
+const char *const kSpectrogramFragment = R"(
+#version 330
+in vec2 T;
+layout (location = 0) out vec4 fragColor;
+
+uniform sampler2D spectra; // a spectrum per row, the rows a ring
+uniform float bins, rows;
+uniform float newest;      // row of the newest spectrum
+uniform float lowest;      // 0 for a linear frequency axis
+uniform float low, high;
+uniform int mode;          // 0 waterfall, 1 line
+
+// Black through blue, magenta and orange to white
+vec3 colormap(float v) {
+  const vec3 stops[5] = vec3[5](vec3(0.0), vec3(0.10, 0.10, 0.55),
+                                vec3(0.70, 0.10, 0.50), vec3(1.00, 0.60, 0.10),
+                                vec3(1.00, 1.00, 0.90));
+  float x = clamp(v, 0.0, 1.0) * 4.0;
+  int i = min(int(x), 3);
+  return mix(stops[i], stops[i + 1], x - float(i));
+}
+
+// Texture coordinate of the bins at x, 0 to 1 across the quad
+float frequency(float x) {
+  x = clamp(x, 0.0, 1.0);
+  float f = lowest > 0.0 ? lowest * pow(1.0 / lowest, x) : x;
+  return (f * (bins - 1.0) + 0.5) / bins;
+}
+
+// The largest value over the pixel from x0 to x1, age spectra back, mapped
+// from low..high to 0..1
+float value(float x0, float x1, float age) {
+  float row = (mod(newest - age, rows) + 0.5) / rows;
+  float s0 = frequency(x0), s1 = frequency(x1);
+  int taps = int(clamp(ceil((s1 - s0) * bins), 1.0, 8.0));
+  float v = texture(spectra, vec2(s0, row)).r;
+  for (int i = 1; i <= taps; i++) {
+    float s = mix(s0, s1, float(i) / float(taps));
+    v = max(v, texture(spectra, vec2(s, row)).r);
+  }
+  return (v - low) / (high - low);
+}
+
+void main() {
+  float dx = abs(dFdx(T.x));
+  float x0 = T.x - 0.5 * dx, x1 = T.x + 0.5 * dx;
+  if (mode == 0) {
+    float age = min(floor((1.0 - T.y) * rows), rows - 1.0);
+    fragColor = vec4(colormap(value(x0, x1, age)), 1.0);
+    return;
+  }
+  float v = clamp(value(x0, x1, 0.0), 0.0, 1.0);
+  // Distance to the curve in pixels, for a line about two pixels wide
+  float e = T.y - v;
+  float d = abs(e) / max(length(vec2(dFdx(e), dFdy(e))), 1e-6);
+  float alpha = max(clamp(1.5 - d, 0.0, 1.0), T.y < v ? 0.2 : 0.0);
+  if (alpha <= 0.0) {
+    discard;
+  }
+  fragColor = vec4(colormap(v), alpha);
+}
+)";
+
+class SpectrogramView {
+public:
+  enum Mode { kWaterfall, kLine };
+
+  float low{0}, high{1};
+  // Lowest frequency on a logarithmic axis, as a fraction of Nyquist
+  // (1e-3 is 24 Hz at 48 kHz); 0 for a linear axis from 0 Hz
+  float lowest{0};
+
+  SpectrogramView() = default;
+  SpectrogramView(const SpectrogramView &) = delete;
+  SpectrogramView &operator=(const SpectrogramView &) = delete;
+  ~SpectrogramView() { destroy(); }
+
+  // A ring of rows spectra of bins values each
+  void create(int bins, int rows = 256) {
+    destroy();
+    mBins = std::max(2, bins);
+    mRows = std::max(1, rows);
+    mNewest = 0;
+    mIndex = 0;
+    mTexture.filterMag(al::Texture::LINEAR);
+    mTexture.filterMin(al::Texture::LINEAR);
+    mTexture.create2D(mBins, mRows, GL_R32F, GL_RED, GL_FLOAT);
+    const std::vector<float> silence(size_t(mBins) * mRows, low);
+    mTexture.submit(silence.data());
+
+    mQuad.reset();
+    mQuad.primitive(al::Mesh::TRIANGLE_STRIP);
+    mQuad.vertex(-1, 1);
+    mQuad.vertex(-1, -1);
+    mQuad.vertex(1, 1);
+    mQuad.vertex(1, -1);
+    mQuad.texCoord(0, 1);
+    mQuad.texCoord(0, 0);
+    mQuad.texCoord(1, 1);
+    mQuad.texCoord(1, 0);
+    mQuad.update();
+    mShader.compile(kSpectrogramVertex, kSpectrogramFragment);
+    mCreated = true;
+  }
+
+  void destroy() {
+    if (!mCreated) {
+      return;
+    }
+    mTexture.destroy();
+    mCreated = false;
+  }
+
+  int bins() const { return mBins; }
+  int rows() const { return mRows; }
+
+  // Writes the bins() values as the newest spectrum, count times: pass the
+  // number of spectra since the last push() to keep time even when some
+  // were never seen
+  void push(const float *values, int count = 1) {
+    count = std::min(std::max(1, count), mRows);
+    mTexture.bind();
+    for (int i = 0; i < count; i++) {
+      mNewest = (mNewest + 1) % mRows;
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, mNewest, mBins, 1, GL_RED,
+                      GL_FLOAT, values);
+    }
+    mTexture.unbind();
+  }
+
+  // Pushes the analyzer's newest spectrum, if there is one, standing in for
+  // any it published in between. Returns whether there was one.
+  bool update(SpectrumAnalyzer &analyzer) {
+    if (!analyzer.fetch()) {
+      return false;
+    }
+    const SpectrumAnalyzer::Spectrum &spectrum = analyzer.spectrum();
+    const uint64_t count = mIndex ? spectrum.index - mIndex : 1;
+    mIndex = spectrum.index;
+    push(spectrum.bins.data(), int(std::min<uint64_t>(count, mRows)));
+    return true;
+  }
+
+  void draw(al::Graphics &g, Mode mode = kWaterfall) {
+    g.texture();
+    mTexture.bind(0);
+    g.shader(mShader);
+    g.shader().uniform("spectra", 0);
+    g.shader().uniform("bins", float(mBins));
+    g.shader().uniform("rows", float(mRows));
+    g.shader().uniform("newest", float(mNewest));
+    g.shader().uniform("lowest", std::min(1.0f, std::max(0.0f, lowest)));
+    g.shader().uniform("low", low);
+    g.shader().uniform("high", high > low ? high : low + 1e-6f);
+    g.shader().uniform("mode", int(mode));
+    g.draw(mQuad);
+    mTexture.unbind(0);
+  }
+
+private:
+  al::Texture mTexture;
+  al::VAOMesh mQuad;
+  al::ShaderProgram mShader;
+  int mBins{0}, mRows{0};
+  int mNewest{0};      // row of the newest spectrum
+  uint64_t mIndex{0};  // SpectrumAnalyzer index of the newest, 0 for none
+  bool mCreated{false};
+};
+
+#endif // SPECTROGRAM_VIEW_HPP
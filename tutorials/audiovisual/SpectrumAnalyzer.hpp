@@ -0,0 +1,186 @@
+#pragma once
+#ifndef SPECTRUM_ANALYZER_HPP
+#define SPECTRUM_ANALYZER_HPP
+
+// Short-time spectrum of an audio signal, analyzed off the audio thread, for
+// the audiovisual tutorials.
+//
+// The audio callback only calls push() with its block, which copies the
+// samples into a lock-free ring and returns: nothing on the audio thread
+// transforms, waits or allocates. The analyzer's own thread drains the ring
+// and every hop samples windows the last size samples (Hann), transforms
+// them with RealFft.hpp and turns the bins into magnitudes, or into
+// decibels mapped to [0, 1], with the SIMD kernels of SimdOps.hpp. Each
+// spectrum is published through a triple buffer, from which the graphics
+// thread takes the newest with fetch(), never waiting for the analysis
+// either and skipping spectra it was too slow for.
+//
+// Magnitudes are normalized by the sum of the window, so a sine of
+// amplitude A centered on a bin reads A / 2 there. In decibels 0 dB is
+// magnitude 1 and maps to 1, floorDb and below map to 0.
+//
+// push() belongs to one thread, fetch() and spectrum() to another.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/SpscQueue.hpp"
+#include "common/TripleBuffer.hpp"
+
+#include "RealFft.hpp"
+
+class SpectrumAnalyzer {
+public:
+  enum Scale { kMagnitude, kDecibels };
+
+  struct Spectrum {
+    std::vector<float> bins; // size / 2 + 1, from 0 Hz to Nyquist
+    uint64_t index{0};       // spectra analyzed so far, this one included
+  };
+
+  // size is rounded up to a power of two; hop is at most size
+  explicit SpectrumAnalyzer(int size = 4096, int hop = 1024,
+                            Scale scale = kMagnitude, float floorDb = -90)
+      : mFft(size), mSize(mFft.size()),
+        mHop(std::min(std::max(1, hop), mSize)), mScale(scale),
+        mFloorDb(std::min(-1.0f, floorDb)), mHistory(mSize, 0.0f),
+        mWindow(mSize), mFrame(mSize), mRe(mFft.bins()), mIm(mFft.bins()),
+        mSpectra(Spectrum{std::vector<float>(mFft.bins(), 0.0f), 0}) {
+    const double pi = 3.14159265358979323846;
+    double sum = 0;
+    for (int i = 0; i < mSize; i++) {
+      mWindow[i] = float(0.5 - 0.5 * std::cos(2 * pi * i / mSize));
+      sum += mWindow[i];
+    }
+    mNorm = float(1 / sum);
+  }
+
+  ~SpectrumAnalyzer() { stop(); }
+
+  SpectrumAnalyzer(const SpectrumAnalyzer &) = delete;
+  SpectrumAnalyzer &operator=(const SpectrumAnalyzer &) = delete;
+
+  int size() const { return mSize; }
+  int hop() const { return mHop; }
+  int bins() const { return mFft.bins(); }
+
+  // Starts the analysis thread. It wakes up about twice per hop at the
+  // sample rate, so it keeps up without spinning.
+  void start(double sampleRate) {
+    stop();
+    const double seconds = mHop / std::max(1.0, sampleRate) / 2;
+    const auto period = std::chrono::microseconds(
+        std::max<int64_t>(1000, int64_t(seconds * 1e6)));
+    mRunning.store(true, std::memory_order_release);
+    mThread = std::thread([this, period] {
+      while (mRunning.load(std::memory_order_acquire)) {
+        analyze();
+        std::this_thread::sleep_for(period);
+      }
+    });
+  }
+
+  void stop() {
+    if (mThread.joinable()) {
+      mRunning.store(false, std::memory_order_release);
+      mThread.join();
+    }
+  }
+
+  // Audio thread: queues n samples. Samples that don't fit because the
+  // analysis fell far behind are dropped and counted.
+  void push(const float *samples, int n) {
+    const size_t pushed = mRing.push(samples, size_t(std::max(0, n)));
+    if (pushed < size_t(n)) {
+      mDropped.fetch_add(uint64_t(n) - pushed, std::memory_order_relaxed);
+    }
+  }
+
+  // Analysis thread: takes the queued samples and publishes a spectrum for
+  // every hop they complete. Returns how many it published. start() runs
+  // it; without start(), call it from a thread of your own.
+  int analyze() {
+    int published = 0;
+    for (;;) {
+      // The history is circular, oldest sample at mWrite
+      const size_t want = size_t(mHop - mPending);
+      const size_t first = std::min(want, size_t(mSize - mWrite));
+      size_t got = mRing.pop(&mHistory[mWrite], first);
+      if (got == first && want > first) {
+        got += mRing.pop(&mHistory[0], want - first);
+      }
+      mWrite = int((mWrite + got) % size_t(mSize));
+      mPending += int(got);
+      if (mPending < mHop) {
+        return published;
+      }
+      mPending = 0;
+      transform();
+      published++;
+    }
+  }
+
+  // Graphics thread: whether a spectrum was published since the last call;
+  // spectrum() then holds the newest
+  bool fetch() { return mSpectra.fetch(); }
+  const Spectrum &spectrum() const { return mSpectra.readBuffer(); }
+
+  // Samples push() could not queue
+  uint64_t dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+  void transform() {
+    // The window over the history, oldest sample first
+    const int older = mSize - mWrite;
+    simd::multiply(mFrame.data(), &mHistory[mWrite], mWindow.data(),
+                   size_t(older));
+    simd::multiply(&mFrame[older], mHistory.data(), &mWindow[older],
+                   size_t(mWrite));
+    mFft.forward(mFrame.data(), mRe.data(), mIm.data());
+
+    Spectrum &out = mSpectra.writeBuffer();
+    float *bins = out.bins.data();
+    const size_t n = out.bins.size();
+    simd::magnitude(bins, mRe.data(), mIm.data(), n);
+    simd::scale(bins, mNorm, n);
+    if (mScale == kDecibels) {
+      // 20 log10(m) = 20 log10(2) log2(m), from floorDb..0 to 0..1
+      simd::log2(bins, n);
+      const float a = 6.02059991f / -mFloorDb;
+      for (size_t k = 0; k < n; k++) {
+        bins[k] = std::min(1.0f, std::max(0.0f, a * bins[k] + 1.0f));
+      }
+    }
+    out.index = ++mAnalyzed;
+    mSpectra.publish();
+  }
+
+  RealFft mFft;
+  const int mSize, mHop;
+  const Scale mScale;
+  const float mFloorDb;
+  float mNorm;
+
+  // Audio thread to analysis thread: 0.68 s at 48 kHz
+  SpscQueue<float, 1 << 15> mRing;
+  std::atomic<uint64_t> mDropped{0};
+
+  // Analysis thread
+  std::vector<float> mHistory; // the last size samples, circular
+  int mWrite{0};               // next sample goes here
+  int mPending{0};             // samples since the last spectrum
+  uint64_t mAnalyzed{0};
+  std::vector<float> mWindow, mFrame, mRe, mIm;
+
+  TripleBuffer<Spectrum> mSpectra;
+  std::atomic<bool> mRunning{false};
+  std::thread mThread;
+};
+
+#endif // SPECTRUM_ANALYZER_HPP
@@ -6,7 +6,8 @@
 #include "al/app/al_App.hpp"
 #include "al/graphics/al_Shapes.hpp"
 #include "al/math/al_Random.hpp"
-#include "Gamma/DFT.h"
+
+#include "SpectrogramView.hpp"
 
 using namespace al;
 using namespace std;
@@ -17,15 +18,14 @@ using namespace std;
 
 struct MyApp : public App
 {
-  // STFT variables
-  // Window size
+  // STFT of the input, on a thread of its own
+  // Window size (Hann window)
   // Hop size; number of samples between transforms
-  // Pad size; number of zero-valued samples appended to window
-  // Window type: HAMMING, HANN, WELCH, NYQUIST, or etc
-  // Format of frequency samples: COMPLEX, MAG_PHASE, or MAG_FREQ
-  gam::STFT stft = gam::STFT(FFT_SIZE, FFT_SIZE / 4, 0, gam::HANN, gam::MAG_FREQ);
-  Mesh mSpectrogram;
-  vector<float> spectrum;
+  // Scale of the spectrum: kMagnitude or kDecibels
+  SpectrumAnalyzer analyzer{FFT_SIZE, FFT_SIZE / 4,
+                            SpectrumAnalyzer::kDecibels};
+  // Scrolling spectra, in a texture drawn on a single quad
+  SpectrogramView spectrogram;
   float i_waveformData[BLOCK_SIZE * CHANNEL_COUNT]{0}; // Waveform variables
   float o_waveformData[BLOCK_SIZE * CHANNEL_COUNT]{0}; // Waveform variables
   Mesh i_waveformMesh[2]{Mesh::LINE_STRIP, Mesh::LINE_STRIP};
@@ -40,10 +40,13 @@ struct MyApp : public App
       quit();
       return;
     }
-    // Declare the size of the spectrum
-    spectrum.resize(FFT_SIZE / 2 + 1);
-    mSpectrogram.primitive(Mesh::LINE_STRIP);
     nav().pos(Vec3f(0, 0, 0));
+    analyzer.start(audioIO().framesPerSecond());
+  }
+
+  void onCreate() override
+  {
+    spectrogram.create(analyzer.bins());
   }
 
   void onAnimate(double dt)
@@ -62,26 +65,13 @@ struct MyApp : public App
         o_waveformMesh[ch].color(HSV(al::rnd::uniform(oy*1000), 1., 1.));
       }
     }
-    // Spectrogram
-    mSpectrogram.reset();
-    for (int i = 0; i < FFT_SIZE / 2; i++)
-    {
-      mSpectrogram.color(HSV(0.5 - spectrum[i] * 100));
-      mSpectrogram.vertex(i, spectrum[i], 0.0);
-    }
   }
   void onSound(AudioIOData &io) override
   {
+    // The analyzer only copies the block here
+    analyzer.push(io.inBuffer(0), io.framesPerBuffer());
     while (io())
     {
-      if (stft(io.in(0)))
-      { // Loop through all the frequency bins
-        for (unsigned k = 0; k < stft.numBins(); ++k)
-        {
-          // Here we simply scale the complex sample
-          spectrum[k] = stft.bin(k).real();
-        }
-      }
       // // Process the outputs - Randomized
       io.out(0) = al::rnd::uniform(io.in(0)*10);
       io.out(1) = al::rnd::uniform(io.in(1)*10);
@@ -93,13 +83,14 @@ struct MyApp : public App
   void onDraw(Graphics &g) override
   {
     g.clear();
-    // Draw Spectrum
-    g.meshColor(); // Use the color in the mesh
+    // Draw Spectrum, with the newest spectrum the analyzer published
+    spectrogram.update(analyzer);
     g.pushMatrix();
-    g.translate(-5, 0, -20);
-    g.scale(100.0 / FFT_SIZE, 1000, 1.0);
-    g.draw(mSpectrogram);
+    g.translate(0, 0, -20);
+    g.scale(5, 1.5, 1.0);
+    spectrogram.draw(g);
     g.popMatrix();
+    g.meshColor(); // Use the color in the mesh
     // Input Waveform
     for(int ch = 0; ch < CHANNEL_COUNT; ch++) { 
       g.pushMatrix();
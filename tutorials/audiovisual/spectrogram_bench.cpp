@@ -0,0 +1,142 @@
+// Benchmark for SpectrogramView: time per frame to show a new spectrum,
+// against building a mesh of it every frame as the tutorials did.
+//
+//   mesh       Mesh::reset(), a vertex and an HSV color per bin and draw(),
+//              as onDraw in 10_integrated.cpp and microphonePlay.cpp did
+//   line       SpectrogramView::push() of the spectrum and draw() as a line
+//   waterfall  the same drawn as a waterfall of 256 spectra
+//
+// Every method shows 240 frames with a new spectrum in each, at 8192 bins
+// (an FFT of 16384 points) and at 2048 (4096 points, the tutorials' size),
+// then waits for the GPU with glFinish(). "cpu ms" is the time per frame
+// spent in the calls, "total ms" the time per frame including the wait,
+// "gpu ms" the GPU's time per frame as timed by a GL timer query, and
+// "KB" what the frame sends to the GPU.
+//
+// This one needs a GL context, so it is an app: it opens a window, prints
+// the table and quits.
+//
+// Build and run with ./run.sh tutorials/audiovisual/spectrogram_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "al/app/al_App.hpp"
+
+#include "common/Benchmark.hpp"
+
+#include "SpectrogramView.hpp"
+
+using namespace al;
+
+const int kFrames = 240;
+const int kSpectra = 16; // cycled through, one per frame
+
+struct Result {
+  double cpu = 0, total = 0, gpu = 0;
+};
+
+// Times kFrames calls of frame(f)
+template <class Function> Result timeFrames(Function &&frame) {
+  GLuint query;
+  glGenQueries(1, &query);
+  glFinish();
+  Result r;
+  auto start = bench::Clock::now();
+  glBeginQuery(GL_TIME_ELAPSED, query);
+  for (int f = 0; f < kFrames; f++) {
+    frame(f);
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  r.cpu = bench::secondsSince(start) / kFrames;
+  glFinish();
+  r.total = bench::secondsSince(start) / kFrames;
+  GLuint64 nanoseconds = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+  r.gpu = nanoseconds * 1e-9 / kFrames;
+  glDeleteQueries(1, &query);
+  return r;
+}
+
+// Spectra in [0, 1] of a few drifting peaks over a noise floor
+std::vector<std::vector<float>> makeSpectra(int bins) {
+  std::vector<std::vector<float>> spectra(kSpectra);
+  for (int s = 0; s < kSpectra; s++) {
+    spectra[s].resize(bins);
+    for (int k = 0; k < bins; k++) {
+      const float x = float(k) / bins;
+      float v = 0.2f + 0.05f * std::sin(37.0f * x + s);
+      for (int p = 1; p <= 8; p++) {
+        const float d = (x - (0.05f * p + 0.002f * s)) * bins;
+        v += 0.6f / p * std::exp(-d * d / 8);
+      }
+      spectra[s][k] = std::min(1.0f, v);
+    }
+  }
+  return spectra;
+}
+
+struct BenchApp : App {
+  bool done = false;
+
+  void onDraw(Graphics &g) override {
+    if (done) {
+      return;
+    }
+    done = true;
+    g.clear();
+    printf("%d frames per method, a new spectrum every frame\n", kFrames);
+    printf("%-6s %-10s %8s %9s %8s %8s\n", "bins", "method", "cpu ms",
+           "total ms", "gpu ms", "KB");
+    for (int bins : {8193, 2049}) {
+      const std::vector<std::vector<float>> spectra = makeSpectra(bins);
+      auto print = [&](const char *method, const Result &r, double bytes) {
+        printf("%-6d %-10s %8.3f %9.3f %8.3f %8.1f\n", bins - 1, method,
+               r.cpu * 1e3, r.total * 1e3, r.gpu * 1e3, bytes / 1024);
+      };
+      g.pushMatrix();
+      g.translate(-0.5, -2, -15);
+
+      Mesh mesh;
+      print("mesh", timeFrames([&](int f) {
+              const std::vector<float> &spectrum = spectra[f % kSpectra];
+              mesh.reset();
+              mesh.primitive(Mesh::LINE_STRIP);
+              for (int i = 0; i < bins - 1; i++) {
+                mesh.color(HSV(0.5 - spectrum[i] * 100));
+                mesh.vertex(i, spectrum[i], 0.0);
+              }
+              g.meshColor();
+              g.pushMatrix();
+              g.scale(5.0 / bins, 1, 1.0);
+              g.draw(mesh);
+              g.popMatrix();
+            }),
+            (bins - 1) * (3 + 4) * sizeof(float));
+
+      SpectrogramView view;
+      view.create(bins);
+      g.scale(2.5, 1, 1.0);
+      for (SpectrogramView::Mode mode :
+           {SpectrogramView::kLine, SpectrogramView::kWaterfall}) {
+        print(mode == SpectrogramView::kLine ? "line" : "waterfall",
+              timeFrames([&](int f) {
+                view.push(spectra[f % kSpectra].data());
+                view.draw(g, mode);
+              }),
+              bins * sizeof(float));
+      }
+      g.popMatrix();
+      fflush(stdout);
+    }
+    quit();
+  }
+};
+
+int main() {
+  BenchApp app;
+  app.start();
+  return 0;
+}
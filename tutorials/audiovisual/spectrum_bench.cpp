@@ -0,0 +1,128 @@
+// Benchmark for SpectrumAnalyzer: time the audio callback spends on the
+// spectrum, before and after the analysis moved to a thread of its own.
+//
+// "stft" is what onSound in the tutorials did: a gam::STFT of 4048 points
+// with a hop of a quarter of that, fed one sample at a time, and
+// tanh(pow(m, 1.3)) of every bin whenever a hop completed. "push" is
+// SpectrumAnalyzer::push() of the block, at 4096 and 8192 points, the
+// latter also in decibels. Callbacks of 512 frames at 48 kHz are timed one
+// by one: "mean" and "max" in microseconds, and the longest as a share of
+// the block's 10.67 ms. The stft spends most blocks collecting samples and
+// then a whole transform in one of them, which is what "max" shows.
+//
+// "analysis" is what the analyzer's thread spends per spectrum, and "load"
+// that as a share of one core at the hop rate.
+//
+// Build and run with ./run.sh tutorials/audiovisual/spectrum_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Gamma/DFT.h"
+
+#include "common/Benchmark.hpp"
+
+#include "SpectrumAnalyzer.hpp"
+
+const int kFrames = 512;
+const double kRate = 48000;
+const int kBlocks = 4000;
+
+struct Row {
+  double mean{0}, max{0}, analysis{0}, load{0};
+};
+
+// kBlocks blocks of a few partials and some noise
+std::vector<float> makeSignal() {
+  std::vector<float> signal(size_t(kBlocks) * kFrames);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+  for (size_t i = 0; i < signal.size(); i++) {
+    const double t = i / kRate;
+    signal[i] = float(0.3 * std::sin(2 * M_PI * 220 * t) +
+                      0.2 * std::sin(2 * M_PI * 331 * t) +
+                      0.1 * std::sin(2 * M_PI * 1870 * t)) +
+                noise(rng);
+  }
+  return signal;
+}
+
+// Times every call of callback(block) and averages; between(), untimed,
+// runs after each
+template <class Function, class Between>
+Row timeCallbacks(const std::vector<float> &signal, Function &&callback,
+                  Between &&between) {
+  Row row;
+  for (int b = 0; b < kBlocks; b++) {
+    const auto start = bench::Clock::now();
+    callback(&signal[size_t(b) * kFrames]);
+    const double t = bench::secondsSince(start);
+    row.mean += t;
+    row.max = std::max(row.max, t);
+    between();
+  }
+  row.mean /= kBlocks;
+  return row;
+}
+
+Row runStft(const std::vector<float> &signal) {
+  gam::STFT stft(4048, 4048 / 4, 0, gam::HANN, gam::MAG_FREQ);
+  std::vector<float> spectrum(4048 / 2 + 1);
+  return timeCallbacks(signal, [&](const float *block) {
+    for (int i = 0; i < kFrames; i++) {
+      if (stft(block[i])) {
+        for (unsigned k = 0; k < stft.numBins(); ++k) {
+          spectrum[k] = std::tanh(std::pow(stft.bin(k).real(), 1.3f));
+        }
+      }
+    }
+    bench::keep(spectrum[0]);
+  }, [] {});
+}
+
+// The analysis runs between callbacks, as it would on its own thread, and
+// is timed on its own
+Row runAnalyzer(const std::vector<float> &signal, int size,
+                SpectrumAnalyzer::Scale scale) {
+  SpectrumAnalyzer analyzer(size, size / 4, scale);
+  double analysis = 0;
+  int spectra = 0;
+  Row row = timeCallbacks(
+      signal, [&](const float *block) { analyzer.push(block, kFrames); },
+      [&] {
+        const auto start = bench::Clock::now();
+        spectra += analyzer.analyze();
+        analysis += bench::secondsSince(start);
+      });
+  row.analysis = analysis / std::max(1, spectra);
+  row.load = row.analysis * kRate / analyzer.hop();
+  analyzer.fetch();
+  bench::keep(analyzer.spectrum().bins[0]);
+  return row;
+}
+
+int main() {
+  const std::vector<float> signal = makeSignal();
+  const double block = kFrames / kRate;
+  printf("%d callbacks of %d frames (%.2f ms @ 48 kHz)\n", kBlocks, kFrames,
+         block * 1e3);
+  printf("%-14s %9s %9s %9s %12s %8s\n", "mode", "mean us", "max us",
+         "max %", "analysis us", "load %");
+  auto print = [&](const char *name, const Row &r) {
+    printf("%-14s %9.2f %9.2f %9.3f", name, r.mean * 1e6, r.max * 1e6,
+           100 * r.max / block);
+    if (r.analysis > 0) {
+      printf(" %12.1f %8.3f", r.analysis * 1e6, 100 * r.load);
+    }
+    printf("\n");
+  };
+  print("stft 4048", runStft(signal));
+  print("push 4096", runAnalyzer(signal, 4096, SpectrumAnalyzer::kMagnitude));
+  print("push 8192", runAnalyzer(signal, 8192, SpectrumAnalyzer::kMagnitude));
+  print("push 8192 dB",
+        runAnalyzer(signal, 8192, SpectrumAnalyzer::kDecibels));
+  return 0;
+}
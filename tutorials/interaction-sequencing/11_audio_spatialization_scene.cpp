@@ -17,6 +17,9 @@
 
 //#include "al/util/sound/al_OutputMaster.hpp"
 
+#include "tools/audio/BlockLbap.hpp"
+#include "tools/audio/ParallelScene.hpp"
+
 using namespace al;
 
 /*
@@ -33,6 +36,8 @@ using namespace al;
 //#define SpatializerType Vbap
 //#define SpatializerType Dbap
 //#define SpatializerType AmbisonicsSpatializer
+// BlockLbap lets the scene render its voices in parallel (see below)
+//#define SpatializerType BlockLbap
 
 //
 class MyAgent : public PositionedVoice {
@@ -105,7 +110,9 @@ struct MyApp : public App {
 
   rnd::Random<> randomGenerator; // Random number generator
 
-  DynamicScene scene;
+  // ParallelScene renders voices on a thread pool when the spatializer is
+  // BlockLbap, and behaves like the DynamicScene it wraps otherwise.
+  ParallelScene<DynamicScene> scene;
   virtual void onInit() override {
     // Configure spatializer for the scene
     auto speakers = StereoSpeakerLayout();
@@ -13,6 +13,9 @@ Kon Hyong Kim - Jan 2021
 
 #include "al/app/al_App.hpp"
 #include <vector>
+
+#include "FieldKernels.hpp"
+
 using namespace al;
 
 class FieldApp : public App {
@@ -27,14 +30,16 @@ public:
   // mesh to store the points we're rendering
   Mesh mesh;
 
-  // phase of the sine waves in the algorithm used in the example
-  float theta;
+  // evaluates the field in tiles across all cores, four pixels at a time
+  FieldEngine engine;
+
+  // the algorithm used in the example (see FieldKernels.hpp)
+  RadialWaves waves;
 
   FieldApp() {
     // initialize variables
     xRes = 512;
     yRes = 512;
-    theta = 0.f;
     scale = 2.f;
   }
 
@@ -43,44 +48,35 @@ public:
     // rendered at the origin.
     // Some elements like nav need to be modified after being created
     nav().pos(0, 0, 4);
-  }
 
-  void onAnimate(double dt) {
-    // reset the mesh
-    mesh.reset();
-    // configure the mesh to render using individual points
-    mesh.primitive(Mesh::POINTS);
+    // the field covers -0.5~0.5 x -0.5~0.5, scaled
+    engine.resize(xRes, yRes);
+    engine.bounds(-0.5f * scale, -0.5f * scale, 0.5f * scale, 0.5f * scale);
 
+    // the points don't move, so the mesh is built once:
+    // a point in the middle of every pixel of the vector field
+    mesh.primitive(Mesh::POINTS);
     for (int j = 0; j < yRes; ++j) {
       for (int i = 0; i < xRes; ++i) {
-        // get the middle of the pixel in a vector field -0.5~0.5 x -0.5~0.5
-        Vec3f p((i + 0.5f) / (float)xRes - 0.5f,
-                (j + 0.5f) / (float)yRes - 0.5f, 0.f);
-
-        // scale the vector field size
-        p *= scale;
-
-        // ** place to apply algorithms based on the vector field
-        // here we're coloring the vector field based on the radius
-        // and a sine wave as an example
-        float radius = p.mag();
-        // RGB that fluctuates from 0-1 based on radius and theta
-        // with different periods
-        Color color = Color(0.5f * sin(8.f * radius + theta) + 0.5f,
-                            0.5f * sin(7.f * radius + theta) + 0.5f,
-                            0.5f * sin(5.f * radius + theta) + 0.5f);
-
-        // here we're rendering a point based on the vector field
-        mesh.vertex(p);
-        mesh.color(color);
+        mesh.vertex(engine.x(i), engine.y(j), 0.f);
+        mesh.color(Color(0.f));
       }
     }
+  }
+
+  void onAnimate(double dt) {
+    // ** place to apply algorithms based on the vector field
+    // here we're coloring the vector field based on the radius
+    // and a sine wave as an example. RGB fluctuates from 0-1 based on
+    // radius and theta with different periods.
+    // The engine writes the colors straight into the mesh
+    engine.evaluate(waves, reinterpret_cast<float *>(mesh.colors().data()));
 
     // increment the phase based on the time elapsed from last frame
     // this allows animation to look smooth regardless of fps
-    theta += 1.5f * dt;
-    if (theta > 2 * M_PI)
-      theta -= 2 * M_PI;
+    waves.theta += 1.5f * dt;
+    if (waves.theta > 2 * M_PI)
+      waves.theta -= 2 * M_PI;
   }
 
   void onDraw(Graphics &g) {
@@ -13,6 +13,10 @@ Kon Hyong Kim - Jan 2021
 
 #include "al/app/al_App.hpp"
 #include <vector>
+
+#include "FieldKernels.hpp"
+#include "StreamingTexture.hpp"
+
 using namespace al;
 
 class FieldApp : public App {
@@ -24,23 +28,23 @@ public:
   // scale of the vector field
   float scale;
 
-  // std::vector to store the color of the vector field
-  std::vector<Color> field;
-
-  // Texture to store the image
-  Texture tex;
+  // Texture to store the image, with upload buffers the field is
+  // evaluated straight into (see StreamingTexture.hpp)
+  StreamingTexture tex;
 
   // Rectangle mesh to apply the texture
   VAOMesh quad;
 
-  // phase of the sine waves in the algorithm used in the example
-  float theta;
+  // evaluates the field in tiles across all cores, four pixels at a time
+  FieldEngine engine;
+
+  // the algorithm used in the example (see FieldKernels.hpp)
+  RadialWaves waves;
 
   FieldApp() {
     // initialize variables
     xRes = 512;
     yRes = 512;
-    theta = 0.f;
     scale = 2.f;
   }
 
@@ -50,15 +54,14 @@ public:
     // Some elements like nav need to be modified after being created
     nav().pos(0, 0, 4);
 
-    // resize the field container
-    field.resize(xRes * yRes);
-
-    // set the filters for the texture. Default: NEAREST
-    tex.filterMag(Texture::LINEAR);
-    tex.filterMin(Texture::LINEAR);
+    // the field covers -0.5~0.5 x -0.5~0.5, scaled
+    engine.resize(xRes, yRes);
+    engine.bounds(-0.5f * scale, -0.5f * scale, 0.5f * scale, 0.5f * scale);
 
-    // create a texture unit on the GPU
-    tex.create2D(xRes, yRes, Texture::RGBA32F, Texture::RGBA, Texture::FLOAT);
+    // create a texture unit on the GPU, filtered LINEAR, and three
+    // buffers to upload the field through. 8 bits per channel are what
+    // the display shows, a quarter of the bytes of floats to upload
+    tex.create(xRes, yRes, 3, field::RGBA8);
 
     // create the quad mesh to apply texture on
     quad.primitive(Mesh::TRIANGLE_STRIP);
@@ -76,44 +79,34 @@ public:
   }
 
   void onAnimate(double dt) {
-    for (int j = 0; j < yRes; ++j) {
-      for (int i = 0; i < xRes; ++i) {
-        // get the middle of the pixel in a vector field -0.5~0.5 x -0.5~0.5
-        Vec3f p((i + 0.5f) / (float)xRes - 0.5f,
-                (j + 0.5f) / (float)yRes - 0.5f, 0.f);
-
-        // scale the vector field size
-        p *= scale;
-
-        // ** place to apply algorithms based on the vector field
-        // here we're coloring the vector field based on the radius
-        // and a sine wave as an example
-        float radius = p.mag();
-        // RGB that fluctuates from 0-1 based on radius and theta
-        // with different periods
-        Color color = Color(0.5f * sin(8.f * radius + theta) + 0.5f,
-                            0.5f * sin(7.f * radius + theta) + 0.5f,
-                            0.5f * sin(5.f * radius + theta) + 0.5f);
-
-        // store the color in the container
-        field[xRes * j + i] = color;
-      }
+    // ** place to apply algorithms based on the vector field
+    // here we're coloring the vector field based on the radius
+    // and a sine wave as an example. RGB fluctuates from 0-1 based on
+    // radius and theta with different periods.
+    // The engine evaluates the middle of every pixel, in tiles across all
+    // cores, four pixels at a time, converted to 8 bit as it goes,
+    // straight into an upload buffer. If the GPU is behind and all
+    // buffers are busy this frame is skipped
+    void *pixels = tex.beginWrite();
+    if (pixels) {
+      engine.evaluate(waves, pixels, tex.format());
+      tex.endWrite();
     }
 
-    // update the texture with the modified vector field
-    tex.submit(field.data());
-
     // increment the phase based on the time elapsed from last frame
     // this allows animation to look smooth regardless of fps
-    theta += 1.5f * dt;
-    if (theta > 2 * M_PI)
-      theta -= 2 * M_PI;
+    waves.theta += 1.5f * dt;
+    if (waves.theta > 2 * M_PI)
+      waves.theta -= 2 * M_PI;
   }
 
   void onDraw(Graphics &g) {
     g.clear();
     // use textures to color meshes
     g.texture();
+    // copy the newest field into the texture. This doesn't wait for the
+    // GPU, which copies while the next field is being written
+    tex.update();
     // bind the texture we want to use
     tex.bind();
     // render the quad to apply texture
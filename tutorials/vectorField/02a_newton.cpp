@@ -14,6 +14,10 @@ Kon Hyong Kim - Jan 2021
 
 #include "al/app/al_App.hpp"
 #include <vector>
+
+#include "IncrementalNewton.hpp"
+#include "StreamingTexture.hpp"
+
 using namespace al;
 
 class FieldApp : public App {
@@ -25,15 +29,23 @@ public:
   // scale of the vector field
   float scale;
 
-  // std::vector to store the color of the vector field
-  std::vector<Color> field;
-
-  // Texture to store the image
-  Texture tex;
+  // Texture to store the image, with upload buffers the field is
+  // evaluated straight into (see StreamingTexture.hpp)
+  StreamingTexture tex;
 
   // Rectangle mesh to apply the texture
   VAOMesh quad;
 
+  // evaluates the field in tiles across all cores, four pixels at a time
+  FieldEngine engine;
+
+  // the algorithm used in the example (see NewtonBasins in
+  // FieldKernels.hpp). Only coef changes, and slowly: set
+  // newton.approximate to only iterate the pixels around those whose root
+  // changed, plus a few rows to refresh the rest, at the cost of a few
+  // stale pixels (see IncrementalNewton.hpp)
+  IncrementalNewton newton;
+
   // variables for the algorithm's artistic manipulation
   float coef;
   bool goUp;
@@ -49,6 +61,9 @@ public:
     goUp = true;
 
     baseColor = Color(0.4f, 0.5f, 0.3f, 1.f);
+    for (int k = 0; k < 4; ++k) {
+      newton.basins.color[k] = baseColor[k];
+    }
   }
 
   void onCreate() {
@@ -57,15 +72,14 @@ public:
     // Some elements like nav need to be modified after being created
     nav().pos(0, 0, 4);
 
-    // resize the field container
-    field.resize(xRes * yRes);
+    // the field covers -0.5~0.5 x -0.5~0.5, scaled
+    engine.resize(xRes, yRes);
+    engine.bounds(-0.5f * scale, -0.5f * scale, 0.5f * scale, 0.5f * scale);
 
-    // set the filters for the texture. Default: NEAREST
-    tex.filterMag(Texture::LINEAR);
-    tex.filterMin(Texture::LINEAR);
-
-    // create a texture unit on the GPU
-    tex.create2D(xRes, yRes, Texture::RGBA32F, Texture::RGBA, Texture::FLOAT);
+    // create a texture unit on the GPU, filtered LINEAR, and three
+    // buffers to upload the field through. 8 bits per channel are what
+    // the display shows, a quarter of the bytes of floats to upload
+    tex.create(xRes, yRes, 3, field::RGBA8);
 
     // create the quad mesh to apply texture on
     quad.primitive(Mesh::TRIANGLE_STRIP);
@@ -82,58 +96,20 @@ public:
     quad.update();
   }
 
-  // square of complex number
-  Vec2f p2(Vec2f p) {
-    return Vec2f(p[0] * p[0] - p[1] * p[1], 2.f * p[0] * p[1]);
-  }
-
-  // cube of complex number
-  Vec2f p3(Vec2f p) {
-    return Vec2f(p[0] * p[0] * p[0] - 3.f * p[0] * p[1] * p[1],
-                 3.f * p[0] * p[0] * p[1] - p[1] * p[1] * p[1]);
-  }
-
-  // function to apply newton's method
-  // here we use p_next = p^9 + coef * p - i
-  // with coef as the artistic manipulation
-  Vec2f myF(Vec2f p) { return p3(p3(p)) + coef * p - Vec2f(0.f, 1.f); }
-
-  // derivative of the function above
-  Vec2f myFPrime(Vec2f p) { return 9.f * p2(p2(p2(p))) + Vec2f(coef, 0.f); }
-
   void onAnimate(double dt) {
-    // reset the field
-    for (auto &f : field) {
-      f.set(0);
-    }
-
-    for (int j = 0; j < yRes; ++j) {
-      for (int i = 0; i < xRes; ++i) {
-        // get the middle of the pixel in a vector field -0.5~0.5 x -0.5~0.5
-        Vec2f p((i + 0.5f) / (float)xRes - 0.5f,
-                (j + 0.5f) / (float)yRes - 0.5f);
-
-        // scale the vector field size
-        p *= scale;
-
-        // apply newton's method to find the root of the function
-        // on each iteration add a bit of the base color
-        // to the corresponding vector field
-        int t = 0;
-        while (myF(p).mag() > 1E-3 && t < 100) {
-          Vec2f f = myF(p);
-          Vec2f fP = myFPrime(p);
-
-          p = p - Vec2f((f[0] * fP[0] + f[1] * fP[1]) /
-                            (fP[0] * fP[0] + fP[1] * fP[1]),
-                        (f[1] * fP[0] - f[0] * fP[1]) /
-                            (fP[0] * fP[0] + fP[1] * fP[1]));
-
-          field[i + j * xRes] += 0.02f * baseColor;
-
-          ++t;
-        }
-      }
+    // apply newton's method to find the root of the function
+    // p_next = p^9 + coef * p - i in the middle of every pixel.
+    // On each iteration a bit of the base color is added to the pixel,
+    // see NewtonBasins in FieldKernels.hpp.
+    // The engine runs it in tiles across all cores, four pixels at a time,
+    // converted to 8 bit as it goes. It writes straight into an upload
+    // buffer. If the GPU is behind and all buffers are busy this frame is
+    // skipped
+    newton.basins.coef = coef;
+    void *pixels = tex.beginWrite();
+    if (pixels) {
+      newton.evaluate(engine, pixels, tex.format());
+      tex.endWrite();
     }
 
     // increment the parameters based on the time elapsed from last frame
@@ -147,15 +123,15 @@ public:
       if (coef < -0.3f)
         goUp = true;
     }
-
-    // update the texture with the modified vector field
-    tex.submit(field.data());
   }
 
   void onDraw(Graphics &g) {
     g.clear();
     // use textures to color meshes
     g.texture();
+    // copy the newest field into the texture. This doesn't wait for the
+    // GPU, which copies while the next field is being written
+    tex.update();
     // bind the texture we want to use
     tex.bind();
     // render the quad to apply texture
@@ -0,0 +1,378 @@
+#pragma once
+#ifndef FIELD_ENGINE_HPP
+#define FIELD_ENGINE_HPP
+
+// Parallel evaluation of a color field over a grid of pixels, for the
+// vectorField tutorials.
+//
+// The image is cut into tiles (64 x 16 pixels by default) and the tiles are
+// handed out by a work-stealing ThreadPool, so expensive areas of the field
+// (slow to converge Newton basins, say) are spread over the threads. Inside
+// a tile the kernel is called once per row span with the x coordinates of
+// the pixel centers, which the engine computes once per resize. Spans always
+// hold a multiple of four pixels: a span that is cut short by the right edge
+// of the image is evaluated into padded scratch memory and copied, so
+// kernels can process four pixels at a time with Float4 and never need a
+// scalar tail loop.
+//
+// Pixel (i, j) has its center at
+//   x = ((i + 0.5) / width - 0.5) * (xMax - xMin) + (xMin + xMax) / 2
+//   y = ((j + 0.5) / height - 0.5) * (yMax - yMin) + (yMin + yMax) / 2
+// which, with bounds of +-scale / 2, is the point the tutorials compute in
+// their loops, rounded the same way. Output is RGBA, four floats per pixel in rows of width
+// pixels, the layout of std::vector<al::Color>, or one of the packed
+// formats of PixelFormats.hpp.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "common/SimdOps.hpp"
+#include "common/ThreadPool.hpp"
+
+#include "PixelFormats.hpp"
+
+namespace field {
+
+// Four floats processed together: SSE on x86, NEON on ARM, plain loops
+// elsewhere
+#if defined(PLAYGROUND_SIMD_SSE)
+struct Float4 {
+  __m128 v;
+  Float4() = default;
+  Float4(__m128 x) : v(x) {}
+  Float4(float x) : v(_mm_set1_ps(x)) {}
+  static Float4 load(const float *p) { return _mm_loadu_ps(p); }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+};
+struct Mask4 {
+  __m128 v;
+};
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+inline Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+inline Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+inline Float4 round(Float4 a) {
+  return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v));
+}
+inline Mask4 operator<(Float4 a, Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask4 operator>(Float4 a, Float4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Mask4 operator&(Mask4 a, Mask4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Mask4 andNot(Mask4 a, Mask4 b) { return {_mm_andnot_ps(b.v, a.v)}; }
+inline bool any(Mask4 m) { return _mm_movemask_ps(m.v) != 0; }
+inline Float4 select(Mask4 m, Float4 a, Float4 b) {
+  return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+}
+// Stores four pixels, given as the four channels of each
+inline void storeRGBA(float *out, Float4 r, Float4 g, Float4 b, Float4 a) {
+  _MM_TRANSPOSE4_PS(r.v, g.v, b.v, a.v);
+  r.store(out);
+  g.store(out + 4);
+  b.store(out + 8);
+  a.store(out + 12);
+}
+#elif defined(PLAYGROUND_SIMD_NEON)
+struct Float4 {
+  float32x4_t v;
+  Float4() = default;
+  Float4(float32x4_t x) : v(x) {}
+  Float4(float x) : v(vdupq_n_f32(x)) {}
+  static Float4 load(const float *p) { return vld1q_f32(p); }
+  void store(float *p) const { vst1q_f32(p, v); }
+};
+struct Mask4 {
+  uint32x4_t v;
+};
+inline Float4 operator+(Float4 a, Float4 b) { return vaddq_f32(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return vsubq_f32(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return vmulq_f32(a.v, b.v); }
+inline Float4 operator/(Float4 a, Float4 b) {
+  // Reciprocal estimate and two Newton-Raphson steps (ARMv7 has no divide)
+  float32x4_t r = vrecpeq_f32(b.v);
+  r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+  r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+  return vmulq_f32(a.v, r);
+}
+inline Float4 sqrt(Float4 a) {
+  float32x4_t r = vrsqrteq_f32(a.v);
+  r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+  r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a.v, r), r));
+  // sqrt(0) would be 0 * inf
+  const uint32x4_t zero = vceqq_f32(a.v, vdupq_n_f32(0.0f));
+  return vbslq_f32(zero, a.v, vmulq_f32(a.v, r));
+}
+inline Float4 min(Float4 a, Float4 b) { return vminq_f32(a.v, b.v); }
+inline Float4 max(Float4 a, Float4 b) { return vmaxq_f32(a.v, b.v); }
+inline Float4 round(Float4 a) {
+  const uint32x4_t negative = vcltq_f32(a.v, vdupq_n_f32(0.0f));
+  const float32x4_t half =
+      vbslq_f32(negative, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+  return vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(a.v, half)));
+}
+inline Mask4 operator<(Float4 a, Float4 b) { return {vcltq_f32(a.v, b.v)}; }
+inline Mask4 operator>(Float4 a, Float4 b) { return {vcgtq_f32(a.v, b.v)}; }
+inline Mask4 operator&(Mask4 a, Mask4 b) { return {vandq_u32(a.v, b.v)}; }
+inline Mask4 andNot(Mask4 a, Mask4 b) { return {vbicq_u32(a.v, b.v)}; }
+inline bool any(Mask4 m) {
+  const uint32x2_t half = vorr_u32(vget_low_u32(m.v), vget_high_u32(m.v));
+  return (vget_lane_u32(half, 0) | vget_lane_u32(half, 1)) != 0;
+}
+inline Float4 select(Mask4 m, Float4 a, Float4 b) {
+  return vbslq_f32(m.v, a.v, b.v);
+}
+inline void storeRGBA(float *out, Float4 r, Float4 g, Float4 b, Float4 a) {
+  float32x4x4_t pixels = {{r.v, g.v, b.v, a.v}};
+  vst4q_f32(out, pixels);
+}
+#else
+struct Float4 {
+  float v[4];
+  Float4() = default;
+  Float4(float x) : v{x, x, x, x} {}
+  static Float4 load(const float *p) {
+    Float4 r;
+    std::memcpy(r.v, p, sizeof(r.v));
+    return r;
+  }
+  void store(float *p) const { std::memcpy(p, v, sizeof(v)); }
+};
+struct Mask4 {
+  bool v[4];
+};
+#define FIELD_FLOAT4_LANES(result, expression)                                 \
+  for (int k = 0; k < 4; k++) {                                                \
+    result.v[k] = (expression);                                                \
+  }
+inline Float4 operator+(Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, a.v[k] + b.v[k]);
+  return r;
+}
+inline Float4 operator-(Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, a.v[k] - b.v[k]);
+  return r;
+}
+inline Float4 operator*(Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, a.v[k] * b.v[k]);
+  return r;
+}
+inline Float4 operator/(Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, a.v[k] / b.v[k]);
+  return r;
+}
+inline Float4 sqrt(Float4 a) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, std::sqrt(a.v[k]));
+  return r;
+}
+inline Float4 min(Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, std::min(a.v[k], b.v[k]));
+  return r;
+}
+inline Float4 max(Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, std::max(a.v[k], b.v[k]));
+  return r;
+}
+inline Float4 round(Float4 a) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, std::floor(a.v[k] + 0.5f));
+  return r;
+}
+inline Mask4 operator<(Float4 a, Float4 b) {
+  Mask4 m;
+  FIELD_FLOAT4_LANES(m, a.v[k] < b.v[k]);
+  return m;
+}
+inline Mask4 operator>(Float4 a, Float4 b) {
+  Mask4 m;
+  FIELD_FLOAT4_LANES(m, a.v[k] > b.v[k]);
+  return m;
+}
+inline Mask4 operator&(Mask4 a, Mask4 b) {
+  Mask4 m;
+  FIELD_FLOAT4_LANES(m, a.v[k] && b.v[k]);
+  return m;
+}
+inline Mask4 andNot(Mask4 a, Mask4 b) {
+  Mask4 m;
+  FIELD_FLOAT4_LANES(m, a.v[k] && !b.v[k]);
+  return m;
+}
+inline bool any(Mask4 m) { return m.v[0] || m.v[1] || m.v[2] || m.v[3]; }
+inline Float4 select(Mask4 m, Float4 a, Float4 b) {
+  Float4 r;
+  FIELD_FLOAT4_LANES(r, m.v[k] ? a.v[k] : b.v[k]);
+  return r;
+}
+#undef FIELD_FLOAT4_LANES
+inline void storeRGBA(float *out, Float4 r, Float4 g, Float4 b, Float4 a) {
+  for (int k = 0; k < 4; k++) {
+    out[k * 4] = r.v[k];
+    out[k * 4 + 1] = g.v[k];
+    out[k * 4 + 2] = b.v[k];
+    out[k * 4 + 3] = a.v[k];
+  }
+}
+#endif
+
+// Sine, within 1e-6 of std::sin for |x| < 1e4: the argument is reduced to
+// [-pi, pi], folded into [-pi/2, pi/2] with sin(pi - x) = sin(x), and the
+// Taylor series is taken up to x^11
+inline Float4 sin(Float4 x) {
+  const Float4 k = round(x * Float4(0.15915494f));
+  // 2 pi in two parts, the first exact in few bits, for an exact k * 2pi
+  x = x - k * Float4(6.28125f);
+  x = x - k * Float4(1.9353072e-3f);
+  const Float4 pi(3.14159265f), halfPi(1.57079633f);
+  x = select(x > halfPi, pi - x,
+             select(x < Float4(0.0f) - halfPi, Float4(0.0f) - pi - x, x));
+  const Float4 x2 = x * x;
+  Float4 s(-2.5052108e-8f);
+  s = s * x2 + Float4(2.7557319e-6f);
+  s = s * x2 + Float4(-1.9841270e-4f);
+  s = s * x2 + Float4(8.3333333e-3f);
+  s = s * x2 + Float4(-1.6666667e-1f);
+  s = s * x2 + Float4(1.0f);
+  return s * x;
+}
+
+// A span of pixels in one row of the image, given to the kernel
+struct Row {
+  int i, j;       // first pixel of the span
+  int count;      // pixels in the image
+  int n;          // count rounded up to a multiple of four
+  const float *x; // x of the n pixel centers (padding continues the row)
+  float y;        // y of the row
+  float *out;     // n RGBA pixels
+};
+
+// Adapts fn(x, y, rgba), evaluating one pixel, into a kernel. Handy for
+// trying out a field before vectorizing it.
+template <class Function> struct PixelKernel {
+  Function fn;
+  void operator()(const Row &row) const {
+    for (int k = 0; k < row.count; k++) {
+      fn(row.x[k], row.y, row.out + k * 4);
+    }
+  }
+};
+
+template <class Function> PixelKernel<Function> perPixel(Function fn) {
+  return PixelKernel<Function>{fn};
+}
+
+} // namespace field
+
+class FieldEngine {
+public:
+  // numThreads counts the calling thread; 0 uses every hardware thread
+  explicit FieldEngine(unsigned numThreads = 0) : mPool(numThreads) {
+    mScratch.resize(mPool.size());
+  }
+
+  void resize(int width, int height) {
+    mWidth = width;
+    mHeight = height;
+    updateCoordinates();
+  }
+
+  void bounds(float xMin, float yMin, float xMax, float yMax) {
+    mXMin = xMin;
+    mYMin = yMin;
+    mXMax = xMax;
+    mYMax = yMax;
+    updateCoordinates();
+  }
+
+  // Tile width is rounded up to a multiple of four
+  void tileSize(int width, int height) {
+    mTileWidth = std::max(4, (width + 3) / 4 * 4);
+    mTileHeight = std::max(1, height);
+  }
+
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+  float x(int i) const { return mX[size_t(i)]; }
+  float y(int j) const { return mY[size_t(j)]; }
+  ThreadPool &pool() { return mPool; }
+
+  // Calls kernel(const field::Row &) over the whole image, writing
+  // width() * height() pixels to out in the given format. The kernel always
+  // writes RGBA floats; for a packed format they go to scratch memory and
+  // are converted row by row while still in cache, so only the packed
+  // pixels reach out (often upload memory, written once and never read).
+  template <class Kernel>
+  void evaluate(Kernel &&kernel, void *out,
+                field::Format format = field::RGBA32F) {
+    const int tilesX = (mWidth + mTileWidth - 1) / mTileWidth;
+    const int tilesY = (mHeight + mTileHeight - 1) / mTileHeight;
+    const bool packed = format != field::RGBA32F;
+    const size_t pixelBytes = field::bytesPerPixel(format);
+    mPool.parallelFor(size_t(tilesX) * tilesY, [&](size_t t, unsigned worker) {
+      const int i0 = int(t % tilesX) * mTileWidth;
+      const int j0 = int(t / tilesX) * mTileHeight;
+      field::Row row;
+      row.i = i0;
+      row.count = std::min(mTileWidth, mWidth - i0);
+      row.n = (row.count + 3) / 4 * 4;
+      row.x = mX.data() + i0;
+      const bool direct = !packed && row.n == row.count;
+      std::vector<float> &scratch = mScratch[worker];
+      if (!direct && scratch.size() < size_t(row.n) * 4) {
+        scratch.resize(size_t(row.n) * 4);
+      }
+      const int j1 = std::min(j0 + mTileHeight, mHeight);
+      for (int j = j0; j < j1; j++) {
+        uint8_t *pixels = static_cast<uint8_t *>(out) +
+                          (size_t(j) * mWidth + i0) * pixelBytes;
+        row.j = j;
+        row.y = mY[size_t(j)];
+        row.out = direct ? reinterpret_cast<float *>(pixels) : scratch.data();
+        kernel(row);
+        if (packed) {
+          field::convert(format, row.out, pixels, size_t(row.count));
+        } else if (!direct) {
+          std::memcpy(pixels, row.out, size_t(row.count) * 4 * sizeof(float));
+        }
+      }
+    });
+  }
+
+private:
+  void updateCoordinates() {
+    // Padded by a few pixels past the right edge for the last span
+    mX.resize(size_t(mWidth) + 4);
+    // In the tutorials' order of operations, so the centers round the same
+    const float width = float(std::max(mWidth, 1));
+    const float xSize = mXMax - mXMin, xCenter = 0.5f * (mXMin + mXMax);
+    for (size_t i = 0; i < mX.size(); i++) {
+      mX[i] = ((i + 0.5f) / width - 0.5f) * xSize + xCenter;
+    }
+    mY.resize(size_t(mHeight));
+    const float height = float(std::max(mHeight, 1));
+    const float ySize = mYMax - mYMin, yCenter = 0.5f * (mYMin + mYMax);
+    for (size_t j = 0; j < mY.size(); j++) {
+      mY[j] = ((j + 0.5f) / height - 0.5f) * ySize + yCenter;
+    }
+  }
+
+  ThreadPool mPool;
+  int mWidth{0}, mHeight{0};
+  int mTileWidth{64}, mTileHeight{16};
+  float mXMin{-1}, mYMin{-1}, mXMax{1}, mYMax{1};
+  std::vector<float> mX, mY;                // pixel centers
+  std::vector<std::vector<float>> mScratch; // padded spans, per worker
+};
+
+#endif // FIELD_ENGINE_HPP
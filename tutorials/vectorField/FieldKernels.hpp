@@ -0,0 +1,91 @@
+#pragma once
+#ifndef FIELD_KERNELS_HPP
+#define FIELD_KERNELS_HPP
+
+// The fields of the vectorField tutorials as FieldEngine kernels, four
+// pixels at a time.
+
+#include "FieldEngine.hpp"
+
+// Rings of color: each channel is 0.5 * sin(k * radius + theta) + 0.5, with
+// k = 8, 7 and 5 for red, green and blue (01_basic_points, 02_texture and
+// 03_pbo)
+struct RadialWaves {
+  float theta{0};
+
+  void operator()(const field::Row &row) const {
+    using field::Float4;
+    const Float4 y(row.y), phase(theta), half(0.5f), one(1.0f);
+    for (int k = 0; k < row.n; k += 4) {
+      const Float4 x = Float4::load(row.x + k);
+      const Float4 radius = field::sqrt(x * x + y * y);
+      const Float4 r = half * field::sin(Float4(8.0f) * radius + phase) + half;
+      const Float4 g = half * field::sin(Float4(7.0f) * radius + phase) + half;
+      const Float4 b = half * field::sin(Float4(5.0f) * radius + phase) + half;
+      field::storeRGBA(row.out + k * 4, r, g, b, one);
+    }
+  }
+};
+
+// Newton's method on f(p) = p^9 + coef * p - i over the complex plane
+// (02a_newton). Every iteration a pixel takes adds 0.02 of the base color,
+// so the color shows how long its point takes to converge. The four pixels
+// of a group iterate together until all of them converged or ran out of
+// iterations; the ones that are done keep their point and count.
+struct NewtonBasins {
+  float coef{-0.2f};
+  float color[4]{0.4f, 0.5f, 0.3f, 1.0f};
+  int maxIterations{100};
+  float tolerance{1e-3f};
+
+  void operator()(const field::Row &row) const {
+    using field::Float4;
+    for (int k = 0; k < row.n; k += 4) {
+      Float4 x = Float4::load(row.x + k), y(row.y), iterations;
+      solve(x, y, iterations);
+      store(row.out + k * 4, iterations);
+    }
+  }
+
+  // Runs Newton's method from the four points (x, y), leaving the point
+  // each one stopped at in (x, y) and its number of iterations
+  void solve(field::Float4 &x, field::Float4 &y,
+             field::Float4 &iterations) const {
+    using field::Float4;
+    using field::Mask4;
+    const Float4 c(coef), tol(tolerance);
+    iterations = Float4(0.0f);
+    for (int t = 0; t < maxIterations; t++) {
+      // f(p) and f'(p) as p3(p3(p)) and p2(p2(p2(p))) like the tutorial
+      const Float4 x3 = x * x * x - Float4(3.0f) * x * y * y;
+      const Float4 y3 = Float4(3.0f) * x * x * y - y * y * y;
+      const Float4 x9 = x3 * x3 * x3 - Float4(3.0f) * x3 * y3 * y3;
+      const Float4 y9 = Float4(3.0f) * x3 * x3 * y3 - y3 * y3 * y3;
+      const Float4 x2 = x * x - y * y, y2 = Float4(2.0f) * x * y;
+      const Float4 x4 = x2 * x2 - y2 * y2, y4 = Float4(2.0f) * x2 * y2;
+      const Float4 x8 = x4 * x4 - y4 * y4, y8 = Float4(2.0f) * x4 * y4;
+      const Float4 fx = x9 + c * x, fy = y9 + c * y - Float4(1.0f);
+      const Mask4 active = field::sqrt(fx * fx + fy * fy) > tol;
+      if (!field::any(active)) {
+        break;
+      }
+      // p -= f / f', with f' = 9 p^8 + coef
+      const Float4 dx = Float4(9.0f) * x8 + c, dy = Float4(9.0f) * y8;
+      const Float4 d = dx * dx + dy * dy;
+      x = field::select(active, x - (fx * dx + fy * dy) / d, x);
+      y = field::select(active, y - (fy * dx - fx * dy) / d, y);
+      iterations =
+          field::select(active, iterations + Float4(1.0f), iterations);
+    }
+  }
+
+  // Stores the colors of four pixels with the given iteration counts
+  void store(float *out, field::Float4 iterations) const {
+    using field::Float4;
+    const Float4 weight = Float4(0.02f) * iterations;
+    field::storeRGBA(out, weight * Float4(color[0]), weight * Float4(color[1]),
+                     weight * Float4(color[2]), weight * Float4(color[3]));
+  }
+};
+
+#endif // FIELD_KERNELS_HPP
@@ -0,0 +1,236 @@
+#pragma once
+#ifndef INCREMENTAL_NEWTON_HPP
+#define INCREMENTAL_NEWTON_HPP
+
+// Incremental evaluation of NewtonBasins for 02a_newton, where only coef
+// changes, and only a little every frame.
+//
+// Every pixel caches its iteration count and the root it converged to (its
+// basin). The nine roots of the function are tracked from frame to frame by
+// Newton's method, warm started from where they were in the previous frame,
+// so a pixel's basin keeps its number while the roots move.
+//
+// Each frame recomputes one row in refreshPeriod, rolling over the image, and
+// every group of four pixels where a pixel or one of its neighbors changed
+// basin when it was last recomputed. Unchanged pixels are
+// skipped and show their cached count. Changes are found where the refresh
+// passes, then followed to the pixels around them frame by frame, which
+// tracks basin boundaries as they move. The change flags of the previous
+// frame are read while those of the current one are written, so the tiles
+// can run in parallel. No count is older than refreshPeriod frames. A large
+// jump in coef, a resize or invalidate() recomputes everything.
+//
+// The field is chaotic close to the basin boundaries, which cover much of
+// the image: even the tutorial's drift of coef changes about 10% of the
+// counts from one frame to the next, mostly by one or two iterations. Those
+// pixels show their count of up to refreshPeriod frames ago, so skipping is
+// off unless approximate is set. Otherwise every pixel is evaluated every
+// frame and nothing is cached.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "FieldEngine.hpp"
+#include "FieldKernels.hpp"
+
+class IncrementalNewton {
+public:
+  static const int kRoots = 9;
+
+  // Parameters of the field. maxIterations must stay below 255.
+  NewtonBasins basins;
+
+  // Skip the pixels away from basin changes. At the tutorial's drift this
+  // iterates about a quarter of the pixels, but about 4% of them show a
+  // stale count, off by up to 1.8 in color (see newton_bench.cpp). Off by
+  // default: every pixel is evaluated by NewtonBasins, exactly
+  bool approximate{false};
+
+  // Every row is recomputed at least once in this many frames
+  int refreshPeriod{16};
+
+  // Also follow pixels whose count changed, not only their basin: fewer
+  // stale pixels for more work
+  bool followCounts{false};
+
+  // A change of coef larger than this since the last frame recomputes
+  // every pixel
+  float maxDrift{1e-2f};
+
+  // Recomputes every pixel in the next frame
+  void invalidate() { mValid = false; }
+
+  // Evaluates the field into width() * height() pixels of the engine, in
+  // the given format
+  void evaluate(FieldEngine &engine, void *out,
+                field::Format format = field::RGBA32F) {
+    const int width = engine.width(), height = engine.height();
+    if (width != mWidth || height != mHeight) {
+      mWidth = width;
+      mHeight = height;
+      const size_t size = size_t(width) * height;
+      mCount.assign(size, 0);
+      mBasin.assign(size, uint8_t(kNone));
+      mChanged[0].assign(size, 0);
+      mChanged[1].assign(size, 0);
+      mValid = false;
+    }
+    if (!approximate) {
+      // Nothing cached: the next approximate frame starts from scratch
+      engine.evaluate(basins, out, format);
+      mEvaluated = size_t(width) * height;
+      mValid = false;
+      mRootsValid = false;
+      return;
+    }
+    if (std::abs(basins.coef - mCoef) > maxDrift) {
+      mValid = false;
+    }
+    mCoef = basins.coef;
+    trackRoots();
+
+    const bool full = !mValid;
+    const uint8_t *previous = mChanged[mCurrent].data();
+    uint8_t *current = mChanged[1 - mCurrent].data();
+    mEvaluated = 0;
+    engine.evaluate(
+        [&](const field::Row &row) {
+          using field::Float4;
+          const bool refresh = full || (row.j + mFrame) % refreshPeriod == 0;
+          size_t evaluated = 0;
+          for (int k = 0; k < row.n; k += 4) {
+            const int i = row.i + k;
+            const size_t index = size_t(row.j) * mWidth + i;
+            const int lanes = std::min(4, row.count - k);
+            bool dirty = refresh || lanes < 4;
+            for (int l = 0; l < 4 && !dirty; l++) {
+              dirty = nearChange(previous, i + l, row.j);
+            }
+            if (!dirty) {
+              std::memset(current + index, 0, 4);
+              float counts[4];
+              for (int l = 0; l < 4; l++) {
+                counts[l] = mCount[index + l];
+              }
+              basins.store(row.out + k * 4, Float4::load(counts));
+              continue;
+            }
+            Float4 x = Float4::load(row.x + k), y(row.y), iterations;
+            basins.solve(x, y, iterations);
+            basins.store(row.out + k * 4, iterations);
+            float xs[4], ys[4], counts[4];
+            x.store(xs);
+            y.store(ys);
+            iterations.store(counts);
+            for (int l = 0; l < lanes; l++) {
+              const uint8_t count = uint8_t(counts[l]);
+              const uint8_t basin = basinOf(xs[l], ys[l], count);
+              current[index + l] =
+                  basin != mBasin[index + l] ||
+                  (followCounts && count != mCount[index + l]);
+              mCount[index + l] = count;
+              mBasin[index + l] = basin;
+            }
+            evaluated += size_t(lanes);
+          }
+          mEvaluated.fetch_add(evaluated, std::memory_order_relaxed);
+        },
+        out, format);
+    mCurrent = 1 - mCurrent;
+    mFrame++;
+    mValid = true;
+  }
+
+  // Pixels iterated in the last frame
+  size_t lastEvaluated() const { return mEvaluated.load(); }
+
+  // The tracked roots, x and y of each
+  const float *roots() const { return mRoots; }
+
+private:
+  static const uint8_t kNone = 255; // did not converge
+
+  // Newton's method for a single root, in double precision
+  void polish(double &x, double &y, int iterations) const {
+    const double c = basins.coef;
+    for (int t = 0; t < iterations; t++) {
+      double x2 = x * x - y * y, y2 = 2 * x * y;
+      double x4 = x2 * x2 - y2 * y2, y4 = 2 * x2 * y2;
+      double x8 = x4 * x4 - y4 * y4, y8 = 2 * x4 * y4;
+      double fx = x8 * x - y8 * y + c * x, fy = x8 * y + y8 * x + c * y - 1;
+      double dx = 9 * x8 + c, dy = 9 * y8;
+      double d = dx * dx + dy * dy;
+      if (d == 0) {
+        return;
+      }
+      double nx = x - (fx * dx + fy * dy) / d;
+      y -= (fy * dx - fx * dy) / d;
+      x = nx;
+    }
+  }
+
+  // Roots of p^9 = i - coef * p: close to the ninth roots of i for small
+  // coef, and close to where they were for a slightly different coef
+  void trackRoots() {
+    for (int r = 0; r < kRoots; r++) {
+      double x, y;
+      if (mRootsValid) {
+        x = mRoots[r * 2];
+        y = mRoots[r * 2 + 1];
+      } else {
+        const double angle = (M_PI / 2 + 2 * M_PI * r) / kRoots;
+        x = std::cos(angle);
+        y = std::sin(angle);
+      }
+      polish(x, y, mRootsValid ? 4 : 50);
+      mRoots[r * 2] = float(x);
+      mRoots[r * 2 + 1] = float(y);
+    }
+    mRootsValid = true;
+  }
+
+  // The root a pixel's point converged to
+  uint8_t basinOf(float x, float y, int iterations) const {
+    if (iterations >= basins.maxIterations) {
+      return kNone;
+    }
+    int nearest = 0;
+    float distance = 1e30f;
+    for (int r = 0; r < kRoots; r++) {
+      const float dx = x - mRoots[r * 2], dy = y - mRoots[r * 2 + 1];
+      const float d = dx * dx + dy * dy;
+      if (d < distance) {
+        distance = d;
+        nearest = r;
+      }
+    }
+    return distance < 1e-2f ? uint8_t(nearest) : uint8_t(kNone);
+  }
+
+  // Whether pixel (i, j) or one of its neighbors changed
+  bool nearChange(const uint8_t *changed, int i, int j) const {
+    const size_t index = size_t(j) * mWidth + i;
+    return changed[index] || (i > 0 && changed[index - 1]) ||
+           (i + 1 < mWidth && changed[index + 1]) ||
+           (j > 0 && changed[index - mWidth]) ||
+           (j + 1 < mHeight && changed[index + mWidth]);
+  }
+
+  int mWidth{0}, mHeight{0};
+  std::vector<uint8_t> mCount;      // iterations of every pixel
+  std::vector<uint8_t> mBasin;      // root of every pixel
+  std::vector<uint8_t> mChanged[2]; // pixels that changed, last and this frame
+  int mCurrent{0};                  // mChanged of the last frame
+  float mRoots[kRoots * 2];
+  bool mRootsValid{false};
+  bool mValid{false};
+  float mCoef{0};
+  int mFrame{0};
+  std::atomic<size_t> mEvaluated{0};
+};
+
+#endif // INCREMENTAL_NEWTON_HPP
@@ -0,0 +1,276 @@
+#pragma once
+#ifndef PIXEL_FORMATS_HPP
+#define PIXEL_FORMATS_HPP
+
+// Packed pixel formats for fields that are only displayed, and conversions
+// from RGBA floats into them, four pixels at a time.
+//
+//   RGBA32F  16 bytes, as computed
+//   RGBA16F   8 bytes, half floats: values above 1 and fine gradients
+//   RGB10A2   4 bytes, 10 bits per color and 2 of alpha
+//   RGBA8     4 bytes, what the display shows
+//
+// RGBA8 and RGB10A2 clamp to [0, 1] and round to nearest. RGB10A2 is packed
+// as GL_UNSIGNED_INT_2_10_10_10_REV, red in the low bits. RGBA16F rounds to
+// nearest even, keeps infinities and NaN and produces denormals. The SSE2
+// and NEON paths give the same bits as the scalar ones (NaN payloads
+// aside).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "common/SimdOps.hpp"
+
+#if defined(PLAYGROUND_SIMD_SSE) && defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace field {
+
+enum Format { RGBA32F, RGBA16F, RGB10A2, RGBA8 };
+
+inline size_t bytesPerPixel(Format format) {
+  switch (format) {
+  case RGBA32F:
+    return 16;
+  case RGBA16F:
+    return 8;
+  default:
+    return 4;
+  }
+}
+
+inline const char *formatName(Format format) {
+  static const char *names[] = {"RGBA32F", "RGBA16F", "RGB10A2", "RGBA8"};
+  return names[format];
+}
+
+namespace detail {
+
+inline uint32_t bits(float x) {
+  uint32_t u;
+  std::memcpy(&u, &x, 4);
+  return u;
+}
+
+inline float unitClamp(float x) {
+  // Also maps NaN to 0
+  return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+}
+
+// Rounds non-negative x to nearest, halves up, like the SIMD paths: they
+// add 0.5 and truncate too
+inline uint32_t roundUnsigned(float x) { return uint32_t(x + 0.5f); }
+
+// Float to half float, after Fabian Giesen's float_to_half_fast3
+inline uint16_t toHalf(float x) {
+  const uint32_t infinity = 255u << 23, halfMax = (127u + 16) << 23;
+  const uint32_t denormalMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+  uint32_t f = bits(x);
+  const uint32_t sign = f & 0x80000000u;
+  f ^= sign;
+  uint32_t h;
+  if (f >= halfMax) {
+    h = f > infinity ? 0x7e00 : 0x7c00; // NaN or infinity
+  } else if (f < (113u << 23)) {
+    // Denormal: let the FPU shift the mantissa into place and round
+    float shifted, magic;
+    std::memcpy(&shifted, &f, 4);
+    std::memcpy(&magic, &denormalMagic, 4);
+    h = bits(shifted + magic) - denormalMagic;
+  } else {
+    const uint32_t odd = (f >> 13) & 1;
+    f += ((15u - 127u) << 23) + 0xfff + odd; // rebias and round to even
+    h = f >> 13;
+  }
+  return uint16_t(h | (sign >> 16));
+}
+
+} // namespace detail
+
+// n RGBA float pixels to RGBA8
+inline void toRGBA8(const float *in, void *out, size_t n) {
+  uint8_t *o = static_cast<uint8_t *>(out);
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+  auto convert = [&](const float *p) {
+    __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), zero), one);
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, scale), half));
+  };
+  for (; i < n / 4 * 4; i += 4) {
+    const float *p = in + i * 4;
+    const __m128i lo = _mm_packs_epi32(convert(p), convert(p + 4));
+    const __m128i hi = _mm_packs_epi32(convert(p + 8), convert(p + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(o + i * 4),
+                     _mm_packus_epi16(lo, hi));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  auto convert = [&](const float *p) {
+    float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(p), zero), one);
+    return vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(half, x, 255.0f)));
+  };
+  for (; i < n / 4 * 4; i += 4) {
+    const float *p = in + i * 4;
+    const uint16x8_t lo = vcombine_u16(convert(p), convert(p + 4));
+    const uint16x8_t hi = vcombine_u16(convert(p + 8), convert(p + 12));
+    vst1q_u8(o + i * 4, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+  }
+#endif
+  for (; i < n; i++) {
+    for (int c = 0; c < 4; c++) {
+      o[i * 4 + c] = uint8_t(
+          detail::roundUnsigned(detail::unitClamp(in[i * 4 + c]) * 255.0f));
+    }
+  }
+}
+
+// n RGBA float pixels to RGB10A2
+inline void toRGB10A2(const float *in, void *out, size_t n) {
+  uint8_t *o = static_cast<uint8_t *>(out);
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE)
+  const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  auto convert = [&](__m128 x, float scale) {
+    x = _mm_min_ps(_mm_max_ps(x, zero), one);
+    x = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(scale)), half);
+    return _mm_cvttps_epi32(x);
+  };
+  for (; i < n / 4 * 4; i += 4) {
+    const float *p = in + i * 4;
+    __m128 r = _mm_loadu_ps(p), g = _mm_loadu_ps(p + 4);
+    __m128 b = _mm_loadu_ps(p + 8), a = _mm_loadu_ps(p + 12);
+    _MM_TRANSPOSE4_PS(r, g, b, a); // four pixels to four channels
+    __m128i packed = convert(r, 1023.0f);
+    packed = _mm_or_si128(packed, _mm_slli_epi32(convert(g, 1023.0f), 10));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(convert(b, 1023.0f), 20));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(convert(a, 3.0f), 30));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(o + i * 4), packed);
+  }
+#elif defined(PLAYGROUND_SIMD_NEON)
+  const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  auto convert = [&](float32x4_t x, float scale) {
+    x = vminq_f32(vmaxq_f32(x, zero), one);
+    return vcvtq_u32_f32(vmlaq_n_f32(half, x, scale));
+  };
+  for (; i < n / 4 * 4; i += 4) {
+    const float32x4x4_t p = vld4q_f32(in + i * 4); // deinterleaves
+    uint32x4_t packed = convert(p.val[0], 1023.0f);
+    packed = vorrq_u32(packed, vshlq_n_u32(convert(p.val[1], 1023.0f), 10));
+    packed = vorrq_u32(packed, vshlq_n_u32(convert(p.val[2], 1023.0f), 20));
+    packed = vorrq_u32(packed, vshlq_n_u32(convert(p.val[3], 3.0f), 30));
+    vst1q_u32(reinterpret_cast<uint32_t *>(o + i * 4), packed);
+  }
+#endif
+  for (; i < n; i++) {
+    const float *p = in + i * 4;
+    const uint32_t packed =
+        detail::roundUnsigned(detail::unitClamp(p[0]) * 1023.0f) |
+        detail::roundUnsigned(detail::unitClamp(p[1]) * 1023.0f) << 10 |
+        detail::roundUnsigned(detail::unitClamp(p[2]) * 1023.0f) << 20 |
+        detail::roundUnsigned(detail::unitClamp(p[3]) * 3.0f) << 30;
+    std::memcpy(o + i * 4, &packed, 4);
+  }
+}
+
+// n RGBA float pixels to RGBA16F
+inline void toRGBA16F(const float *in, void *out, size_t n) {
+  uint8_t *o = static_cast<uint8_t *>(out);
+  size_t i = 0;
+#if defined(PLAYGROUND_SIMD_SSE) && defined(__F16C__)
+  // The conversion instruction, where the compiler may use it (-mf16c)
+  for (; i < n / 2 * 2; i += 2) {
+    const __m128i lo = _mm_cvtps_ph(_mm_loadu_ps(in + i * 4), 0);
+    const __m128i hi = _mm_cvtps_ph(_mm_loadu_ps(in + i * 4 + 4), 0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(o + i * 8),
+                     _mm_unpacklo_epi64(lo, hi));
+  }
+#elif defined(PLAYGROUND_SIMD_SSE)
+  // detail::toHalf() on four floats, with selects instead of branches
+  const __m128i signMask = _mm_set1_epi32(int(0x80000000u));
+  const __m128i infinity = _mm_set1_epi32(255 << 23);
+  const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);
+  const __m128i denormalLimit = _mm_set1_epi32(113 << 23);
+  const __m128i denormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1)
+                                               << 23);
+  const __m128i rebias = _mm_set1_epi32(int((15u - 127u) << 23) + 0xfff);
+  const __m128i oneBit = _mm_set1_epi32(1);
+  const __m128i offset = _mm_set1_epi32(0x8000);
+  const __m128i offset16 = _mm_set1_epi16(short(0x8000));
+  auto convert = [&](const float *p) {
+    __m128i f = _mm_castps_si128(_mm_loadu_ps(p));
+    const __m128i sign = _mm_and_si128(f, signMask);
+    f = _mm_xor_si128(f, sign);
+    // Above the half range: infinity, or a quiet NaN
+    const __m128i nan = _mm_cmpgt_epi32(f, infinity);
+    const __m128i large = _mm_or_si128(
+        _mm_cmpgt_epi32(f, halfMax), _mm_cmpeq_epi32(f, halfMax));
+    const __m128i special = _mm_or_si128(
+        _mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x0200)));
+    // Denormals
+    const __m128i small = _mm_cmplt_epi32(f, denormalLimit);
+    const __m128i denormal = _mm_sub_epi32(
+        _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(f),
+                                    _mm_castsi128_ps(denormalMagic))),
+        denormalMagic);
+    // Normals
+    const __m128i odd = _mm_and_si128(_mm_srli_epi32(f, 13), oneBit);
+    const __m128i normal = _mm_srli_epi32(
+        _mm_add_epi32(_mm_add_epi32(f, rebias), odd), 13);
+    __m128i h = _mm_or_si128(_mm_and_si128(small, denormal),
+                             _mm_andnot_si128(small, normal));
+    h = _mm_or_si128(_mm_and_si128(large, special),
+                     _mm_andnot_si128(large, h));
+    h = _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+    // Centered around zero for the signed saturating pack below
+    return _mm_sub_epi32(h, offset);
+  };
+  for (; i < n / 2 * 2; i += 2) {
+    const __m128i packed =
+        _mm_packs_epi32(convert(in + i * 4), convert(in + i * 4 + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(o + i * 8),
+                     _mm_xor_si128(packed, offset16));
+  }
+#elif defined(PLAYGROUND_SIMD_NEON) && defined(__aarch64__)
+  for (; i < n / 2 * 2; i += 2) {
+    const float16x8_t h = vcombine_f16(vcvt_f16_f32(vld1q_f32(in + i * 4)),
+                                       vcvt_f16_f32(vld1q_f32(in + i * 4 + 4)));
+    vst1q_u16(reinterpret_cast<uint16_t *>(o + i * 8),
+              vreinterpretq_u16_f16(h));
+  }
+#endif
+  for (; i < n; i++) {
+    for (int c = 0; c < 4; c++) {
+      const uint16_t h = detail::toHalf(in[i * 4 + c]);
+      std::memcpy(o + i * 8 + c * 2, &h, 2);
+    }
+  }
+}
+
+// n RGBA float pixels to the given format
+inline void convert(Format format, const float *in, void *out, size_t n) {
+  switch (format) {
+  case RGBA32F:
+    std::memcpy(out, in, n * 16);
+    break;
+  case RGBA16F:
+    toRGBA16F(in, out, n);
+    break;
+  case RGB10A2:
+    toRGB10A2(in, out, n);
+    break;
+  case RGBA8:
+    toRGBA8(in, out, n);
+    break;
+  }
+}
+
+} // namespace field
+
+#endif // PIXEL_FORMATS_HPP
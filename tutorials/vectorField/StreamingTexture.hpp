@@ -0,0 +1,339 @@
+#pragma once
+#ifndef STREAMING_TEXTURE_HPP
+#define STREAMING_TEXTURE_HPP
+
+// Texture whose pixels are rewritten every frame, uploaded through a ring of
+// persistently mapped pixel buffers.
+//
+// The upload memory is one GL buffer holding numSlots frames, mapped once
+// for the lifetime of the texture (GL 4.4 / ARB_buffer_storage, coherent
+// mapping). The producer asks for a slot with beginWrite(), writes the
+// frame straight into mapped memory (a FieldEngine can evaluate into it
+// from any thread) and hands it over with endWrite(). On the graphics
+// thread, update() copies the newest finished frame into the texture from
+// its slot and puts a fence behind the copy; the slot is only handed out
+// again once the fence has passed. With three slots the producer writes one
+// frame while the previous one waits and the one before is being copied, so
+// neither side waits for the other. If the producer gets ahead, the older
+// of two waiting frames is dropped; if the GPU falls behind, beginWrite()
+// returns nullptr instead of blocking and the producer skips a frame.
+//
+// Every copy is timed with a GL timer query, read back when its slot is
+// retired, so bandwidth() reports what the transfers actually achieve.
+//
+// The texture holds one of the formats of PixelFormats.hpp. The packed ones
+// (RGBA8 for what the display shows, RGB10A2, RGBA16F) take a half to a
+// quarter of the memory, bus and copy time of RGBA32F; FieldEngine converts
+// into them as it evaluates.
+//
+// Without buffer storage (macOS stops at GL 4.1) the slots are plain memory
+// and update() uploads from it with glTexSubImage2D, which copies in the
+// driver before returning.
+//
+// create(), update(), bind() and destroy() need the GL context.
+// beginWrite() and endWrite() may be called from one other thread.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "al/graphics/al_OpenGL.hpp"
+#include "al/graphics/al_Texture.hpp"
+
+#include "PixelFormats.hpp"
+
+class StreamingTexture {
+public:
+  static const int kMaxSlots = 4;
+
+  StreamingTexture() = default;
+  StreamingTexture(const StreamingTexture &) = delete;
+  StreamingTexture &operator=(const StreamingTexture &) = delete;
+  ~StreamingTexture() { destroy(); }
+
+  // Texture of width x height pixels in the given format with numSlots
+  // upload buffers (2 to kMaxSlots)
+  void create(int width, int height, int numSlots = 3,
+              field::Format format = field::RGBA32F) {
+    destroy();
+    mWidth = width;
+    mHeight = height;
+    mFormat = format;
+    mNumSlots = std::min(std::max(numSlots, 2), int(kMaxSlots));
+    mFrameBytes = size_t(width) * height * field::bytesPerPixel(format);
+    // Slots start on 256 byte boundaries, enough for any texture upload
+    mSlotStride = (mFrameBytes + 255) / 256 * 256;
+
+    mTexture.filterMag(al::Texture::LINEAR);
+    mTexture.filterMin(al::Texture::LINEAR);
+    mTexture.create2D(width, height, internalFormat(), GL_RGBA, pixelType());
+
+    const size_t bytes = mSlotStride * mNumSlots;
+    mPersistent = glBufferStorage != nullptr;
+    if (mPersistent) {
+      const GLbitfield flags =
+          GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glGenBuffers(1, &mBuffer);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(bytes), nullptr,
+                      flags);
+      mMemory = static_cast<uint8_t *>(
+          glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(bytes),
+                           flags));
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      mPersistent = mMemory != nullptr;
+      if (!mPersistent) {
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+      }
+    }
+    if (!mPersistent) {
+      mFallback.assign(bytes, 0);
+      mMemory = mFallback.data();
+    }
+    glGenQueries(mNumSlots, mQueries);
+    for (int s = 0; s < mNumSlots; s++) {
+      mSlots[s].state.store(kFree);
+      mSlots[s].frame.store(0);
+      mSlots[s].fence = nullptr;
+      mSlots[s].timed = false;
+    }
+    mProduced = 0;
+    mUploaded = mDropped = mSkipped = 0;
+    resetBandwidth();
+  }
+
+  void destroy() {
+    if (mNumSlots == 0) {
+      return;
+    }
+    for (int s = 0; s < mNumSlots; s++) {
+      if (mSlots[s].fence) {
+        glDeleteSync(mSlots[s].fence);
+        mSlots[s].fence = nullptr;
+      }
+    }
+    glDeleteQueries(mNumSlots, mQueries);
+    if (mBuffer) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      glDeleteBuffers(1, &mBuffer);
+      mBuffer = 0;
+    }
+    mFallback.clear();
+    mMemory = nullptr;
+    mTexture.destroy();
+    mNumSlots = 0;
+  }
+
+  int width() const { return mWidth; }
+  int height() const { return mHeight; }
+  field::Format format() const { return mFormat; }
+  size_t frameBytes() const { return mFrameBytes; }
+  bool persistent() const { return mPersistent; }
+
+  // Producer: memory for the next frame, width() * height() pixels of
+  // format() in rows from the bottom, or nullptr if every slot is still in
+  // use
+  void *beginWrite() {
+    for (int s = 0; s < mNumSlots; s++) {
+      int expected = kFree;
+      if (mSlots[s].state.compare_exchange_strong(expected, kWriting,
+                                                  std::memory_order_acquire)) {
+        mWriting = s;
+        return mMemory + mSlotStride * s;
+      }
+    }
+    mSkipped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  // Producer: the frame of the last beginWrite() is complete
+  void endWrite() {
+    Slot &slot = mSlots[mWriting];
+    slot.frame.store(++mProduced, std::memory_order_relaxed);
+    slot.state.store(kReady, std::memory_order_release);
+    // An older frame still waiting will never be shown
+    for (int s = 0; s < mNumSlots; s++) {
+      int expected = kReady;
+      if (s != mWriting &&
+          mSlots[s].frame.load(std::memory_order_relaxed) < mProduced &&
+          mSlots[s].state.compare_exchange_strong(expected, kFree)) {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Graphics thread: copies the newest complete frame into the texture.
+  // Returns false if there was none.
+  bool update() {
+    retire(false);
+    int newest;
+    for (;;) {
+      // The producer may reuse a slot while its frame is read here; the
+      // exchange below makes sure the chosen slot is still ready
+      newest = -1;
+      uint64_t newestFrame = 0;
+      for (int s = 0; s < mNumSlots; s++) {
+        if (mSlots[s].state.load(std::memory_order_acquire) != kReady) {
+          continue;
+        }
+        const uint64_t frame = mSlots[s].frame.load(std::memory_order_relaxed);
+        if (newest < 0 || frame > newestFrame) {
+          newest = s;
+          newestFrame = frame;
+        }
+      }
+      if (newest < 0) {
+        return false;
+      }
+      // Fails if the producer just replaced it with a newer frame
+      int expected = kReady;
+      if (mSlots[newest].state.compare_exchange_strong(
+              expected, kUploading, std::memory_order_acquire)) {
+        break;
+      }
+    }
+
+    Slot &slot = mSlots[newest];
+    const bool timed = !mTiming;
+    if (timed) {
+      // One query at a time: GL_TIME_ELAPSED queries can't overlap
+      glBeginQuery(GL_TIME_ELAPSED, mQueries[newest]);
+      mTiming = true;
+    }
+    mTexture.bind();
+    if (mPersistent) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, GL_RGBA,
+                      pixelType(),
+                      reinterpret_cast<void *>(mSlotStride * newest));
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, GL_RGBA,
+                      pixelType(), mMemory + mSlotStride * newest);
+    }
+    mTexture.unbind();
+    if (timed) {
+      glEndQuery(GL_TIME_ELAPSED);
+    }
+    slot.timed = timed;
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state.store(kInFlight, std::memory_order_relaxed);
+    mUploaded++;
+    return true;
+  }
+
+  // Graphics thread: waits for every copy in flight, e.g. before timing
+  void finish() { retire(true); }
+
+  void bind(int unit = 0) { mTexture.bind(unit); }
+  void unbind(int unit = 0) { mTexture.unbind(unit); }
+  al::Texture &texture() { return mTexture; }
+
+  // Bytes per second of the copies into the texture, as timed on the GPU
+  // since create() or resetBandwidth()
+  double bandwidth() const {
+    return mTimedSeconds > 0 ? mTimedBytes / mTimedSeconds : 0;
+  }
+  void resetBandwidth() {
+    mTimedBytes = 0;
+    mTimedSeconds = 0;
+  }
+
+  // Frames copied into the texture, frames the producer wrote that were
+  // replaced by newer ones before being copied, and beginWrite() calls that
+  // found no free slot
+  size_t uploaded() const { return mUploaded; }
+  size_t dropped() const { return mDropped.load(); }
+  size_t skipped() const { return mSkipped.load(); }
+
+private:
+  enum State { kFree, kWriting, kReady, kUploading, kInFlight };
+
+  struct Slot {
+    std::atomic<int> state{kFree};
+    std::atomic<uint64_t> frame{0}; // written by the producer only
+    GLsync fence{nullptr};
+    bool timed{false};
+  };
+
+  GLint internalFormat() const {
+    switch (mFormat) {
+    case field::RGBA16F:
+      return GL_RGBA16F;
+    case field::RGB10A2:
+      return GL_RGB10_A2;
+    case field::RGBA8:
+      return GL_RGBA8;
+    default:
+      return GL_RGBA32F;
+    }
+  }
+
+  GLenum pixelType() const {
+    switch (mFormat) {
+    case field::RGBA16F:
+      return GL_HALF_FLOAT;
+    case field::RGB10A2:
+      return GL_UNSIGNED_INT_2_10_10_10_REV;
+    case field::RGBA8:
+      return GL_UNSIGNED_BYTE;
+    default:
+      return GL_FLOAT;
+    }
+  }
+
+  // Frees the slots whose copies have completed
+  void retire(bool wait) {
+    for (int s = 0; s < mNumSlots; s++) {
+      Slot &slot = mSlots[s];
+      if (slot.state.load(std::memory_order_relaxed) != kInFlight) {
+        continue;
+      }
+      // Waiting flushes the fence to the GPU first, or it could time out
+      // without ever being reached
+      const GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+      const GLuint64 timeout = wait ? GLuint64(1000000000) : 0;
+      const GLenum status = glClientWaitSync(slot.fence, flags, timeout);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        continue;
+      }
+      glDeleteSync(slot.fence);
+      slot.fence = nullptr;
+      if (slot.timed) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(mQueries[s], GL_QUERY_RESULT, &nanoseconds);
+        mTimedBytes += double(mFrameBytes);
+        mTimedSeconds += nanoseconds * 1e-9;
+        slot.timed = false;
+        mTiming = false;
+      }
+      slot.state.store(kFree, std::memory_order_release);
+    }
+  }
+
+  al::Texture mTexture;
+  int mWidth{0}, mHeight{0};
+  field::Format mFormat{field::RGBA32F};
+  int mNumSlots{0};
+  size_t mFrameBytes{0}, mSlotStride{0};
+  bool mPersistent{false};
+  GLuint mBuffer{0};
+  uint8_t *mMemory{nullptr};
+  std::vector<uint8_t> mFallback; // slots without buffer storage
+  Slot mSlots[kMaxSlots];
+  GLuint mQueries[kMaxSlots]{};
+  bool mTiming{false}; // a timer query is running or unread
+
+  int mWriting{0};       // producer's slot
+  uint64_t mProduced{0}; // producer's frame counter
+  size_t mUploaded{0};
+  std::atomic<size_t> mDropped{0}, mSkipped{0};
+  double mTimedBytes{0}, mTimedSeconds{0};
+};
+
+#endif // STREAMING_TEXTURE_HPP
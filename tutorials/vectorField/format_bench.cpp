@@ -0,0 +1,79 @@
+// Benchmark for the packed pixel formats of PixelFormats.hpp: what producing
+// each format costs on the CPU, at 2048 x 2048.
+//
+// "convert" is the conversion alone from RGBA floats in cache-sized rows,
+// SIMD against the scalar code the kernels fall back to, in millions of
+// pixels per second; "same" checks that both give the same bits. "waves"
+// is a frame of RadialWaves evaluated by FieldEngine into each format, on
+// every hardware thread, and "MB" the bytes it leaves for the upload. The
+// upload itself is timed per format by texture_stream_bench.cpp.
+//
+// Build and run with ./run.sh tutorials/vectorField/format_bench.cpp
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "FieldKernels.hpp"
+
+const int kSize = 2048;
+const size_t kRow = 1024; // pixels per conversion call
+
+// The scalar tails of the conversions, one pixel at a time
+void convertScalar(field::Format format, const float *in, void *out,
+                   size_t n) {
+  uint8_t *o = static_cast<uint8_t *>(out);
+  for (size_t i = 0; i < n; i++) {
+    field::convert(format, in + i * 4, o + i * field::bytesPerPixel(format),
+                   1);
+  }
+}
+
+int main() {
+  const size_t pixels = size_t(kSize) * kSize;
+  // Colors in [0, 1] with some out of range, as fields produce them
+  std::vector<float> colors(kRow * 4);
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> uniform(-0.1f, 1.1f);
+  for (float &c : colors) {
+    c = uniform(random);
+  }
+
+  FieldEngine engine;
+  engine.resize(kSize, kSize);
+  engine.bounds(-1, -1, 1, 1);
+  RadialWaves waves;
+  std::vector<uint8_t> out(pixels * 16), simd(kRow * 16), scalar(kRow * 16);
+
+  printf("%dx%d, %u threads for waves\n", kSize, kSize, engine.pool().size());
+  printf("%-8s %12s %12s %5s %9s %6s\n", "format", "simd Mpx/s",
+         "scalar Mpx/s", "same", "waves ms", "MB");
+  for (field::Format format :
+       {field::RGBA32F, field::RGBA16F, field::RGB10A2, field::RGBA8}) {
+    const double simdTime = bench::measure([&] {
+      for (size_t p = 0; p < pixels; p += kRow) {
+        field::convert(format, colors.data(), simd.data(), kRow);
+        bench::keep(simd[0]);
+      }
+    });
+    const double scalarTime = bench::measure([&] {
+      for (size_t p = 0; p < pixels; p += kRow) {
+        convertScalar(format, colors.data(), scalar.data(), kRow);
+        bench::keep(scalar[0]);
+      }
+    });
+    const size_t bytes = kRow * field::bytesPerPixel(format);
+    const bool same = std::memcmp(simd.data(), scalar.data(), bytes) == 0;
+    const double wavesTime =
+        bench::measure([&] { engine.evaluate(waves, out.data(), format); });
+    printf("%-8s %12.0f %12.0f %5s %9.2f %6.1f\n", field::formatName(format),
+           pixels / simdTime * 1e-6, pixels / scalarTime * 1e-6,
+           same ? "yes" : "NO", wavesTime * 1e3,
+           pixels * field::bytesPerPixel(format) * 1e-6);
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Benchmark for IncrementalNewton against evaluating every pixel of
+// 02a_newton's field every frame: frame time, share of pixels iterated and
+// the difference to the full evaluation, over 120 frames of coef drifting
+// down from -0.2.
+//
+// "tutorial" drifts coef at the rate of 02a_newton at 60 frames per second
+// (0.0002 per second), "100x" a hundred times faster, which moves the basin
+// boundaries a pixel or more every few frames. Errors are per frame, in
+// color units (a count off by one is 0.02 * base color); "wrong" is the
+// share of pixels whose color differs from the full evaluation. "exact" is
+// the default, which recomputes every pixel and must match; "basin" skips
+// the pixels away from basin changes (IncrementalNewton::approximate),
+// "count" also follows those whose count changed (followCounts).
+//
+// Build and run with ./run.sh tutorials/vectorField/newton_bench.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "common/Benchmark.hpp"
+
+#include "IncrementalNewton.hpp"
+
+const int kFrames = 120;
+
+struct Drift {
+  const char *name;
+  float perFrame;
+};
+
+enum Mode { kExact, kBasin, kCount };
+const char *const kModeNames[] = {"exact", "basin", "count"};
+
+// Returns false if the exact mode differs from the full evaluation
+bool run(const Drift &drift, int size, Mode mode) {
+  FieldEngine engine;
+  engine.resize(size, size);
+  engine.bounds(-1, -1, 1, 1);
+  NewtonBasins full;
+  IncrementalNewton incremental;
+  incremental.approximate = mode != kExact;
+  incremental.followCounts = mode == kCount;
+  std::vector<float> reference(size_t(size) * size * 4), out(reference.size());
+
+  // The first frame computes everything in both
+  double fullTime = 0, incrementalTime = 0, iterated = 0;
+  float maxError = 0;
+  double meanError = 0, wrong = 0;
+  for (int f = 0; f < kFrames; f++) {
+    const float coef = -0.2f - drift.perFrame * f;
+    full.coef = incremental.basins.coef = coef;
+
+    auto start = bench::Clock::now();
+    engine.evaluate(full, reference.data());
+    fullTime += bench::secondsSince(start);
+    start = bench::Clock::now();
+    incremental.evaluate(engine, out.data());
+    incrementalTime += bench::secondsSince(start);
+    iterated += double(incremental.lastEvaluated()) / (size * size);
+
+    size_t differing = 0;
+    for (size_t p = 0; p < reference.size(); p += 4) {
+      float e = 0;
+      for (int k = 0; k < 4; k++) {
+        e = std::max(e, std::abs(reference[p + k] - out[p + k]));
+      }
+      maxError = std::max(maxError, e);
+      meanError += e;
+      differing += e > 0 ? 1 : 0;
+    }
+    wrong += double(differing) / (size * size);
+  }
+  printf("%-9s %-6s %4dx%-4d %8.2f %8.2f %8.1f%% %10.3f %10.1e %7.2f%%\n",
+         drift.name, kModeNames[mode], size, size, fullTime / kFrames * 1e3,
+         incrementalTime / kFrames * 1e3, iterated / kFrames * 100, maxError,
+         meanError / kFrames / (size * size), wrong / kFrames * 100);
+  fflush(stdout);
+  return mode != kExact || maxError == 0;
+}
+
+int main() {
+  const Drift drifts[] = {{"tutorial", 0.0002f / 60}, {"100x", 0.02f / 60}};
+  printf("%u hardware threads, %d frames\n",
+         std::max(1u, std::thread::hardware_concurrency()), kFrames);
+  printf("%-9s %-6s %9s %8s %8s %9s %10s %10s %8s\n", "drift", "mode", "size",
+         "full ms", "incr ms", "iterated", "max error", "mean error", "wrong");
+  bool exact = true;
+  for (const Drift &drift : drifts) {
+    for (int size : {512, 1024}) {
+      for (Mode mode : {kExact, kBasin, kCount}) {
+        exact = run(drift, size, mode) && exact;
+      }
+    }
+  }
+  if (!exact) {
+    printf("FAILED: the exact mode differs from the full evaluation\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,193 @@
+// Benchmark for StreamingTexture: upload bandwidth of a new RGBA float field
+// every frame, at 512 x 512 up to 3840 x 2160, against the two ways the
+// tutorials uploaded before.
+//
+//   submit  Texture::submit() from a std::vector (02_texture.cpp)
+//   pbo x2  two PBOs, orphaned, mapped and filled with memcpy every frame,
+//           one uploading while the other is filled (03_pbo.cpp)
+//   stream  StreamingTexture with three persistently mapped slots
+//
+// Every method uploads 240 frames as fast as it can, copying the same field
+// into its upload memory (which stands in for evaluating into it), then
+// waits for the GPU with glFinish(). "cpu ms" is the time per frame spent in
+// the calls, "MB/s" the frames' bytes over the total time including the
+// wait. For the stream, "gpu MB/s" is StreamingTexture::bandwidth(), the
+// copies into the texture as timed by GL timer queries, and "skipped" the
+// frames for which every slot was still busy.
+//
+// A second table streams 2048 x 2048 frames in each format of
+// PixelFormats.hpp, with the time per upload on the GPU. The frames are
+// copied in already converted; format_bench.cpp times the conversions.
+//
+// This one needs a GL context, so it is an app: it opens a window, prints
+// the table and quits.
+//
+// Build and run with ./run.sh tutorials/vectorField/texture_stream_bench.cpp
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "al/app/al_App.hpp"
+
+#include "common/Benchmark.hpp"
+
+#include "StreamingTexture.hpp"
+
+using namespace al;
+
+const int kFrames = 240;
+
+struct Result {
+  double cpu = 0, total = 0;
+};
+
+Result uploadSubmit(int width, int height, const std::vector<float> &field) {
+  Texture tex;
+  tex.create2D(width, height, Texture::RGBA32F, Texture::RGBA, Texture::FLOAT);
+  glFinish();
+  Result r;
+  auto start = bench::Clock::now();
+  for (int f = 0; f < kFrames; f++) {
+    tex.submit(field.data());
+  }
+  r.cpu = bench::secondsSince(start);
+  glFinish();
+  r.total = bench::secondsSince(start);
+  tex.destroy();
+  return r;
+}
+
+Result uploadPbo(int width, int height, const std::vector<float> &field) {
+  Texture tex;
+  tex.create2D(width, height, Texture::RGBA32F, Texture::RGBA, Texture::FLOAT);
+  const size_t size = field.size() * sizeof(float);
+  BufferObject buffer[2];
+  for (auto &b : buffer) {
+    b.bufferType(GL_PIXEL_UNPACK_BUFFER);
+    b.usage(GL_STREAM_DRAW);
+    b.create();
+    b.bind();
+    b.data(size, nullptr);
+    b.unbind();
+  }
+  glFinish();
+  Result r;
+  auto start = bench::Clock::now();
+  for (int f = 0; f < kFrames; f++) {
+    const int index = f % 2, next = 1 - index;
+    tex.bind();
+    buffer[index].bind();
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT,
+                    0);
+    buffer[next].bind();
+    buffer[next].data(size, nullptr);
+    void *ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (ptr) {
+      std::memcpy(ptr, field.data(), size);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    buffer[next].unbind();
+    tex.unbind();
+  }
+  r.cpu = bench::secondsSince(start);
+  glFinish();
+  r.total = bench::secondsSince(start);
+  for (auto &b : buffer) {
+    b.destroy();
+  }
+  tex.destroy();
+  return r;
+}
+
+Result uploadStream(int width, int height, const std::vector<float> &field,
+                    StreamingTexture &stream,
+                    field::Format format = field::RGBA32F) {
+  stream.create(width, height, 3, format);
+  glFinish();
+  Result r;
+  auto start = bench::Clock::now();
+  for (int f = 0; f < kFrames; f++) {
+    void *pixels = stream.beginWrite();
+    if (pixels) {
+      std::memcpy(pixels, field.data(), stream.frameBytes());
+      stream.endWrite();
+    }
+    stream.update();
+  }
+  r.cpu = bench::secondsSince(start);
+  glFinish();
+  stream.finish();
+  r.total = bench::secondsSince(start);
+  return r;
+}
+
+struct BenchApp : App {
+  void onCreate() override {
+    const int sizes[][2] = {{512, 512}, {1024, 1024}, {2048, 2048},
+                            {3840, 2160}};
+    printf("%d frames per method\n", kFrames);
+    printf("%-10s %-8s %8s %9s %9s %8s\n", "size", "method", "cpu ms",
+           "MB/s", "gpu MB/s", "skipped");
+    for (auto &size : sizes) {
+      const int width = size[0], height = size[1];
+      std::vector<float> field(size_t(width) * height * 4);
+      for (size_t i = 0; i < field.size(); i++) {
+        field[i] = float(i % 251) / 250.0f;
+      }
+      const double megabytes = field.size() * sizeof(float) * 1e-6;
+      auto print = [&](const char *method, const Result &r, double gpu,
+                       size_t skipped) {
+        const size_t frames = kFrames - skipped;
+        printf("%4dx%-5d %-8s %8.3f %9.0f", width, height, method,
+               r.cpu / kFrames * 1e3, frames * megabytes / r.total);
+        if (gpu > 0) {
+          printf(" %9.0f %8zu", gpu * 1e-6, skipped);
+        }
+        printf("\n");
+      };
+      print("submit", uploadSubmit(width, height, field), 0, 0);
+      print("pbo x2", uploadPbo(width, height, field), 0, 0);
+      StreamingTexture stream;
+      Result r = uploadStream(width, height, field, stream);
+      print(stream.persistent() ? "stream" : "stream*", r, stream.bandwidth(),
+            stream.skipped());
+      fflush(stdout);
+    }
+    printf("(* without persistent mapping)\n\n");
+
+    const int width = 2048, height = 2048;
+    const size_t pixels = size_t(width) * height;
+    std::vector<float> field(pixels * 4);
+    for (size_t i = 0; i < field.size(); i++) {
+      field[i] = float(i % 251) / 250.0f;
+    }
+    printf("%dx%d streamed per format\n", width, height);
+    printf("%-8s %8s %8s %9s %9s %9s %8s\n", "format", "MB", "cpu ms",
+           "MB/s", "gpu MB/s", "upload ms", "skipped");
+    for (field::Format format :
+         {field::RGBA32F, field::RGBA16F, field::RGB10A2, field::RGBA8}) {
+      // The field converted, in the front of a buffer of the float size
+      std::vector<float> frame(field.size());
+      field::convert(format, field.data(), frame.data(), pixels);
+      StreamingTexture stream;
+      Result r = uploadStream(width, height, frame, stream, format);
+      const double megabytes = stream.frameBytes() * 1e-6;
+      const size_t frames = kFrames - stream.skipped();
+      const double gpu = stream.bandwidth();
+      printf("%-8s %8.1f %8.3f %9.0f %9.0f %9.3f %8zu\n",
+             field::formatName(format), megabytes, r.cpu / kFrames * 1e3,
+             frames * megabytes / r.total, gpu * 1e-6,
+             gpu > 0 ? stream.frameBytes() / gpu * 1e3 : 0.0,
+             stream.skipped());
+      fflush(stdout);
+    }
+    quit();
+  }
+};
+
+int main() {
+  BenchApp app;
+  app.start();
+  return 0;
+}